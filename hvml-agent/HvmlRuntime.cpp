@@ -176,7 +176,7 @@ bool HvmlRuntime::GetDollarString(hvml_string_t& dollar_s,
             if (! vdom) return false;
 
             A(hvml_dom_type(vdom) == MKDOT(D_JSON), "internal logic error");
-            hvml_jo_value_t* jo = hvml_dom_jo(vdom);
+            hvml_jo_value_t* jo = hvml_dom_jo_shared(vdom);
             if (hvml_jo_value_type(jo) == MKJOT(J_STRING)) {
                 const char *s;
                 if (! hvml_jo_string_get(jo, &s)) {
@@ -208,6 +208,24 @@ bool HvmlRuntime::GetDollarString(hvml_string_t& dollar_s,
             if ('$' != init_as_s[0]) return false;
             hvml_dom_t* vdom = FindInitData(&init_as_s[1]);
             if (! vdom) return false;
+
+            if (strncmp(dollar_s.str, "$?.", 3)) return false;
+            if (dollar_index < 0) return false;
+
+            A(hvml_dom_type(vdom) == MKDOT(D_JSON), "internal logic error");
+            hvml_jo_value_t* jo = hvml_dom_jo_shared(vdom);
+            hvml_jo_value_t* item = hvml_jo_array_get(jo, (size_t)dollar_index);
+            if (! item) return false;
+
+            const char* key = &dollar_s.str[3];
+            hvml_jo_value_t* val = hvml_jo_object_get(item, key, strlen(key));
+            if (val && hvml_jo_value_type(val) == MKJOT(J_STRING)) {
+                const char *s;
+                if (! hvml_jo_string_get(val, &s)) {
+                    hvml_string_set(output_s, s, strlen(s));
+                    return true;
+                }
+            }
         } break;
     }
 
@@ -0,0 +1,105 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_atom_h_
+#define _hvml_atom_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// process-wide table of interned names, such as tag names and attribute keys
+// equal names are interned as the same atom, thus compared by value
+// atoms live till the process exits, thus the table grows with every distinct
+// name, by a few dozen bytes plus the name itself, up to 2^32-1 atoms
+// lookups and names of atoms take no lock, interning a new name does
+typedef uint32_t                     hvml_atom_t;
+
+// predefined atoms, which need no interning
+typedef enum {
+    HVML_ATOM_NONE,
+
+    // tags
+
+    HVML_ATOM_HVML,
+    HVML_ATOM_HEAD,
+    HVML_ATOM_BODY,
+
+    HVML_ATOM_ARCHETYPE,
+    HVML_ATOM_ARCHEDATA,
+    HVML_ATOM_ERROR,
+    HVML_ATOM_EXCEPT,
+    HVML_ATOM_INIT,
+    HVML_ATOM_SET,
+    HVML_ATOM_UPDATE,
+    HVML_ATOM_REMOVE,
+    HVML_ATOM_EMPTY,
+    HVML_ATOM_TEST,
+    HVML_ATOM_MATCH,
+    HVML_ATOM_CHOOSE,
+    HVML_ATOM_ITERATE,
+    HVML_ATOM_REDUCE,
+    HVML_ATOM_SORT,
+    HVML_ATOM_OBSERVE,
+    HVML_ATOM_FIRE,
+    HVML_ATOM_REQUEST,
+    HVML_ATOM_CONNECT,
+    HVML_ATOM_SEND,
+    HVML_ATOM_DISCONNECT,
+    HVML_ATOM_LOAD,
+    HVML_ATOM_BACK,
+    HVML_ATOM_DEFINE,
+    HVML_ATOM_INCLUDE,
+    HVML_ATOM_CALL,
+    HVML_ATOM_RETURN,
+    HVML_ATOM_CATCH,
+
+    // attribute keys of verbs
+    HVML_ATOM_ID,
+    HVML_ATOM_ON,
+    HVML_ATOM_IN,
+    HVML_ATOM_WITH,
+    HVML_ATOM_TO,
+    HVML_ATOM_AS,
+    HVML_ATOM_BY,
+    HVML_ATOM_FOR,
+    HVML_ATOM_AT,
+    HVML_ATOM_FROM,
+    HVML_ATOM_VIA,
+
+    HVML_ATOM_PREDEFINED           // # of predefined atoms
+} HVML_ATOM;
+
+// return the atom of name, which is interned if not yet
+// HVML_ATOM_NONE if out of memory, or of atoms
+hvml_atom_t     hvml_atom_intern(const char *name, size_t len);
+// return the atom of name, without interning it
+// HVML_ATOM_NONE if name has never been interned
+hvml_atom_t     hvml_atom_lookup(const char *name, size_t len);
+
+// null-terminated name of atom, NULL for HVML_ATOM_NONE
+const char*     hvml_atom_str(hvml_atom_t atom);
+size_t          hvml_atom_len(hvml_atom_t atom);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_atom_h_
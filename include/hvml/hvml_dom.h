@@ -18,6 +18,7 @@
 #ifndef _hvml_dom_h_
 #define _hvml_dom_h_
 
+#include "hvml/hvml_atom.h"
 #include "hvml/hvml_jo.h"
 
 #include <stddef.h>
@@ -45,9 +46,14 @@ typedef struct hvml_dom_gen_s                  hvml_dom_gen_t;
 typedef struct hvml_doms_s                     hvml_doms_t;
 typedef struct hvml_dom_context_node_s         hvml_dom_context_node_t;
 
+// zero-initialized as empty set
+// entries are unique, membership is hash-indexed once the set grows large
 struct hvml_doms_s {
     hvml_dom_t      **doms;
     size_t            ndoms;
+    size_t            cap;
+    hvml_dom_t      **set;      // open addressing, linear probing
+    size_t            slots;    // power of 2, or 0 if not indexed
 };
 
 struct hvml_dom_context_node_s {
@@ -63,6 +69,8 @@ int  hvml_doms_append_doms(hvml_doms_t *doms, hvml_doms_t *in);
 int  hvml_doms_reverse(hvml_doms_t *doms);
 int  hvml_doms_sort(hvml_doms_t *doms, hvml_doms_t *in);
 void hvml_doms_cleanup(hvml_doms_t *doms);
+// empties the set, but keeps its buffers for reuse
+void hvml_doms_reset(hvml_doms_t *doms);
 void hvml_doms_destroy(hvml_doms_t *doms);
 
 
@@ -76,6 +84,10 @@ hvml_dom_t* hvml_dom_set_val(hvml_dom_t *dom, const char *val, size_t val_len);
 hvml_dom_t* hvml_dom_append_content(hvml_dom_t *dom, const char *txt, size_t len);
 hvml_dom_t* hvml_dom_add_tag(hvml_dom_t *dom, const char *tag, size_t len);
 hvml_dom_t* hvml_dom_append_json(hvml_dom_t *dom, hvml_jo_value_t *jo);
+// append a copy of `from` alone, without its attrs or children
+// which shares its text, attr val or json if possible, see hvml_dom_clone_shared
+// dom might be null, for an orphan copy
+hvml_dom_t* hvml_dom_append_shared(hvml_dom_t *dom, hvml_dom_t *from);
 
 hvml_dom_t* hvml_dom_root(hvml_dom_t *dom);
 hvml_dom_t* hvml_dom_doc(hvml_dom_t *dom);
@@ -90,8 +102,8 @@ void        hvml_dom_detach(hvml_dom_t *dom);
 
 hvml_dom_t* hvml_dom_select(hvml_dom_t *dom, const char *selector);
 
-void        hvml_dom_str_serialize_file(const char *str, size_t len, FILE *out);
-void        hvml_dom_attr_val_serialize_file(const char *str, size_t len, FILE *out);
+int         hvml_dom_str_serialize_file(const char *str, size_t len, FILE *out);
+int         hvml_dom_attr_val_serialize_file(const char *str, size_t len, FILE *out);
 void        hvml_dom_attr_set_key(hvml_dom_t *dom, const char *key, size_t key_len);
 void        hvml_dom_attr_set_val(hvml_dom_t *dom, const char *val, size_t val_len);
 void        hvml_dom_set_text(hvml_dom_t *dom, const char *txt, size_t txt_len);
@@ -104,7 +116,11 @@ const char*   hvml_dom_tag_name(hvml_dom_t *dom);      // tag's name
 const char*   hvml_dom_attr_key(hvml_dom_t *dom);      // attr's key
 const char*   hvml_dom_attr_val(hvml_dom_t *dom);      // attr's val
 const char*   hvml_dom_text(hvml_dom_t *dom);          // elementText
-hvml_jo_value_t* hvml_dom_jo(hvml_dom_t *dom);         // elementJson
+hvml_jo_value_t* hvml_dom_jo(hvml_dom_t *dom);         // elementJson, copied first if shared
+hvml_jo_value_t* hvml_dom_jo_shared(hvml_dom_t *dom);  // elementJson, read-only since it might be shared
+// tag names and attr keys are interned, the same names are of the same atom
+hvml_atom_t   hvml_dom_tag_atom(hvml_dom_t *dom);
+hvml_atom_t   hvml_dom_attr_atom(hvml_dom_t *dom);
 
 int hvml_dom_position(hvml_dom_t *dom);
 
@@ -115,9 +131,26 @@ typedef void (*hvml_dom_back_traverse_cb)(hvml_dom_t *dom, int lvl, void *arg, i
 int         hvml_dom_back_traverse(hvml_dom_t *dom, void *arg, hvml_dom_back_traverse_cb back_traverse_cb);
 
 hvml_dom_t* hvml_dom_clone(hvml_dom_t *dom);
+// copy-on-write clone: nodes are copied, whereas texts, attr vals and jsons
+// are shared with dom, and with the other clones of it
+// texts and attr vals are immutable, replacing them unshares the node
+// jsons are copied by the first hvml_dom_jo on either side
+// note: strings of an arena document are copied instead
+hvml_dom_t* hvml_dom_clone_shared(hvml_dom_t *dom);
 
 hvml_dom_gen_t*   hvml_dom_gen_create();
+// all nodes and strings of the generated document are allocated from
+// an arena owned by its root, and released at once by hvml_dom_destroy(root)
+// nodes added later to such document go into the same arena
+// note: nodes detached from such document shall not outlive its root,
+//       hvml_dom_clone them if needed
+hvml_dom_gen_t*   hvml_dom_gen_create_with_arena();
 void              hvml_dom_gen_destroy(hvml_dom_gen_t *gen);
+// drop what's parsed so far and start over, the buffers are kept for reuse
+// arena and keep_origin settings stay as they are
+void              hvml_dom_gen_reset(hvml_dom_gen_t *gen);
+// keep the origin text of json numbers, see hvml_jo_gen_set_keep_origin
+void              hvml_dom_gen_set_keep_origin(hvml_dom_gen_t *gen, int keep);
 
 int               hvml_dom_gen_parse_char(hvml_dom_gen_t *gen, const char c);
 int               hvml_dom_gen_parse(hvml_dom_gen_t *gen, const char *buf, size_t len);
@@ -125,12 +158,45 @@ int               hvml_dom_gen_parse_string(hvml_dom_gen_t *gen, const char *str
 hvml_dom_t*       hvml_dom_gen_parse_end(hvml_dom_gen_t *gen);
 
 hvml_dom_t*       hvml_dom_load_from_stream(FILE *in);
+// maps the file and parses it in one go, into an arena document
+// text and attribute values needing no unescaping point into the mapping,
+// which is released together with the document
+hvml_dom_t*       hvml_dom_load_from_file(const char *path);
+
+// a binary image of a whole document, embedded json included, that loads
+// with no parsing: nodes are rebuilt in an arena by index, and strings point
+// into the mapped image, which is released together with the document
+// images are only meant to be loaded on the platform that saved them
+int               hvml_dom_save_snapshot(hvml_dom_t *dom, const char *path);
+hvml_dom_t*       hvml_dom_load_snapshot(const char *path);
 
 // https://www.w3.org/TR/1999/REC-xpath-19991116/
 // https://www.freeformatter.com/xpath-tester.html#ad-output
 // xpath'y query
 int hvml_dom_query(hvml_dom_t *dom, const char *path, hvml_doms_t *doms);
+
+// compile once, exec many times
+// hvml_dom_query(dom, path, doms) is equivalent to compile/exec/destroy
+typedef struct hvml_dom_xpath_s                hvml_dom_xpath_t;
+hvml_dom_xpath_t* hvml_dom_xpath_compile(const char *path);
+int               hvml_dom_xpath_exec(hvml_dom_xpath_t *xpath, hvml_dom_t *dom, hvml_doms_t *doms);
+void              hvml_dom_xpath_destroy(hvml_dom_xpath_t *xpath);
+// process-wide LRU cache of compiled xpath, keyed by the expression string
+// used by hvml_dom_xpath_compile thus hvml_dom_query as well
+// disabled by default, capacity of 0 disables and flushes it
+// handles still in use survive eviction, until destroyed
+int               hvml_dom_xpath_cache_set_capacity(size_t capacity);
 int hvml_dom_qry(hvml_dom_t *dom, const char *path, hvml_doms_t *doms);
+
+// antlr4 counterpart of hvml_dom_xpath_t
+// the parse tree is kept, thus exec only walks it
+// hvml_dom_qry(dom, path, doms) is equivalent to compile/exec/destroy
+typedef struct hvml_dom_qry_s                  hvml_dom_qry_t;
+hvml_dom_qry_t*   hvml_dom_qry_compile(const char *path);
+int               hvml_dom_qry_exec(hvml_dom_qry_t *qry, hvml_dom_t *dom, hvml_doms_t *doms);
+void              hvml_dom_qry_destroy(hvml_dom_qry_t *qry);
+// process-wide LRU cache, the same as hvml_dom_xpath_cache_set_capacity
+int               hvml_dom_qry_cache_set_capacity(size_t capacity);
 int hvml_dom_string_for_xpath(hvml_dom_t *dom, const char **v, int *allocated);
 
 #ifdef __cplusplus
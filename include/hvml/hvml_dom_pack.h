@@ -0,0 +1,74 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_dom_pack_h_
+#define _hvml_dom_pack_h_
+
+#include "hvml/hvml_dom.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// packed, read-only counterpart of a hvml_dom_t document
+// nodes live in one array and refer to each other by 32-bit index
+// attributes of a tag are stored as a contiguous run in another array
+// tag names and attribute keys are kept as atoms, the rest of strings are pooled
+// json values are cloned, and owned by the pack
+typedef struct hvml_dom_pack_s                 hvml_dom_pack_t;
+
+// a node is denoted by its index in the pack, starting from 1 at the D_ROOT
+// an attribute is denoted by its index, flagged with HVML_DOM_PACK_ATTR
+typedef uint32_t                               hvml_dom_pack_id_t;
+#define HVML_DOM_PACK_NONE        ((hvml_dom_pack_id_t)0)
+#define HVML_DOM_PACK_ATTR        ((hvml_dom_pack_id_t)0x80000000u)
+
+// dom shall be of D_ROOT or D_TAG, which is packed under a D_ROOT
+hvml_dom_pack_t*    hvml_dom_pack(hvml_dom_t *dom);
+hvml_dom_pack_t*    hvml_dom_pack_load_from_file(const char *path);
+// rebuild a hvml_dom_t document on the heap
+hvml_dom_t*         hvml_dom_unpack(hvml_dom_pack_t *pack);
+void                hvml_dom_pack_destroy(hvml_dom_pack_t *pack);
+
+// bytes held by the pack, json values excluded
+size_t              hvml_dom_pack_footprint(hvml_dom_pack_t *pack);
+size_t              hvml_dom_pack_nodes(hvml_dom_pack_t *pack);
+
+// the same as hvml_dom_root/parent/..., HVML_DOM_PACK_NONE if there's none
+hvml_dom_pack_id_t  hvml_dom_pack_root(hvml_dom_pack_t *pack);
+hvml_dom_pack_id_t  hvml_dom_pack_parent(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_dom_pack_id_t  hvml_dom_pack_next(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_dom_pack_id_t  hvml_dom_pack_prev(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_dom_pack_id_t  hvml_dom_pack_child(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_dom_pack_id_t  hvml_dom_pack_attr_head(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_dom_pack_id_t  hvml_dom_pack_attr_next(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr);
+
+HVML_DOM_TYPE       hvml_dom_pack_type(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+const char*         hvml_dom_pack_tag_name(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+const char*         hvml_dom_pack_attr_key(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr);
+const char*         hvml_dom_pack_attr_val(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr);
+const char*         hvml_dom_pack_text(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+hvml_jo_value_t*    hvml_dom_pack_jo(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_dom_pack_h_
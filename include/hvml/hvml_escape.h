@@ -0,0 +1,63 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_escape_h_
+#define _hvml_escape_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HVML_ESCAPE_DOM_TEXT,        // & <
+    HVML_ESCAPE_DOM_ATTR,        // & < "
+    HVML_ESCAPE_JSON,            // " \ \b \t \f \r \n \0
+} HVML_ESCAPE_SET;
+
+typedef enum {
+    HVML_ESCAPE_ISA_AUTO,        // the best one the running cpu supports
+    HVML_ESCAPE_ISA_SCALAR,
+    HVML_ESCAPE_ISA_SSE2,
+    HVML_ESCAPE_ISA_AVX2,
+} HVML_ESCAPE_ISA;
+
+// offset of the first byte in [s, s+len) that belongs to set
+// len if there's none
+size_t          hvml_escape_scan(HVML_ESCAPE_SET set, const char *s, size_t len);
+
+// the same, but with the given kernel, which must be supported
+size_t          hvml_escape_scan_isa(HVML_ESCAPE_ISA isa, HVML_ESCAPE_SET set, const char *s, size_t len);
+
+// 1: the running cpu supports isa
+int             hvml_escape_isa_supported(HVML_ESCAPE_ISA isa);
+
+// forces the kernel used by hvml_escape_scan and hvml_json_parse_buffer, for tests and benches
+// not thread-safe, call it before any serialization starts
+// -1: isa not supported
+int             hvml_escape_set_isa(HVML_ESCAPE_ISA isa);
+HVML_ESCAPE_ISA hvml_escape_get_isa(void);
+
+const char*     hvml_escape_isa_name(HVML_ESCAPE_ISA isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_escape_h_
+
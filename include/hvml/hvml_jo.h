@@ -18,6 +18,8 @@
 #ifndef _hvml_jo_h_
 #define _hvml_jo_h_
 
+#include "hvml/hvml_json_parser.h"
+#include "hvml/hvml_rstr.h"
 #include "hvml/hvml_string.h"
 
 #include <stdint.h>
@@ -51,10 +53,16 @@ hvml_jo_value_t* hvml_jo_true();
 hvml_jo_value_t* hvml_jo_false();
 hvml_jo_value_t* hvml_jo_null();
 hvml_jo_value_t* hvml_jo_number(const long double v, const char *orgin);
+// num->origin is copied, if not NULL
+hvml_jo_value_t* hvml_jo_number_from_json(const hvml_json_number_t *num);
 hvml_jo_value_t* hvml_jo_string(const char *v, size_t len);
 hvml_jo_value_t* hvml_jo_object();
 hvml_jo_value_t* hvml_jo_array();
 hvml_jo_value_t* hvml_jo_object_kv(const char *key, size_t len);
+// the same, but share the bytes of rs instead of copying
+hvml_jo_value_t* hvml_jo_number_shared(const long double v, hvml_rstr_t *origin);
+hvml_jo_value_t* hvml_jo_string_shared(hvml_rstr_t *rs);
+hvml_jo_value_t* hvml_jo_object_kv_shared(hvml_rstr_t *key);
 
 
 // if jo is of array, append val into array jo
@@ -63,6 +71,25 @@ hvml_jo_value_t* hvml_jo_object_kv(const char *key, size_t len);
 // otherwise, failed with -1
 int              hvml_jo_value_push(hvml_jo_value_t *jo, hvml_jo_value_t *val);
 
+// jo shall be of object, val shall be of orphan object_kv
+// append val as object jo's kv, and return val
+// otherwise, failed with NULL
+hvml_jo_value_t* hvml_jo_object_append_kv(hvml_jo_value_t *jo, hvml_jo_value_t *val);
+// jo shall be of object
+// return the first kv of object jo, whose key matches, or NULL if not found
+// objects with many keys are hash-indexed on first lookup
+// lookups, as well as hvml_jo_array_get, are safe among concurrent readers
+hvml_jo_value_t* hvml_jo_object_get_kv_by_key(hvml_jo_value_t *jo, const char *key, size_t len);
+// return the val-part of the first kv of object jo, whose key matches
+// or NULL if jo is not of object, or not found
+hvml_jo_value_t* hvml_jo_object_get(hvml_jo_value_t *jo, const char *key, size_t len);
+// return the # of elements of array jo, or 0 if jo is not of array
+size_t           hvml_jo_array_size(hvml_jo_value_t *jo);
+// return the idx-th element of array jo
+// or NULL if jo is not of array, or idx is out of range
+// indexing is O(1) unless elements other than the last one were detached
+hvml_jo_value_t* hvml_jo_array_get(hvml_jo_value_t *jo, size_t idx);
+
 
 // detach a json value from it's parent
 void             hvml_jo_value_detach(hvml_jo_value_t *jo);
@@ -85,9 +112,21 @@ hvml_jo_value_t* hvml_jo_value_child(hvml_jo_value_t *jo);
 hvml_jo_value_t* hvml_jo_value_sibling_next(hvml_jo_value_t *jo);
 hvml_jo_value_t* hvml_jo_value_sibling_prev(hvml_jo_value_t *jo);
 
+// numbers are kept as int64 if integral and in range, or as double otherwise
+// the origin text is NULL unless kept, see hvml_jo_gen_set_keep_origin
 int hvml_jo_number_get(hvml_jo_value_t *jo, long double *d, const char **s);
+int hvml_jo_number_get_json(hvml_jo_value_t *jo, hvml_json_number_t *num);
+// -1 if jo is not of an integer
+int hvml_jo_number_get_int64(hvml_jo_value_t *jo, int64_t *v);
+int hvml_jo_number_get_double(hvml_jo_value_t *jo, double *v);
 int hvml_jo_string_get(hvml_jo_value_t *jo, const char **s);
 int hvml_jo_kv_get(hvml_jo_value_t *jo, const char **key, hvml_jo_value_t **val);
+// the same, but with length, since strings and keys may hold \0's
+int hvml_jo_string_get_len(hvml_jo_value_t *jo, const char **s, size_t *len);
+int hvml_jo_kv_get_key(hvml_jo_value_t *jo, const char **key, size_t *len);
+// the bytes of a string, origin of a number, or key of a kv, NULL otherwise
+// which can be shared by hvml_rstr_ref, since they're immutable
+hvml_rstr_t*     hvml_jo_value_rstr(hvml_jo_value_t *jo);
 
 // return # of json value's children
 size_t           hvml_jo_value_children(hvml_jo_value_t *jo);
@@ -96,12 +135,25 @@ size_t           hvml_jo_value_children(hvml_jo_value_t *jo);
 typedef int (*jo_traverse_f)(hvml_jo_value_t *jo, int lvl, int action, void *arg);
 int hvml_jo_value_traverse(hvml_jo_value_t *jo, void *arg, jo_traverse_f cb);
 
+// strings, origins of numbers and keys are shared with jo, rather than copied
 hvml_jo_value_t* hvml_jo_clone(hvml_jo_value_t *jo);
 
 // create a `generator`, with which we can build a json value from string stream
 hvml_jo_gen_t*   hvml_jo_gen_create();
 // destroy the `generator`
 void             hvml_jo_gen_destroy(hvml_jo_gen_t *gen);
+// drop what's parsed so far and start over, the buffers are kept for reuse
+void             hvml_jo_gen_reset(hvml_jo_gen_t *gen);
+// per-thread pool of generators, to parse many small documents with no
+// allocation but for the values themselves
+// released ones are reset, keep_origin included, and the pooled ones are
+// destroyed when the thread exits
+hvml_jo_gen_t*   hvml_jo_gen_acquire();
+void             hvml_jo_gen_release(hvml_jo_gen_t *gen);
+// keep the origin text of numbers, for round-trip fidelity, off by default
+// kept ones are printed as is, otherwise numbers are printed from int64 or
+// double, and those beyond the range of double, such as 1e309, as null
+void             hvml_jo_gen_set_keep_origin(hvml_jo_gen_t *gen, int keep);
 
 // pump string stream into the `generator` to build a json value on the fly
 int              hvml_jo_gen_parse_char(hvml_jo_gen_t *gen, const char c);
@@ -111,9 +163,18 @@ int              hvml_jo_gen_parse_string(hvml_jo_gen_t *gen, const char *str);
 // the json value built till now
 // if the string stream fails to denote a `well-formed` json value, NULL would be returned
 hvml_jo_value_t* hvml_jo_gen_parse_end(hvml_jo_gen_t *gen);
+// build a json value out of a complete buffer in one go, with hvml_json_parse_buffer
+// falling back to the incremental parser for diagnostics, if buf is not `well-formed`
+// gen shall be fresh, with nothing pumped yet
+hvml_jo_value_t* hvml_jo_gen_parse_buffer(hvml_jo_gen_t *gen, const char *buf, size_t len);
 
-// load a json value from file stream
+// load a json value from file stream, which is read till eof and parsed in one go
 hvml_jo_value_t* hvml_jo_value_load_from_stream(FILE *in);
+// maps the file and parses it in one go
+// strings are still copied, since jo values are owned and freed one by one
+hvml_jo_value_t* hvml_jo_value_load_from_file(const char *path);
+// parsed in one go with a pooled generator
+hvml_jo_value_t* hvml_jo_value_load_from_buffer(const char *buf, size_t len);
 
 #ifdef __cplusplus
 }
@@ -18,6 +18,7 @@
 #ifndef _hvml_json_parser_h_
 #define _hvml_json_parser_h_
 
+#include "hvml/hvml_escape.h"
 #include "hvml/hvml_string.h"
 
 #include <stddef.h>
@@ -30,6 +31,19 @@ extern "C" {
 
 typedef struct hvml_json_parser_s                hvml_json_parser_t;
 typedef struct hvml_json_parser_conf_s           hvml_json_parser_conf_t;
+typedef struct hvml_json_number_s                hvml_json_number_t;
+
+// a number as scanned
+// integers are kept as int64 if in range, -0 excluded, otherwise as double
+struct hvml_json_number_s {
+    unsigned int   integer:1;   // i is valid, otherwise d
+    int64_t        i;
+    double         d;
+    // the text as is, valid only during on_number
+    // or NULL when not kept, see hvml_jo_gen_set_keep_origin
+    const char    *origin;
+    size_t         len;         // of the text, even if not kept
+};
 
 struct hvml_json_parser_conf_s {
     // all callback-funcs just mean as name implies
@@ -44,7 +58,7 @@ struct hvml_json_parser_conf_s {
     int (*on_false)(void *arg);
     int (*on_null)(void *arg);
     int (*on_string)(void *arg, const char *val, size_t len);
-    int (*on_number)(void *arg, const char *origin, long double val);
+    int (*on_number)(void *arg, const hvml_json_number_t *num);
     int (*on_item_done)(void *arg);
     int (*on_val_done)(void *arg);
     int (*on_end)(void *arg);
@@ -61,7 +75,7 @@ struct hvml_json_parser_conf_s {
 hvml_json_parser_t* hvml_json_parser_create(hvml_json_parser_conf_t conf);
 // destroy the json parser
 void                hvml_json_parser_destroy(hvml_json_parser_t *parser);
-// reset the internal state of the json parser
+// reset the internal state of the json parser, the buffers are kept for reuse
 void                hvml_json_parser_reset(hvml_json_parser_t *parser);
 
 // pump string stream into the `parser` to trigger registered-callbacks on the fly
@@ -77,8 +91,24 @@ int                 hvml_json_parser_is_ending(hvml_json_parser_t *parser);
 // useful only when initializing `embedded-json-fragment-parser`
 void                hvml_json_parser_set_offset(hvml_json_parser_t *parser, size_t line, size_t col);
 
+// non-incremental counterpart of hvml_json_parser_parse + parse_end, for a complete buffer
+// structural characters are indexed in bulk first, with the simd kernel chosen by
+// hvml_escape_set_isa, and then the same callbacks are fired, except on_end
+// conf->embedded is not supported
+// -1 if buf fails to denote a json value or a callback fails, with nothing logged
+// thus callers might fall back to hvml_json_parser for diagnostics
+int                 hvml_json_parse_buffer(const hvml_json_parser_conf_t *conf, const char *buf, size_t len);
+// the same, but with the given kernel, which must be supported
+int                 hvml_json_parse_buffer_isa(HVML_ESCAPE_ISA isa, const hvml_json_parser_conf_t *conf,
+                                               const char *buf, size_t len);
+
+// scan a number of json syntax out of [s, s+len), with a leading '+' allowed
+// -1 if it's not a number as a whole
+// num->origin is left NULL
+int                 hvml_json_number_parse(const char *s, size_t len, hvml_json_number_t *num);
+
 // serializing `str` as a json string
-void                hvml_json_str_printf(FILE *out, const char *s, size_t len);
+int                 hvml_json_str_printf(FILE *out, const char *s, size_t len);
 int                 hvml_json_str_serialize(hvml_stream_t *stream, const char *s, size_t len);
 
 #ifdef __cplusplus
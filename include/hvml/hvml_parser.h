@@ -18,6 +18,8 @@
 #ifndef _hvml_parser_h_
 #define _hvml_parser_h_
 
+#include "hvml/hvml_json_parser.h"
+
 #include <stddef.h>
 #include <stdint.h>
 
@@ -49,7 +51,7 @@ struct hvml_parser_conf_s {
     int (*on_false)(void *arg);
     int (*on_null)(void *arg);
     int (*on_string)(void *arg, const char *val, size_t len);
-    int (*on_number)(void *arg, const char *origin, long double val);
+    int (*on_number)(void *arg, const hvml_json_number_t *num);
     int (*on_end)(void *arg);
 
     // user-provided arg, would be passed in callbacks
@@ -60,6 +62,8 @@ struct hvml_parser_conf_s {
 hvml_parser_t* hvml_parser_create(hvml_parser_conf_t conf);
 // destroy the hvml parser
 void           hvml_parser_destroy(hvml_parser_t *parser);
+// back to the state right after creation, the buffers are kept for reuse
+void           hvml_parser_reset(hvml_parser_t *parser);
 
 // pump string stream into the `parser` to trigger registered-callbacks on the fly
 int            hvml_parser_parse_char(hvml_parser_t *parser, const char c);
@@ -67,6 +71,12 @@ int            hvml_parser_parse(hvml_parser_t *parser, const char *buf, size_t
 int            hvml_parser_parse_string(hvml_parser_t *parser, const char *str);
 int            hvml_parser_parse_end(hvml_parser_t *parser);
 
+// only meaningful inside on_text/on_attr_val callbacks fired by hvml_parser_parse
+// 1: the token is a verbatim copy of [*span, *span + *len) of the buffer being parsed,
+//    and the byte right after it is the delimiter being processed
+// 0: the token has been unescaped/normalized, or came in pieces
+int            hvml_parser_token_span(hvml_parser_t *parser, const char **span, size_t *len);
+
 const char* match_escapes(const char *str, char *raw);
 const char* conv_escape(const char raw);
 
@@ -0,0 +1,90 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_reader_h_
+#define _hvml_reader_h_
+
+#include "hvml/hvml_json_parser.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// pull-style reader of hvml, with no dom built
+// events are the same as hvml_parser_conf_t callbacks, pulled one by one
+// memory in use is bounded by nesting depth and the longest token, rather
+// than the size of the document
+typedef struct hvml_reader_s               hvml_reader_t;
+typedef struct hvml_reader_event_s         hvml_reader_event_t;
+
+typedef enum {
+    HVML_READER_OPEN_TAG,
+    HVML_READER_ATTR_KEY,
+    HVML_READER_ATTR_VAL,
+    HVML_READER_CLOSE_TAG,
+    HVML_READER_TEXT,
+
+    // json within tags such as <init>
+    HVML_READER_JSON_BEGIN,
+    HVML_READER_OPEN_ARRAY,
+    HVML_READER_CLOSE_ARRAY,
+    HVML_READER_OPEN_OBJ,
+    HVML_READER_CLOSE_OBJ,
+    HVML_READER_KEY,
+    HVML_READER_TRUE,
+    HVML_READER_FALSE,
+    HVML_READER_NULL,
+    HVML_READER_STRING,
+    HVML_READER_NUMBER,
+    HVML_READER_JSON_END
+} HVML_READER_EVENT;
+
+struct hvml_reader_event_s {
+    HVML_READER_EVENT          type;
+    // tag name, attr key/val, text, json key/string, or the text of a number
+    // not null-terminated, and valid till the next hvml_reader_next
+    // views of text and attr vals point into the input, if copied verbatim
+    const char                *str;
+    size_t                     len;
+    // of HVML_READER_NUMBER, origin/len the same as str/len
+    hvml_json_number_t         num;
+};
+
+const char*     hvml_reader_event_str(HVML_READER_EVENT type);
+
+// buf shall outlive the reader
+hvml_reader_t*  hvml_reader_create(const char *buf, size_t len);
+// maps the file, which is unmapped by hvml_reader_destroy
+hvml_reader_t*  hvml_reader_create_from_file(const char *path);
+void            hvml_reader_destroy(hvml_reader_t *reader);
+
+// 1:  an event is got
+// 0:  end of document
+// -1: parse error or out of memory, and so are the following calls
+//     events parsed before the error are got first
+int             hvml_reader_next(hvml_reader_t *reader, hvml_reader_event_t *ev);
+// # of tags open so far
+size_t          hvml_reader_depth(hvml_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_reader_h_
+
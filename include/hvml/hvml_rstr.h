@@ -0,0 +1,49 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_rstr_h_
+#define _hvml_rstr_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// immutable, reference-counted string
+// held by whoever shares the bytes instead of copying them
+// refs are counted atomically, thus a string may be read, ref'ed and unref'ed
+// from different threads
+typedef struct hvml_rstr_s             hvml_rstr_t;
+
+// with refs of 1, NULL if out of memory
+hvml_rstr_t*    hvml_rstr_create(const char *buf, size_t len);
+// returns rs itself
+hvml_rstr_t*    hvml_rstr_ref(hvml_rstr_t *rs);
+// released once refs drop to 0
+void            hvml_rstr_unref(hvml_rstr_t *rs);
+
+// null-terminated
+const char*     hvml_rstr_str(hvml_rstr_t *rs);
+size_t          hvml_rstr_len(hvml_rstr_t *rs);
+size_t          hvml_rstr_refs(hvml_rstr_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_rstr_h_
@@ -30,6 +30,8 @@ typedef struct hvml_string_s           hvml_string_t;
 struct hvml_string_s {
     char           *str;
     size_t          len;
+    size_t          cap;    // bytes allocated for str, including null terminator
+                            // meaningless if str is null
 };
 
 #define hvml_string_str(s) ((s)->str)
@@ -37,13 +39,20 @@ struct hvml_string_s {
 
 // there is no `init`-like function here since hvml_string_t is public
 // and self-descripted
+// reset keeps the allocated buffer for reuse, whereas clear frees it
 void hvml_string_reset(hvml_string_t *str);
 void hvml_string_clear(hvml_string_t *str);
 
+// make room for at least `len` bytes plus null terminator
+int  hvml_string_reserve(hvml_string_t *str, size_t len);
+// release unused capacity
+int  hvml_string_shrink_to_fit(hvml_string_t *str);
+
 int  hvml_string_push(hvml_string_t *str, const char c);
 int  hvml_string_pop(hvml_string_t *str, char *c);
 
 int  hvml_string_append(hvml_string_t *str, const char *s);
+int  hvml_string_append_n(hvml_string_t *str, const char *buf, size_t n);
 
 int  hvml_string_get(hvml_string_t *str, char **buf, size_t *len);
 int  hvml_string_set(hvml_string_t *str, const char *buf, size_t len);
@@ -73,6 +82,17 @@ hvml_stream_t* hvml_stream_bind_file(FILE *out, int take_ownership);
 hvml_stream_t* hvml_stream_bind_string(hvml_string_t *str);
 void           hvml_stream_destroy(hvml_stream_t *stream);
 
+// output is buffered within the stream
+// call hvml_stream_flush before reading what is bound, destroy flushes as well
+// but failure of that is lost, thus flush before destroy to know it
+int hvml_stream_write(hvml_stream_t *stream, const char *buf, size_t len);
+int hvml_stream_puts(hvml_stream_t *stream, const char *s);
+int hvml_stream_putc(hvml_stream_t *stream, const char c);
+int hvml_stream_flush(hvml_stream_t *stream);
+
+#ifdef __GNUC__
+__attribute__ ((format (printf, 2, 3)))
+#endif
 int hvml_stream_printf(hvml_stream_t *stream, const char *fmt, ...);
 
 #ifdef __cplusplus
@@ -30,6 +30,8 @@ typedef struct hvml_utf8_encoder_s         hvml_utf8_encoder_t;
 
 hvml_utf8_decoder_t* hvml_utf8_decoder();
 void                 hvml_utf8_decoder_destroy(hvml_utf8_decoder_t *decoder);
+// drop any cached utf8 fragment, the buffer is kept for reuse
+void                 hvml_utf8_decoder_reset(hvml_utf8_decoder_t *decoder);
 
 // 0:  ok, but not complete
 // 1:  ok, and complete
@@ -41,6 +43,18 @@ int                  hvml_utf8_decoder_ready(hvml_utf8_decoder_t *decoder);
 
 const char*          hvml_utf8_decoder_cache(hvml_utf8_decoder_t *decoder, size_t *len);
 
+// well-formed utf8 as of RFC 3629: no overlongs, surrogates or code points
+// beyond U+10FFFF
+// 0:  all valid
+// 1:  valid but for a sequence truncated at the end
+// -1: ill-formed sequence
+// in the latter two cases, *err_off is set to where the sequence starts
+int                  hvml_utf8_validate(const char *buf, size_t len, size_t *err_off);
+// decode into at most `cap` code points, and return how many are decoded
+// *consumed is set to # of bytes they take, which falls short of len only
+// when cps is full, or at an ill-formed or truncated sequence
+size_t               hvml_utf8_decode(const char *buf, size_t len, uint32_t *cps, size_t cap, size_t *consumed);
+
 
 int                  hvml_utf8_encode(const uint64_t cp, char *output, size_t *output_len);
 
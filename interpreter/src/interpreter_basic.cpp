@@ -88,7 +88,7 @@ void Interpreter_Basic::traverse_for_printf(hvml_dom_t *dom, int lvl, int tag_op
         } break;
         case MKDOT(D_JSON):
         {
-            hvml_jo_value_printf(hvml_dom_jo(dom), parg->out);
+            hvml_jo_value_printf(hvml_dom_jo_shared(dom), parg->out);
             parg->lvl = lvl;
         } break;
         default: {
@@ -239,46 +239,47 @@ void Interpreter_Runtime::traverse_for_divide(hvml_dom_t *dom,
                     }
                     I("----- done to %s", tag_name);
 
-                    if (0 == strcmp("archetype", tag_name)) {
-                        I("----- <archetype> ---");
-                        AddNewArchetype(param->archetype_part,
-                                        dom,
-                                        param->udom_curr_ptr);
-                        param->vdom_ignore = dom;
-                    }
-                    else if (0 == strcmp("iterate", tag_name)) {
-                        I("----- <iterate> ---");
-                        AddNewIterate(param->iterate_part,
-                                      dom,
-                                      param->udom_curr_ptr);
-                        param->vdom_ignore = dom;
-                    }
-                    else if (0 == strcmp("init", tag_name)) {
-                        I("----- <init> ---");
-                        AddNewInit(param->init_part, dom);
-                        param->vdom_ignore = dom;
-                    }
-                    else if (0 == strcmp("observe", tag_name)) {
-                        I("----- <observe> ---");
-                        AddNewObserve(param->observe_part, dom);
-                        param->vdom_ignore = dom;
-                    }
-                    else {
-                        I("----- A <udom-%s> ---", tag_name);
-                        if (0 == strcmp("hvml", tag_name)) {
+                    switch (hvml_dom_tag_atom(dom)) {
+                        case HVML_ATOM_ARCHETYPE: {
+                            I("----- <archetype> ---");
+                            AddNewArchetype(param->archetype_part,
+                                            dom,
+                                            param->udom_curr_ptr);
+                            param->vdom_ignore = dom;
+                        } break;
+                        case HVML_ATOM_ITERATE: {
+                            I("----- <iterate> ---");
+                            AddNewIterate(param->iterate_part,
+                                          dom,
+                                          param->udom_curr_ptr);
+                            param->vdom_ignore = dom;
+                        } break;
+                        case HVML_ATOM_INIT: {
+                            I("----- <init> ---");
+                            AddNewInit(param->init_part, dom);
+                            param->vdom_ignore = dom;
+                        } break;
+                        case HVML_ATOM_OBSERVE: {
+                            I("----- <observe> ---");
+                            AddNewObserve(param->observe_part, dom);
+                            param->vdom_ignore = dom;
+                        } break;
+                        case HVML_ATOM_HVML: {
+                            I("----- A <udom-%s> ---", tag_name);
                             tag_name = "html";
                             hvml_dom_t* u = hvml_dom_add_tag(param->udom_curr_ptr,
                                             tag_name, strlen(tag_name));
                             A(u, "internal logic error");
                             param->udom_curr_ptr = u;
                             *(param->udom_pptr) = u;
-                        }
-                        else {
+                        } break;
+                        default: {
+                            I("----- A <udom-%s> ---", tag_name);
                             hvml_dom_t* u = hvml_dom_add_tag(param->udom_curr_ptr,
                                         tag_name, strlen(tag_name));
                             A(u, "internal logic error");
                             param->udom_curr_ptr = u;
-                        }
+                        } break;
                     }
  
                 } break;
@@ -321,11 +322,8 @@ void Interpreter_Runtime::traverse_for_divide(hvml_dom_t *dom,
             }
             I("----- ATTR %s ---", hvml_dom_attr_key(dom));
 
-            const char *key = hvml_dom_attr_key(dom);
             const char *val = hvml_dom_attr_val(dom);
-            A(key, "internal logic error");
-            hvml_dom_t* u = hvml_dom_append_attr(param->udom_curr_ptr,
-                            key, strlen(key), val, val ? strlen(val) : 0);
+            hvml_dom_t* u = hvml_dom_append_shared(param->udom_curr_ptr, dom);
             A(u, "internal logic error");
 
             size_t mustache_str_len;
@@ -350,8 +348,7 @@ void Interpreter_Runtime::traverse_for_divide(hvml_dom_t *dom,
 
             const char *text = hvml_dom_text(dom);
             A(text, "internal logic error");
-            hvml_dom_t* u = hvml_dom_append_content(param->udom_curr_ptr,
-                            text, strlen(text));
+            hvml_dom_t* u = hvml_dom_append_shared(param->udom_curr_ptr, dom);
             A(u, "internal logic error");
 
             size_t mustache_str_len;
@@ -374,11 +371,8 @@ void Interpreter_Runtime::traverse_for_divide(hvml_dom_t *dom,
             }
             I("----- JOSN ---");
 
-            hvml_jo_value_t *jo = hvml_dom_jo(dom);
-            A(jo, "internal logic error");
-            jo = hvml_jo_clone(jo);
-            A(jo, "internal logic error");
-            hvml_dom_t* v = hvml_dom_append_json(param->udom_curr_ptr, jo);
+            // shared with the vdom, until either side writes to it
+            hvml_dom_t* v = hvml_dom_append_shared(param->udom_curr_ptr, dom);
             A(v, "internal logic error");
         } break;
 
@@ -411,9 +405,8 @@ void Interpreter_Runtime::AddNewArchetype(ArchetypeGroup_t* archetype_part,
 
     hvml_dom_t *attr = hvml_dom_attr_head(vdom);
     while (attr) {
-        const char *key = hvml_dom_attr_key(attr);
         const char *val = hvml_dom_attr_val(attr);
-        if (0 == strcmp("id", key)) {
+        if (hvml_dom_attr_atom(attr) == HVML_ATOM_ID) {
             hvml_string_set(&new_archetype.s_id, val, strlen(val));
         }
         attr = hvml_dom_attr_next(attr);
@@ -431,17 +424,19 @@ void Interpreter_Runtime::AddNewIterate(IterateGroup_t* iterate_part,
 
     hvml_dom_t *attr = hvml_dom_attr_head(vdom);
     while (attr) {
-        const char *key = hvml_dom_attr_key(attr);
         const char *val = hvml_dom_attr_val(attr);
 
-        if (0 == strcmp("on", key)) {
-            hvml_string_set(&new_iterate.s_on, val, strlen(val));
-        }
-        else if (0 == strcmp("with", key)) {
-            hvml_string_set(&new_iterate.s_with, val, strlen(val));
-        }
-        else if (0 == strcmp("to", key)) {
-            hvml_string_set(&new_iterate.s_to, val, strlen(val));
+        switch (hvml_dom_attr_atom(attr)) {
+            case HVML_ATOM_ON: {
+                hvml_string_set(&new_iterate.s_on, val, strlen(val));
+            } break;
+            case HVML_ATOM_WITH: {
+                hvml_string_set(&new_iterate.s_with, val, strlen(val));
+            } break;
+            case HVML_ATOM_TO: {
+                hvml_string_set(&new_iterate.s_to, val, strlen(val));
+            } break;
+            default: break;
         }
         attr = hvml_dom_attr_next(attr);
     }
@@ -459,14 +454,16 @@ void Interpreter_Runtime::AddNewInit(InitGroup_t* init_part,
     while (attr) {
         const char *key = hvml_dom_attr_key(attr);
         const char *val = hvml_dom_attr_val(attr);
-        if (0 == strcmp("as", key)) {
-            hvml_string_set(&new_init.s_as, val, strlen(val));
-        }
-        else if (0 == strcmp("by", key)) {
-            hvml_string_set(&new_init.s_by, val, strlen(val));
-        }
-        else {
-            new_init.en_adverb = get_adverb_type(key);
+        switch (hvml_dom_attr_atom(attr)) {
+            case HVML_ATOM_AS: {
+                hvml_string_set(&new_init.s_as, val, strlen(val));
+            } break;
+            case HVML_ATOM_BY: {
+                hvml_string_set(&new_init.s_by, val, strlen(val));
+            } break;
+            default: {
+                new_init.en_adverb = get_adverb_type(key);
+            } break;
         }
         attr = hvml_dom_attr_next(attr);
     }
@@ -481,16 +478,18 @@ void Interpreter_Runtime::AddNewObserve(ObserveGroup_t* observe_part,
 
     hvml_dom_t *attr = hvml_dom_attr_head(vdom);
     while (attr) {
-        const char *key = hvml_dom_attr_key(attr);
         const char *val = hvml_dom_attr_val(attr);
-        if (0 == strcmp("on", key)) {
-            hvml_string_set(&new_observe.s_on, val, strlen(val));
-        }
-        else if (0 == strcmp("to", key)) {
-            hvml_string_set(&new_observe.s_to, val, strlen(val));
-        }
-        else if (0 == strcmp("for", key)) {
-            new_observe.en_for = get_observe_for_type(val);
+        switch (hvml_dom_attr_atom(attr)) {
+            case HVML_ATOM_ON: {
+                hvml_string_set(&new_observe.s_on, val, strlen(val));
+            } break;
+            case HVML_ATOM_TO: {
+                hvml_string_set(&new_observe.s_to, val, strlen(val));
+            } break;
+            case HVML_ATOM_FOR: {
+                new_observe.en_for = get_observe_for_type(val);
+            } break;
+            default: break;
         }
         attr = hvml_dom_attr_next(attr);
     }
@@ -0,0 +1,317 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_atom.h"
+
+#include "hvml_atomic.h"
+
+#include "hvml/hvml_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+  #include <Windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+// atoms are stored in blocks that never move once allocated, and so are names
+// the directory of blocks and the hash slots are replaced when grown, and the
+// replaced ones are kept for readers still on them, till the process exits
+// new ones are published by release stores, thus hvml_atom_lookup and
+// hvml_atom_str read without locking, and only interning a new name locks
+#define ATOM_BLOCK_BITS          10
+#define ATOM_BLOCK_SIZE          (1u << ATOM_BLOCK_BITS)
+#define ATOM_MAX                 UINT32_MAX
+#define ATOM_CHUNK_SIZE          (16 * 1024)
+
+typedef struct atom_entry_s              atom_entry_t;
+struct atom_entry_s {
+    const char              *str;
+    size_t                   len;
+};
+
+static const atom_entry_t predefined[HVML_ATOM_PREDEFINED] = {
+    { NULL,         0  },
+
+    { "hvml",       4  },
+    { "head",       4  },
+    { "body",       4  },
+
+    { "archetype",  9  },
+    { "archedata",  9  },
+    { "error",      5  },
+    { "except",     6  },
+    { "init",       4  },
+    { "set",        3  },
+    { "update",     6  },
+    { "remove",     6  },
+    { "empty",      5  },
+    { "test",       4  },
+    { "match",      5  },
+    { "choose",     6  },
+    { "iterate",    7  },
+    { "reduce",     6  },
+    { "sort",       4  },
+    { "observe",    7  },
+    { "fire",       4  },
+    { "request",    7  },
+    { "connect",    7  },
+    { "send",       4  },
+    { "disconnect", 10 },
+    { "load",       4  },
+    { "back",       4  },
+    { "define",     6  },
+    { "include",    7  },
+    { "call",       4  },
+    { "return",     6  },
+    { "catch",      5  },
+
+    { "id",         2  },
+    { "on",         2  },
+    { "in",         2  },
+    { "with",       4  },
+    { "to",         2  },
+    { "as",         2  },
+    { "by",         2  },
+    { "for",        3  },
+    { "at",         2  },
+    { "from",       4  },
+    { "via",        3  },
+};
+
+typedef struct atom_dir_s                atom_dir_t;
+struct atom_dir_s {
+    atom_dir_t              *retired;      // the one replaced by this
+    size_t                   nblocks;
+    atom_entry_t           **blocks;
+};
+
+typedef struct atom_slots_s              atom_slots_t;
+struct atom_slots_s {
+    atom_slots_t            *retired;      // the one replaced by this
+    size_t                   nslots;       // power of 2
+    size_t                  *slots;        // open addressing, linear probing, atom of each
+};
+
+typedef struct atom_table_s              atom_table_t;
+struct atom_table_s {
+    atom_dir_t              *dir;
+    atom_slots_t            *slots;
+    uint32_t                 count;        // atoms allocated, predefined ones included
+    char                    *chunk;        // names are carved from here
+    size_t                   chunk_left;
+};
+
+static atom_table_t            atoms = {0};
+#ifdef _MSC_VER
+static SRWLOCK                 atoms_lock = SRWLOCK_INIT;
+static void atoms_acquire(void) { AcquireSRWLockExclusive(&atoms_lock); }
+static void atoms_release(void) { ReleaseSRWLockExclusive(&atoms_lock); }
+#else
+static pthread_mutex_t         atoms_lock = PTHREAD_MUTEX_INITIALIZER;
+static void atoms_acquire(void) { pthread_mutex_lock(&atoms_lock); }
+static void atoms_release(void) { pthread_mutex_unlock(&atoms_lock); }
+#endif
+
+static size_t atom_hash(const char *name, size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<len; ++i) {
+        h ^= (unsigned char)name[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static atom_dir_t* atom_dir(void) {
+    return (atom_dir_t*)hvml_atomic_get_ptr((void* volatile*)&atoms.dir);
+}
+
+static atom_slots_t* atom_slots(void) {
+    return (atom_slots_t*)hvml_atomic_get_ptr((void* volatile*)&atoms.slots);
+}
+
+static atom_entry_t* atom_entry(atom_dir_t *dir, hvml_atom_t atom) {
+    return dir->blocks[atom >> ATOM_BLOCK_BITS] + (atom & (ATOM_BLOCK_SIZE - 1));
+}
+
+// the slot of name, or the empty one where it goes
+// atoms in slots are published after their entries, see atom_add
+static size_t* atom_probe(atom_slots_t *t, const char *name, size_t len) {
+    size_t mask = t->nslots - 1;
+    size_t i    = atom_hash(name, len) & mask;
+    size_t atom;
+    while ( (atom=hvml_atomic_get(t->slots + i)) ) {
+        atom_entry_t *e = atom_entry(atom_dir(), (hvml_atom_t)atom);
+        if (e->len==len && memcmp(e->str, name, len)==0) break;
+        i = (i + 1) & mask;
+    }
+    return t->slots + i;
+}
+
+// the following are called with the lock held
+
+static int atom_rehash(size_t nslots) {
+    atom_slots_t *t = (atom_slots_t*)calloc(1, sizeof(*t) + nslots * sizeof(size_t));
+    if (!t) return -1;
+    t->retired = atoms.slots;
+    t->nslots  = nslots;
+    t->slots   = (size_t*)(t + 1);
+
+    atom_dir_t *dir = atoms.dir;
+    for (hvml_atom_t atom=1; atom<atoms.count; ++atom) {
+        atom_entry_t *e = atom_entry(dir, atom);
+        *atom_probe(t, e->str, e->len) = atom;
+    }
+    hvml_atomic_set_ptr((void* volatile*)&atoms.slots, t);
+
+    return 0;
+}
+
+static int atom_grow_dir(size_t nblocks) {
+    atom_dir_t *dir = (atom_dir_t*)calloc(1, sizeof(*dir) + nblocks * sizeof(atom_entry_t*));
+    if (!dir) return -1;
+    dir->retired = atoms.dir;
+    dir->nblocks = nblocks;
+    dir->blocks  = (atom_entry_t**)(dir + 1);
+    if (atoms.dir) {
+        memcpy(dir->blocks, atoms.dir->blocks, atoms.dir->nblocks * sizeof(atom_entry_t*));
+    }
+    hvml_atomic_set_ptr((void* volatile*)&atoms.dir, dir);
+
+    return 0;
+}
+
+static int atom_init(void) {
+    if (atoms.slots) return 0;
+
+    if (!atoms.dir && atom_grow_dir(16)) return -1;
+
+    if (!atoms.dir->blocks[0]) {
+        atom_entry_t *block = (atom_entry_t*)calloc(ATOM_BLOCK_SIZE, sizeof(atom_entry_t));
+        if (!block) return -1;
+        memcpy(block, predefined, sizeof(predefined));
+        atoms.dir->blocks[0] = block;
+        atoms.count          = HVML_ATOM_PREDEFINED;
+    }
+
+    return atom_rehash(128);
+}
+
+static const char* atom_strdup(const char *name, size_t len) {
+    char *s = NULL;
+    if (len + 1 > ATOM_CHUNK_SIZE / 4) {
+        s = (char*)malloc(len + 1);
+    } else {
+        if (atoms.chunk_left < len + 1) {
+            atoms.chunk = (char*)malloc(ATOM_CHUNK_SIZE);
+            if (!atoms.chunk) {
+                atoms.chunk_left = 0;
+                return NULL;
+            }
+            atoms.chunk_left = ATOM_CHUNK_SIZE;
+        }
+        s                 = atoms.chunk;
+        atoms.chunk      += len + 1;
+        atoms.chunk_left -= len + 1;
+    }
+    if (!s) return NULL;
+    memcpy(s, name, len);
+    s[len] = '\0';
+    return s;
+}
+
+static hvml_atom_t atom_add(const char *name, size_t len) {
+    hvml_atom_t atom  = atoms.count;
+    size_t      block = atom >> ATOM_BLOCK_BITS;
+    if (atom == ATOM_MAX) {
+        E("too many atoms");
+        return HVML_ATOM_NONE;
+    }
+
+    // keep load factor under 1/2, failure only means more collisions
+    // unless there's no room at all
+    if ((size_t)(atoms.count + 1) * 2 > atoms.slots->nslots) {
+        if (atom_rehash(atoms.slots->nslots * 2) && atoms.count + 1 >= atoms.slots->nslots) {
+            return HVML_ATOM_NONE;
+        }
+    }
+
+    if (block >= atoms.dir->nblocks) {
+        if (atom_grow_dir(atoms.dir->nblocks * 2)) return HVML_ATOM_NONE;
+    }
+    if (!atoms.dir->blocks[block]) {
+        atoms.dir->blocks[block] = (atom_entry_t*)calloc(ATOM_BLOCK_SIZE, sizeof(atom_entry_t));
+        if (!atoms.dir->blocks[block]) return HVML_ATOM_NONE;
+    }
+
+    const char *s = atom_strdup(name, len);
+    if (!s) return HVML_ATOM_NONE;
+
+    atom_entry_t *e = atom_entry(atoms.dir, atom);
+    e->str          = s;
+    e->len          = len;
+    atoms.count    += 1;
+    // published after the entry
+    hvml_atomic_set(atom_probe(atoms.slots, name, len), atom);
+
+    return atom;
+}
+
+hvml_atom_t hvml_atom_intern(const char *name, size_t len) {
+    A(name, "internal logic error");
+
+    hvml_atom_t atom = hvml_atom_lookup(name, len);
+    if (atom) return atom;
+
+    atoms_acquire();
+    if (atom_init()==0) {
+        // interned by another thread in the meantime
+        atom = (hvml_atom_t)*atom_probe(atoms.slots, name, len);
+        if (!atom) atom = atom_add(name, len);
+    }
+    atoms_release();
+
+    return atom;
+}
+
+hvml_atom_t hvml_atom_lookup(const char *name, size_t len) {
+    A(name, "internal logic error");
+
+    atom_slots_t *t = atom_slots();
+    if (!t) {
+        atoms_acquire();
+        int r = atom_init();
+        atoms_release();
+        if (r) return HVML_ATOM_NONE;
+        t = atom_slots();
+    }
+
+    return (hvml_atom_t)hvml_atomic_get(atom_probe(t, name, len));
+}
+
+const char* hvml_atom_str(hvml_atom_t atom) {
+    if (atom < HVML_ATOM_PREDEFINED) return predefined[atom].str;
+    return atom_entry(atom_dir(), atom)->str;
+}
+
+size_t hvml_atom_len(hvml_atom_t atom) {
+    if (atom < HVML_ATOM_PREDEFINED) return predefined[atom].len;
+    return atom_entry(atom_dir(), atom)->len;
+}
@@ -0,0 +1,113 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_atomic_h_
+#define _hvml_atomic_h_
+
+#include <stddef.h>
+
+#ifdef _MSC_VER
+  #include <Windows.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// reference counting, shared across threads
+// inc returns nothing, dec returns the count left
+// cas_ptr sets *v to desired if it's still expected, and returns what it was
+// get/get_ptr acquire, set/set_ptr release, thus lazily built data can be
+// published to readers on the other threads
+
+#ifdef _MSC_VER
+static __inline void hvml_atomic_inc(volatile size_t *v) {
+  #ifdef _WIN64
+    InterlockedIncrement64((volatile LONG64*)v);
+  #else
+    InterlockedIncrement((volatile LONG*)v);
+  #endif
+}
+
+static __inline size_t hvml_atomic_dec(volatile size_t *v) {
+  #ifdef _WIN64
+    return (size_t)InterlockedDecrement64((volatile LONG64*)v);
+  #else
+    return (size_t)InterlockedDecrement((volatile LONG*)v);
+  #endif
+}
+
+static __inline size_t hvml_atomic_get(volatile size_t *v) {
+    return *v;
+}
+
+static __inline void hvml_atomic_set(volatile size_t *v, size_t n) {
+  #ifdef _WIN64
+    InterlockedExchange64((volatile LONG64*)v, (LONG64)n);
+  #else
+    InterlockedExchange((volatile LONG*)v, (LONG)n);
+  #endif
+}
+
+static __inline void* hvml_atomic_get_ptr(void * volatile *v) {
+    return *v;
+}
+
+static __inline void hvml_atomic_set_ptr(void * volatile *v, void *p) {
+    InterlockedExchangePointer(v, p);
+}
+
+static __inline void* hvml_atomic_cas_ptr(void * volatile *v, void *expected, void *desired) {
+    return InterlockedCompareExchangePointer(v, desired, expected);
+}
+#else
+static inline void hvml_atomic_inc(volatile size_t *v) {
+    __atomic_add_fetch(v, 1, __ATOMIC_RELAXED);
+}
+
+static inline size_t hvml_atomic_dec(volatile size_t *v) {
+    // the last one to release shall see all the writes made by the others
+    return __atomic_sub_fetch(v, 1, __ATOMIC_ACQ_REL);
+}
+
+static inline size_t hvml_atomic_get(volatile size_t *v) {
+    return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+}
+
+static inline void hvml_atomic_set(volatile size_t *v, size_t n) {
+    __atomic_store_n(v, n, __ATOMIC_RELEASE);
+}
+
+static inline void* hvml_atomic_get_ptr(void * volatile *v) {
+    return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+}
+
+static inline void hvml_atomic_set_ptr(void * volatile *v, void *p) {
+    __atomic_store_n(v, p, __ATOMIC_RELEASE);
+}
+
+static inline void* hvml_atomic_cas_ptr(void * volatile *v, void *expected, void *desired) {
+    __atomic_compare_exchange_n(v, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return expected;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_atomic_h_
@@ -17,13 +17,18 @@
 
 #include "hvml/hvml_dom.h"
 
+#include "hvml_atomic.h"
 #include "hvml_dom_xpath_parser.h"
+#include "hvml_file_map.h"
 
+#include "hvml/hvml_atom.h"
+#include "hvml/hvml_escape.h"
 #include "hvml/hvml_jo.h"
 #include "hvml/hvml_json_parser.h"
 #include "hvml/hvml_list.h"
 #include "hvml/hvml_parser.h"
 #include "hvml/hvml_printf.h"
+#include "hvml/hvml_rstr.h"
 #include "hvml/hvml_string.h"
 
 #include <ctype.h>
@@ -32,6 +37,12 @@
 #include <math.h>
 #include <string.h>
 
+#ifdef _MSC_VER
+  #include <Windows.h>
+#else
+  #include <pthread.h>
+#endif
+
 // for easy coding
 #define DOM_MEMBERS() \
     HLIST_MEMBERS(hvml_dom_t, hvml_dom_t, _dom_); \
@@ -61,6 +72,14 @@
 #define DOM_ATTR_APPEND(ov,v)     HLIST_APPEND(hvml_dom_t, hvml_dom_t, _attr_, ov, v)
 #define DOM_ATTR_REMOVE(v)        HLIST_REMOVE(hvml_dom_t, hvml_dom_t, _attr_, v)
 
+// document order is numbered lazily by hvml_doms_sort, starting from 1 at the
+// top-most node. a top-most node with seq of 0 means the tree is to be renumbered
+// thus structural changes beneath any numbered node have to reset it
+// queries might run on the same document in parallel, thus the renumbering is
+// done under a lock striped by the top-most node, and published by storing
+// the seq of the top-most node last, see hvml_doms_sort
+#define DOM_ORDER_TOUCH(v)   do { if ((v)->seq) hvml_dom_order_invalidate(v); } while (0)
+
 const char *hvml_dom_xpath_eval_type_str(HVML_DOM_XPATH_EVAL_TYPE t) {
     switch (t) {
         case HVML_DOM_XPATH_EVAL_UNKNOWN:    return "HVML_DOM_XPATH_EVAL_UNKNOWN";
@@ -78,28 +97,55 @@ const char *hvml_dom_xpath_eval_type_str(HVML_DOM_XPATH_EVAL_TYPE t) {
 typedef struct hvml_dom_tag_s               hvml_dom_tag_t;
 typedef struct hvml_dom_attr_s              hvml_dom_attr_t;
 typedef struct hvml_dom_text_s              hvml_dom_text_t;
+typedef struct hvml_dom_json_s              hvml_dom_json_t;
+typedef struct hvml_dom_str_s               hvml_dom_str_t;
+typedef struct hvml_dom_jo_ref_s            hvml_dom_jo_ref_t;
+typedef struct hvml_dom_arena_s             hvml_dom_arena_t;
+typedef struct hvml_dom_arena_chunk_s       hvml_dom_arena_chunk_t;
+
+// val of D_ATTR, or txt of D_TEXT, which is never modified in place
+// heap nodes hold it in rs, and share it with their clones
+// arena nodes carve it from the arena, or borrow it from the mapping
+struct hvml_dom_str_s {
+    const char         *str;
+    size_t              len;
+    hvml_rstr_t        *rs;
+};
+
+// jo shared by D_JSON clones, released with the last of them
+struct hvml_dom_jo_ref_s {
+    volatile size_t     refs;
+    hvml_jo_value_t    *jo;
+};
 
 struct hvml_dom_tag_s {
-    hvml_string_t       name;
+    hvml_atom_t         name;
 };
 
 struct hvml_dom_attr_s {
-    hvml_string_t       key;
-    hvml_string_t       val;
+    hvml_atom_t         key;
+    hvml_dom_str_t      val;
 };
 
 struct hvml_dom_text_s {
-    hvml_string_t       txt;
+    hvml_dom_str_t      txt;
+};
+
+struct hvml_dom_json_s {
+    hvml_jo_value_t    *jo;
+    hvml_dom_jo_ref_t  * volatile ref; // non-null if jo is shared, copied on write
 };
 
 struct hvml_dom_s {
     HVML_DOM_TYPE       dt;
+    hvml_dom_arena_t   *arena;    // null if allocated from heap
+    size_t              seq;      // document order, 0 if not numbered yet
 
     union {
         hvml_dom_tag_t    tag;
         hvml_dom_attr_t   attr;
         hvml_dom_text_t   txt;
-        hvml_jo_value_t  *jo;
+        hvml_dom_json_t   json;
     } u;
 
     DOM_ATTR_MEMBERS();
@@ -110,8 +156,51 @@ struct hvml_dom_gen_s {
     hvml_dom_t          *dom;
     hvml_parser_t       *parser;
     hvml_jo_value_t     *jo;
+
+    // the file being parsed, if loaded by hvml_dom_load_from_file
+    // verbatim text/attr-val tokens are borrowed from it rather than copied
+    hvml_file_map_t     *map;
+
+    unsigned int         with_arena:1;
+    unsigned int         keep_origin:1;
+};
+
+// per-document arena
+// nodes and their strings are carved from chunks, and released as a whole
+// when the owner (the D_ROOT) is destroyed
+// jo values are still allocated from heap, which are counted in `jsons`,
+// so that the tree has to be walked only when there are any
+#define DOM_ARENA_CHUNK_MIN      (64 * 1024)
+#define DOM_ARENA_CHUNK_MAX      (1024 * 1024)
+
+struct hvml_dom_arena_chunk_s {
+    hvml_dom_arena_chunk_t   *next;
+    size_t                    size;
+    size_t                    used;
 };
 
+struct hvml_dom_arena_s {
+    hvml_dom_arena_chunk_t   *chunks;      // the most recent one comes first
+    hvml_dom_t               *owner;
+    size_t                    jsons;
+    hvml_file_map_t           map;         // strings borrowed by hvml_dom_load_from_file
+};
+
+static hvml_dom_arena_t* hvml_dom_arena_create(void);
+static void              hvml_dom_arena_destroy(hvml_dom_arena_t *arena);
+static void*             hvml_dom_arena_alloc(hvml_dom_arena_t *arena, size_t size, size_t align);
+
+static hvml_dom_t*       hvml_dom_create_in(hvml_dom_arena_t *arena);
+static int               hvml_dom_string_set(hvml_dom_t *dom, hvml_dom_str_t *str, const char *buf, size_t len);
+static int               hvml_dom_string_share(hvml_dom_t *dom, hvml_dom_str_t *str, const hvml_dom_str_t *from);
+static void              hvml_dom_string_clear(hvml_dom_t *dom, hvml_dom_str_t *str);
+static int               hvml_dom_gen_string_set(hvml_dom_gen_t *gen, hvml_dom_t *dom, hvml_dom_str_t *str, const char *s);
+static int               hvml_dom_json_share(hvml_dom_t *dom, hvml_dom_t *from);
+static void              hvml_dom_json_clear(hvml_dom_t *dom);
+
+static void              hvml_dom_order_invalidate(hvml_dom_t *dom);
+static void              hvml_dom_order_renumber(hvml_dom_t *top);
+
 const char *hvml_dom_type_str(HVML_DOM_TYPE t) {
     switch (t) {
         case MKDOT(D_ROOT):               return "D_ROOT";
@@ -151,19 +240,82 @@ static void hvml_dom_xpath_eval_cleanup(hvml_dom_xpath_eval_t *ev) {
 
 const hvml_doms_t null_doms = {0};
 
+#define DOMS_SET_THRESHOLD        32
+
+static size_t doms_ptr_hash(const hvml_dom_t *dom) {
+    uint64_t h = (uint64_t)(uintptr_t)dom;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+static hvml_dom_t** doms_set_probe(hvml_dom_t **set, size_t slots, const hvml_dom_t *dom) {
+    size_t mask = slots - 1;
+    size_t i    = doms_ptr_hash(dom) & mask;
+    while (set[i] && set[i]!=dom) {
+        i = (i + 1) & mask;
+    }
+    return set + i;
+}
+
+static int doms_set_rebuild(hvml_doms_t *doms, size_t slots) {
+    hvml_dom_t **set = (hvml_dom_t**)calloc(slots, sizeof(*set));
+    if (!set) return -1; // out of memory
+
+    for (size_t i=0; i<doms->ndoms; ++i) {
+        hvml_dom_t **slot = doms_set_probe(set, slots, doms->doms[i]);
+        *slot = doms->doms[i];
+    }
+
+    free(doms->set);
+    doms->set   = set;
+    doms->slots = slots;
+
+    return 0;
+}
+
+static int doms_reserve(hvml_doms_t *doms, size_t cap) {
+    if (cap <= doms->cap) return 0;
+
+    size_t n = doms->cap ? doms->cap : 8;
+    while (n < cap) n *= 2;
+
+    hvml_dom_t **e = (hvml_dom_t**)realloc(doms->doms, n * sizeof(*e));
+    if (!e) return -1; // out of memory
+
+    doms->doms = e;
+    doms->cap  = n;
+
+    return 0;
+}
+
 int hvml_doms_append_dom(hvml_doms_t *doms, hvml_dom_t *dom) {
     if (!doms) return -1;
     if (!dom) return 0;
 
-    for (size_t i=0; i<doms->ndoms; ++i) {
-        if (dom == doms->doms[i]) return 0;
+    if (doms->set) {
+        if (*doms_set_probe(doms->set, doms->slots, dom)) return 0;
+    } else {
+        for (size_t i=0; i<doms->ndoms; ++i) {
+            if (dom == doms->doms[i]) return 0;
+        }
+    }
+
+    if (doms_reserve(doms, doms->ndoms + 1)) return -1;
+
+    // keep load factor under 1/2
+    if ((doms->ndoms + 1) * 2 > doms->slots && doms->ndoms + 1 >= DOMS_SET_THRESHOLD) {
+        size_t slots = doms->slots ? doms->slots * 2 : DOMS_SET_THRESHOLD * 2;
+        while (slots < (doms->ndoms + 1) * 2) slots *= 2;
+        if (doms_set_rebuild(doms, slots)) return -1;
+    }
+
+    doms->doms[doms->ndoms++] = dom;
+    if (doms->set) {
+        *doms_set_probe(doms->set, doms->slots, dom) = dom;
     }
 
-    hvml_dom_t **e = (hvml_dom_t**)realloc(doms->doms, (doms->ndoms+1)*sizeof(*e));
-    if (!e) return -1;
-    e[doms->ndoms] = dom;
-    doms->doms     = e;
-    doms->ndoms   += 1;
     return 0;
 }
 
@@ -172,6 +324,8 @@ int hvml_doms_append_doms(hvml_doms_t *doms, hvml_doms_t *in) {
     if (!in) return 0;
     if (in->ndoms==0) return 0;
 
+    if (doms_reserve(doms, doms->ndoms + in->ndoms)) return -1;
+
     int r = 0;
 
     for (size_t i=0; i<in->ndoms; ++i) {
@@ -186,8 +340,21 @@ void hvml_doms_cleanup(hvml_doms_t *doms) {
     if (!doms) return;
 
     free(doms->doms);
+    free(doms->set);
     doms->doms     = NULL;
     doms->ndoms    = 0;
+    doms->cap      = 0;
+    doms->set      = NULL;
+    doms->slots    = 0;
+}
+
+void hvml_doms_reset(hvml_doms_t *doms) {
+    if (!doms) return;
+
+    doms->ndoms = 0;
+    if (doms->set) {
+        memset(doms->set, 0, doms->slots * sizeof(*doms->set));
+    }
 }
 
 void hvml_doms_destroy(hvml_doms_t *doms) {
@@ -204,34 +371,25 @@ hvml_dom_t* hvml_dom_create() {
     return dom;
 }
 
-void hvml_dom_destroy(hvml_dom_t *dom) {
-    hvml_dom_detach(dom);
+// releases dom itself, its attrs and children are left untouched
+static void hvml_dom_release(hvml_dom_t *dom) {
+    hvml_dom_arena_t *arena = dom->arena;
 
     switch (dom->dt) {
-        case MKDOT(D_ROOT):
-        {
-            hvml_dom_t *child = DOM_HEAD(dom);
-            if (!child) break;
-            A(hvml_dom_type(child)==MKDOT(D_TAG), "internal logic error");
-            A(DOM_NEXT(child)==NULL, "internal logic error");
-        } break;
-        case MKDOT(D_TAG):
-        {
-            hvml_string_clear(&dom->u.tag.name);
-        } break;
+        case MKDOT(D_ROOT): break;
+        case MKDOT(D_TAG): break;
         case MKDOT(D_ATTR):
         {
-            hvml_string_clear(&dom->u.attr.key);
-            hvml_string_clear(&dom->u.attr.val);
+            hvml_dom_string_clear(dom, &dom->u.attr.val);
         } break;
         case MKDOT(D_TEXT):
         {
-            hvml_string_clear(&dom->u.txt.txt);
+            hvml_dom_string_clear(dom, &dom->u.txt.txt);
         } break;
         case MKDOT(D_JSON):
         {
-            hvml_jo_value_free(dom->u.jo);
-            dom->u.jo = NULL;
+            hvml_dom_json_clear(dom);
+            if (arena) arena->jsons -= 1;
         } break;
         default:
         {
@@ -239,19 +397,62 @@ void hvml_dom_destroy(hvml_dom_t *dom) {
         } break;
     }
 
-    hvml_dom_t *d = DOM_HEAD(dom);
-    while (d) {
-        hvml_dom_destroy(d);
-        d = DOM_HEAD(dom);
+    if (!arena) {
+        free(dom);
+        return;
     }
 
-    d = DOM_ATTR_HEAD(dom);
-    while (d) {
-        hvml_dom_destroy(d);
-        d = DOM_ATTR_HEAD(dom);
+    // the rest lives in the arena
+    if (arena->owner==dom) {
+        hvml_dom_arena_destroy(arena);
+    }
+}
+
+void hvml_dom_destroy(hvml_dom_t *dom) {
+    hvml_dom_detach(dom);
+
+    hvml_dom_arena_t *arena = dom->arena;
+    if (arena && arena->owner==dom && arena->jsons==0) {
+        // nothing lives outside of the arena, no need to walk the tree
+        hvml_dom_arena_destroy(arena);
+        return;
+    }
+
+    if (dom->dt==MKDOT(D_ROOT) && DOM_HEAD(dom)) {
+        A(hvml_dom_type(DOM_HEAD(dom))==MKDOT(D_TAG), "internal logic error");
+        A(DOM_NEXT(DOM_HEAD(dom))==NULL, "internal logic error");
     }
 
-    free(dom);
+    // the whole subtree is going away, thus walked in post-order
+    // without recursion, nor unlinking nodes one by one
+    // attrs go before children, and dom itself goes last
+    hvml_dom_t *d = dom;
+    while (d) {
+        for (;;) {
+            if (DOM_ATTR_HEAD(d))   d = DOM_ATTR_HEAD(d);
+            else if (DOM_HEAD(d))   d = DOM_HEAD(d);
+            else break;
+        }
+
+        hvml_dom_t *next = NULL;
+        if (d != dom) {
+            if (DOM_ATTR_OWNER(d)) {
+                next = DOM_ATTR_NEXT(d);
+                if (!next) {
+                    next = DOM_ATTR_OWNER(d);
+                    DOM_ATTR_HEAD(next) = NULL;
+                }
+            } else {
+                next = DOM_NEXT(d);
+                if (!next) {
+                    next = DOM_OWNER(d);
+                    DOM_HEAD(next) = NULL;
+                }
+            }
+        }
+        hvml_dom_release(d);
+        d = next;
+    }
 }
 
 hvml_dom_t* hvml_dom_make_root(hvml_dom_t *dom) {
@@ -287,17 +488,20 @@ hvml_dom_t* hvml_dom_make_root(hvml_dom_t *dom) {
 
 hvml_dom_t* hvml_dom_append_attr(hvml_dom_t *dom, const char *key, size_t key_len, const char *val, size_t val_len) {
     A(!dom || dom->dt == MKDOT(D_TAG), "internal logic error");
-    hvml_dom_t *v      = hvml_dom_create();
+    hvml_dom_t *v      = hvml_dom_create_in(dom ? dom->arena : NULL);
     if (!v) return NULL;
     v->dt              = MKDOT(D_ATTR);
     do {
-        int ret = hvml_string_set(&v->u.attr.key, key, key_len);
-        if (ret) break;
+        v->u.attr.key = hvml_atom_intern(key, key_len);
+        if (!v->u.attr.key) break;
         if (val) {
-            ret = hvml_string_set(&v->u.attr.val, val, val_len);
+            int ret = hvml_dom_string_set(v, &v->u.attr.val, val, val_len);
             if (ret) break;
         }
-        if (dom) DOM_ATTR_APPEND(dom, v);
+        if (dom) {
+            DOM_ORDER_TOUCH(dom);
+            DOM_ATTR_APPEND(dom, v);
+        }
         return v;
     } while (0);
     hvml_dom_destroy(v);
@@ -308,7 +512,7 @@ hvml_dom_t* hvml_dom_set_val(hvml_dom_t *dom, const char *val, size_t val_len) {
     A(dom && dom->dt == MKDOT(D_ATTR), "internal logic error");
     A(dom->dt != MKDOT(D_ROOT), "internal logic error");
     do {
-        int ret = hvml_string_set(&dom->u.attr.val, val, val_len);
+        int ret = hvml_dom_string_set(dom, &dom->u.attr.val, val, val_len);
         if (ret) break;
         return dom;
     } while (0);
@@ -318,13 +522,16 @@ hvml_dom_t* hvml_dom_set_val(hvml_dom_t *dom, const char *val, size_t val_len) {
 hvml_dom_t* hvml_dom_append_content(hvml_dom_t *dom, const char *txt, size_t len) {
     A(!dom || dom->dt == MKDOT(D_TAG), "internal logic error");
     A(dom->dt != MKDOT(D_ROOT), "internal logic error");
-    hvml_dom_t *v      = hvml_dom_create();
+    hvml_dom_t *v      = hvml_dom_create_in(dom ? dom->arena : NULL);
     if (!v) return NULL;
     v->dt              = MKDOT(D_TEXT);
     do {
-        int ret = hvml_string_set(&v->u.txt.txt, txt, len);
+        int ret = hvml_dom_string_set(v, &v->u.txt.txt, txt, len);
         if (ret) break;
-        if (dom) DOM_APPEND(dom, v);
+        if (dom) {
+            DOM_ORDER_TOUCH(dom);
+            DOM_APPEND(dom, v);
+        }
         return v;
     } while (0);
     hvml_dom_destroy(v);
@@ -333,16 +540,17 @@ hvml_dom_t* hvml_dom_append_content(hvml_dom_t *dom, const char *txt, size_t len
 
 hvml_dom_t* hvml_dom_add_tag(hvml_dom_t *dom, const char *tag, size_t len) {
     A(!dom || dom->dt == MKDOT(D_TAG) || (dom->dt == MKDOT(D_ROOT) && DOM_HEAD(dom)==NULL), "internal logic error");
-    hvml_dom_t *v      = hvml_dom_create();
+    hvml_dom_t *v      = hvml_dom_create_in(dom ? dom->arena : NULL);
     if (!v) return NULL;
     v->dt              = MKDOT(D_TAG);
     do {
-        int ret = hvml_string_set(&v->u.tag.name, tag, len);
-        if (ret) break;
+        v->u.tag.name = hvml_atom_intern(tag, len);
+        if (!v->u.tag.name) break;
         if (dom) {
             if (dom->dt == MKDOT(D_ROOT)) {
                 A(DOM_HEAD(dom)==NULL, "internal logic error");
             }
+            DOM_ORDER_TOUCH(dom);
             DOM_APPEND(dom, v);
         }
         return v;
@@ -355,25 +563,82 @@ hvml_dom_t* hvml_dom_append_json(hvml_dom_t *dom, hvml_jo_value_t *jo) {
     A(dom && dom->dt == MKDOT(D_TAG), "internal logic error");
     A(dom->dt != MKDOT(D_ROOT), "internal logic error");
     A(jo, "internal logic error");
-    hvml_dom_t *v      = hvml_dom_create();
+    hvml_dom_t *v      = hvml_dom_create_in(dom->arena);
     if (!v) return NULL;
     v->dt              = MKDOT(D_JSON);
+    if (v->arena) v->arena->jsons += 1;
     if (hvml_jo_value_parent(jo)==NULL) {
         // jo is root, take owner ship
-        v->u.jo        = jo;
+        v->u.json.jo   = jo;
+        DOM_ORDER_TOUCH(dom);
         DOM_APPEND(dom, v);
         return v;
     }
     // jo is subvalue, clone it
-    v->u.jo = hvml_jo_clone(jo);
-    if (!v->u.jo) {
+    v->u.json.jo = hvml_jo_clone(jo);
+    if (!v->u.json.jo) {
         hvml_dom_destroy(v);
         return NULL;
     }
+    DOM_ORDER_TOUCH(dom);
     DOM_APPEND(dom, v);
     return v;
 }
 
+hvml_dom_t* hvml_dom_append_shared(hvml_dom_t *dom, hvml_dom_t *from) {
+    A(from, "internal logic error");
+    A(!dom || dom->dt == MKDOT(D_TAG) || (dom->dt == MKDOT(D_ROOT) && from->dt == MKDOT(D_TAG) && DOM_HEAD(dom)==NULL),
+      "internal logic error");
+    if (from->dt == MKDOT(D_ROOT)) {
+        E("D_ROOT can not be appended");
+        return NULL;
+    }
+
+    hvml_dom_t *v = hvml_dom_create_in(dom ? dom->arena : NULL);
+    if (!v) return NULL;
+    v->dt         = from->dt;
+
+    int r = 0;
+    switch (from->dt) {
+        case MKDOT(D_TAG):
+        {
+            v->u.tag.name = from->u.tag.name;
+        } break;
+        case MKDOT(D_ATTR):
+        {
+            v->u.attr.key = from->u.attr.key;
+            r = hvml_dom_string_share(v, &v->u.attr.val, &from->u.attr.val);
+        } break;
+        case MKDOT(D_TEXT):
+        {
+            r = hvml_dom_string_share(v, &v->u.txt.txt, &from->u.txt.txt);
+        } break;
+        case MKDOT(D_JSON):
+        {
+            if (v->arena) v->arena->jsons += 1;
+            r = hvml_dom_json_share(v, from);
+        } break;
+        default:
+        {
+            A(0, "internal logic error");
+        } break;
+    }
+    if (r) {
+        hvml_dom_destroy(v);
+        return NULL;
+    }
+    if (!dom) return v;
+
+    DOM_ORDER_TOUCH(dom);
+    if (v->dt == MKDOT(D_ATTR)) {
+        DOM_ATTR_APPEND(dom, v);
+    } else {
+        DOM_APPEND(dom, v);
+    }
+
+    return v;
+}
+
 hvml_dom_t* hvml_dom_root(hvml_dom_t *dom) {
     while (dom) {
         hvml_dom_t *parent = NULL;
@@ -459,10 +724,13 @@ hvml_dom_t* hvml_dom_attr_next(hvml_dom_t *attr) {
 }
 
 void hvml_dom_detach(hvml_dom_t *dom) {
+    // numbers within the detached subtree are still in relative order
     if (DOM_OWNER(dom)) {
+        DOM_ORDER_TOUCH(DOM_OWNER(dom));
         DOM_REMOVE(dom);
     }
     if (DOM_ATTR_OWNER(dom)) {
+        DOM_ORDER_TOUCH(DOM_ATTR_OWNER(dom));
         DOM_ATTR_REMOVE(dom);
     }
 }
@@ -473,78 +741,68 @@ hvml_dom_t* hvml_dom_select(hvml_dom_t *dom, const char *selector) {
     (void)selector;
 }
 
-void hvml_dom_str_serialize_file(const char *str, size_t len, FILE *out) {
+int hvml_dom_str_serialize_file(const char *str, size_t len, FILE *out) {
     hvml_stream_t *stream = hvml_stream_bind_file(out, 0);
-    if (!stream) return;
-    hvml_dom_str_serialize(str, len, stream);
+    if (!stream) return -1;
+    int r = hvml_dom_str_serialize(str, len, stream);
+    if (hvml_stream_flush(stream)) r = -1;
     hvml_stream_destroy(stream);
+    return r;
 }
 
-void hvml_dom_attr_val_serialize_file(const char *str, size_t len, FILE *out) {
+int hvml_dom_attr_val_serialize_file(const char *str, size_t len, FILE *out) {
     hvml_stream_t *stream = hvml_stream_bind_file(out, 0);
-    if (!stream) return;
-    hvml_dom_attr_val_serialize(str, len, stream);
+    if (!stream) return -1;
+    int r = hvml_dom_attr_val_serialize(str, len, stream);
+    if (hvml_stream_flush(stream)) r = -1;
     hvml_stream_destroy(stream);
+    return r;
 }
 
-int hvml_dom_str_serialize(const char *str, size_t len, hvml_stream_t *stream) {
-    const char *p = str;
-    int r = 0;
-    for (size_t i=0; i<len; ++i, ++p) {
-        const char c = *p;
-        switch (c) {
-            case '&': {
-                r = hvml_stream_printf(stream, "&amp;");
-            } break;
-            case '<': {
-                r = hvml_stream_printf(stream, "&lt;");
-            } break;
-            default: {
-                r = hvml_stream_printf(stream, "%c", c);
-            } break;
+// unescaped runs are located by hvml_escape_scan and copied in one go
+static int dom_str_serialize(const char *str, size_t len, HVML_ESCAPE_SET set, hvml_stream_t *stream) {
+    const char *p   = str;
+    const char *end = str + len;
+    while (p < end) {
+        size_t n = hvml_escape_scan(set, p, end - p);
+        if (hvml_stream_write(stream, p, n)) return -1;
+        p += n;
+        if (p == end) break;
+        const char *esc = NULL;
+        switch (*p) {
+            case '&': esc = "&amp;";  break;
+            case '<': esc = "&lt;";   break;
+            case '"': esc = "&quot;"; break;
+            default:  A(0, "internal logic error");
         }
-        if (r<0) break;
+        if (hvml_stream_puts(stream, esc)) return -1;
+        ++p;
     }
-    return r<0 ? -1 : 0;
+    return 0;
+}
+
+int hvml_dom_str_serialize(const char *str, size_t len, hvml_stream_t *stream) {
+    return dom_str_serialize(str, len, HVML_ESCAPE_DOM_TEXT, stream);
 }
 
 int hvml_dom_attr_val_serialize(const char *str, size_t len, hvml_stream_t *stream) {
-    const char *p = str;
-    int r = 0;
-    for (size_t i=0; i<len; ++i, ++p) {
-        const char c = *p;
-        switch (c) {
-            case '&': {
-                r = hvml_stream_printf(stream, "&amp;");
-            } break;
-            case '<': {
-                r = hvml_stream_printf(stream, "&lt;");
-            } break;
-            case '"': {
-                r = hvml_stream_printf(stream, "&quot;");
-            } break;
-            default: {
-                r = hvml_stream_printf(stream, "%c", c);
-            } break;
-        }
-        if (r<0) break;
-    }
-    return r<0 ? -1 : 0;
+    return dom_str_serialize(str, len, HVML_ESCAPE_DOM_ATTR, stream);
 }
 
 void hvml_dom_attr_set_key(hvml_dom_t *dom, const char *key, size_t key_len) {
     A((dom->dt == MKDOT(D_ATTR)), "internal logic error");
-    hvml_string_set(&dom->u.attr.key, key, key_len);
+    hvml_atom_t atom = hvml_atom_intern(key, key_len);
+    if (atom) dom->u.attr.key = atom;
 }
 
 void hvml_dom_attr_set_val(hvml_dom_t *dom, const char *val, size_t val_len) {
     A((dom->dt == MKDOT(D_ATTR)), "internal logic error");
-    hvml_string_set(&dom->u.attr.val, val, val_len);
+    hvml_dom_string_set(dom, &dom->u.attr.val, val, val_len);
 }
 
 void hvml_dom_set_text(hvml_dom_t *dom, const char *txt, size_t txt_len) {
     A((dom->dt == MKDOT(D_TEXT)), "internal logic error");
-    hvml_string_set(&dom->u.txt.txt, txt, txt_len);
+    hvml_dom_string_set(dom, &dom->u.txt.txt, txt, txt_len);
 }
 
 HVML_DOM_TYPE hvml_dom_type(hvml_dom_t *dom) {
@@ -553,12 +811,22 @@ HVML_DOM_TYPE hvml_dom_type(hvml_dom_t *dom) {
 
 const char* hvml_dom_tag_name(hvml_dom_t *dom) {
     A(dom->dt == MKDOT(D_TAG), "internal logic error");
-    return dom->u.tag.name.str;
+    return hvml_atom_str(dom->u.tag.name);
 }
 
 const char* hvml_dom_attr_key(hvml_dom_t *dom) {
     A(dom->dt == MKDOT(D_ATTR), "internal logic error");
-    return dom->u.attr.key.str;
+    return hvml_atom_str(dom->u.attr.key);
+}
+
+hvml_atom_t hvml_dom_tag_atom(hvml_dom_t *dom) {
+    A(dom->dt == MKDOT(D_TAG), "internal logic error");
+    return dom->u.tag.name;
+}
+
+hvml_atom_t hvml_dom_attr_atom(hvml_dom_t *dom) {
+    A(dom->dt == MKDOT(D_ATTR), "internal logic error");
+    return dom->u.attr.key;
 }
 
 const char* hvml_dom_attr_val(hvml_dom_t *dom) {
@@ -573,7 +841,31 @@ const char* hvml_dom_text(hvml_dom_t *dom) {
 
 hvml_jo_value_t* hvml_dom_jo(hvml_dom_t *dom) {
     A(dom->dt == MKDOT(D_JSON), "internal logic error");
-    return dom->u.jo;
+    hvml_dom_jo_ref_t *ref = dom->u.json.ref;
+    if (!ref) return dom->u.json.jo;
+
+    // about to be written thru the returned one, thus unshared first
+    if (hvml_atomic_get(&ref->refs)==1) {
+        // the only one left
+        free(ref);
+    } else {
+        hvml_jo_value_t *jo = hvml_jo_clone(ref->jo);
+        if (!jo) return NULL;
+        if (hvml_atomic_dec(&ref->refs)==0) {
+            // the others have gone in the meantime
+            hvml_jo_value_free(ref->jo);
+            free(ref);
+        }
+        dom->u.json.jo = jo;
+    }
+    dom->u.json.ref = NULL;
+
+    return dom->u.json.jo;
+}
+
+hvml_jo_value_t* hvml_dom_jo_shared(hvml_dom_t *dom) {
+    A(dom->dt == MKDOT(D_JSON), "internal logic error");
+    return dom->u.json.jo;
 }
 
 int hvml_dom_context_node_position(hvml_dom_context_node_t *node) {
@@ -617,6 +909,7 @@ int hvml_dom_back_traverse(hvml_dom_t *dom, void *arg, hvml_dom_back_traverse_cb
 typedef struct dom_clone_s            dom_clone_t;
 struct dom_clone_s {
     hvml_dom_t        *dom;
+    int                shared;    // texts, attr vals and jsons are shared rather than copied
 };
 
 static void traverse_for_clone(hvml_dom_t *dom, int lvl, int tag_open_close, void *arg, int *breakout) {
@@ -637,9 +930,8 @@ static void traverse_for_clone(hvml_dom_t *dom, int lvl, int tag_open_close, voi
         case MKDOT(D_TAG): {
             switch (tag_open_close) {
                 case 1: {
-                    const char *s = hvml_dom_tag_name(dom);
-                    A(s, "internal logic error");
-                    v = hvml_dom_add_tag(dc->dom, s, strlen(s));
+                    // atoms are immutable, thus shared in either way
+                    v = hvml_dom_append_shared(dc->dom, dom);
                     if (!v) break;
                     A(hvml_dom_type(v)==MKDOT(D_TAG), "internal logic error");
                     dc->dom = v;
@@ -670,21 +962,29 @@ static void traverse_for_clone(hvml_dom_t *dom, int lvl, int tag_open_close, voi
             }
         } break;
         case MKDOT(D_ATTR): {
-            const char *key = hvml_dom_attr_key(dom);
-            const char *val = hvml_dom_attr_val(dom);
-            A(key, "internal logic error");
             A(hvml_dom_type(dc->dom)==MKDOT(D_TAG), "internal logic error");
-            v = hvml_dom_append_attr(dc->dom, key, strlen(key), val, val ? strlen(val) : 0);
+            if (dc->shared) {
+                v = hvml_dom_append_shared(dc->dom, dom);
+            } else {
+                const char *key = hvml_dom_attr_key(dom);
+                const char *val = hvml_dom_attr_val(dom);
+                A(key, "internal logic error");
+                v = hvml_dom_append_attr(dc->dom, key, strlen(key), val, val ? strlen(val) : 0);
+            }
             if (!v) break;
             A(hvml_dom_type(v)==MKDOT(D_ATTR), "internal logic error");
             A(DOM_ATTR_OWNER(v)==dc->dom, "internal logic error");
             *breakout = 0;
         } break;
         case MKDOT(D_TEXT): {
-            const char *text = hvml_dom_text(dom);
-            A(text, "internal logic error");
             A(hvml_dom_type(dc->dom)==MKDOT(D_TAG), "internal logic error");
-            v = hvml_dom_append_content(dc->dom, text, strlen(text));
+            if (dc->shared) {
+                v = hvml_dom_append_shared(dc->dom, dom);
+            } else {
+                const char *text = hvml_dom_text(dom);
+                A(text, "internal logic error");
+                v = hvml_dom_append_content(dc->dom, text, strlen(text));
+            }
             if (!v) break;
             A(hvml_dom_type(v)==MKDOT(D_TEXT), "internal logic error");
             A(DOM_OWNER(v)==dc->dom, "internal logic error");
@@ -692,7 +992,14 @@ static void traverse_for_clone(hvml_dom_t *dom, int lvl, int tag_open_close, voi
         } break;
         case MKDOT(D_JSON): {
             A(dc->dom, "internal logic error");
-            hvml_jo_value_t *jo = hvml_dom_jo(dom);
+            if (dc->shared) {
+                A(hvml_dom_type(dc->dom)==MKDOT(D_TAG), "internal logic error");
+                v = hvml_dom_append_shared(dc->dom, dom);
+                if (!v) break;
+                *breakout = 0;
+                break;
+            }
+            hvml_jo_value_t *jo = hvml_dom_jo_shared(dom);
             A(jo, "internal logic error");
             jo = hvml_jo_clone(jo);
             if (!jo) break;
@@ -712,8 +1019,9 @@ static void traverse_for_clone(hvml_dom_t *dom, int lvl, int tag_open_close, voi
     }
 }
 
-hvml_dom_t* hvml_dom_clone(hvml_dom_t *dom) {
+static hvml_dom_t* do_hvml_dom_clone(hvml_dom_t *dom, int shared) {
     dom_clone_t arg = {0};
+    arg.shared = shared;
     int r = hvml_dom_traverse(dom, &arg, traverse_for_clone);
     if (r) {
         if (arg.dom) {
@@ -735,6 +1043,14 @@ hvml_dom_t* hvml_dom_clone(hvml_dom_t *dom) {
     return arg.dom;
 }
 
+hvml_dom_t* hvml_dom_clone(hvml_dom_t *dom) {
+    return do_hvml_dom_clone(dom, 0);
+}
+
+hvml_dom_t* hvml_dom_clone_shared(hvml_dom_t *dom) {
+    return do_hvml_dom_clone(dom, 1);
+}
+
 static int on_open_tag(void *arg, const char *tag);
 static int on_attr_key(void *arg, const char *key);
 static int on_attr_val(void *arg, const char *val);
@@ -751,7 +1067,7 @@ static int on_true(void *arg);
 static int on_false(void *arg);
 static int on_null(void *arg);
 static int on_string(void *arg, const char *val, size_t len);
-static int on_number(void *arg, const char *origin, long double val);
+static int on_number(void *arg, const hvml_json_number_t *num);
 static int on_end(void *arg);
 
 hvml_dom_gen_t* hvml_dom_gen_create() {
@@ -791,9 +1107,18 @@ hvml_dom_gen_t* hvml_dom_gen_create() {
     return gen;
 }
 
+hvml_dom_gen_t* hvml_dom_gen_create_with_arena() {
+    hvml_dom_gen_t *gen = hvml_dom_gen_create();
+    if (!gen) return NULL;
+
+    gen->with_arena = 1;
+
+    return gen;
+}
+
 void hvml_dom_gen_destroy(hvml_dom_gen_t *gen) {
     if (gen->dom) {
-        hvml_dom_t *root = hvml_dom_doc(gen->dom);
+        hvml_dom_t *root = hvml_dom_root(gen->dom);
         A(root, "internal logic error");
         hvml_dom_destroy(root);
         gen->dom = NULL;
@@ -805,13 +1130,34 @@ void hvml_dom_gen_destroy(hvml_dom_gen_t *gen) {
     }
 
     if (gen->jo) {
-        hvml_jo_value_free(gen->jo);
+        hvml_jo_value_free(hvml_jo_value_root(gen->jo));
         gen->jo = NULL;
     }
 
     free(gen);
 }
 
+void hvml_dom_gen_reset(hvml_dom_gen_t *gen) {
+    if (gen->dom) {
+        hvml_dom_t *root = hvml_dom_root(gen->dom);
+        A(root, "internal logic error");
+        hvml_dom_destroy(root);
+        gen->dom = NULL;
+    }
+
+    if (gen->jo) {
+        hvml_jo_value_free(hvml_jo_value_root(gen->jo));
+        gen->jo = NULL;
+    }
+
+    gen->map = NULL;
+    hvml_parser_reset(gen->parser);
+}
+
+void hvml_dom_gen_set_keep_origin(hvml_dom_gen_t *gen, int keep) {
+    gen->keep_origin = keep ? 1 : 0;
+}
+
 int hvml_dom_gen_parse_char(hvml_dom_gen_t *gen, const char c) {
     return hvml_parser_parse_char(gen->parser, c);
 }
@@ -838,26 +1184,604 @@ hvml_dom_t* hvml_dom_gen_parse_end(hvml_dom_gen_t *gen) {
     return root;
 }
 
-hvml_dom_t* hvml_dom_load_from_stream(FILE *in) {
-    hvml_dom_gen_t *gen = hvml_dom_gen_create();
-    if (!gen) return NULL;
+hvml_dom_t* hvml_dom_load_from_stream(FILE *in) {
+    hvml_dom_gen_t *gen = hvml_dom_gen_create();
+    if (!gen) return NULL;
+
+    char buf[4096] = {0};
+    int  n         = 0;
+    int  ret       = 0;
+
+    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
+        ret = hvml_dom_gen_parse(gen, buf, n);
+        if (ret) break;
+    }
+    hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
+    hvml_dom_gen_destroy(gen);
+
+    if (ret==0) {
+        return dom;
+    }
+    if (dom) hvml_dom_destroy(dom);
+    return NULL;
+}
+
+hvml_dom_t* hvml_dom_load_from_file(const char *path) {
+    hvml_file_map_t map;
+    if (hvml_file_map(path, &map)) return NULL;
+
+    hvml_dom_gen_t *gen = hvml_dom_gen_create_with_arena();
+    if (!gen) {
+        hvml_file_unmap(&map);
+        return NULL;
+    }
+    gen->map = &map;
+
+    // all at once, straight from the mapping
+    int ret = hvml_dom_gen_parse(gen, map.buf, map.len);
+    hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
+    hvml_dom_gen_destroy(gen);
+
+    if (ret==0 && dom) {
+        // the document owns the mapping from now on
+        A(dom->arena && dom->arena->owner==dom, "internal logic error");
+        dom->arena->map = map;
+        return dom;
+    }
+    if (dom) hvml_dom_destroy(dom);
+    hvml_file_unmap(&map);
+    return NULL;
+}
+
+// snapshot: a relocatable image of a document, valid on the same platform only
+//   header | nodes | jos | numbers | strings
+// nodes are in document order with attrs right after their owner, and refer
+// to their parent by index. jo's are in pre-order and refer to # of children.
+// strings are null-terminated, deduplicated, and referred to by offset
+#define DOM_SNAP_MAGIC       "HVMLSNAP"
+#define DOM_SNAP_VERSION     2
+#define DOM_SNAP_ENDIAN      0x01020304u
+#define DOM_SNAP_NONE        0xffffffffu
+
+typedef struct dom_snap_header_s        dom_snap_header_t;
+typedef struct dom_snap_node_s          dom_snap_node_t;
+typedef struct dom_snap_jo_s            dom_snap_jo_t;
+typedef struct dom_snap_number_s        dom_snap_number_t;
+typedef struct dom_snap_s               dom_snap_t;
+
+struct dom_snap_header_s {
+    char              magic[8];
+    uint32_t          version;
+    uint32_t          endian;
+    uint32_t          number;       // sizeof(dom_snap_number_t)
+    uint32_t          reserved;
+    uint64_t          nodes;
+    uint64_t          jos;
+    uint64_t          numbers;
+    uint64_t          strings;      // in bytes
+};
+
+struct dom_snap_node_s {
+    uint32_t          dt;
+    uint32_t          parent;       // DOM_SNAP_NONE for the root
+    uint32_t          a, a_len;     // tag name/attr key/text, or first jo and # of jo's for D_JSON
+    uint32_t          b, b_len;     // attr val
+};
+
+struct dom_snap_jo_s {
+    uint32_t          jot;
+    uint32_t          n;            // # of children, or index into numbers for J_NUMBER
+    uint32_t          s, s_len;     // string/key/origin of number, if kept
+};
+
+struct dom_snap_number_s {
+    union {
+        int64_t       i;
+        double        d;
+    } v;
+    uint32_t          integer;
+    uint32_t          len;          // of the origin text, even if not kept
+};
+
+struct dom_snap_s {
+    hvml_string_t     nodes;
+    hvml_string_t     jos;
+    hvml_string_t     numbers;
+    hvml_string_t     strings;
+    uint64_t          nnodes;
+    uint64_t          njos;
+    uint64_t          nnumbers;
+
+    // dedup of strings, open addressing, offset+1 of each
+    uint32_t         *slots;
+    size_t            nslots;
+    size_t            used;
+};
+
+static size_t dom_snap_hash(const char *s, size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static int dom_snap_string(dom_snap_t *snap, const char *s, size_t len, uint32_t *off) {
+    if (!s) {
+        s   = "";
+        len = 0;
+    }
+    if (len >= DOM_SNAP_NONE || snap->strings.len + len + 1 >= DOM_SNAP_NONE) {
+        E("string too long for snapshot");
+        return -1;
+    }
+
+    if ((snap->used + 1) * 2 > snap->nslots) {
+        size_t    nslots = snap->nslots ? snap->nslots * 2 : 1024;
+        uint32_t *slots  = (uint32_t*)calloc(nslots, sizeof(*slots));
+        if (!slots) return -1;
+        for (size_t i=0; i<snap->nslots; ++i) {
+            uint32_t o = snap->slots[i];
+            if (!o) continue;
+            const char *p = snap->strings.str + o - 1;
+            size_t j = dom_snap_hash(p, strlen(p)) & (nslots - 1);
+            while (slots[j]) j = (j + 1) & (nslots - 1);
+            slots[j] = o;
+        }
+        free(snap->slots);
+        snap->slots  = slots;
+        snap->nslots = nslots;
+    }
+
+    // strings with \0 inside are never matched, thus simply not shared
+    size_t j = dom_snap_hash(s, len) & (snap->nslots - 1);
+    while (snap->slots[j]) {
+        const char *p = snap->strings.str + snap->slots[j] - 1;
+        if (strncmp(p, s, len)==0 && p[len]=='\0' && memchr(s, '\0', len)==NULL) {
+            *off = snap->slots[j] - 1;
+            return 0;
+        }
+        j = (j + 1) & (snap->nslots - 1);
+    }
+
+    *off = (uint32_t)snap->strings.len;
+    if (hvml_string_append_n(&snap->strings, s, len)) return -1;
+    if (hvml_string_push(&snap->strings, '\0')) return -1;
+    if (memchr(s, '\0', len)==NULL) {
+        snap->slots[j] = *off + 1;
+        snap->used    += 1;
+    }
+    return 0;
+}
+
+static int dom_snap_jo_rec(dom_snap_t *snap, hvml_jo_value_t *jo) {
+    dom_snap_jo_t rec = {0};
+    rec.jot = hvml_jo_value_type(jo);
+
+    const char *s   = NULL;
+    size_t      len = 0;
+    switch (hvml_jo_value_type(jo)) {
+        case MKJOT(J_NUMBER):
+        {
+            hvml_json_number_t num;
+            A(0==hvml_jo_number_get_json(jo, &num), "internal logic error");
+            dom_snap_number_t n;
+            memset(&n, 0, sizeof(n));
+            if (num.integer) n.v.i = num.i;
+            else             n.v.d = num.d;
+            n.integer = num.integer;
+            n.len     = num.len > UINT32_MAX ? UINT32_MAX : (uint32_t)num.len;
+            s         = num.origin;
+            len       = num.origin ? num.len : 0;
+            rec.n = (uint32_t)snap->nnumbers;
+            if (hvml_string_append_n(&snap->numbers, (const char*)&n, sizeof(n))) return -1;
+            snap->nnumbers += 1;
+        } break;
+        case MKJOT(J_STRING):
+        {
+            A(0==hvml_jo_string_get_len(jo, &s, &len), "internal logic error");
+        } break;
+        case MKJOT(J_OBJECT_KV):
+        {
+            A(0==hvml_jo_kv_get_key(jo, &s, &len), "internal logic error");
+            rec.n = (uint32_t)hvml_jo_value_children(jo);
+        } break;
+        case MKJOT(J_OBJECT):
+        case MKJOT(J_ARRAY):
+        {
+            rec.n = (uint32_t)hvml_jo_value_children(jo);
+        } break;
+        default: break;
+    }
+    if (dom_snap_string(snap, s, len, &rec.s)) return -1;
+    rec.s_len = (uint32_t)len;
+
+    if (hvml_string_append_n(&snap->jos, (const char*)&rec, sizeof(rec))) return -1;
+    snap->njos += 1;
+
+    return 0;
+}
+
+static int dom_snap_jo(dom_snap_t *snap, hvml_jo_value_t *jo) {
+    // pre-order, without recursion, thus no limit on nesting
+    hvml_jo_value_t *v = jo;
+    while (v) {
+        if (dom_snap_jo_rec(snap, v)) return -1;
+
+        hvml_jo_value_t *next = hvml_jo_value_child(v);
+        if (next) {
+            v = next;
+            continue;
+        }
+        while (v != jo && !hvml_jo_value_sibling_next(v)) v = hvml_jo_value_owner(v);
+        v = (v == jo) ? NULL : hvml_jo_value_sibling_next(v);
+    }
+    return 0;
+}
+
+static int dom_snap_node(dom_snap_t *snap, hvml_dom_t *dom, uint32_t parent) {
+    if (snap->nnodes >= DOM_SNAP_NONE) return -1;
+
+    uint32_t        idx = (uint32_t)snap->nnodes;
+    dom_snap_node_t rec = {0};
+    rec.dt     = dom->dt;
+    rec.parent = parent;
+
+    int r = 0;
+    switch (dom->dt) {
+        case MKDOT(D_ROOT): break;
+        case MKDOT(D_TAG):
+        {
+            size_t len = hvml_atom_len(dom->u.tag.name);
+            r = dom_snap_string(snap, hvml_atom_str(dom->u.tag.name), len, &rec.a);
+            rec.a_len = (uint32_t)len;
+        } break;
+        case MKDOT(D_ATTR):
+        {
+            size_t len = hvml_atom_len(dom->u.attr.key);
+            r = dom_snap_string(snap, hvml_atom_str(dom->u.attr.key), len, &rec.a);
+            rec.a_len = (uint32_t)len;
+            if (r==0) r = dom_snap_string(snap, dom->u.attr.val.str, dom->u.attr.val.len, &rec.b);
+            rec.b_len = (uint32_t)dom->u.attr.val.len;
+            // null if no value at all, rather than an empty one
+            if (!dom->u.attr.val.str) rec.b = DOM_SNAP_NONE;
+        } break;
+        case MKDOT(D_TEXT):
+        {
+            r = dom_snap_string(snap, dom->u.txt.txt.str, dom->u.txt.txt.len, &rec.a);
+            rec.a_len = (uint32_t)dom->u.txt.txt.len;
+        } break;
+        case MKDOT(D_JSON):
+        {
+            uint64_t first = snap->njos;
+            r = dom_snap_jo(snap, dom->u.json.jo);
+            rec.a     = (uint32_t)first;
+            rec.a_len = (uint32_t)(snap->njos - first);
+            if (snap->njos >= DOM_SNAP_NONE) r = -1;
+        } break;
+        default:
+        {
+            A(0, "internal logic error");
+        } break;
+    }
+    if (r) return -1;
+
+    if (hvml_string_append_n(&snap->nodes, (const char*)&rec, sizeof(rec))) return -1;
+    snap->nnodes += 1;
+
+    for (hvml_dom_t *d = DOM_ATTR_HEAD(dom); d; d = DOM_ATTR_NEXT(d)) {
+        if (dom_snap_node(snap, d, idx)) return -1;
+    }
+    for (hvml_dom_t *d = DOM_HEAD(dom); d; d = DOM_NEXT(d)) {
+        if (dom_snap_node(snap, d, idx)) return -1;
+    }
+    return 0;
+}
+
+int hvml_dom_save_snapshot(hvml_dom_t *dom, const char *path) {
+    A(dom, "internal logic error");
+    if (dom->dt != MKDOT(D_ROOT)) {
+        E("only documents can be snapshotted");
+        return -1;
+    }
+
+    dom_snap_t snap;
+    memset(&snap, 0, sizeof(snap));
+
+    int r = dom_snap_node(&snap, dom, DOM_SNAP_NONE);
+
+    FILE *out = NULL;
+    if (r==0) {
+        out = fopen(path, "wb");
+        if (!out) {
+            E("failed to open file: %s", path);
+            r = -1;
+        }
+    }
+    if (r==0) {
+        dom_snap_header_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, DOM_SNAP_MAGIC, sizeof(hdr.magic));
+        hdr.version  = DOM_SNAP_VERSION;
+        hdr.endian   = DOM_SNAP_ENDIAN;
+        hdr.number   = sizeof(dom_snap_number_t);
+        hdr.nodes    = snap.nnodes;
+        hdr.jos      = snap.njos;
+        hdr.numbers  = snap.nnumbers;
+        hdr.strings  = snap.strings.len;
+
+        if (fwrite(&hdr, sizeof(hdr), 1, out)!=1) r = -1;
+        if (r==0 && snap.nodes.len   && fwrite(snap.nodes.str,   snap.nodes.len,   1, out)!=1) r = -1;
+        if (r==0 && snap.jos.len     && fwrite(snap.jos.str,     snap.jos.len,     1, out)!=1) r = -1;
+        if (r==0 && snap.numbers.len && fwrite(snap.numbers.str, snap.numbers.len, 1, out)!=1) r = -1;
+        if (r==0 && snap.strings.len && fwrite(snap.strings.str, snap.strings.len, 1, out)!=1) r = -1;
+        if (fclose(out)) r = -1;
+        if (r) E("failed to write file: %s", path);
+    }
+
+    hvml_string_clear(&snap.nodes);
+    hvml_string_clear(&snap.jos);
+    hvml_string_clear(&snap.numbers);
+    hvml_string_clear(&snap.strings);
+    free(snap.slots);
+
+    return r ? -1 : 0;
+}
+
+typedef struct dom_snap_view_s          dom_snap_view_t;
+struct dom_snap_view_s {
+    const dom_snap_node_t  *nodes;
+    const dom_snap_jo_t    *jos;
+    const char             *numbers;
+    char                   *strings;
+    dom_snap_header_t       hdr;
+};
+
+static const char* dom_snap_view_string(dom_snap_view_t *view, uint32_t off, uint32_t len) {
+    if ((uint64_t)off + len >= view->hdr.strings) return NULL;
+    if (view->strings[off + len] != '\0') return NULL;
+    return view->strings + off;
+}
+
+static hvml_jo_value_t* dom_snap_view_jo_rec(dom_snap_view_t *view, const dom_snap_jo_t *rec) {
+    const char *s = dom_snap_view_string(view, rec->s, rec->s_len);
+    if (!s) return NULL;
+
+    switch (rec->jot) {
+        case MKJOT(J_TRUE):      return hvml_jo_true();
+        case MKJOT(J_FALSE):     return hvml_jo_false();
+        case MKJOT(J_NULL):      return hvml_jo_null();
+        case MKJOT(J_STRING):    return hvml_jo_string(s, rec->s_len);
+        case MKJOT(J_OBJECT):    return hvml_jo_object();
+        case MKJOT(J_ARRAY):     return hvml_jo_array();
+        case MKJOT(J_OBJECT_KV): return hvml_jo_object_kv(s, rec->s_len);
+        case MKJOT(J_NUMBER):
+        {
+            if (rec->n >= view->hdr.numbers) return NULL;
+            dom_snap_number_t  n;
+            memcpy(&n, view->numbers + (size_t)rec->n * sizeof(n), sizeof(n));
+            hvml_json_number_t num;
+            memset(&num, 0, sizeof(num));
+            num.integer = n.integer ? 1 : 0;
+            if (num.integer) num.i = n.v.i;
+            else             num.d = n.v.d;
+            num.origin  = rec->s_len ? s : NULL;
+            num.len     = rec->s_len ? rec->s_len : n.len;
+            return hvml_jo_number_from_json(&num);
+        } break;
+        default: return NULL;
+    }
+}
+
+// jo's are small and owned one by one, thus rebuilt on the heap
+// records are in pre-order, and rebuilt without recursion, thus no limit on nesting
+static hvml_jo_value_t* dom_snap_view_jo(dom_snap_view_t *view, uint64_t *i, uint64_t end) {
+    hvml_jo_value_t *root = NULL;
+    hvml_jo_value_t *cur  = NULL;     // the container being filled
+
+    // # of children still expected, one per open container
+    uint32_t        *left = NULL;
+    size_t           nleft = 0;
+    size_t           cap   = 0;
+
+    int ok = 1;
+    do {
+        if (*i >= end) { ok = 0; break; }
+        const dom_snap_jo_t *rec = view->jos + *i;
+        *i += 1;
+
+        uint32_t n = 0;
+        switch (rec->jot) {
+            case MKJOT(J_OBJECT):
+            case MKJOT(J_ARRAY):     n = rec->n; break;
+            case MKJOT(J_OBJECT_KV): n = 1;      break;
+            default: break;
+        }
+        // kv's go into objects, and nowhere else, each with one single value
+        int kv = rec->jot==MKJOT(J_OBJECT_KV);
+        if (kv && rec->n!=1)                                          { ok = 0; break; }
+        if (kv != (cur && hvml_jo_value_type(cur)==MKJOT(J_OBJECT))) { ok = 0; break; }
+
+        hvml_jo_value_t *jo = dom_snap_view_jo_rec(view, rec);
+        if (!jo) { ok = 0; break; }
+        if (!cur) {
+            root = jo;
+        } else {
+            if (hvml_jo_value_push(cur, jo)) {
+                hvml_jo_value_free(jo);
+                ok = 0;
+                break;
+            }
+            left[nleft-1] -= 1;
+        }
+
+        if (n) {
+            if (nleft == cap) {
+                size_t    c = cap ? cap * 2 : 64;
+                uint32_t *p = (uint32_t*)realloc(left, c * sizeof(*left));
+                if (!p) { ok = 0; break; }
+                left = p;
+                cap  = c;
+            }
+            left[nleft++] = n;
+            cur = jo;
+        }
+        while (cur && left[nleft-1]==0) {
+            nleft -= 1;
+            cur    = nleft ? hvml_jo_value_owner(cur) : NULL;
+        }
+    } while (cur);
+
+    free(left);
+    if (!ok) {
+        // the whole rebuilt so far hangs on the root
+        if (root) hvml_jo_value_free(root);
+        return NULL;
+    }
+    return root;
+}
+
+hvml_dom_t* hvml_dom_load_snapshot(const char *path) {
+    hvml_file_map_t map;
+    if (hvml_file_map(path, &map)) return NULL;
 
-    char buf[4096] = {0};
-    int  n         = 0;
-    int  ret       = 0;
+    dom_snap_view_t view;
+    memset(&view, 0, sizeof(view));
 
-    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
-        ret = hvml_dom_gen_parse(gen, buf, n);
-        if (ret) break;
+    int ok = 0;
+    do {
+        if (map.len < sizeof(view.hdr)) break;
+        memcpy(&view.hdr, map.buf, sizeof(view.hdr));
+        if (memcmp(view.hdr.magic, DOM_SNAP_MAGIC, sizeof(view.hdr.magic))) break;
+        if (view.hdr.version != DOM_SNAP_VERSION)   break;
+        if (view.hdr.endian  != DOM_SNAP_ENDIAN)    break;
+        if (view.hdr.number  != sizeof(dom_snap_number_t)) break;
+        if (view.hdr.nodes == 0 || view.hdr.nodes >= DOM_SNAP_NONE) break;
+        if (view.hdr.jos >= DOM_SNAP_NONE || view.hdr.numbers >= DOM_SNAP_NONE) break;
+        if (view.hdr.strings >= DOM_SNAP_NONE) break;
+        uint64_t bytes = sizeof(view.hdr)
+                       + view.hdr.nodes   * sizeof(dom_snap_node_t)
+                       + view.hdr.jos     * sizeof(dom_snap_jo_t)
+                       + view.hdr.numbers * sizeof(dom_snap_number_t)
+                       + view.hdr.strings;
+        if (bytes != map.len) break;
+        ok = 1;
+    } while (0);
+    if (!ok) {
+        E("not a valid snapshot: %s", path);
+        hvml_file_unmap(&map);
+        return NULL;
     }
-    hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
-    hvml_dom_gen_destroy(gen);
 
-    if (ret==0) {
-        return dom;
+    char *p = map.buf + sizeof(view.hdr);
+    view.nodes   = (const dom_snap_node_t*)p;  p += view.hdr.nodes   * sizeof(dom_snap_node_t);
+    view.jos     = (const dom_snap_jo_t*)p;    p += view.hdr.jos     * sizeof(dom_snap_jo_t);
+    view.numbers = p;                          p += view.hdr.numbers * sizeof(dom_snap_number_t);
+    view.strings = p;
+
+    hvml_dom_arena_t *arena = hvml_dom_arena_create();
+    hvml_dom_t       *doms  = NULL;
+    if (arena) {
+        // all nodes at once, then linked by index
+        doms = (hvml_dom_t*)hvml_dom_arena_alloc(arena, view.hdr.nodes * sizeof(*doms), sizeof(void*));
     }
-    if (dom) hvml_dom_destroy(dom);
-    return NULL;
+    if (!doms) {
+        hvml_dom_arena_destroy(arena);
+        hvml_file_unmap(&map);
+        return NULL;
+    }
+    memset(doms, 0, view.hdr.nodes * sizeof(*doms));
+    doms->dt     = MKDOT(D_ROOT);
+    doms->arena  = arena;
+    arena->owner = doms;
+    arena->map   = map;
+
+    ok = view.nodes[0].dt == MKDOT(D_ROOT) && view.nodes[0].parent == DOM_SNAP_NONE;
+    for (uint64_t i=0; i<view.hdr.nodes && ok; ++i) {
+        const dom_snap_node_t *rec = view.nodes + i;
+        hvml_dom_t            *v   = doms + i;
+        v->dt    = (HVML_DOM_TYPE)rec->dt;
+        v->arena = arena;
+
+        hvml_dom_t *parent = NULL;
+        if (i>0) {
+            if (rec->parent >= i) { ok = 0; break; }
+            parent = doms + rec->parent;
+        }
+
+        const char *a = NULL;
+        switch (rec->dt) {
+            case MKDOT(D_ROOT):
+            {
+                ok = (i==0);
+            } break;
+            case MKDOT(D_TAG):
+            {
+                a  = dom_snap_view_string(&view, rec->a, rec->a_len);
+                // a document has one single top-most tag
+                ok = a && ((parent->dt==MKDOT(D_ROOT) && !DOM_HEAD(parent)) || parent->dt==MKDOT(D_TAG));
+                if (!ok) break;
+                v->u.tag.name = hvml_atom_intern(a, rec->a_len);
+                ok = v->u.tag.name ? 1 : 0;
+                if (!ok) break;
+                DOM_APPEND(parent, v);
+            } break;
+            case MKDOT(D_ATTR):
+            {
+                a  = dom_snap_view_string(&view, rec->a, rec->a_len);
+                ok = a && parent->dt==MKDOT(D_TAG);
+                if (!ok) break;
+                v->u.attr.key = hvml_atom_intern(a, rec->a_len);
+                ok = v->u.attr.key ? 1 : 0;
+                if (!ok) break;
+                if (rec->b != DOM_SNAP_NONE) {
+                    const char *b = dom_snap_view_string(&view, rec->b, rec->b_len);
+                    if (!b) { ok = 0; break; }
+                    v->u.attr.val.str = b;
+                    v->u.attr.val.len = rec->b_len;
+                }
+                DOM_ATTR_APPEND(parent, v);
+            } break;
+            case MKDOT(D_TEXT):
+            {
+                a  = dom_snap_view_string(&view, rec->a, rec->a_len);
+                ok = a && parent->dt==MKDOT(D_TAG);
+                if (!ok) break;
+                v->u.txt.txt.str = a;
+                v->u.txt.txt.len = rec->a_len;
+                DOM_APPEND(parent, v);
+            } break;
+            case MKDOT(D_JSON):
+            {
+                uint64_t j   = rec->a;
+                uint64_t end = (uint64_t)rec->a + rec->a_len;
+                ok = parent->dt==MKDOT(D_TAG) && end <= view.hdr.jos;
+                if (!ok) break;
+                // kv's are rejected at the top, thus never left behind here
+                v->u.json.jo = dom_snap_view_jo(&view, &j, end);
+                ok = v->u.json.jo ? 1 : 0;
+                if (!ok) break;
+                arena->jsons += 1;
+                DOM_APPEND(parent, v);
+                ok = (j==end);
+            } break;
+            default:
+            {
+                ok = 0;
+            } break;
+        }
+    }
+
+    if (!ok) {
+        E("not a valid snapshot: %s", path);
+        // json's are owned only once appended, thus nothing leaks
+        hvml_dom_destroy(doms);
+        return NULL;
+    }
+
+    return doms;
 }
 
 static int do_hvml_dom_check_node_test(hvml_dom_t *dom, HVML_DOM_XPATH_AXIS_TYPE axis, hvml_dom_xpath_node_test_t *node_test, hvml_dom_t **v);
@@ -1018,63 +1942,83 @@ static int hvml_doms_append_relative(hvml_doms_t *out, HVML_DOM_XPATH_AXIS_TYPE
     return collect.failed ? -1 : 0;
 }
 
-typedef struct doms_sort_s        doms_sort_t;
-struct doms_sort_s {
-    hvml_doms_t    *doms;
-    hvml_doms_t    *in;
-    size_t          count;
-    int             failed;
+#define DOM_ORDER_LOCKS          16
+
+#ifdef _MSC_VER
+static SRWLOCK                 order_locks[DOM_ORDER_LOCKS] = {
+    SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT,
+    SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT,
+    SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT,
+    SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT,
 };
+static void order_acquire(size_t i) { AcquireSRWLockExclusive(order_locks + i); }
+static void order_release(size_t i) { ReleaseSRWLockExclusive(order_locks + i); }
+#else
+static pthread_mutex_t         order_locks[DOM_ORDER_LOCKS] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+};
+static void order_acquire(size_t i) { pthread_mutex_lock(order_locks + i); }
+static void order_release(size_t i) { pthread_mutex_unlock(order_locks + i); }
+#endif
+
+static void hvml_dom_order_invalidate(hvml_dom_t *dom) {
+    hvml_dom_t *top = hvml_dom_root(dom);
+    A(top, "internal logic error");
+    hvml_atomic_set(&top->seq, 0);
+}
 
-static void traverse_for_doms_sort(hvml_dom_t *dom, int lvl, int tag_open_close, void *arg, int *breakout) {
-    doms_sort_t *parg = (doms_sort_t*)arg;
-    A(parg, "internal logic error");
-    A(lvl>=0, "internal logic error");
+static void traverse_for_order(hvml_dom_t *dom, int lvl, int tag_open_close, void *arg, int *breakout) {
+    (void)lvl;
+    size_t *seq = (size_t*)arg;
 
     *breakout = 0;
 
-    int r = 0;
+    // the top-most one is numbered by hvml_dom_order_renumber, at last
+    if (*seq == 0) {
+        ++*seq;
+        return;
+    }
 
     switch (hvml_dom_type(dom)) {
-        case MKDOT(D_ROOT): break;
-        case MKDOT(D_TAG):
-        {
-            switch (tag_open_close) {
-                case 1: break;
-                case 2:
-                case 3:
-                case 4: {
-                    dom = NULL;
-                } break;
-                default: {
-                    A(0, "internal logic error");
-                } break;
-            }
+        case MKDOT(D_TAG): {
+            // numbered when opened
+            if (tag_open_close != 1) return;
         } break;
-        case MKDOT(D_ATTR): break;
-        case MKDOT(D_TEXT): break;
+        case MKDOT(D_ROOT):
+        case MKDOT(D_ATTR):
+        case MKDOT(D_TEXT):
         case MKDOT(D_JSON): break;
         default: {
             A(0, "internal logic error");
         } break;
     }
-    if (!dom) return;
-    for (size_t i=0; i<parg->in->ndoms; ++i) {
-        if (parg->in->doms[i] != dom) continue;
-        r = hvml_doms_append_dom(parg->doms, dom);
-        if (r) break;
-        parg->in->doms[i] = NULL;
-        parg->count -= 1;
-        break;
-    }
-    if (r) {
-        parg->failed = -1;
-        *breakout = 1;
-        return;
-    }
-    if (parg->count == 0) {
-        *breakout = 1;
+    dom->seq = ++*seq;
+}
+
+static void hvml_dom_order_renumber(hvml_dom_t *top) {
+    if (hvml_atomic_get(&top->seq)) return;
+
+    size_t lock = ((uintptr_t)top / sizeof(*top)) % DOM_ORDER_LOCKS;
+    order_acquire(lock);
+    // numbered by another thread in the meantime
+    if (hvml_atomic_get(&top->seq) == 0) {
+        size_t seq = 0;
+        hvml_dom_traverse(top, &seq, traverse_for_order);
+        // publish the numbers of the others
+        hvml_atomic_set(&top->seq, 1);
     }
+    order_release(lock);
+}
+
+static int doms_order_cmp(const void *l, const void *r) {
+    const hvml_dom_t *ld = *(hvml_dom_t* const*)l;
+    const hvml_dom_t *rd = *(hvml_dom_t* const*)r;
+    if (ld->seq < rd->seq) return -1;
+    if (ld->seq > rd->seq) return  1;
+    return 0;
 }
 
 int hvml_doms_reverse(hvml_doms_t *doms) {
@@ -1096,17 +2040,15 @@ int hvml_doms_sort(hvml_doms_t *doms, hvml_doms_t *in) {
     if (in->ndoms==0) return 0;
     A(in->doms[0], "internal logic error");
 
-    doms_sort_t parg;
-    parg.doms    = doms;
-    parg.in      = in;
-    parg.count   = in->ndoms;
-    parg.failed  = 0;
-    hvml_dom_traverse(hvml_dom_root(in->doms[0]), &parg, traverse_for_doms_sort);
-    if (parg.failed) {
+    hvml_dom_t *top = hvml_dom_root(in->doms[0]);
+    hvml_dom_order_renumber(top);
+
+    if (hvml_doms_append_doms(doms, in)) {
         hvml_doms_cleanup(doms);
         return -1;
     }
-    A(parg.count == 0, "internal logic error");
+    qsort(doms->doms, doms->ndoms, sizeof(*doms->doms), doms_order_cmp);
+
     return 0;
 }
 
@@ -1172,12 +2114,20 @@ static int do_hvml_dom_check_node_test(hvml_dom_t *dom, HVML_DOM_XPATH_AXIS_TYPE
     const char *prefix     = node_test->u.name_test.prefix;
     const char *local_part = node_test->u.name_test.local_part;
     A(local_part, "internal logic error");
-    const char *tok = NULL;
+    hvml_atom_t atom = HVML_ATOM_NONE;
     if (dom->dt == MKDOT(D_TAG)) {
-        tok = hvml_dom_tag_name(dom);
+        atom = dom->u.tag.name;
     } else if (dom->dt == MKDOT(D_ATTR)) {
-        tok = hvml_dom_attr_key(dom);
+        atom = dom->u.attr.key;
     }
+
+    if (node_test->u.name_test.atom) {
+        // "xxx" or "xxx:yyy", interned when compiled
+        if (atom == node_test->u.name_test.atom) *v = dom;
+        return 0;
+    }
+
+    const char *tok   = atom ? hvml_atom_str(atom) : NULL;
     const char *colon = tok ? strchr(tok, ':') : NULL;
 
     if (strcmp(local_part, "*")==0) {
@@ -1193,25 +2143,10 @@ static int do_hvml_dom_check_node_test(hvml_dom_t *dom, HVML_DOM_XPATH_AXIS_TYPE
         *v = dom;
         return 0;
     }
-    if (prefix && strcmp(prefix, "*")==0) {
-        // "*:xxx"
-        if (!tok) return 0;
-        if (!colon) return 0;
-        if (strcmp(colon+1, local_part)) return 0;
-        *v = dom;
-        return 0;
-    }
-    if (!prefix) {
-        // "xxx"
-        if (!tok) return 0;
-        if (strcmp(tok, local_part)) return 0;
-        *v = dom;
-        return 0;
-    }
-    // "xxx:yyy"
+    A(prefix && strcmp(prefix, "*")==0, "internal logic error");
+    // "*:xxx"
     if (!tok) return 0;
     if (!colon) return 0;
-    if (strstr(tok, prefix)!=tok) return 0;
     if (strcmp(colon+1, local_part)) return 0;
     *v = dom;
     return 0;
@@ -2511,21 +3446,266 @@ static int hvml_dom_xpath_eval_arith(hvml_dom_xpath_eval_t *left, hvml_dom_xpath
     return 0;
 }
 
-int hvml_dom_query(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
-    A(path,   "internal logic error");
+// compiled xpath
+// when cached, refc is guarded by the cache lock, and steps are shared
+// read-only among threads
+struct hvml_dom_xpath_s {
+    char                    *path;
+    size_t                   len;
+    size_t                   hash;
+    hvml_dom_xpath_steps_t   steps;
+
+    size_t                   refc;
+    unsigned int             cached:1;     // created thru the cache
+
+    hvml_dom_xpath_t        *lru_prev;     // most recently used comes first
+    hvml_dom_xpath_t        *lru_next;
+    hvml_dom_xpath_t        *bucket_next;
+};
 
-    int r = 0;
+typedef struct xpath_cache_s           xpath_cache_t;
+struct xpath_cache_s {
+    size_t                   capacity;     // 0 if disabled
+    size_t                   count;
+    hvml_dom_xpath_t       **buckets;
+    size_t                   nbuckets;     // power of 2
+    hvml_dom_xpath_t        *lru_head;
+    hvml_dom_xpath_t        *lru_tail;
+};
 
-    hvml_doms_t out = {0};
+static xpath_cache_t           xpath_cache = {0};
+#ifdef _MSC_VER
+static SRWLOCK                 xpath_cache_lock = SRWLOCK_INIT;
+static void xpath_cache_acquire(void) { AcquireSRWLockExclusive(&xpath_cache_lock); }
+static void xpath_cache_release(void) { ReleaseSRWLockExclusive(&xpath_cache_lock); }
+#else
+static pthread_mutex_t         xpath_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static void xpath_cache_acquire(void) { pthread_mutex_lock(&xpath_cache_lock); }
+static void xpath_cache_release(void) { pthread_mutex_unlock(&xpath_cache_lock); }
+#endif
+
+static size_t xpath_hash(const char *path, size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<len; ++i) {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static hvml_dom_xpath_t* xpath_create(const char *path, size_t len, size_t hash) {
+    hvml_dom_xpath_t *xpath = (hvml_dom_xpath_t*)calloc(1, sizeof(*xpath));
+    if (!xpath) return NULL;
+
+    xpath->path = strdup(path);
+    if (!xpath->path) {
+        free(xpath);
+        return NULL;
+    }
+    xpath->len   = len;
+    xpath->hash  = hash;
+    xpath->steps = null_steps;
+    xpath->refc  = 1;
+
+    if (hvml_dom_xpath_parse(path, &xpath->steps)) {
+        hvml_dom_xpath_steps_cleanup(&xpath->steps);
+        free(xpath->path);
+        free(xpath);
+        return NULL;
+    }
+
+    return xpath;
+}
+
+static void xpath_free(hvml_dom_xpath_t *xpath) {
+    hvml_dom_xpath_steps_cleanup(&xpath->steps);
+    free(xpath->path);
+    free(xpath);
+}
+
+// all xpath_cache_* functions shall be called with the lock held
+static void xpath_cache_lru_unlink(hvml_dom_xpath_t *xpath) {
+    xpath_cache_t *cache = &xpath_cache;
+    if (xpath->lru_prev) xpath->lru_prev->lru_next = xpath->lru_next;
+    else                 cache->lru_head           = xpath->lru_next;
+    if (xpath->lru_next) xpath->lru_next->lru_prev = xpath->lru_prev;
+    else                 cache->lru_tail           = xpath->lru_prev;
+    xpath->lru_prev = NULL;
+    xpath->lru_next = NULL;
+}
 
-    hvml_dom_xpath_steps_t steps = null_steps;
+static void xpath_cache_lru_push(hvml_dom_xpath_t *xpath) {
+    xpath_cache_t *cache = &xpath_cache;
+    xpath->lru_prev = NULL;
+    xpath->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = xpath;
+    else                 cache->lru_tail           = xpath;
+    cache->lru_head = xpath;
+}
+
+static hvml_dom_xpath_t* xpath_cache_find(const char *path, size_t len, size_t hash) {
+    xpath_cache_t *cache = &xpath_cache;
+    if (!cache->buckets) return NULL;
+
+    hvml_dom_xpath_t *xpath = cache->buckets[hash & (cache->nbuckets - 1)];
+    while (xpath) {
+        if (xpath->hash==hash && xpath->len==len && memcmp(xpath->path, path, len)==0) break;
+        xpath = xpath->bucket_next;
+    }
+    return xpath;
+}
+
+static void xpath_cache_evict(hvml_dom_xpath_t *xpath) {
+    xpath_cache_t *cache = &xpath_cache;
+
+    hvml_dom_xpath_t **pp = &cache->buckets[xpath->hash & (cache->nbuckets - 1)];
+    while (*pp != xpath) pp = &(*pp)->bucket_next;
+    *pp = xpath->bucket_next;
+    xpath->bucket_next = NULL;
+
+    xpath_cache_lru_unlink(xpath);
+    cache->count -= 1;
 
-    r = hvml_dom_xpath_parse(path, &steps);
+    // still in use by someone else, the last one frees it
+    xpath->refc -= 1;
+    if (xpath->refc == 0) xpath_free(xpath);
+}
+
+static void xpath_cache_insert(hvml_dom_xpath_t *xpath) {
+    xpath_cache_t *cache = &xpath_cache;
+    A(cache->capacity, "internal logic error");
+
+    while (cache->count >= cache->capacity) {
+        xpath_cache_evict(cache->lru_tail);
+    }
 
+    hvml_dom_xpath_t **pp = &cache->buckets[xpath->hash & (cache->nbuckets - 1)];
+    xpath->bucket_next = *pp;
+    *pp = xpath;
+    xpath_cache_lru_push(xpath);
+    cache->count += 1;
+    xpath->refc  += 1;   // held by cache
+}
+
+int hvml_dom_xpath_cache_set_capacity(size_t capacity) {
+    int r = 0;
+    xpath_cache_acquire();
     do {
-        if (r) break;
-        r = do_hvml_dom_eval_location(dom, &steps, &out);
+        xpath_cache_t *cache = &xpath_cache;
+        while (cache->count > capacity) {
+            xpath_cache_evict(cache->lru_tail);
+        }
+        cache->capacity = capacity;
+        if (capacity == 0) {
+            free(cache->buckets);
+            cache->buckets  = NULL;
+            cache->nbuckets = 0;
+            break;
+        }
+
+        size_t nbuckets = 16;
+        while (nbuckets < capacity) nbuckets *= 2;
+        if (nbuckets == cache->nbuckets) break;
+
+        hvml_dom_xpath_t **buckets = (hvml_dom_xpath_t**)calloc(nbuckets, sizeof(*buckets));
+        if (!buckets) {
+            // keep the previous buckets if any, chains just grow longer
+            if (!cache->buckets) cache->capacity = 0;
+            r = -1; // out of memory
+            break;
+        }
+        // rehash
+        hvml_dom_xpath_t *xpath = cache->lru_head;
+        while (xpath) {
+            hvml_dom_xpath_t **pp = &buckets[xpath->hash & (nbuckets - 1)];
+            xpath->bucket_next = *pp;
+            *pp = xpath;
+            xpath = xpath->lru_next;
+        }
+        free(cache->buckets);
+        cache->buckets  = buckets;
+        cache->nbuckets = nbuckets;
     } while (0);
+    xpath_cache_release();
+
+    return r;
+}
+
+hvml_dom_xpath_t* hvml_dom_xpath_compile(const char *path) {
+    A(path, "internal logic error");
+
+    size_t len  = strlen(path);
+    size_t hash = xpath_hash(path, len);
+
+    hvml_dom_xpath_t *xpath = NULL;
+
+    xpath_cache_acquire();
+    if (xpath_cache.capacity) {
+        xpath = xpath_cache_find(path, len, hash);
+        if (xpath) {
+            xpath_cache_lru_unlink(xpath);
+            xpath_cache_lru_push(xpath);
+            xpath->refc += 1;
+        }
+    }
+    int enabled = xpath_cache.capacity ? 1 : 0;
+    xpath_cache_release();
+
+    if (xpath) return xpath;
+
+    // parse outside of the lock
+    xpath = xpath_create(path, len, hash);
+    if (!xpath) return NULL;
+    if (!enabled) return xpath;
+
+    xpath->cached = 1;
+
+    xpath_cache_acquire();
+    if (xpath_cache.capacity) {
+        hvml_dom_xpath_t *v = xpath_cache_find(path, len, hash);
+        if (v) {
+            // compiled by another thread in the mean time
+            xpath_cache_lru_unlink(v);
+            xpath_cache_lru_push(v);
+            v->refc += 1;
+            xpath_free(xpath);
+            xpath = v;
+        } else {
+            xpath_cache_insert(xpath);
+        }
+    }
+    xpath_cache_release();
+
+    return xpath;
+}
+
+void hvml_dom_xpath_destroy(hvml_dom_xpath_t *xpath) {
+    if (!xpath) return;
+
+    if (!xpath->cached) {
+        A(xpath->refc == 1, "internal logic error");
+        xpath_free(xpath);
+        return;
+    }
+
+    xpath_cache_acquire();
+    A(xpath->refc > 0, "internal logic error");
+    xpath->refc -= 1;
+    size_t refc = xpath->refc;
+    xpath_cache_release();
+
+    if (refc == 0) xpath_free(xpath);
+}
+
+int hvml_dom_xpath_exec(hvml_dom_xpath_t *xpath, hvml_dom_t *dom, hvml_doms_t *doms) {
+    A(xpath, "internal logic error");
+
+    int r = 0;
+
+    hvml_doms_t out = {0};
+
+    r = do_hvml_dom_eval_location(dom, &xpath->steps, &out);
 
     if (r==0) {
         if (doms) {
@@ -2536,38 +3716,63 @@ int hvml_dom_query(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
         }
     }
 
-    hvml_dom_xpath_steps_cleanup(&steps);
     hvml_doms_cleanup(&out);
 
     return r ? -1 : 0;
 }
 
+int hvml_dom_query(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
+    A(path,   "internal logic error");
+
+    hvml_dom_xpath_t *xpath = hvml_dom_xpath_compile(path);
+    if (!xpath) return -1;
+
+    int r = hvml_dom_xpath_exec(xpath, dom, doms);
+
+    hvml_dom_xpath_destroy(xpath);
+
+    return r;
+}
+
 
 
 static int on_open_tag(void *arg, const char *tag) {
     hvml_dom_gen_t *gen = (hvml_dom_gen_t*)arg;
     if (!gen->dom) {
-        gen->dom = hvml_dom_create();
-        if (!gen->dom) return -1;
+        hvml_dom_arena_t *arena = NULL;
+        if (gen->with_arena) {
+            arena = hvml_dom_arena_create();
+            if (!arena) return -1;
+        }
+        gen->dom = hvml_dom_create_in(arena);
+        if (!gen->dom) {
+            hvml_dom_arena_destroy(arena);
+            return -1;
+        }
         gen->dom->dt = MKDOT(D_ROOT);
+        if (arena) arena->owner = gen->dom;
     }
     A(gen->dom, "internal logic error");
-    hvml_dom_t *v       = hvml_dom_create();
+    hvml_dom_t *v       = hvml_dom_create_in(gen->dom->arena);
     if (!v) return -1;
     v->dt      = MKDOT(D_TAG);
-    if (hvml_string_set(&v->u.tag.name, tag, strlen(tag))) {
+    v->u.tag.name = hvml_atom_intern(tag, strlen(tag));
+    if (!v->u.tag.name) {
         hvml_dom_destroy(v);
         return -1;
     }
     switch (gen->dom->dt) {
         case MKDOT(D_ROOT): {
             A(DOM_HEAD(gen->dom)==NULL, "internal logic error");
+            DOM_ORDER_TOUCH(gen->dom);
             DOM_APPEND(gen->dom, v);
         } break;
         case MKDOT(D_TAG): {
+            DOM_ORDER_TOUCH(gen->dom);
             DOM_APPEND(gen->dom, v);
         } break;
         case MKDOT(D_ATTR): {
+            DOM_ORDER_TOUCH(DOM_ATTR_OWNER(gen->dom));
             DOM_APPEND(DOM_ATTR_OWNER(gen->dom), v);
         } break;
         default: {
@@ -2580,18 +3785,21 @@ static int on_open_tag(void *arg, const char *tag) {
 
 static int on_attr_key(void *arg, const char *key) {
     hvml_dom_gen_t *gen = (hvml_dom_gen_t*)arg;
-    hvml_dom_t *v       = hvml_dom_create();
+    A(gen->dom, "internal logic error");
+    hvml_dom_t *v       = hvml_dom_create_in(gen->dom->arena);
     if (!v) return -1;
     v->dt      = MKDOT(D_ATTR);
-    if (hvml_string_set(&v->u.attr.key, key, strlen(key))) {
+    v->u.attr.key = hvml_atom_intern(key, strlen(key));
+    if (!v->u.attr.key) {
         hvml_dom_destroy(v);
         return -1;
     }
-    A(gen->dom, "internal logic error");
     if (gen->dom->dt == MKDOT(D_ATTR)) {
+        DOM_ORDER_TOUCH(DOM_ATTR_OWNER(gen->dom));
         DOM_ATTR_APPEND(DOM_ATTR_OWNER(gen->dom), v);
     } else {
         A(gen->dom->dt == MKDOT(D_TAG), "internal logic error");
+        DOM_ORDER_TOUCH(gen->dom);
         DOM_ATTR_APPEND(gen->dom, v);
     }
     gen->dom = v;
@@ -2603,7 +3811,7 @@ static int on_attr_val(void *arg, const char *val) {
     hvml_dom_gen_t *gen = (hvml_dom_gen_t*)arg;
     A(gen->dom, "internal logic error");
     A(gen->dom->dt == MKDOT(D_ATTR), "internal logic error");
-    if (hvml_string_set(&gen->dom->u.attr.val, val, strlen(val))) {
+    if (hvml_dom_gen_string_set(gen, gen->dom, &gen->dom->u.attr.val, val)) {
         return -1;
     }
     gen->dom = DOM_ATTR_OWNER(gen->dom);
@@ -2628,17 +3836,19 @@ static int on_close_tag(void *arg) {
 static int on_text(void *arg, const char *txt) {
     hvml_dom_gen_t *gen = (hvml_dom_gen_t*)arg;
     A(gen->dom, "internal logic error");
-    hvml_dom_t *v       = hvml_dom_create();
+    hvml_dom_t *v       = hvml_dom_create_in(gen->dom->arena);
     if (!v) return -1;
     v->dt      = MKDOT(D_TEXT);
-    if (hvml_string_set(&v->u.txt.txt, txt, strlen(txt))) {
+    if (hvml_dom_gen_string_set(gen, v, &v->u.txt.txt, txt)) {
         hvml_dom_destroy(v);
         return -1;
     }
     if (gen->dom->dt == MKDOT(D_ATTR)) {
+        DOM_ORDER_TOUCH(DOM_ATTR_OWNER(gen->dom));
         DOM_APPEND(DOM_ATTR_OWNER(gen->dom), v);
     } else {
         A(gen->dom->dt == MKDOT(D_TAG), "internal logic error");
+        DOM_ORDER_TOUCH(gen->dom);
         DOM_APPEND(gen->dom, v);
     }
     gen->dom = DOM_OWNER(v);
@@ -2807,12 +4017,15 @@ static int on_string(void *arg, const char *val, size_t len) {
     return 0;
 }
 
-static int on_number(void *arg, const char *origin, long double val) {
-    hvml_jo_value_t *jo = hvml_jo_number(val, origin);
-    if (!jo) return -1;
-
+static int on_number(void *arg, const hvml_json_number_t *num) {
     hvml_dom_gen_t *gen = (hvml_dom_gen_t*)arg;
 
+    hvml_json_number_t n = *num;
+    if (!gen->keep_origin) n.origin = NULL;
+
+    hvml_jo_value_t *jo = hvml_jo_number_from_json(&n);
+    if (!jo) return -1;
+
     if (hvml_jo_value_push(gen->jo, jo)) {
         hvml_jo_value_free(jo);
         return -1;
@@ -2839,6 +4052,177 @@ static int on_end(void *arg) {
     return 0;
 }
 
+static hvml_dom_arena_t* hvml_dom_arena_create(void) {
+    hvml_dom_arena_t *arena = (hvml_dom_arena_t*)calloc(1, sizeof(*arena));
+    if (!arena) return NULL;
+
+    return arena;
+}
+
+static void hvml_dom_arena_destroy(hvml_dom_arena_t *arena) {
+    if (!arena) return;
+
+    hvml_dom_arena_chunk_t *chunk = arena->chunks;
+    while (chunk) {
+        hvml_dom_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    hvml_file_unmap(&arena->map);
+
+    free(arena);
+}
+
+static void* hvml_dom_arena_alloc(hvml_dom_arena_t *arena, size_t size, size_t align) {
+    hvml_dom_arena_chunk_t *chunk = arena->chunks;
+    if (chunk) {
+        size_t used = (chunk->used + align - 1) & ~(align - 1);
+        if (used + size <= chunk->size) {
+            chunk->used = used + size;
+            return (char*)(chunk + 1) + used;
+        }
+    }
+
+    // chunk size doubles until DOM_ARENA_CHUNK_MAX, thus big documents
+    // end up with a few big chunks rather than many small ones
+    size_t bytes = chunk ? chunk->size * 2 : DOM_ARENA_CHUNK_MIN;
+    if (bytes > DOM_ARENA_CHUNK_MAX) bytes = DOM_ARENA_CHUNK_MAX;
+    if (bytes < size)                bytes = size;
+
+    chunk = (hvml_dom_arena_chunk_t*)malloc(sizeof(*chunk) + bytes);
+    if (!chunk) return NULL;
+
+    chunk->next   = arena->chunks;
+    chunk->size   = bytes;
+    chunk->used   = size;
+    arena->chunks = chunk;
+
+    return chunk + 1;
+}
+
+static hvml_dom_t* hvml_dom_create_in(hvml_dom_arena_t *arena) {
+    if (!arena) return hvml_dom_create();
+
+    hvml_dom_t *dom = (hvml_dom_t*)hvml_dom_arena_alloc(arena, sizeof(*dom), sizeof(void*));
+    if (!dom) return NULL;
+
+    memset(dom, 0, sizeof(*dom));
+    dom->arena = arena;
+
+    return dom;
+}
+
+static int hvml_dom_string_set(hvml_dom_t *dom, hvml_dom_str_t *str, const char *buf, size_t len) {
+    if (!dom->arena) {
+        // buf might be the current one, thus released afterward
+        hvml_rstr_t *rs = hvml_rstr_create(buf, len);
+        if (!rs) return -1;
+        hvml_rstr_unref(str->rs);
+        str->str = hvml_rstr_str(rs);
+        str->len = len;
+        str->rs  = rs;
+        return 0;
+    }
+
+    // the previous one, if any, is left in the arena until the whole is released
+    char *s = (char*)hvml_dom_arena_alloc(dom->arena, len + 1, 1); // one extra null terminator
+    if (!s) return -1;
+
+    memcpy(s, buf, len);
+    s[len]   = '\0';
+    str->str = s;
+    str->len = len;
+
+    return 0;
+}
+
+// heap nodes share the bytes, if from holds them in rs
+// otherwise they are copied
+static int hvml_dom_string_share(hvml_dom_t *dom, hvml_dom_str_t *str, const hvml_dom_str_t *from) {
+    if (!from->str) {
+        hvml_dom_string_clear(dom, str);
+        return 0;
+    }
+    if (dom->arena || !from->rs) {
+        return hvml_dom_string_set(dom, str, from->str, from->len);
+    }
+
+    hvml_rstr_t *rs = hvml_rstr_ref(from->rs);
+    hvml_rstr_unref(str->rs);
+    str->str = from->str;
+    str->len = from->len;
+    str->rs  = rs;
+
+    return 0;
+}
+
+static void hvml_dom_string_clear(hvml_dom_t *dom, hvml_dom_str_t *str) {
+    A(!dom->arena || !str->rs, "internal logic error");
+    hvml_rstr_unref(str->rs);
+
+    str->str = NULL;
+    str->len = 0;
+    str->rs  = NULL;
+}
+
+// dom takes a ref on the jo of from, which is copied by whoever writes first
+static int hvml_dom_json_share(hvml_dom_t *dom, hvml_dom_t *from) {
+    A(dom->dt==MKDOT(D_JSON) && from->dt==MKDOT(D_JSON), "internal logic error");
+    A(!dom->u.json.jo, "internal logic error");
+
+    // from might be cloned by other threads at the same time
+    // acquire pairs with the cas below, for ref->jo set by whoever wins
+    hvml_dom_jo_ref_t *ref = (hvml_dom_jo_ref_t*)hvml_atomic_get_ptr((void* volatile*)&from->u.json.ref);
+    if (!ref) {
+        ref = (hvml_dom_jo_ref_t*)malloc(sizeof(*ref));
+        if (!ref) return -1;
+        ref->refs = 1;
+        ref->jo   = from->u.json.jo;
+        hvml_dom_jo_ref_t *was = (hvml_dom_jo_ref_t*)hvml_atomic_cas_ptr((void* volatile*)&from->u.json.ref, NULL, ref);
+        if (was) {
+            free(ref);
+            ref = was;
+        }
+    }
+    hvml_atomic_inc(&ref->refs);
+
+    dom->u.json.jo  = ref->jo;
+    dom->u.json.ref = ref;
+
+    return 0;
+}
+
+static void hvml_dom_json_clear(hvml_dom_t *dom) {
+    hvml_dom_jo_ref_t *ref = dom->u.json.ref;
+    if (!ref) {
+        if (dom->u.json.jo) hvml_jo_value_free(dom->u.json.jo);
+    } else if (hvml_atomic_dec(&ref->refs)==0) {
+        hvml_jo_value_free(ref->jo);
+        free(ref);
+    }
+    dom->u.json.jo  = NULL;
+    dom->u.json.ref = NULL;
+}
+
+// only arena strings may be borrowed, since they are never freed one by one
+static int hvml_dom_gen_string_set(hvml_dom_gen_t *gen, hvml_dom_t *dom, hvml_dom_str_t *str, const char *s) {
+    const char *span = NULL;
+    size_t      len  = 0;
+    if (gen->map && dom->arena && hvml_parser_token_span(gen->parser, &span, &len)) {
+        char *p = (char*)span;
+        if (p >= gen->map->buf && p + len < gen->map->buf + gen->map->len) {
+            // the byte after is the delimiter that the parser has just consumed
+            // and the mapping is private, thus it's safe to terminate the token in place
+            p[len]   = '\0';
+            str->str = p;
+            str->len = len;
+            return 0;
+        }
+    }
+    return hvml_dom_string_set(dom, str, s, strlen(s));
+}
+
 static int do_hvml_dom_traverse(hvml_dom_t *dom, traverse_t *tvs) {
     A(dom, "internal logic error");
     A(tvs, "internal logic error");
@@ -0,0 +1,422 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_dom_pack.h"
+
+#include "hvml/hvml_jo.h"
+#include "hvml/hvml_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DOM_PACK_NO_STR          UINT32_MAX
+
+typedef struct dom_pack_node_s           dom_pack_node_t;
+typedef struct dom_pack_attr_s           dom_pack_attr_t;
+
+// 28 bytes, vs. some 170 bytes of a hvml_dom_t plus its strings
+struct dom_pack_node_s {
+    uint32_t            parent;
+    uint32_t            next;
+    uint32_t            prev;
+    uint32_t            child;
+    uint32_t            attr;     // the first attr in attrs
+    uint32_t            str;      // D_TAG: atom of name; D_TEXT: text; D_JSON: index in jos
+    uint32_t            nattr:28;
+    uint32_t            dt:4;
+};
+
+struct dom_pack_attr_s {
+    uint32_t            owner;
+    uint32_t            key;      // atom
+    uint32_t            val;      // DOM_PACK_NO_STR if the attr has no value
+};
+
+struct hvml_dom_pack_s {
+    dom_pack_node_t    *nodes;    // nodes[0] is not used
+    size_t              nnodes;   // including nodes[0]
+    dom_pack_attr_t    *attrs;
+    size_t              nattrs;
+    char               *pool;     // null-terminated strings, referred by offset
+    size_t              pool_len;
+    hvml_jo_value_t   **jos;
+    size_t              njos;
+};
+
+// bookkeeping only needed while packing
+typedef struct dom_pack_builder_s        dom_pack_builder_t;
+struct dom_pack_builder_s {
+    hvml_dom_pack_t    *pack;
+    uint32_t           *tails;    // last child of each node
+    size_t              pool_cap;
+};
+
+static int dom_pack_string(dom_pack_builder_t *b, const char *s, uint32_t *off) {
+    hvml_dom_pack_t *pack = b->pack;
+    size_t           len  = strlen(s);
+    if (pack->pool_len + len + 1 > b->pool_cap) {
+        A(0, "internal logic error");
+        return -1;
+    }
+    memcpy(pack->pool + pack->pool_len, s, len + 1);
+    *off            = (uint32_t)pack->pool_len;
+    pack->pool_len += len + 1;
+    return 0;
+}
+
+static uint32_t dom_pack_add(dom_pack_builder_t *b, hvml_dom_t *dom, HVML_DOM_TYPE dt, uint32_t pid) {
+    hvml_dom_pack_t *pack = b->pack;
+    uint32_t         id   = (uint32_t)pack->nnodes++;
+    dom_pack_node_t *v    = pack->nodes + id;
+    v->dt     = dt;
+    v->parent = pid;
+    if (pid) {
+        uint32_t tail = b->tails[pid];
+        if (tail) {
+            pack->nodes[tail].next = id;
+            v->prev                = tail;
+        } else {
+            pack->nodes[pid].child = id;
+        }
+        b->tails[pid] = id;
+    }
+
+    switch (dt) {
+        case MKDOT(D_ROOT): break;
+        case MKDOT(D_TAG):
+        {
+            v->str  = hvml_dom_tag_atom(dom);
+            v->attr = (uint32_t)pack->nattrs;
+            for (hvml_dom_t *d = hvml_dom_attr_head(dom); d; d = hvml_dom_attr_next(d)) {
+                dom_pack_attr_t *attr = pack->attrs + pack->nattrs++;
+                const char      *val  = hvml_dom_attr_val(d);
+                attr->owner = id;
+                attr->key   = hvml_dom_attr_atom(d);
+                attr->val   = DOM_PACK_NO_STR;
+                if (val && dom_pack_string(b, val, &attr->val)) return 0;
+                v->nattr += 1;
+            }
+        } break;
+        case MKDOT(D_TEXT):
+        {
+            if (dom_pack_string(b, hvml_dom_text(dom), &v->str)) return 0;
+        } break;
+        case MKDOT(D_JSON):
+        {
+            hvml_jo_value_t *jo = hvml_jo_clone(hvml_dom_jo_shared(dom));
+            if (!jo) return 0;
+            v->str = (uint32_t)pack->njos;
+            pack->jos[pack->njos++] = jo;
+        } break;
+        default:
+        {
+            A(0, "internal logic error");
+        } break;
+    }
+
+    return id;
+}
+
+static int dom_pack_count(hvml_dom_t *top, size_t *nodes, size_t *attrs, size_t *jos, size_t *bytes) {
+    hvml_dom_t *d = top;
+    while (d) {
+        *nodes += 1;
+        switch (hvml_dom_type(d)) {
+            case MKDOT(D_TAG):
+            {
+                for (hvml_dom_t *a = hvml_dom_attr_head(d); a; a = hvml_dom_attr_next(a)) {
+                    const char *val = hvml_dom_attr_val(a);
+                    *attrs += 1;
+                    if (val) *bytes += strlen(val) + 1;
+                }
+            } break;
+            case MKDOT(D_TEXT):
+            {
+                *bytes += strlen(hvml_dom_text(d)) + 1;
+            } break;
+            case MKDOT(D_JSON):
+            {
+                *jos += 1;
+            } break;
+            default: break;
+        }
+        hvml_dom_t *child = hvml_dom_child(d);
+        if (child) {
+            d = child;
+            continue;
+        }
+        // pre-order, without recursion
+        while (d != top && !hvml_dom_next(d)) d = hvml_dom_parent(d);
+        d = (d == top) ? NULL : hvml_dom_next(d);
+    }
+
+    // indices shall fit into 32 bits, with the top one reserved
+    if (*nodes >= HVML_DOM_PACK_ATTR || *attrs >= HVML_DOM_PACK_ATTR || *bytes >= DOM_PACK_NO_STR) {
+        E("document too large to be packed");
+        return -1;
+    }
+    return 0;
+}
+
+hvml_dom_pack_t* hvml_dom_pack(hvml_dom_t *dom) {
+    HVML_DOM_TYPE dt = hvml_dom_type(dom);
+    if (dt!=MKDOT(D_ROOT) && dt!=MKDOT(D_TAG)) {
+        E("only D_ROOT or D_TAG can be packed");
+        return NULL;
+    }
+
+    size_t nodes = 1;                             // nodes[0]
+    size_t attrs = 0;
+    size_t jos   = 0;
+    size_t bytes = 0;
+    if (dt==MKDOT(D_TAG)) nodes += 1;            // D_ROOT on top
+    if (dom_pack_count(dom, &nodes, &attrs, &jos, &bytes)) return NULL;
+
+    hvml_dom_pack_t *pack = (hvml_dom_pack_t*)calloc(1, sizeof(*pack));
+    if (!pack) return NULL;
+
+    dom_pack_builder_t b = {0};
+    b.pack     = pack;
+    b.pool_cap = bytes;
+
+    int ok = 0;
+    do {
+        pack->nodes = (dom_pack_node_t*)calloc(nodes, sizeof(*pack->nodes));
+        pack->attrs = (dom_pack_attr_t*)calloc(attrs ? attrs : 1, sizeof(*pack->attrs));
+        pack->pool  = (char*)malloc(bytes ? bytes : 1);
+        pack->jos   = (hvml_jo_value_t**)calloc(jos ? jos : 1, sizeof(*pack->jos));
+        b.tails     = (uint32_t*)calloc(nodes, sizeof(*b.tails));
+        if (!pack->nodes || !pack->attrs || !pack->pool || !pack->jos) break;
+        if (!b.tails) break;
+
+        pack->nnodes = 1;
+        uint32_t pid = 0;
+        if (dt==MKDOT(D_TAG)) pid = dom_pack_add(&b, NULL, MKDOT(D_ROOT), 0);
+
+        hvml_dom_t *d = dom;
+        while (d) {
+            uint32_t id = dom_pack_add(&b, d, hvml_dom_type(d), pid);
+            if (!id) break;
+            hvml_dom_t *child = hvml_dom_child(d);
+            if (child) {
+                pid = id;
+                d   = child;
+                continue;
+            }
+            // climbing up, the parent of the next sibling to visit is tracked as well
+            while (d != dom && !hvml_dom_next(d)) {
+                d   = hvml_dom_parent(d);
+                pid = pack->nodes[pid].parent;
+            }
+            d = (d == dom) ? NULL : hvml_dom_next(d);
+            if (!d) ok = 1;
+        }
+        if (!ok) break;
+        A(pack->nnodes==nodes && pack->nattrs==attrs && pack->njos==jos, "internal logic error");
+        A(pack->pool_len==bytes, "internal logic error");
+    } while (0);
+
+    free(b.tails);
+
+    if (!ok) {
+        hvml_dom_pack_destroy(pack);
+        return NULL;
+    }
+
+    return pack;
+}
+
+hvml_dom_pack_t* hvml_dom_pack_load_from_file(const char *path) {
+    hvml_dom_t *dom = hvml_dom_load_from_file(path);
+    if (!dom) return NULL;
+
+    hvml_dom_pack_t *pack = hvml_dom_pack(dom);
+    hvml_dom_destroy(dom);
+
+    return pack;
+}
+
+hvml_dom_t* hvml_dom_unpack(hvml_dom_pack_t *pack) {
+    A(pack && pack->nnodes > 1, "internal logic error");
+
+    // ids are in document order, thus parents are always created first
+    hvml_dom_t **doms = (hvml_dom_t**)calloc(pack->nnodes, sizeof(*doms));
+    if (!doms) return NULL;
+
+    hvml_dom_t *root = hvml_dom_create();
+    int         ok   = root ? 1 : 0;
+    doms[1] = root;
+
+    for (hvml_dom_pack_id_t id=2; id<pack->nnodes && ok; ++id) {
+        hvml_dom_t *parent = doms[hvml_dom_pack_parent(pack, id)];
+        hvml_dom_t *v      = NULL;
+        switch (hvml_dom_pack_type(pack, id)) {
+            case MKDOT(D_TAG):
+            {
+                const char *name = hvml_dom_pack_tag_name(pack, id);
+                v = hvml_dom_add_tag(parent, name, strlen(name));
+                hvml_dom_pack_id_t attr = hvml_dom_pack_attr_head(pack, id);
+                for (; v && attr; attr = hvml_dom_pack_attr_next(pack, attr)) {
+                    const char *key = hvml_dom_pack_attr_key(pack, attr);
+                    const char *val = hvml_dom_pack_attr_val(pack, attr);
+                    if (!hvml_dom_append_attr(v, key, strlen(key), val, val ? strlen(val) : 0)) v = NULL;
+                }
+            } break;
+            case MKDOT(D_TEXT):
+            {
+                const char *txt = hvml_dom_pack_text(pack, id);
+                v = hvml_dom_append_content(parent, txt, strlen(txt));
+            } break;
+            case MKDOT(D_JSON):
+            {
+                hvml_jo_value_t *jo = hvml_jo_clone(hvml_dom_pack_jo(pack, id));
+                if (!jo) break;
+                v = hvml_dom_append_json(parent, jo);
+                if (!v) hvml_jo_value_free(jo);
+            } break;
+            default:
+            {
+                A(0, "internal logic error");
+            } break;
+        }
+        doms[id] = v;
+        ok = v ? 1 : 0;
+    }
+
+    free(doms);
+
+    if (!ok) {
+        if (root) hvml_dom_destroy(root);
+        return NULL;
+    }
+
+    return root;
+}
+
+void hvml_dom_pack_destroy(hvml_dom_pack_t *pack) {
+    if (!pack) return;
+
+    for (size_t i=0; i<pack->njos; ++i) {
+        hvml_jo_value_free(pack->jos[i]);
+    }
+
+    free(pack->nodes);
+    free(pack->attrs);
+    free(pack->pool);
+    free(pack->jos);
+    free(pack);
+}
+
+size_t hvml_dom_pack_footprint(hvml_dom_pack_t *pack) {
+    return sizeof(*pack)
+         + pack->nnodes * sizeof(*pack->nodes)
+         + pack->nattrs * sizeof(*pack->attrs)
+         + pack->pool_len
+         + pack->njos * sizeof(*pack->jos);
+}
+
+size_t hvml_dom_pack_nodes(hvml_dom_pack_t *pack) {
+    return pack->nnodes - 1;
+}
+
+static dom_pack_node_t* dom_pack_node(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    A(id && id<pack->nnodes, "internal logic error");
+    return pack->nodes + id;
+}
+
+static dom_pack_attr_t* dom_pack_attr(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr) {
+    A(attr & HVML_DOM_PACK_ATTR, "internal logic error");
+    attr &= ~HVML_DOM_PACK_ATTR;
+    A(attr<pack->nattrs, "internal logic error");
+    return pack->attrs + attr;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_root(hvml_dom_pack_t *pack) {
+    return pack->nnodes > 1 ? 1 : HVML_DOM_PACK_NONE;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_parent(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) return dom_pack_attr(pack, id)->owner;
+    return dom_pack_node(pack, id)->parent;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_next(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) return HVML_DOM_PACK_NONE;
+    return dom_pack_node(pack, id)->next;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_prev(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) return HVML_DOM_PACK_NONE;
+    return dom_pack_node(pack, id)->prev;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_child(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) return HVML_DOM_PACK_NONE;
+    return dom_pack_node(pack, id)->child;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_attr_head(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) return HVML_DOM_PACK_NONE;
+    dom_pack_node_t *v = dom_pack_node(pack, id);
+    if (!v->nattr) return HVML_DOM_PACK_NONE;
+    return v->attr | HVML_DOM_PACK_ATTR;
+}
+
+hvml_dom_pack_id_t hvml_dom_pack_attr_next(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr) {
+    dom_pack_attr_t *a = dom_pack_attr(pack, attr);
+    dom_pack_node_t *v = dom_pack_node(pack, a->owner);
+    // attrs of a tag are contiguous
+    hvml_dom_pack_id_t next = (attr & ~HVML_DOM_PACK_ATTR) + 1;
+    if (next >= v->attr + v->nattr) return HVML_DOM_PACK_NONE;
+    return next | HVML_DOM_PACK_ATTR;
+}
+
+HVML_DOM_TYPE hvml_dom_pack_type(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    if (id & HVML_DOM_PACK_ATTR) {
+        dom_pack_attr(pack, id);
+        return MKDOT(D_ATTR);
+    }
+    return (HVML_DOM_TYPE)dom_pack_node(pack, id)->dt;
+}
+
+const char* hvml_dom_pack_tag_name(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    dom_pack_node_t *v = dom_pack_node(pack, id);
+    A(v->dt == MKDOT(D_TAG), "internal logic error");
+    return hvml_atom_str(v->str);
+}
+
+const char* hvml_dom_pack_attr_key(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr) {
+    return hvml_atom_str(dom_pack_attr(pack, attr)->key);
+}
+
+const char* hvml_dom_pack_attr_val(hvml_dom_pack_t *pack, hvml_dom_pack_id_t attr) {
+    dom_pack_attr_t *a = dom_pack_attr(pack, attr);
+    if (a->val==DOM_PACK_NO_STR) return NULL;
+    return pack->pool + a->val;
+}
+
+const char* hvml_dom_pack_text(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    dom_pack_node_t *v = dom_pack_node(pack, id);
+    A(v->dt == MKDOT(D_TEXT), "internal logic error");
+    return pack->pool + v->str;
+}
+
+hvml_jo_value_t* hvml_dom_pack_jo(hvml_dom_pack_t *pack, hvml_dom_pack_id_t id) {
+    dom_pack_node_t *v = dom_pack_node(pack, id);
+    A(v->dt == MKDOT(D_JSON), "internal logic error");
+    return pack->jos[v->str];
+}
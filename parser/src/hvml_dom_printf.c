@@ -51,6 +51,20 @@ int hvml_dom_printf(hvml_dom_t *dom, FILE *out) {
     if (!stream) return -1;
 
     int r = hvml_dom_serialize(dom, stream);
+    // the last chunk is written here
+    if (hvml_stream_flush(stream)) r = -1;
+
+    hvml_stream_destroy(stream);
+
+    return r;
+}
+
+int hvml_dom_serialize_string(hvml_dom_t *dom, hvml_string_t *str) {
+    hvml_stream_t *stream = hvml_stream_bind_string(str);
+    if (!stream) return -1;
+
+    int r = hvml_dom_serialize(dom, stream);
+    if (hvml_stream_flush(stream)) r = -1;
 
     hvml_stream_destroy(stream);
 
@@ -76,16 +90,22 @@ static void traverse_for_printf(hvml_dom_t *dom, int lvl, int tag_open_close, vo
         {
             switch (tag_open_close) {
                 case 1: {
-                    r = hvml_stream_printf(parg->stream, "<%s", hvml_dom_tag_name(dom));
+                    r = hvml_stream_putc(parg->stream, '<');
+                    if (r<0) break;
+                    r = hvml_stream_puts(parg->stream, hvml_dom_tag_name(dom));
                 } break;
                 case 2: {
-                    r = hvml_stream_printf(parg->stream, "/>");
+                    r = hvml_stream_puts(parg->stream, "/>");
                 } break;
                 case 3: {
-                    r = hvml_stream_printf(parg->stream, ">");
+                    r = hvml_stream_putc(parg->stream, '>');
                 } break;
                 case 4: {
-                    r = hvml_stream_printf(parg->stream, "</%s>", hvml_dom_tag_name(dom));
+                    r = hvml_stream_puts(parg->stream, "</");
+                    if (r<0) break;
+                    r = hvml_stream_puts(parg->stream, hvml_dom_tag_name(dom));
+                    if (r<0) break;
+                    r = hvml_stream_putc(parg->stream, '>');
                 } break;
                 default: {
                     A(0, "internal logic error");
@@ -97,16 +117,16 @@ static void traverse_for_printf(hvml_dom_t *dom, int lvl, int tag_open_close, vo
             A(parg->lvl >= parg->rooted ? 1 : 0, "internal logic error");
             const char *key = hvml_dom_attr_key(dom);
             const char *val = hvml_dom_attr_val(dom);
-            r = hvml_stream_printf(parg->stream, " ");
+            r = hvml_stream_putc(parg->stream, ' ');
             if (r<0) break;
-            r = hvml_stream_printf(parg->stream, "%s", key);
+            r = hvml_stream_puts(parg->stream, key);
             if (r<0) break;
             if (val) {
-                r = hvml_stream_printf(parg->stream, "=\"");
+                r = hvml_stream_puts(parg->stream, "=\"");
                 if (r<0) break;
                 r = hvml_dom_attr_val_serialize(val, strlen(val), parg->stream);
                 if (r<0) break;
-                r = hvml_stream_printf(parg->stream, "\"");
+                r = hvml_stream_putc(parg->stream, '"');
             }
         } break;
         case MKDOT(D_TEXT):
@@ -116,7 +136,7 @@ static void traverse_for_printf(hvml_dom_t *dom, int lvl, int tag_open_close, vo
         } break;
         case MKDOT(D_JSON):
         {
-            r = hvml_jo_value_serialize(hvml_dom_jo(dom), parg->stream);
+            r = hvml_jo_value_serialize(hvml_dom_jo_shared(dom), parg->stream);
         } break;
         default: {
             A(0, "internal logic error");
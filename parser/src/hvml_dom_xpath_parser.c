@@ -19,6 +19,9 @@
 
 #include "hvml/hvml_log.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 const char *hvml_dom_xpath_dot  = ".";
 const char *hvml_dom_xpath_dot2 = "..";
 const hvml_dom_xpath_step_t            null_step                 = {0};
@@ -44,6 +47,31 @@ void hvml_dom_xpath_qname_cleanup(hvml_dom_xpath_qname_t *qname) {
         free(qname->local_part);
         qname->local_part = NULL;
     }
+    qname->atom = HVML_ATOM_NONE;
+}
+
+int hvml_dom_xpath_qname_intern(hvml_dom_xpath_qname_t *qname) {
+    A(qname && qname->local_part, "internal logic error");
+    if (strcmp(qname->local_part, "*")==0) return 0;
+    if (qname->prefix && strcmp(qname->prefix, "*")==0) return 0;
+
+    if (!qname->prefix) {
+        qname->atom = hvml_atom_intern(qname->local_part, strlen(qname->local_part));
+        return qname->atom ? 0 : -1;
+    }
+
+    // prefix:local_part
+    size_t prefix_len = strlen(qname->prefix);
+    size_t local_len  = strlen(qname->local_part);
+    char  *name       = (char*)malloc(prefix_len + 1 + local_len);
+    if (!name) return -1;
+    memcpy(name, qname->prefix, prefix_len);
+    name[prefix_len] = ':';
+    memcpy(name + prefix_len + 1, qname->local_part, local_len);
+    qname->atom = hvml_atom_intern(name, prefix_len + 1 + local_len);
+    free(name);
+
+    return qname->atom ? 0 : -1;
 }
 
 void hvml_dom_xpath_node_test_cleanup(hvml_dom_xpath_node_test_t *node_test) {
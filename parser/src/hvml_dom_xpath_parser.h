@@ -139,6 +139,7 @@ typedef struct hvml_dom_xpath_exprs_s          hvml_dom_xpath_exprs_t;
 struct hvml_dom_xpath_qname_s {
     char           *prefix;
     char           *local_part;
+    hvml_atom_t     atom;         // of the name as a whole, if used in a name test
 };
 
 struct hvml_dom_xpath_node_test_s {
@@ -252,6 +253,8 @@ void hvml_dom_xpath_union_expr_destroy(hvml_dom_xpath_union_expr_t *union_expr);
 void hvml_dom_xpath_exprs_destroy(hvml_dom_xpath_exprs_t *exprs);
 
 int hvml_dom_xpath_exprs_append_expr(hvml_dom_xpath_exprs_t *exprs, hvml_dom_xpath_expr_t *expr);
+// interns the name of a name test, unless it's a wildcard one
+int hvml_dom_xpath_qname_intern(hvml_dom_xpath_qname_t *qname);
 
 
 
@@ -375,7 +375,11 @@ node_test:
                       } }
 | qname             { $$ = null_node_test;
                       $$.is_name_test = 1;
-                      $$.u.name_test = $1; }
+                      $$.u.name_test = $1;
+                      if (hvml_dom_xpath_qname_intern(&($$.u.name_test))) {
+                        hvml_dom_xpath_qname_cleanup(&($$.u.name_test));
+                        YYABORT;
+                      } }
 | ncname ':' '*'    { $$ = null_node_test;
                       $$.is_name_test = 1;
                       $$.u.name_test.prefix = $1;
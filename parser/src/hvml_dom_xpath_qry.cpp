@@ -23,23 +23,138 @@
 #include "xpathParser.h"
 #include "xpathDomVisitor.h"
 
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 using namespace antlr4;
 
-int hvml_dom_qry(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
-    ANTLRInputStream input(path);
-    xpathLexer lexer(&input);
-    CommonTokenStream tokens(&lexer);
+namespace {
+
+// everything needed to keep the parse tree alive
+// contexts are owned by the parser, tokens by the token stream
+// the DFA and prediction context caches are static members of
+// xpathLexer/xpathParser, which are shared among all instances, and
+// guarded by the antlr4 runtime, thus every compilation warms them up
+// for all threads
+// once built, the tree is only read by xpathDomVisitor, thus one
+// compiled query can be executed by many threads at the same time
+struct xpathCompiled {
+    explicit xpathCompiled(const std::string &path)
+        : input(path), lexer(&input), tokens(&lexer), parser(&tokens), root(nullptr) {
+        tokens.fill();
+        root = parser.main();
+    }
+
+    ANTLRInputStream       input;
+    xpathLexer             lexer;
+    CommonTokenStream      tokens;
+    xpathParser            parser;
+    tree::ParseTree       *root;
+};
+
+typedef std::shared_ptr<xpathCompiled> xpathCompiledPtr;
 
-    tokens.fill();
+class xpathCache {
+public:
+    xpathCompiledPtr get(const std::string &path) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (capacity_==0) return nullptr;
+        auto it = index_.find(path);
+        if (it==index_.end()) return nullptr;
+        // most recently used comes first
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+    }
+
+    // returns the one already cached if compiled by another thread in the mean time
+    xpathCompiledPtr put(const std::string &path, xpathCompiledPtr compiled) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (capacity_==0) return compiled;
+        auto it = index_.find(path);
+        if (it!=index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+        lru_.emplace_front(path, compiled);
+        index_[path] = lru_.begin();
+        shrink(capacity_);
+        return compiled;
+    }
 
-    xpathParser parser(&tokens);
-    tree::ParseTree* tree = parser.main();
+    void set_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> guard(lock_);
+        // handles still in use keep their own reference
+        shrink(capacity);
+        capacity_ = capacity;
+    }
+
+    bool enabled() {
+        std::lock_guard<std::mutex> guard(lock_);
+        return capacity_ > 0;
+    }
+
+private:
+    void shrink(size_t capacity) {
+        while (lru_.size() > capacity) {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<std::pair<std::string, xpathCompiledPtr>>     lru_t;
+
+    std::mutex                                             lock_;
+    size_t                                                 capacity_ = 0;  // 0 if disabled
+    lru_t                                                  lru_;
+    std::unordered_map<std::string, lru_t::iterator>       index_;
+};
+
+xpathCache& qry_cache() {
+    // never destroyed, thus safe to be used during process exit
+    static xpathCache *cache = new xpathCache;
+    return *cache;
+}
+
+} // namespace
+
+struct hvml_dom_qry_s {
+    xpathCompiledPtr       compiled;
+};
+
+hvml_dom_qry_t* hvml_dom_qry_compile(const char *path) {
+    A(path, "internal logic error");
+
+    try {
+        std::string s(path);
+        xpathCache &cache = qry_cache();
+
+        xpathCompiledPtr compiled = cache.get(s);
+        if (!compiled) {
+            // parse outside of the lock
+            compiled = std::make_shared<xpathCompiled>(s);
+            if (cache.enabled()) {
+                compiled = cache.put(s, compiled);
+            }
+        }
+
+        return new hvml_dom_qry_t{compiled};
+    } catch (std::exception &e) {
+        D("exception: [%s]", e.what());
+        return NULL;
+    }
+}
+
+int hvml_dom_qry_exec(hvml_dom_qry_t *qry, hvml_dom_t *dom, hvml_doms_t *doms) {
+    A(qry, "internal logic error");
 
     int r = 0;
     try {
         do {
             xpathDomVisitor visitor(dom, 0, 1);
-            xpathNodeset ns = visitor.visit(tree);
+            xpathNodeset ns = visitor.visit(qry->compiled->root);
             if (doms) {
                 r = hvml_doms_append_doms(doms, ns.get());
             }
@@ -53,3 +168,28 @@ int hvml_dom_qry(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
     return r ? -1 : 0;
 }
 
+void hvml_dom_qry_destroy(hvml_dom_qry_t *qry) {
+    delete qry;
+}
+
+int hvml_dom_qry_cache_set_capacity(size_t capacity) {
+    try {
+        qry_cache().set_capacity(capacity);
+    } catch (std::exception &e) {
+        D("exception: [%s]", e.what());
+        return -1;
+    }
+    return 0;
+}
+
+int hvml_dom_qry(hvml_dom_t *dom, const char *path, hvml_doms_t *doms) {
+    hvml_dom_qry_t *qry = hvml_dom_qry_compile(path);
+    if (!qry) return -1;
+
+    int r = hvml_dom_qry_exec(qry, dom, doms);
+
+    hvml_dom_qry_destroy(qry);
+
+    return r;
+}
+
@@ -0,0 +1,237 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_escape.h"
+
+#include "hvml/hvml_log.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define HVML_ESCAPE_SSE2    1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// avx2 is chosen at runtime, thus not required at compile time
+#if defined(HVML_ESCAPE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HVML_ESCAPE_AVX2    1
+#include <immintrin.h>
+#endif
+
+#define TEXT     (1<<HVML_ESCAPE_DOM_TEXT)
+#define ATTR     (1<<HVML_ESCAPE_DOM_ATTR)
+#define JSON     (1<<HVML_ESCAPE_JSON)
+
+// one bit per set
+static const unsigned char escape_table[256] = {
+    ['&']  = TEXT | ATTR,
+    ['<']  = TEXT | ATTR,
+    ['"']  = ATTR | JSON,
+    ['\\'] = JSON,
+    ['\b'] = JSON,
+    ['\t'] = JSON,
+    ['\f'] = JSON,
+    ['\r'] = JSON,
+    ['\n'] = JSON,
+    ['\0'] = JSON,
+};
+
+static HVML_ESCAPE_ISA escape_isa = HVML_ESCAPE_ISA_AUTO;
+
+static size_t scan_scalar(HVML_ESCAPE_SET set, const char *s, size_t len) {
+    const unsigned char *p   = (const unsigned char*)s;
+    const unsigned char  bit = (unsigned char)(1<<set);
+    size_t i = 0;
+    for (; i<len; ++i) {
+        if (escape_table[p[i]] & bit) break;
+    }
+    return i;
+}
+
+#ifdef HVML_ESCAPE_SSE2
+// bytes compared one by one, plus all bytes below a bound (0 for none)
+// candidates below the bound are checked against escape_table
+static const char escape_text[] = { '&', '<' };
+static const char escape_attr[] = { '&', '<', '"' };
+static const char escape_json[] = { '"', '\\' };
+#define JSON_BELOW   ('\r' + 1)
+
+static int ctz32(unsigned int v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// first escape in candidate mask, or -1 if they're all false positives
+static int mask_first(unsigned int mask, const char *s, unsigned char bit) {
+    while (mask) {
+        int k = ctz32(mask);
+        if (escape_table[(unsigned char)s[k]] & bit) return k;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+// n and below are constants at every call site, thus the loops get unrolled
+// returns where the scalar tail shall start if nothing found
+static inline size_t sse2_scan(HVML_ESCAPE_SET set, const char *s, size_t len,
+                               const char *chars, int n, unsigned char below)
+{
+    const unsigned char bit = (unsigned char)(1<<set);
+    __m128i c[4];
+    for (int k=0; k<n; ++k) c[k] = _mm_set1_epi8(chars[k]);
+    const __m128i b = _mm_set1_epi8((char)(below - 1));
+
+    size_t i = 0;
+    for (; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+        __m128i m = _mm_cmpeq_epi8(v, c[0]);
+        for (int k=1; k<n; ++k) m = _mm_or_si128(m, _mm_cmpeq_epi8(v, c[k]));
+        if (below) m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(v, b), v));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+        if (!mask) continue;
+        int k = below ? mask_first(mask, s+i, bit) : ctz32(mask);
+        if (k>=0) return i + k;
+    }
+    return i;
+}
+
+static size_t scan_sse2(HVML_ESCAPE_SET set, const char *s, size_t len) {
+    size_t i = 0;
+    switch (set) {
+        case HVML_ESCAPE_DOM_TEXT: i = sse2_scan(set, s, len, escape_text, 2, 0);          break;
+        case HVML_ESCAPE_DOM_ATTR: i = sse2_scan(set, s, len, escape_attr, 3, 0);          break;
+        case HVML_ESCAPE_JSON:     i = sse2_scan(set, s, len, escape_json, 2, JSON_BELOW); break;
+        default: A(0, "internal logic error");
+    }
+    if (i<len && (escape_table[(unsigned char)s[i]] & (1<<set))) return i;
+    return i + scan_scalar(set, s+i, len-i);
+}
+#endif // HVML_ESCAPE_SSE2
+
+#ifdef HVML_ESCAPE_AVX2
+__attribute__((target("avx2")))
+static inline size_t avx2_scan(HVML_ESCAPE_SET set, const char *s, size_t len,
+                               const char *chars, int n, unsigned char below)
+{
+    const unsigned char bit = (unsigned char)(1<<set);
+    __m256i c[4];
+    for (int k=0; k<n; ++k) c[k] = _mm256_set1_epi8(chars[k]);
+    const __m256i b = _mm256_set1_epi8((char)(below - 1));
+
+    size_t i = 0;
+    for (; i+32<=len; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s+i));
+        __m256i m = _mm256_cmpeq_epi8(v, c[0]);
+        for (int k=1; k<n; ++k) m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, c[k]));
+        if (below) m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(v, b), v));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+        if (!mask) continue;
+        int k = below ? mask_first(mask, s+i, bit) : ctz32(mask);
+        if (k>=0) return i + k;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(HVML_ESCAPE_SET set, const char *s, size_t len) {
+    size_t i = 0;
+    switch (set) {
+        case HVML_ESCAPE_DOM_TEXT: i = avx2_scan(set, s, len, escape_text, 2, 0);          break;
+        case HVML_ESCAPE_DOM_ATTR: i = avx2_scan(set, s, len, escape_attr, 3, 0);          break;
+        case HVML_ESCAPE_JSON:     i = avx2_scan(set, s, len, escape_json, 2, JSON_BELOW); break;
+        default: A(0, "internal logic error");
+    }
+    if (i<len && (escape_table[(unsigned char)s[i]] & (1<<set))) return i;
+    // less than 32 bytes left
+    return i + scan_sse2(set, s+i, len-i);
+}
+#endif // HVML_ESCAPE_AVX2
+
+int hvml_escape_isa_supported(HVML_ESCAPE_ISA isa) {
+    switch (isa) {
+        case HVML_ESCAPE_ISA_AUTO:
+        case HVML_ESCAPE_ISA_SCALAR:
+            return 1;
+        case HVML_ESCAPE_ISA_SSE2:
+#ifdef HVML_ESCAPE_SSE2
+            return 1;
+#else
+            return 0;
+#endif
+        case HVML_ESCAPE_ISA_AVX2:
+#ifdef HVML_ESCAPE_AVX2
+            return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+            return 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static HVML_ESCAPE_ISA escape_best_isa(void) {
+    if (hvml_escape_isa_supported(HVML_ESCAPE_ISA_AVX2)) return HVML_ESCAPE_ISA_AVX2;
+    if (hvml_escape_isa_supported(HVML_ESCAPE_ISA_SSE2)) return HVML_ESCAPE_ISA_SSE2;
+    return HVML_ESCAPE_ISA_SCALAR;
+}
+
+size_t hvml_escape_scan_isa(HVML_ESCAPE_ISA isa, HVML_ESCAPE_SET set, const char *s, size_t len) {
+    if (isa==HVML_ESCAPE_ISA_AUTO) isa = escape_best_isa();
+    switch (isa) {
+#ifdef HVML_ESCAPE_AVX2
+        case HVML_ESCAPE_ISA_AVX2: return scan_avx2(set, s, len);
+#endif
+#ifdef HVML_ESCAPE_SSE2
+        case HVML_ESCAPE_ISA_SSE2: return scan_sse2(set, s, len);
+#endif
+        default:                   return scan_scalar(set, s, len);
+    }
+}
+
+size_t hvml_escape_scan(HVML_ESCAPE_SET set, const char *s, size_t len) {
+    return hvml_escape_scan_isa(escape_isa, set, s, len);
+}
+
+int hvml_escape_set_isa(HVML_ESCAPE_ISA isa) {
+    if (!hvml_escape_isa_supported(isa)) return -1;
+    escape_isa = isa;
+    return 0;
+}
+
+HVML_ESCAPE_ISA hvml_escape_get_isa(void) {
+    if (escape_isa==HVML_ESCAPE_ISA_AUTO) return escape_best_isa();
+    return escape_isa;
+}
+
+const char* hvml_escape_isa_name(HVML_ESCAPE_ISA isa) {
+    switch (isa) {
+        case HVML_ESCAPE_ISA_AUTO:   return "auto";
+        case HVML_ESCAPE_ISA_SCALAR: return "scalar";
+        case HVML_ESCAPE_ISA_SSE2:   return "sse2";
+        case HVML_ESCAPE_ISA_AVX2:   return "avx2";
+        default:                     return "unknown";
+    }
+}
+
@@ -0,0 +1,121 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml_file_map.h"
+
+#include "hvml/hvml_log.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+int hvml_file_map(const char *path, hvml_file_map_t *map) {
+    memset(map, 0, sizeof(*map));
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file==INVALID_HANDLE_VALUE) {
+        E("failed to open file: %s", path);
+        return -1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (unsigned long long)size.QuadPart > (size_t)-1) {
+        E("failed to stat file: %s", path);
+        CloseHandle(file);
+        return -1;
+    }
+    if (size.QuadPart==0) {
+        CloseHandle(file);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        E("failed to map file: %s", path);
+        return -1;
+    }
+
+    void *buf = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!buf) {
+        E("failed to map file: %s", path);
+        CloseHandle(mapping);
+        return -1;
+    }
+
+    map->buf     = (char*)buf;
+    map->len     = (size_t)size.QuadPart;
+    map->mapping = mapping;
+
+    return 0;
+}
+
+void hvml_file_unmap(hvml_file_map_t *map) {
+    if (map->buf)     UnmapViewOfFile(map->buf);
+    if (map->mapping) CloseHandle((HANDLE)map->mapping);
+    memset(map, 0, sizeof(*map));
+}
+#else
+int hvml_file_map(const char *path, hvml_file_map_t *map) {
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(path, O_RDONLY);
+    if (fd==-1) {
+        E("failed to open file: %s", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        E("not a regular file: %s", path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size==0) {
+        close(fd);
+        return 0;
+    }
+
+    // private and writable, thus the pages we touch are copied on write
+    void *buf = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf==MAP_FAILED) {
+        E("failed to map file: %s", path);
+        return -1;
+    }
+
+    map->buf = (char*)buf;
+    map->len = (size_t)st.st_size;
+
+    return 0;
+}
+
+void hvml_file_unmap(hvml_file_map_t *map) {
+    if (map->buf) munmap(map->buf, map->len);
+    memset(map, 0, sizeof(*map));
+}
+#endif
+
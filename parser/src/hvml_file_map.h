@@ -0,0 +1,46 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _hvml_file_map_h_
+#define _hvml_file_map_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a private, copy-on-write view of a whole file
+// writes go to the process's own pages, never back to the file
+typedef struct hvml_file_map_s          hvml_file_map_t;
+struct hvml_file_map_s {
+    char            *buf;     // null if the file is empty
+    size_t           len;
+#ifdef _WIN32
+    void            *mapping; // HANDLE
+#endif
+};
+
+int  hvml_file_map(const char *path, hvml_file_map_t *map);
+void hvml_file_unmap(hvml_file_map_t *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hvml_file_map_h_
+
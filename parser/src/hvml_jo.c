@@ -17,6 +17,9 @@
 
 #include "hvml/hvml_jo.h"
 
+#include "hvml_atomic.h"
+#include "hvml_file_map.h"
+
 #include "hvml/hvml_json_parser.h"
 #include "hvml/hvml_list.h"
 #include "hvml/hvml_log.h"
@@ -27,6 +30,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _MSC_VER
+  #include <Windows.h>
+#else
+  #include <pthread.h>
+#endif
+
 // for easy coding
 #define VAL_MEMBERS() \
     HLIST_MEMBERS(hvml_jo_value_t, hvml_jo_value_t, _val_); \
@@ -45,6 +54,8 @@
 struct hvml_jo_gen_s {
     hvml_jo_value_t          *jo;
     hvml_json_parser_t       *parser;
+
+    unsigned int              keep_origin:1;
 };
 
 typedef struct hvml_jo_true_s         hvml_jo_true_t;
@@ -71,27 +82,51 @@ struct hvml_jo_false_s { EMPTY_STRUCT_DEF };
 
 struct hvml_jo_null_s { EMPTY_STRUCT_DEF };
 
+// strings, origins of numbers and keys are immutable, and shared by clones
+// numbers are kept as int64 or double, the same as hvml_json_number_t
+// and the origin text is kept only if asked for
 struct hvml_jo_number_s {
-    long double    ldbl;
-    char          *origin;
+    union {
+        int64_t    i;
+        double     d;
+    } v;
+    hvml_rstr_t   *origin;  // or NULL
+    uint32_t       len;     // of the origin text, even if not kept
+    unsigned int   integer:1;
 };
 
 struct hvml_jo_string_s {
-    char   *str;
-    size_t  len;
+    const char    *str;     // bytes of rs
+    size_t         len;
+    hvml_rstr_t   *rs;
 };
 
+// objects with many keys get a hash index of their kv's
+// built lazily on lookup, and maintained by push/append/detach afterward
+// duplicated keys are not indexed, lookup always hits the first one
+// index is published last, thus lookups are safe among concurrent readers
+#define JO_OBJECT_INDEX_THRESHOLD        16
+
 struct hvml_jo_object_s {
-    EMPTY_STRUCT_DEF
+    hvml_jo_value_t ** volatile index; // open addressing, linear probing
+    size_t                   slots;    // power of 2, or 0 if not indexed
+    size_t                   dups;     // # of kv's not indexed due to duplicated keys
 };
 
+// arrays keep a side vector of their elements for random access
+// built lazily on indexing, appended to by push, and invalidated by detaching
+// any element other than the last one
+// len is published last, the same as index of object
 struct hvml_jo_array_s {
-    EMPTY_STRUCT_DEF
+    hvml_jo_value_t        **elems;
+    size_t                   cap;
+    volatile size_t          len;      // valid only if equals to # of children
 };
 
 struct hvml_jo_object_kv_s {
-    char                    *key;
+    const char              *key;      // bytes of rs
     size_t                   len;
+    hvml_rstr_t             *rs;
     hvml_jo_value_t         *val;
 };
 
@@ -117,6 +152,18 @@ struct hvml_jo_value_s {
 #define hvml_jo_value_from_union(ptr) \
     ptr ? (hvml_jo_value_t*)(((char*)ptr)-offsetof(hvml_jo_value_t, jstr)) : NULL
 
+// serializes lazy builds of indices among readers of the same value
+// mutations are still up to the caller to serialize
+#ifdef _MSC_VER
+static SRWLOCK                 lazy_lock = SRWLOCK_INIT;
+static void lazy_acquire(void) { AcquireSRWLockExclusive(&lazy_lock); }
+static void lazy_release(void) { ReleaseSRWLockExclusive(&lazy_lock); }
+#else
+static pthread_mutex_t         lazy_lock = PTHREAD_MUTEX_INITIALIZER;
+static void lazy_acquire(void) { pthread_mutex_lock(&lazy_lock); }
+static void lazy_release(void) { pthread_mutex_unlock(&lazy_lock); }
+#endif
+
 const char *hvml_jo_type_str(HVML_JO_TYPE t) {
     switch (t) {
         case MKJOT(J_TRUE):                return "J_TRUE";
@@ -158,39 +205,109 @@ hvml_jo_value_t* hvml_jo_null() {
     return jo;
 }
 
-hvml_jo_value_t* hvml_jo_number(const long double v, const char *origin) {
+// the adopt-family takes over the reference of rs, even if failed
+// num->origin is ignored, origin might be NULL
+static hvml_jo_value_t* hvml_jo_number_adopt(const hvml_json_number_t *num, hvml_rstr_t *origin) {
     hvml_jo_value_t *jo = (hvml_jo_value_t*)calloc(1, sizeof(*jo));
-    if (!jo) return NULL;
-
-    jo->jot             = MKJOT(J_NUMBER);
-    jo->u.jnum.ldbl     = v;
-    jo->u.jnum.origin   = strdup(origin);
-
-    if (!jo->u.jnum.origin) {
-        hvml_jo_value_free(jo);
+    if (!jo) {
+        hvml_rstr_unref(origin);
         return NULL;
     }
 
+    jo->jot               = MKJOT(J_NUMBER);
+    jo->u.jnum.integer    = num->integer;
+    if (num->integer) jo->u.jnum.v.i = num->i;
+    else              jo->u.jnum.v.d = num->d;
+    jo->u.jnum.origin     = origin;
+    jo->u.jnum.len        = num->len > UINT32_MAX ? UINT32_MAX : (uint32_t)num->len;
+
     return jo;
 }
 
-hvml_jo_value_t* hvml_jo_string(const char *v, size_t len) {
+static hvml_jo_value_t* hvml_jo_string_adopt(hvml_rstr_t *rs) {
+    if (!rs) return NULL;
+
     hvml_jo_value_t *jo = (hvml_jo_value_t*)calloc(1, sizeof(*jo));
-    if (!jo) return NULL;
+    if (!jo) {
+        hvml_rstr_unref(rs);
+        return NULL;
+    }
 
     jo->jot        = MKJOT(J_STRING);
-    jo->u.jstr.str = (char*)malloc(len+1);
-    if (!jo->u.jstr.str) {
-        free(jo);
+    jo->u.jstr.str = hvml_rstr_str(rs);
+    jo->u.jstr.len = hvml_rstr_len(rs);
+    jo->u.jstr.rs  = rs;
+
+    return jo;
+}
+
+static hvml_jo_value_t* hvml_jo_object_kv_adopt(hvml_rstr_t *key) {
+    if (!key) return NULL;
+
+    hvml_jo_value_t *jo = (hvml_jo_value_t*)calloc(1, sizeof(*jo));
+    if (!jo) {
+        hvml_rstr_unref(key);
         return NULL;
     }
-    memcpy(jo->u.jstr.str, v, len);
-    jo->u.jstr.str[len] = '\0';
-    jo->u.jstr.len      = len;
+
+    jo->jot       = MKJOT(J_OBJECT_KV);
+    jo->u.jkv.key = hvml_rstr_str(key);
+    jo->u.jkv.len = hvml_rstr_len(key);
+    jo->u.jkv.rs  = key;
 
     return jo;
 }
 
+// v prevails, origin only tells if it's an integer
+static void hvml_jo_number_of(const long double v, const char *origin, size_t len, hvml_json_number_t *num) {
+    if (hvml_json_number_parse(origin, len, num)) {
+        memset(num, 0, sizeof(*num));
+        num->len = len;
+    }
+    if (num->integer && (long double)num->i != v) num->integer = 0;
+    if (!num->integer) num->d = (double)v;
+}
+
+hvml_jo_value_t* hvml_jo_number(const long double v, const char *origin) {
+    size_t             len = strlen(origin);
+    hvml_json_number_t num;
+    hvml_jo_number_of(v, origin, len, &num);
+
+    hvml_rstr_t *rs = hvml_rstr_create(origin, len);
+    if (!rs) return NULL;
+
+    return hvml_jo_number_adopt(&num, rs);
+}
+
+hvml_jo_value_t* hvml_jo_number_from_json(const hvml_json_number_t *num) {
+    hvml_rstr_t *rs = NULL;
+    if (num->origin) {
+        rs = hvml_rstr_create(num->origin, num->len);
+        if (!rs) return NULL;
+    }
+
+    return hvml_jo_number_adopt(num, rs);
+}
+
+hvml_jo_value_t* hvml_jo_string(const char *v, size_t len) {
+    return hvml_jo_string_adopt(hvml_rstr_create(v, len));
+}
+
+hvml_jo_value_t* hvml_jo_number_shared(const long double v, hvml_rstr_t *origin) {
+    hvml_json_number_t num;
+    hvml_jo_number_of(v, hvml_rstr_str(origin), hvml_rstr_len(origin), &num);
+
+    return hvml_jo_number_adopt(&num, hvml_rstr_ref(origin));
+}
+
+hvml_jo_value_t* hvml_jo_string_shared(hvml_rstr_t *rs) {
+    return hvml_jo_string_adopt(hvml_rstr_ref(rs));
+}
+
+hvml_jo_value_t* hvml_jo_object_kv_shared(hvml_rstr_t *key) {
+    return hvml_jo_object_kv_adopt(hvml_rstr_ref(key));
+}
+
 hvml_jo_value_t* hvml_jo_object() {
     hvml_jo_value_t *jo = (hvml_jo_value_t*)calloc(1, sizeof(*jo));
     if (!jo) return NULL;
@@ -210,22 +327,16 @@ hvml_jo_value_t* hvml_jo_array() {
 }
 
 hvml_jo_value_t* hvml_jo_object_kv(const char *key, size_t len) {
-    hvml_jo_value_t *jo = (hvml_jo_value_t*)calloc(1, sizeof(*jo));
-    if (!jo) return NULL;
-
-    jo->jot       = MKJOT(J_OBJECT_KV);
-    jo->u.jkv.key = (char*)malloc(len+1);
-    if (!jo->u.jkv.key) {
-        free(jo);
-        return NULL;
-    }
-    memcpy(jo->u.jkv.key, key, len);
-    jo->u.jkv.key[len] = '\0';
-    jo->u.jkv.len      = len;
-
-    return jo;
+    return hvml_jo_object_kv_adopt(hvml_rstr_create(key, len));
 }
 
+static int  hvml_jo_object_index_build(hvml_jo_value_t *jo, size_t slots);
+static void hvml_jo_object_index_drop(hvml_jo_value_t *jo);
+static int  hvml_jo_object_index_insert(hvml_jo_value_t *jo, hvml_jo_value_t *kv);
+static void hvml_jo_object_index_remove(hvml_jo_value_t *jo, hvml_jo_value_t *kv);
+static void hvml_jo_array_elems_push(hvml_jo_value_t *jo, hvml_jo_value_t *val);
+static void hvml_jo_array_elems_remove(hvml_jo_value_t *jo, hvml_jo_value_t *val);
+
 int hvml_jo_value_push(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
     if (!val) return -1;
     if (!VAL_IS_ORPHAN(val)) {
@@ -239,6 +350,7 @@ int hvml_jo_value_push(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
         case MKJOT(J_ARRAY):
         {
             VAL_APPEND(jo, val);
+            hvml_jo_array_elems_push(jo, val);
         } break;
         case MKJOT(J_OBJECT):
         {
@@ -247,6 +359,7 @@ int hvml_jo_value_push(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
                 return -1;
             }
             VAL_APPEND(jo, val);
+            hvml_jo_object_index_insert(jo, val);
         } break;
         case MKJOT(J_OBJECT_KV):
         {
@@ -267,21 +380,246 @@ int hvml_jo_value_push(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
     return 0;
 }
 
-hvml_jo_value_t* hvml_jo_object_get_kv_by_key(hvml_jo_value_t *jo, const char *key, size_t len) {
+static size_t jo_key_hash(const char *key, size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static hvml_jo_value_t** jo_index_probe(hvml_jo_value_t **index, size_t slots, const char *key, size_t len) {
+    size_t mask = slots - 1;
+    size_t i    = jo_key_hash(key, len) & mask;
+    while (index[i]) {
+        hvml_jo_value_t *kv = index[i];
+        if (kv->u.jkv.len == len && memcmp(kv->u.jkv.key, key, len)==0) break;
+        i = (i + 1) & mask;
+    }
+    return index + i;
+}
+
+static int hvml_jo_object_index_build(hvml_jo_value_t *jo, size_t slots) {
     A(jo->jot == MKJOT(J_OBJECT), "internal logic error");
 
+    hvml_jo_value_t **index = (hvml_jo_value_t**)calloc(slots, sizeof(*index));
+    if (!index) return -1;
+
+    size_t dups = 0;
     hvml_jo_value_t *kv = VAL_HEAD(jo);
     while (kv) {
-        if (kv->u.jkv.len == len && memcmp(kv->u.jkv.key, key, len)==0) break;
+        hvml_jo_value_t **slot = jo_index_probe(index, slots, kv->u.jkv.key, kv->u.jkv.len);
+        if (*slot) {
+            dups += 1;
+        } else {
+            *slot = kv;
+        }
         kv = VAL_NEXT(kv);
     }
 
+    free(jo->u.jobject.index);
+    jo->u.jobject.slots = slots;
+    jo->u.jobject.dups  = dups;
+    hvml_atomic_set_ptr((void * volatile *)&jo->u.jobject.index, index);
+
+    return 0;
+}
+
+static void hvml_jo_object_index_drop(hvml_jo_value_t *jo) {
+    A(jo->jot == MKJOT(J_OBJECT), "internal logic error");
+
+    free(jo->u.jobject.index);
+    jo->u.jobject.index = NULL;
+    jo->u.jobject.slots = 0;
+    jo->u.jobject.dups  = 0;
+}
+
+// kv has already been appended
+static int hvml_jo_object_index_insert(hvml_jo_value_t *jo, hvml_jo_value_t *kv) {
+    if (!jo->u.jobject.index) return 0;
+
+    size_t slots = jo->u.jobject.slots;
+    if (VAL_COUNT(jo) * 2 > slots) {
+        // keep load factor under 1/2
+        if (hvml_jo_object_index_build(jo, slots * 2)) {
+            hvml_jo_object_index_drop(jo);
+            return -1;
+        }
+        return 0;
+    }
+
+    hvml_jo_value_t **slot = jo_index_probe(jo->u.jobject.index, slots, kv->u.jkv.key, kv->u.jkv.len);
+    if (*slot) {
+        jo->u.jobject.dups += 1;
+    } else {
+        *slot = kv;
+    }
+
+    return 0;
+}
+
+// kv has already been removed
+static void hvml_jo_object_index_remove(hvml_jo_value_t *jo, hvml_jo_value_t *kv) {
+    if (!jo->u.jobject.index) return;
+
+    if (jo->u.jobject.dups) {
+        // a shadowed kv might come to front, simply rebuild on next lookup
+        hvml_jo_object_index_drop(jo);
+        return;
+    }
+
+    hvml_jo_value_t **index = jo->u.jobject.index;
+    size_t            mask  = jo->u.jobject.slots - 1;
+    hvml_jo_value_t **slot  = jo_index_probe(index, jo->u.jobject.slots, kv->u.jkv.key, kv->u.jkv.len);
+    A(*slot == kv, "internal logic error");
+
+    // backward shift deletion, no tombstones needed
+    size_t i = (size_t)(slot - index);
+    size_t j = i;
+    index[i] = NULL;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!index[j]) break;
+        size_t k = jo_key_hash(index[j]->u.jkv.key, index[j]->u.jkv.len) & mask;
+        if (i<=j ? (i<k && k<=j) : (i<k || k<=j)) continue;
+        index[i] = index[j];
+        index[j] = NULL;
+        i        = j;
+    }
+}
+
+hvml_jo_value_t* hvml_jo_object_get_kv_by_key(hvml_jo_value_t *jo, const char *key, size_t len) {
+    A(jo->jot == MKJOT(J_OBJECT), "internal logic error");
+
+    hvml_jo_value_t **index = (hvml_jo_value_t**)hvml_atomic_get_ptr((void * volatile *)&jo->u.jobject.index);
+    if (!index && VAL_COUNT(jo) >= JO_OBJECT_INDEX_THRESHOLD) {
+        lazy_acquire();
+        // might have been built by another reader meanwhile
+        if (!jo->u.jobject.index) {
+            size_t slots = JO_OBJECT_INDEX_THRESHOLD * 2;
+            while (slots < VAL_COUNT(jo) * 2) slots *= 2;
+            // fall back to linear search if failed
+            hvml_jo_object_index_build(jo, slots);
+        }
+        index = jo->u.jobject.index;
+        lazy_release();
+    }
+
+    hvml_jo_value_t *kv = NULL;
+    if (index) {
+        kv = *jo_index_probe(index, jo->u.jobject.slots, key, len);
+    } else {
+        kv = VAL_HEAD(jo);
+        while (kv) {
+            if (kv->u.jkv.len == len && memcmp(kv->u.jkv.key, key, len)==0) break;
+            kv = VAL_NEXT(kv);
+        }
+    }
+
     if (!kv) return NULL;
 
     A(kv->jot == MKJOT(J_OBJECT_KV), "internal logic error");
     return kv;
 }
 
+static int hvml_jo_array_elems_reserve(hvml_jo_value_t *jo, size_t cap) {
+    if (cap <= jo->u.jarray.cap) return 0;
+
+    size_t n = jo->u.jarray.cap ? jo->u.jarray.cap : 16;
+    while (n < cap) n *= 2;
+
+    hvml_jo_value_t **elems = (hvml_jo_value_t**)realloc(jo->u.jarray.elems, n * sizeof(*elems));
+    if (!elems) return -1; // out of memory
+
+    jo->u.jarray.elems = elems;
+    jo->u.jarray.cap   = n;
+
+    return 0;
+}
+
+// val has already been appended
+static void hvml_jo_array_elems_push(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
+    if (!jo->u.jarray.elems) return;
+    if (jo->u.jarray.len + 1 != VAL_COUNT(jo)) return; // stale already
+
+    if (hvml_jo_array_elems_reserve(jo, jo->u.jarray.len + 1)) {
+        jo->u.jarray.len = 0; // rebuild on next indexing
+        return;
+    }
+    jo->u.jarray.elems[jo->u.jarray.len++] = val;
+}
+
+// val has already been removed
+static void hvml_jo_array_elems_remove(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
+    if (!jo->u.jarray.elems) return;
+    if (jo->u.jarray.len != VAL_COUNT(jo) + 1) return; // stale already
+
+    if (jo->u.jarray.elems[jo->u.jarray.len - 1] == val) {
+        jo->u.jarray.len -= 1;
+    } else {
+        jo->u.jarray.len  = 0; // rebuild on next indexing
+    }
+}
+
+static void hvml_jo_array_elems_drop(hvml_jo_value_t *jo) {
+    free(jo->u.jarray.elems);
+    jo->u.jarray.elems = NULL;
+    jo->u.jarray.cap   = 0;
+    jo->u.jarray.len   = 0;
+}
+
+size_t hvml_jo_array_size(hvml_jo_value_t *jo) {
+    if (!jo || jo->jot != MKJOT(J_ARRAY)) return 0;
+
+    return VAL_COUNT(jo);
+}
+
+hvml_jo_value_t* hvml_jo_array_get(hvml_jo_value_t *jo, size_t idx) {
+    if (!jo || jo->jot != MKJOT(J_ARRAY)) return NULL;
+
+    size_t count = VAL_COUNT(jo);
+    if (idx >= count) return NULL;
+
+    if (hvml_atomic_get(&jo->u.jarray.len) != count) {
+        lazy_acquire();
+        // might have been built by another reader meanwhile
+        int r = 0;
+        if (jo->u.jarray.len != count) {
+            r = hvml_jo_array_elems_reserve(jo, count);
+            if (r==0) {
+                size_t           i = 0;
+                hvml_jo_value_t *v = VAL_HEAD(jo);
+                while (v) {
+                    jo->u.jarray.elems[i++] = v;
+                    v = VAL_NEXT(v);
+                }
+                A(i == count, "internal logic error");
+                hvml_atomic_set(&jo->u.jarray.len, count);
+            }
+        }
+        lazy_release();
+        if (r) {
+            // fall back to walking the list
+            hvml_jo_value_t *v = VAL_HEAD(jo);
+            while (idx-- > 0) v = VAL_NEXT(v);
+            return v;
+        }
+    }
+
+    return jo->u.jarray.elems[idx];
+}
+
+hvml_jo_value_t* hvml_jo_object_get(hvml_jo_value_t *jo, const char *key, size_t len) {
+    if (!jo || jo->jot != MKJOT(J_OBJECT)) return NULL;
+
+    hvml_jo_value_t *kv = hvml_jo_object_get_kv_by_key(jo, key, len);
+    if (!kv) return NULL;
+
+    return kv->u.jkv.val;
+}
+
 hvml_jo_value_t* hvml_jo_object_append_kv(hvml_jo_value_t *jo, hvml_jo_value_t *val) {
     if (jo->jot != MKJOT(J_OBJECT)) {
         E("jo[%p/%s] is NOT object", (void*)jo, hvml_jo_value_type_str(jo));
@@ -297,6 +635,7 @@ hvml_jo_value_t* hvml_jo_object_append_kv(hvml_jo_value_t *jo, hvml_jo_value_t *
     }
 
     VAL_APPEND(jo, val);
+    hvml_jo_object_index_insert(jo, val);
 
     return val;
 }
@@ -315,57 +654,41 @@ void hvml_jo_value_detach(hvml_jo_value_t *jo) {
 
     if (owner->jot == MKJOT(J_OBJECT_KV)) {
         owner->u.jkv.val = NULL;
+    } else if (owner->jot == MKJOT(J_OBJECT)) {
+        hvml_jo_object_index_remove(owner, jo);
+    } else if (owner->jot == MKJOT(J_ARRAY)) {
+        hvml_jo_array_elems_remove(owner, jo);
     }
 }
 
-void hvml_jo_value_free(hvml_jo_value_t *jo) {
-    hvml_jo_value_detach(jo);
-
+// releases jo itself, its sub-values are left untouched
+static void hvml_jo_value_release(hvml_jo_value_t *jo) {
     switch (jo->jot) {
         case MKJOT(J_TRUE):
         case MKJOT(J_FALSE):
         case MKJOT(J_NULL):
         case MKJOT(J_NUMBER): {
-            if (jo->u.jnum.origin) {
-                free(jo->u.jnum.origin);
-                jo->u.jnum.origin = NULL;
-            }
+            hvml_rstr_unref(jo->u.jnum.origin);
+            jo->u.jnum.origin = NULL;
         } break;
         case MKJOT(J_STRING): {
-            free(jo->u.jstr.str);
+            hvml_rstr_unref(jo->u.jstr.rs);
+            jo->u.jstr.rs  = NULL;
             jo->u.jstr.str = NULL;
             jo->u.jstr.len = 0;
         } break;
         case MKJOT(J_OBJECT): {
-            while (VAL_COUNT(jo)>0) {
-                size_t count = VAL_COUNT(jo);
-                hvml_jo_value_t *v = VAL_TAIL(jo);
-                A(v, "internal logic error");
-
-                hvml_jo_value_free(v);
-                A(count - 1 == VAL_COUNT(jo), "internal logic error");
-            }
+            hvml_jo_object_index_drop(jo);
         } break;
         case MKJOT(J_ARRAY): {
-            while (VAL_COUNT(jo)>0) {
-                size_t count = VAL_COUNT(jo);
-                hvml_jo_value_t *v = VAL_TAIL(jo);
-                A(v, "internal logic error");
-
-                hvml_jo_value_free(v);
-                A(count - 1 == VAL_COUNT(jo), "internal logic error");
-            }
+            hvml_jo_array_elems_drop(jo);
         } break;
         case MKJOT(J_OBJECT_KV): {
-            if (jo->u.jkv.key) {
-                free(jo->u.jkv.key);
-                jo->u.jkv.key = NULL;
-                jo->u.jkv.len = 0;
-            }
-            if (jo->u.jkv.val) {
-                hvml_jo_value_free(jo->u.jkv.val);
-                jo->u.jkv.val = NULL;
-            }
+            hvml_rstr_unref(jo->u.jkv.rs);
+            jo->u.jkv.rs  = NULL;
+            jo->u.jkv.key = NULL;
+            jo->u.jkv.len = 0;
+            jo->u.jkv.val = NULL;
         } break;
         default: {
             A(0, "internal logic error, unknown JOT: [%d]", jo->jot);
@@ -376,6 +699,29 @@ void hvml_jo_value_free(hvml_jo_value_t *jo) {
     free(jo);
 }
 
+void hvml_jo_value_free(hvml_jo_value_t *jo) {
+    hvml_jo_value_detach(jo);
+
+    // the whole subtree is going away, thus walked in post-order
+    // without recursion, nor unlinking sub-values one by one
+    hvml_jo_value_t *v = jo;
+    while (v) {
+        while (VAL_HEAD(v)) v = VAL_HEAD(v);
+
+        hvml_jo_value_t *next = NULL;
+        if (v != jo) {
+            next = VAL_NEXT(v);
+            if (!next) {
+                // the last one of its siblings, the owner is left childless
+                next = VAL_OWNER(v);
+                VAL_HEAD(next) = NULL;
+            }
+        }
+        hvml_jo_value_release(v);
+        v = next;
+    }
+}
+
 HVML_JO_TYPE hvml_jo_value_type(hvml_jo_value_t *jo) {
     return jo->jot;
 }
@@ -450,9 +796,43 @@ int hvml_jo_number_get(hvml_jo_value_t *jo, long double *d, const char **s) {
 
     if (jo->jot!=MKJOT(J_NUMBER)) return -1;
 
-    if (d) *d = jo->u.jnum.ldbl;
+    if (d) *d = jo->u.jnum.integer ? (long double)jo->u.jnum.v.i : (long double)jo->u.jnum.v.d;
+
+    if (s) *s = jo->u.jnum.origin ? hvml_rstr_str(jo->u.jnum.origin) : NULL;
+
+    return 0;
+}
+
+int hvml_jo_number_get_json(hvml_jo_value_t *jo, hvml_json_number_t *num) {
+    if (jo == NULL) return -1;
+
+    if (jo->jot!=MKJOT(J_NUMBER)) return -1;
+
+    num->integer = jo->u.jnum.integer;
+    num->i       = jo->u.jnum.integer ? jo->u.jnum.v.i : 0;
+    num->d       = jo->u.jnum.integer ? (double)jo->u.jnum.v.i : jo->u.jnum.v.d;
+    num->origin  = jo->u.jnum.origin ? hvml_rstr_str(jo->u.jnum.origin) : NULL;
+    num->len     = jo->u.jnum.len;
+
+    return 0;
+}
+
+int hvml_jo_number_get_int64(hvml_jo_value_t *jo, int64_t *v) {
+    if (jo == NULL) return -1;
+
+    if (jo->jot!=MKJOT(J_NUMBER) || !jo->u.jnum.integer) return -1;
+
+    if (v) *v = jo->u.jnum.v.i;
+
+    return 0;
+}
+
+int hvml_jo_number_get_double(hvml_jo_value_t *jo, double *v) {
+    if (jo == NULL) return -1;
+
+    if (jo->jot!=MKJOT(J_NUMBER)) return -1;
 
-    if (s) *s = jo->u.jnum.origin;
+    if (v) *v = jo->u.jnum.integer ? (double)jo->u.jnum.v.i : jo->u.jnum.v.d;
 
     return 0;
 }
@@ -467,6 +847,39 @@ int hvml_jo_string_get(hvml_jo_value_t *jo, const char **s) {
     return 0;
 }
 
+int hvml_jo_string_get_len(hvml_jo_value_t *jo, const char **s, size_t *len) {
+    if (jo == NULL) return -1;
+
+    if (jo->jot!=MKJOT(J_STRING)) return -1;
+
+    if (s)   *s   = jo->u.jstr.str;
+    if (len) *len = jo->u.jstr.len;
+
+    return 0;
+}
+
+int hvml_jo_kv_get_key(hvml_jo_value_t *jo, const char **key, size_t *len) {
+    if (jo == NULL) return -1;
+
+    if (jo->jot!=MKJOT(J_OBJECT_KV)) return -1;
+
+    if (key) *key = jo->u.jkv.key;
+    if (len) *len = jo->u.jkv.len;
+
+    return 0;
+}
+
+hvml_rstr_t* hvml_jo_value_rstr(hvml_jo_value_t *jo) {
+    if (jo == NULL) return NULL;
+
+    switch (jo->jot) {
+        case MKJOT(J_NUMBER):    return jo->u.jnum.origin;
+        case MKJOT(J_STRING):    return jo->u.jstr.rs;
+        case MKJOT(J_OBJECT_KV): return jo->u.jkv.rs;
+        default:                 return NULL;
+    }
+}
+
 int hvml_jo_kv_get(hvml_jo_value_t *jo, const char **key, hvml_jo_value_t **val) {
     if (jo == NULL) return -1;
 
@@ -648,30 +1061,26 @@ static int traverse_for_clone(hvml_jo_value_t *jo, int lvl, int action, void *ar
             if (!v) return -1;
         } break;
         case MKJOT(J_FALSE): {
-            v = hvml_jo_true();
+            v = hvml_jo_false();
             if (!v) return -1;
         } break;
         case MKJOT(J_NULL): {
-            v = hvml_jo_true();
+            v = hvml_jo_null();
             if (!v) return -1;
         } break;
         case MKJOT(J_NUMBER): {
             A(action==0, "internal logic error");
 
-            long double d;
-            const char *s;
-            A(0==hvml_jo_number_get(jo, &d, &s), "internal logic error");
-            v = hvml_jo_number(d, s);
+            hvml_json_number_t num;
+            A(0==hvml_jo_number_get_json(jo, &num), "internal logic error");
+            hvml_rstr_t *origin = jo->u.jnum.origin;
+            v = hvml_jo_number_adopt(&num, origin ? hvml_rstr_ref(origin) : NULL);
             if (!v) return -1; // out of memory
         } break;
         case MKJOT(J_STRING): {
             A(action==0, "internal logic error");
 
-            const char *s;
-            if (hvml_jo_string_get(jo, &s)) {
-                A(0, "internal logic error"); // shouldn't reach here
-            }
-            v = hvml_jo_string(s, strlen(s));
+            v = hvml_jo_string_shared(jo->u.jstr.rs);
             if (!v) return -1; // out of memory
         } break;
         case MKJOT(J_OBJECT): {
@@ -701,10 +1110,7 @@ static int traverse_for_clone(hvml_jo_value_t *jo, int lvl, int action, void *ar
         case MKJOT(J_OBJECT_KV): {
             switch (action) {
                 case 1: {
-                    const char      *key;
-                    A(0==hvml_jo_kv_get(jo, &key, NULL), "internal logic error");
-                    A(key, "internal logic error");
-                    hvml_jo_value_t *v = hvml_jo_object_kv(key, strlen(key));
+                    hvml_jo_value_t *v = hvml_jo_object_kv_shared(jo->u.jkv.rs);
                     if (!v) return -1; // out of memory
                     A(hvml_jo_value_type(jc->jo)==MKJOT(J_OBJECT), "internal logic error");
                     if (hvml_jo_value_push(jc->jo, v)) {
@@ -769,7 +1175,7 @@ hvml_jo_value_t* hvml_jo_clone(hvml_jo_value_t *jo) {
     int r = hvml_jo_value_traverse(jo, &arg, traverse_for_clone);
     if (r) {
         if (arg.jo) {
-            free(arg.jo);
+            hvml_jo_value_free(hvml_jo_value_root(arg.jo));
             arg.jo = NULL;
         }
         return NULL;
@@ -787,32 +1193,95 @@ static int on_true(void *arg);
 static int on_false(void *arg);
 static int on_null(void *arg);
 static int on_string(void *arg, const char *val, size_t len);
-static int on_number(void *arg, const char *origin, long double val);
+static int on_number(void *arg, const hvml_json_number_t *num);
 static int on_item_done(void *arg);
 static int on_val_done(void *arg);
 static int on_end(void *arg);
 
+static void hvml_jo_gen_conf(hvml_jo_gen_t *gen, hvml_json_parser_conf_t *conf) {
+    memset(conf, 0, sizeof(*conf));
+    conf->on_begin              = on_begin;
+    conf->on_open_array         = on_open_array;
+    conf->on_close_array        = on_close_array;
+    conf->on_open_obj           = on_open_obj;
+    conf->on_close_obj          = on_close_obj;
+    conf->on_key                = on_key;
+    conf->on_true               = on_true;
+    conf->on_false              = on_false;
+    conf->on_null               = on_null;
+    conf->on_string             = on_string;
+    conf->on_number             = on_number;
+    conf->on_item_done          = on_item_done;
+    conf->on_val_done           = on_val_done;
+    conf->on_end                = on_end;
+
+    conf->arg                   = gen;
+}
+
+// per-thread pool of generators, see hvml_jo_gen_acquire
+// the pool lives in thread-local storage, and the key is only there to
+// destroy what's pooled when the thread exits
+#define JO_GEN_POOL_SIZE         4
+
+typedef struct jo_gen_pool_s           jo_gen_pool_t;
+struct jo_gen_pool_s {
+    hvml_jo_gen_t           *gens[JO_GEN_POOL_SIZE];
+    size_t                   count;
+    unsigned int             registered:1;
+};
+
+#ifdef __GNUC__
+  static __thread jo_gen_pool_t         gen_pool = {0};
+#elif defined(_MSC_VER)
+  __declspec(thread) static jo_gen_pool_t gen_pool = {0};
+#else
+  #error Please look for an approach to declare tls variable in this compiler
+#endif
+
+static void gen_pool_flush(void *arg) {
+    jo_gen_pool_t *pool = (jo_gen_pool_t*)arg;
+    while (pool->count) {
+        pool->count -= 1;
+        hvml_jo_gen_destroy(pool->gens[pool->count]);
+        pool->gens[pool->count] = NULL;
+    }
+    pool->registered = 0;
+}
+
+#ifdef _MSC_VER
+static INIT_ONCE               gen_pool_once = INIT_ONCE_STATIC_INIT;
+static DWORD                   gen_pool_key  = FLS_OUT_OF_INDEXES;
+static VOID NTAPI gen_pool_on_exit(PVOID arg) { gen_pool_flush(arg); }
+static BOOL CALLBACK gen_pool_init(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    (void)once; (void)param; (void)ctx;
+    gen_pool_key = FlsAlloc(gen_pool_on_exit);
+    return TRUE;
+}
+static int gen_pool_register(jo_gen_pool_t *pool) {
+    InitOnceExecuteOnce(&gen_pool_once, gen_pool_init, NULL, NULL);
+    if (gen_pool_key==FLS_OUT_OF_INDEXES) return -1;
+    return FlsSetValue(gen_pool_key, pool) ? 0 : -1;
+}
+#else
+static pthread_once_t          gen_pool_once   = PTHREAD_ONCE_INIT;
+static pthread_key_t           gen_pool_key;
+static int                     gen_pool_key_ok = 0;
+static void gen_pool_init(void) {
+    gen_pool_key_ok = pthread_key_create(&gen_pool_key, gen_pool_flush)==0;
+}
+static int gen_pool_register(jo_gen_pool_t *pool) {
+    pthread_once(&gen_pool_once, gen_pool_init);
+    if (!gen_pool_key_ok) return -1;
+    return pthread_setspecific(gen_pool_key, pool) ? -1 : 0;
+}
+#endif
+
 hvml_jo_gen_t* hvml_jo_gen_create() {
     hvml_jo_gen_t *gen = (hvml_jo_gen_t*)calloc(1, sizeof(*gen));
     if (!gen) return NULL;
 
-    hvml_json_parser_conf_t conf = {0};
-    conf.on_begin               = on_begin;
-    conf.on_open_array          = on_open_array;
-    conf.on_close_array         = on_close_array;
-    conf.on_open_obj            = on_open_obj;
-    conf.on_close_obj           = on_close_obj;
-    conf.on_key                 = on_key;
-    conf.on_true                = on_true;
-    conf.on_false               = on_false;
-    conf.on_null                = on_null;
-    conf.on_string              = on_string;
-    conf.on_number              = on_number;
-    conf.on_item_done           = on_item_done;
-    conf.on_val_done            = on_val_done;
-    conf.on_end                 = on_end;
-
-    conf.arg                    = gen;
+    hvml_json_parser_conf_t conf;
+    hvml_jo_gen_conf(gen, &conf);
 
     gen->parser = hvml_json_parser_create(conf);
     if (!gen->parser) {
@@ -841,6 +1310,49 @@ void hvml_jo_gen_destroy(hvml_jo_gen_t *gen) {
     free(gen);
 }
 
+void hvml_jo_gen_reset(hvml_jo_gen_t *gen) {
+    if (gen->jo) {
+        hvml_jo_value_free(hvml_jo_value_root(gen->jo));
+        gen->jo = NULL;
+    }
+    hvml_json_parser_reset(gen->parser);
+}
+
+hvml_jo_gen_t* hvml_jo_gen_acquire() {
+    jo_gen_pool_t *pool = &gen_pool;
+    if (pool->count) {
+        pool->count -= 1;
+        hvml_jo_gen_t *gen = pool->gens[pool->count];
+        pool->gens[pool->count] = NULL;
+        return gen;
+    }
+    return hvml_jo_gen_create();
+}
+
+void hvml_jo_gen_release(hvml_jo_gen_t *gen) {
+    if (!gen) return;
+
+    jo_gen_pool_t *pool = &gen_pool;
+    do {
+        if (pool->count >= JO_GEN_POOL_SIZE) break;
+        if (!pool->registered) {
+            if (gen_pool_register(pool)) break;
+            pool->registered = 1;
+        }
+        hvml_jo_gen_reset(gen);
+        gen->keep_origin = 0;
+        pool->gens[pool->count] = gen;
+        pool->count += 1;
+        return;
+    } while (0);
+
+    hvml_jo_gen_destroy(gen);
+}
+
+void hvml_jo_gen_set_keep_origin(hvml_jo_gen_t *gen, int keep) {
+    gen->keep_origin = keep ? 1 : 0;
+}
+
 int hvml_jo_gen_parse_char(hvml_jo_gen_t *gen, const char c) {
     return hvml_json_parser_parse_char(gen->parser, c);
 }
@@ -863,21 +1375,29 @@ hvml_jo_value_t* hvml_jo_gen_parse_end(hvml_jo_gen_t *gen) {
     return jo;
 }
 
-hvml_jo_value_t* hvml_jo_value_load_from_stream(FILE *in) {
-    hvml_jo_gen_t *gen = hvml_jo_gen_create();
-    if (!gen) return NULL;
+hvml_jo_value_t* hvml_jo_gen_parse_buffer(hvml_jo_gen_t *gen, const char *buf, size_t len) {
+    A(gen->jo==NULL, "internal logic error");
+    A(hvml_json_parser_is_begin(gen->parser), "internal logic error");
 
-    char buf[4096] = {0};
-    int  n         = 0;
-    int  ret       = 0;
+    hvml_json_parser_conf_t conf;
+    hvml_jo_gen_conf(gen, &conf);
 
-    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
-        ret = hvml_jo_gen_parse(gen, buf, n);
-        if (ret) break;
+    hvml_jo_value_t *jo = NULL;
+    if (hvml_json_parse_buffer(&conf, buf, len)==0) {
+        jo      = gen->jo;
+        gen->jo = NULL;
+        return jo;
     }
-    hvml_jo_value_t *jo = hvml_jo_gen_parse_end(gen);
-    hvml_jo_gen_destroy(gen);
 
+    // the partial one is dropped, and the incremental parser tells what goes wrong
+    if (gen->jo) {
+        hvml_jo_value_free(hvml_jo_value_root(gen->jo));
+        gen->jo = NULL;
+    }
+    int ret = hvml_jo_gen_parse(gen, buf, len);
+    jo = hvml_jo_gen_parse_end(gen);
+    // ready for the next buffer
+    hvml_jo_gen_reset(gen);
     if (ret==0) {
         return jo;
     }
@@ -886,6 +1406,45 @@ hvml_jo_value_t* hvml_jo_value_load_from_stream(FILE *in) {
     return NULL;
 }
 
+hvml_jo_value_t* hvml_jo_value_load_from_stream(FILE *in) {
+    // read till eof anyway, thus parsed in one go
+    hvml_string_t str = {0};
+    char buf[4096];
+    size_t n = 0;
+    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
+        if (hvml_string_append_n(&str, buf, n)) {
+            hvml_string_clear(&str);
+            return NULL;
+        }
+    }
+
+    hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer(hvml_string_str(&str), hvml_string_len(&str));
+    hvml_string_clear(&str);
+
+    return jo;
+}
+
+hvml_jo_value_t* hvml_jo_value_load_from_file(const char *path) {
+    hvml_file_map_t map;
+    if (hvml_file_map(path, &map)) return NULL;
+
+    // all at once, straight from the mapping
+    hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer(map.buf, map.len);
+    hvml_file_unmap(&map);
+
+    return jo;
+}
+
+hvml_jo_value_t* hvml_jo_value_load_from_buffer(const char *buf, size_t len) {
+    hvml_jo_gen_t *gen = hvml_jo_gen_acquire();
+    if (!gen) return NULL;
+
+    hvml_jo_value_t *jo = hvml_jo_gen_parse_buffer(gen, buf, len);
+    hvml_jo_gen_release(gen);
+
+    return jo;
+}
+
 
 
 
@@ -1035,12 +1594,15 @@ static int on_string(void *arg, const char *val, size_t len) {
     return 0;
 }
 
-static int on_number(void *arg, const char *origin, long double val) {
-    hvml_jo_value_t *jo = hvml_jo_number(val, origin);
-    if (!jo) return -1;
-
+static int on_number(void *arg, const hvml_json_number_t *num) {
     hvml_jo_gen_t *gen = (hvml_jo_gen_t*)arg;
 
+    hvml_json_number_t n = *num;
+    if (!gen->keep_origin) n.origin = NULL;
+
+    hvml_jo_value_t *jo = hvml_jo_number_from_json(&n);
+    if (!jo) return -1;
+
     if (hvml_jo_value_push(gen->jo, jo)) {
         hvml_jo_value_free(jo);
         return -1;
@@ -22,7 +22,9 @@
 #include "hvml/hvml_string.h"
 
 #include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef struct jo_value_printf_s        jo_value_printf_t;
@@ -44,74 +46,96 @@ static int traverse_for_printf(hvml_jo_value_t *jo, int lvl, int action, void *a
         case MKJOT(J_TRUE): {
             A(action==0, "internal logic error");
             if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                r = hvml_stream_printf(parg->stream, ":");
+                r = hvml_stream_putc(parg->stream, ':');
             } else if (prev) {
-                r = hvml_stream_printf(parg->stream, ",");
+                r = hvml_stream_putc(parg->stream, ',');
             }
             if (r<0) break;
-            r = hvml_stream_printf(parg->stream, "true");
+            r = hvml_stream_puts(parg->stream, "true");
         } break;
         case MKJOT(J_FALSE): {
             A(action==0, "internal logic error");
             if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                r = hvml_stream_printf(parg->stream, ":");
+                r = hvml_stream_putc(parg->stream, ':');
             } else if (prev) {
-                r = hvml_stream_printf(parg->stream, ",");
+                r = hvml_stream_putc(parg->stream, ',');
             }
             if (r<0) break;
-            r = hvml_stream_printf(parg->stream, "false");
+            r = hvml_stream_puts(parg->stream, "false");
         } break;
         case MKJOT(J_NULL): {
             A(action==0, "internal logic error");
             if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                r = hvml_stream_printf(parg->stream, ":");
+                r = hvml_stream_putc(parg->stream, ':');
             } else if (prev) {
-                r = hvml_stream_printf(parg->stream, ",");
+                r = hvml_stream_putc(parg->stream, ',');
             }
             if (r<0) break;
-            r = hvml_stream_printf(parg->stream, "null");
+            r = hvml_stream_puts(parg->stream, "null");
         } break;
         case MKJOT(J_NUMBER): {
             A(action==0, "internal logic error");
             if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                r = hvml_stream_printf(parg->stream, ":");
+                r = hvml_stream_putc(parg->stream, ':');
             } else if (prev) {
-                r = hvml_stream_printf(parg->stream, ",");
+                r = hvml_stream_putc(parg->stream, ',');
             }
             if (r<0) break;
-            long double d;
-            const char *s;
-            A(0==hvml_jo_number_get(jo, &d, &s), "internal logic error");
-            int prec = strlen(s);
-            r = hvml_stream_printf(parg->stream, "%.*Lg", prec, d);
+            hvml_json_number_t num;
+            A(0==hvml_jo_number_get_json(jo, &num), "internal logic error");
+            // kept for round-trip fidelity, such as uint64 beyond int64
+            if (num.origin) {
+                r = hvml_stream_write(parg->stream, num.origin, num.len);
+                break;
+            }
+            if (num.integer) {
+                r = hvml_stream_printf(parg->stream, "%" PRId64, num.i);
+                break;
+            }
+            // out of range for double, such as 1e309, and json has no inf/nan
+            if (!isfinite(num.d)) {
+                r = hvml_stream_puts(parg->stream, "null");
+                break;
+            }
+            // as many digits as the origin text, but no more than needed
+            // to read the same double back
+            int prec = (int)num.len;
+            if (prec==0 || prec>15) {
+                char buf[32];
+                for (prec=15; prec<17; ++prec) {
+                    snprintf(buf, sizeof(buf), "%.*g", prec, num.d);
+                    if (strtod(buf, NULL)==num.d) break;
+                }
+            }
+            r = hvml_stream_printf(parg->stream, "%.*g", prec, num.d);
         } break;
         case MKJOT(J_STRING): {
             A(action==0, "internal logic error");
             if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                r = hvml_stream_printf(parg->stream, ":");
+                r = hvml_stream_putc(parg->stream, ':');
             } else if (prev) {
-                r = hvml_stream_printf(parg->stream, ",");
+                r = hvml_stream_putc(parg->stream, ',');
             }
             if (r<0) break;
             const char *s;
             if (!hvml_jo_string_get(jo, &s)) {
-                hvml_json_str_serialize(parg->stream, s, s ? strlen(s) : 0);
+                r = hvml_json_str_serialize(parg->stream, s, s ? strlen(s) : 0);
             }
         } break;
         case MKJOT(J_OBJECT): {
             switch (action) {
                 case 1: {
                     if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                        r = hvml_stream_printf(parg->stream, ":");
+                        r = hvml_stream_putc(parg->stream, ':');
                     } else if (prev) {
-                        r = hvml_stream_printf(parg->stream, ",");
+                        r = hvml_stream_putc(parg->stream, ',');
                     }
                     if (r<0) break;
-                    r = hvml_stream_printf(parg->stream, "{"); // "}"
+                    r = hvml_stream_putc(parg->stream, '{'); // "}"
                 } break;
                 case -1: {
                     // "{"
-                    r = hvml_stream_printf(parg->stream, "}");
+                    r = hvml_stream_putc(parg->stream, '}');
                 } break;
                 default: {
                     A(0, "internal logic error");
@@ -122,7 +146,7 @@ static int traverse_for_printf(hvml_jo_value_t *jo, int lvl, int action, void *a
             switch (action) {
                 case 1: {
                     if (prev) {
-                        r = hvml_stream_printf(parg->stream, ",");
+                        r = hvml_stream_putc(parg->stream, ',');
                         if (r<0) break;
                     }
                     const char      *key;
@@ -142,16 +166,16 @@ static int traverse_for_printf(hvml_jo_value_t *jo, int lvl, int action, void *a
             switch (action) {
                 case 1: {
                     if (parent && hvml_jo_value_type(parent)==MKJOT(J_OBJECT_KV)) {
-                        r = hvml_stream_printf(parg->stream, ":");
+                        r = hvml_stream_putc(parg->stream, ':');
                     } else if (prev) {
-                        r = hvml_stream_printf(parg->stream, ",");
+                        r = hvml_stream_putc(parg->stream, ',');
                     }
                     if (r<0) break;
-                    r = hvml_stream_printf(parg->stream, "["); // "]";
+                    r = hvml_stream_putc(parg->stream, '['); // "]";
                 } break;
                 case -1: {
                     // "["
-                    r = hvml_stream_printf(parg->stream, "]");
+                    r = hvml_stream_putc(parg->stream, ']');
                 } break;
                 default: {
                     A(0, "internal logic error");
@@ -183,6 +207,8 @@ int hvml_jo_value_printf(hvml_jo_value_t *jo, FILE *out) {
     if (!stream) return -1;
 
     int r = hvml_jo_value_serialize(jo, stream);
+    // the last chunk is written here
+    if (hvml_stream_flush(stream)) r = -1;
 
     hvml_stream_destroy(stream);
 
@@ -197,6 +223,7 @@ int hvml_jo_value_serialize_string(hvml_jo_value_t *jo, hvml_string_t *str) {
     if (!parg.stream) return -1;
 
     hvml_jo_value_traverse(jo, &parg, traverse_for_printf);
+    if (hvml_stream_flush(parg.stream)) parg.failed = 1;
 
     hvml_stream_destroy(parg.stream);
 
@@ -0,0 +1,617 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_json_parser.h"
+
+#include "hvml/hvml_log.h"
+#include "hvml/hvml_string.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define HVML_JSON_SSE2      1
+#include <emmintrin.h>
+#endif
+
+// avx2 is chosen at runtime, thus not required at compile time
+#if defined(HVML_JSON_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HVML_JSON_AVX2      1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// two stages, the same as simdjson
+// stage 1 classifies 64 bytes at a time into bitmaps, and turns them into
+// offsets of structural characters: {}[]:, quotes, starts of scalars, and
+// backslashes and \r's within strings, which need more than copying
+// stage 2 walks the offsets, thus whitespaces are never looked at
+// stage 1 runs a batch ahead of stage 2, to keep the offsets in cache
+#define JSON_BLOCK           64
+#define JSON_BATCH           (256 * JSON_BLOCK)
+
+#define C_WS     0x01   // the same as isspace
+#define C_OP     0x02
+#define C_QT     0x04
+#define C_BS     0x08
+#define C_CR     0x10
+
+static const unsigned char json_class[256] = {
+    [' ']  = C_WS,
+    ['\t'] = C_WS,
+    ['\n'] = C_WS,
+    ['\v'] = C_WS,
+    ['\f'] = C_WS,
+    ['\r'] = C_WS | C_CR,
+    ['{']  = C_OP,
+    ['}']  = C_OP,
+    ['[']  = C_OP,
+    [']']  = C_OP,
+    [':']  = C_OP,
+    [',']  = C_OP,
+    ['"']  = C_QT,
+    ['\\'] = C_BS,
+};
+
+#define IS_DELIM(c)  (json_class[(unsigned char)(c)] & (C_WS | C_OP | C_QT))
+
+typedef struct json_block_s            json_block_t;
+struct json_block_s {
+    uint64_t       ws;
+    uint64_t       op;
+    uint64_t       qt;
+    uint64_t       bs;
+    uint64_t       cr;
+};
+
+typedef void (*json_classify_f)(const unsigned char *p, json_block_t *b);
+
+typedef struct json_scanner_s          json_scanner_t;
+struct json_scanner_s {
+    const char        *buf;
+    size_t             len;
+    json_classify_f    classify;
+
+    size_t             scanned;        // bytes indexed so far
+    uint64_t           escaped;        // carries from the previous block
+    uint64_t           in_string;
+    uint64_t           scalar;
+
+    uint32_t          *idx;            // offsets relative to base
+    size_t             base;
+    size_t             n;
+    size_t             cur;
+};
+
+static void classify_scalar(const unsigned char *p, json_block_t *b) {
+    memset(b, 0, sizeof(*b));
+    for (int i=0; i<JSON_BLOCK; ++i) {
+        const unsigned char c   = json_class[p[i]];
+        const uint64_t      bit = (uint64_t)1 << i;
+        if (!c) continue;
+        if (c & C_WS) b->ws |= bit;
+        if (c & C_OP) b->op |= bit;
+        if (c & C_QT) b->qt |= bit;
+        if (c & C_BS) b->bs |= bit;
+        if (c & C_CR) b->cr |= bit;
+    }
+}
+
+#ifdef HVML_JSON_SSE2
+// '[' and '{' differ only in 0x20, so do ']' and '}'
+static void classify_sse2(const unsigned char *p, json_block_t *b) {
+    const __m128i sp    = _mm_set1_epi8(' ');
+    const __m128i ht    = _mm_set1_epi8('\t');
+    const __m128i cr    = _mm_set1_epi8('\r');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i lbr   = _mm_set1_epi8('{');
+    const __m128i rbr   = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i qt    = _mm_set1_epi8('"');
+    const __m128i bs    = _mm_set1_epi8('\\');
+
+    memset(b, 0, sizeof(*b));
+    for (int k=0; k<JSON_BLOCK/16; ++k) {
+        __m128i v  = _mm_loadu_si128((const __m128i*)(p + 16*k));
+        __m128i l  = _mm_or_si128(v, lower);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                                  _mm_cmpeq_epi8(_mm_min_epu8(_mm_max_epu8(v, ht), cr), v));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(l, lbr), _mm_cmpeq_epi8(l, rbr)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        const int s = 16*k;
+        b->ws |= (uint64_t)(unsigned int)_mm_movemask_epi8(ws)                     << s;
+        b->op |= (uint64_t)(unsigned int)_mm_movemask_epi8(op)                     << s;
+        b->qt |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, qt))  << s;
+        b->bs |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, bs))  << s;
+        b->cr |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr))  << s;
+    }
+}
+#endif // HVML_JSON_SSE2
+
+#ifdef HVML_JSON_AVX2
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *p, json_block_t *b) {
+    const __m256i sp    = _mm256_set1_epi8(' ');
+    const __m256i ht    = _mm256_set1_epi8('\t');
+    const __m256i cr    = _mm256_set1_epi8('\r');
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i lbr   = _mm256_set1_epi8('{');
+    const __m256i rbr   = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i qt    = _mm256_set1_epi8('"');
+    const __m256i bs    = _mm256_set1_epi8('\\');
+
+    memset(b, 0, sizeof(*b));
+    for (int k=0; k<JSON_BLOCK/32; ++k) {
+        __m256i v  = _mm256_loadu_si256((const __m256i*)(p + 32*k));
+        __m256i l  = _mm256_or_si256(v, lower);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                     _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_max_epu8(v, ht), cr), v));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(l, lbr), _mm256_cmpeq_epi8(l, rbr)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        const int s = 32*k;
+        b->ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws)                        << s;
+        b->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op)                        << s;
+        b->qt |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, qt))  << s;
+        b->bs |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bs))  << s;
+        b->cr |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cr))  << s;
+    }
+}
+#endif // HVML_JSON_AVX2
+
+static int ctz64(uint64_t v) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#elif defined(_MSC_VER)
+    unsigned long i;
+    if (_BitScanForward(&i, (unsigned long)v)) return (int)i;
+    _BitScanForward(&i, (unsigned long)(v >> 32));
+    return (int)i + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// bit i is set if there're odd quotes in [0, i]
+static uint64_t prefix_xor(uint64_t v) {
+    v ^= v << 1;
+    v ^= v << 2;
+    v ^= v << 4;
+    v ^= v << 8;
+    v ^= v << 16;
+    v ^= v << 32;
+    return v;
+}
+
+// characters escaped by backslashes, odd-length runs of backslashes escape the next one
+// carried into the next block by s->escaped
+static uint64_t json_escaped(json_scanner_t *s, uint64_t bs) {
+    const uint64_t even = 0x5555555555555555ULL;
+
+    bs &= ~s->escaped;
+    uint64_t follows = (bs << 1) | s->escaped;
+    uint64_t starts  = bs & ~even & ~follows;
+    uint64_t seqs    = starts + bs;
+    s->escaped       = seqs < starts ? 1 : 0;
+    return (even ^ (seqs << 1)) & follows;
+}
+
+static void json_scan_block(json_scanner_t *s, const unsigned char *p, size_t off) {
+    json_block_t b;
+    s->classify(p, &b);
+
+    uint64_t escaped   = json_escaped(s, b.bs);
+    uint64_t quotes    = b.qt & ~escaped;
+    uint64_t in_string = prefix_xor(quotes) ^ s->in_string;
+    s->in_string       = (uint64_t)((int64_t)in_string >> 63);
+
+    uint64_t scalar    = ~(b.ws | b.op | quotes);
+    uint64_t follows   = (scalar << 1) | s->scalar;
+    s->scalar          = scalar >> 63;
+
+    // opening quotes are in in_string, closing ones are not
+    uint64_t m = (b.op & ~in_string)
+               | quotes
+               | (scalar & ~follows & ~in_string)
+               | (((b.bs & ~escaped) | b.cr) & in_string);
+
+    uint32_t rel = (uint32_t)(off - s->base);
+    while (m) {
+        s->idx[s->n++] = rel + (uint32_t)ctz64(m);
+        m &= m - 1;
+    }
+}
+
+// next batch of offsets, 0 if there's none
+static size_t json_scan_batch(json_scanner_t *s) {
+    s->base = s->scanned;
+    s->n    = 0;
+    s->cur  = 0;
+    while (s->n==0 && s->scanned < s->len) {
+        size_t end = s->base + JSON_BATCH;
+        if (end > s->len) end = s->len;
+        for (; s->scanned + JSON_BLOCK <= end; s->scanned += JSON_BLOCK) {
+            json_scan_block(s, (const unsigned char*)s->buf + s->scanned, s->scanned);
+        }
+        if (s->scanned < end) {
+            // the tail, padded with spaces
+            unsigned char tail[JSON_BLOCK];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, s->buf + s->scanned, end - s->scanned);
+            json_scan_block(s, tail, s->scanned);
+            s->scanned = end;
+        }
+        if (s->n==0) s->base = s->scanned;
+    }
+    return s->n;
+}
+
+static int json_next(json_scanner_t *s, size_t *pos) {
+    if (s->cur==s->n && json_scan_batch(s)==0) return -1;
+    *pos = s->base + s->idx[s->cur++];
+    return 0;
+}
+
+static json_classify_f json_classifier(HVML_ESCAPE_ISA isa) {
+    if (isa==HVML_ESCAPE_ISA_AUTO) isa = hvml_escape_get_isa();
+    if (!hvml_escape_isa_supported(isa)) return NULL;
+    switch (isa) {
+#ifdef HVML_JSON_AVX2
+        case HVML_ESCAPE_ISA_AVX2: return classify_avx2;
+#endif
+#ifdef HVML_JSON_SSE2
+        case HVML_ESCAPE_ISA_SSE2: return classify_sse2;
+#endif
+        default:                   return classify_scalar;
+    }
+}
+
+typedef struct json_ctx_s              json_ctx_t;
+struct json_ctx_s {
+    json_scanner_t                 s;
+    const hvml_json_parser_conf_t *conf;
+    hvml_string_t                  stack;  // 'o' or 'a' of each open container
+    hvml_string_t                  cache;  // unescaped strings
+};
+
+typedef enum {
+    ST_BEGIN,
+    ST_OBJ_KEY,       // after '{' or ',' within object
+    ST_KEY_DONE,
+    ST_COLON,
+    ST_VAL_DONE,
+    ST_ARRAY_ITEM,    // after '[' or ',' within array
+    ST_ITEM_DONE,
+    ST_END,
+} JSON_STATE;
+
+#define FIRE(cb)           (ctx->conf->cb && ctx->conf->cb(ctx->conf->arg))
+#define FIRE_ARGS(cb, ...) (ctx->conf->cb && ctx->conf->cb(ctx->conf->arg, __VA_ARGS__))
+
+#define IS_HIGH_SURROGATE(v)  ((v)>=0xD800 && (v)<=0xDBFF)
+#define IS_LOW_SURROGATE(v)   ((v)>=0xDC00 && (v)<=0xDFFF)
+
+static int json_hex4(const char *p, uint32_t *v) {
+    uint32_t u = 0;
+    for (int i=0; i<4; ++i) {
+        const char c = p[i];
+        u <<= 4;
+        if      (c>='0' && c<='9') u |= (uint32_t)(c - '0');
+        else if (c>='a' && c<='f') u |= (uint32_t)(c - 'a' + 10);
+        else if (c>='A' && c<='F') u |= (uint32_t)(c - 'A' + 10);
+        else return -1;
+    }
+    *v = u;
+    return 0;
+}
+
+// unescapes [p, end) into ctx->cache, the same as hvml_json_parser does
+// \r and \r\n are taken as \n, and \uXXXX below 0x10000 always takes 3 bytes
+static int json_unescape(json_ctx_t *ctx, const char *p, const char *end) {
+    hvml_string_reset(&ctx->cache);
+    while (p<end) {
+        const char *q = p;
+        while (q<end && *q!='\\' && *q!='\r') ++q;
+        if (q>p && hvml_string_append_n(&ctx->cache, p, q-p)) return -1;
+        if (q==end) break;
+        p = q + 1;
+        if (*q=='\r') {
+            if (p<end && *p=='\n') ++p;
+            if (hvml_string_push(&ctx->cache, '\n')) return -1;
+            continue;
+        }
+        // an unescaped backslash is never the last one before the closing quote
+        char c = 0;
+        switch (*p++) {
+            case '"':  c = '"';  break;
+            case '/':  c = '/';  break;
+            case '\\': c = '\\'; break;
+            case 'b':  c = '\b'; break;
+            case 't':  c = '\t'; break;
+            case 'f':  c = '\f'; break;
+            case 'r':  c = '\r'; break;
+            case 'n':  c = '\n'; break;
+            case 'u':
+            {
+                uint32_t hi = 0, lo = 0;
+                if (end-p < 4 || json_hex4(p, &hi)) return -1;
+                p += 4;
+                char     u8[4];
+                size_t   n = 0;
+                if (IS_HIGH_SURROGATE(hi)) {
+                    if (end-p < 6 || p[0]!='\\' || p[1]!='u' || json_hex4(p+2, &lo)) return -1;
+                    if (!IS_LOW_SURROGATE(lo)) return -1;
+                    p += 6;
+                    uint32_t ucs = 0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00);
+                    u8[n++] = (char)(0xf0 | ((ucs >> 18) & 0x07));
+                    u8[n++] = (char)(0x80 | ((ucs >> 12) & 0x3f));
+                    u8[n++] = (char)(0x80 | ((ucs >> 6) & 0x3f));
+                    u8[n++] = (char)(0x80 | (ucs & 0x3f));
+                } else {
+                    switch (hi) {
+                        case '"': case '/': case '\\': case '\b': case '\f':
+                        case '\t': case '\r': case '\n': case '\0':
+                        {
+                            u8[n++] = (char)hi;
+                        } break;
+                        default:
+                        {
+                            u8[n++] = (char)(0xe0 | (hi >> 12));
+                            u8[n++] = (char)(0x80 | ((hi >> 6) & 0x3f));
+                            u8[n++] = (char)(0x80 | (hi & 0x3f));
+                        } break;
+                    }
+                }
+                if (hvml_string_append_n(&ctx->cache, u8, n)) return -1;
+                continue;
+            } break;
+            default: return -1;
+        }
+        if (hvml_string_push(&ctx->cache, c)) return -1;
+    }
+    return 0;
+}
+
+// q is the opening quote, strings without escapes are passed in place
+static int json_string(json_ctx_t *ctx, size_t q, const char **str, size_t *len) {
+    const char *buf  = ctx->s.buf;
+    int         slow = 0;
+    size_t      pos  = 0;
+    for (;;) {
+        if (json_next(&ctx->s, &pos)) return -1;
+        if (buf[pos]=='"') break;
+        slow = 1;
+    }
+    if (!slow) {
+        *str = buf + q + 1;
+        *len = pos - q - 1;
+        return 0;
+    }
+    if (json_unescape(ctx, buf + q + 1, buf + pos)) return -1;
+    *str = hvml_string_str(&ctx->cache);
+    *len = hvml_string_len(&ctx->cache);
+    return 0;
+}
+
+static int json_is_digit(const char *p, const char *end) {
+    return p<end && *p>='0' && *p<='9';
+}
+
+// the same syntax as the states of hvml_json_parser
+// a number is taken as a whole only if a delimiter follows, even at the end
+static int json_number(json_ctx_t *ctx, size_t pos, hvml_json_number_t *num) {
+    const char *s   = ctx->s.buf + pos;
+    const char *end = ctx->s.buf + ctx->s.len;
+    const char *p   = s;
+
+    if (*p=='+' || *p=='-') ++p;
+    if (!json_is_digit(p, end)) return -1;
+    if (*p++ != '0') {
+        while (json_is_digit(p, end)) ++p;
+    }
+    if (p<end && *p=='.') {
+        ++p;
+        while (json_is_digit(p, end)) ++p;
+    }
+    if (p<end && (*p=='e' || *p=='E')) {
+        ++p;
+        if (p<end && (*p=='+' || *p=='-')) ++p;
+        else if (!json_is_digit(p, end)) return -1;
+        while (json_is_digit(p, end)) ++p;
+    }
+    if (p==end || !IS_DELIM(*p)) return -1;
+    if (p[-1]=='+' || p[-1]=='-') return -1;
+
+    if (hvml_json_number_parse(s, p-s, num)) return -1;
+    num->origin = s;
+    return 0;
+}
+
+static int json_literal(json_ctx_t *ctx, size_t pos, const char *lit, size_t n) {
+    if (ctx->s.len - pos < n || memcmp(ctx->s.buf + pos, lit, n)) return -1;
+    if (pos + n < ctx->s.len && !IS_DELIM(ctx->s.buf[pos + n])) return -1;
+    return 0;
+}
+
+static JSON_STATE json_after_value(json_ctx_t *ctx) {
+    size_t depth = hvml_string_len(&ctx->stack);
+    if (depth==0) return ST_END;
+    return hvml_string_str(&ctx->stack)[depth-1]=='o' ? ST_VAL_DONE : ST_ITEM_DONE;
+}
+
+// a value starts at pos, -1 on failure
+static int json_value(json_ctx_t *ctx, size_t pos) {
+    const char c = ctx->s.buf[pos];
+    switch (c) {
+        case '{':
+        {
+            if (hvml_string_push(&ctx->stack, 'o')) return -1;
+            if (FIRE(on_open_obj)) return -1;
+            return ST_OBJ_KEY;
+        } break;
+        case '[':
+        {
+            if (hvml_string_push(&ctx->stack, 'a')) return -1;
+            if (FIRE(on_open_array)) return -1;
+            return ST_ARRAY_ITEM;
+        } break;
+        case '"':
+        {
+            const char *str = NULL;
+            size_t      len = 0;
+            if (json_string(ctx, pos, &str, &len)) return -1;
+            if (FIRE_ARGS(on_string, str, len)) return -1;
+        } break;
+        case 't':
+        {
+            if (json_literal(ctx, pos, "true", 4)) return -1;
+            if (FIRE(on_true)) return -1;
+        } break;
+        case 'f':
+        {
+            if (json_literal(ctx, pos, "false", 5)) return -1;
+            if (FIRE(on_false)) return -1;
+        } break;
+        case 'n':
+        {
+            if (json_literal(ctx, pos, "null", 4)) return -1;
+            if (FIRE(on_null)) return -1;
+        } break;
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case '+': // not in json standard
+        case '-':
+        {
+            hvml_json_number_t num;
+            if (json_number(ctx, pos, &num)) return -1;
+            if (FIRE_ARGS(on_number, &num)) return -1;
+        } break;
+        default: return -1;
+    }
+    return json_after_value(ctx);
+}
+
+// the container on top is closed by c, -1 on failure
+static int json_close(json_ctx_t *ctx, const char c) {
+    if (c=='}') {
+        if (FIRE(on_close_obj)) return -1;
+    } else {
+        if (FIRE(on_close_array)) return -1;
+    }
+    hvml_string_pop(&ctx->stack, NULL);
+    return json_after_value(ctx);
+}
+
+static int json_parse(json_ctx_t *ctx) {
+    int    state = ST_BEGIN;
+    size_t pos   = 0;
+    while (state>=0 && json_next(&ctx->s, &pos)==0) {
+        const char c = ctx->s.buf[pos];
+        switch (state) {
+            case ST_BEGIN:
+            {
+                if (FIRE(on_begin)) return -1;
+                state = json_value(ctx, pos);
+            } break;
+            case ST_OBJ_KEY:
+            {
+                if (c==',') break;
+                if (c=='}') {
+                    state = json_close(ctx, c);
+                    break;
+                }
+                const char *key = NULL;
+                size_t      len = 0;
+                if (c!='"' || json_string(ctx, pos, &key, &len)) return -1;
+                if (FIRE_ARGS(on_key, key, len)) return -1;
+                state = ST_KEY_DONE;
+            } break;
+            case ST_KEY_DONE:
+            {
+                if (c!=':') return -1;
+                state = ST_COLON;
+            } break;
+            case ST_COLON:
+            {
+                state = json_value(ctx, pos);
+            } break;
+            case ST_VAL_DONE:
+            {
+                if (c!=',' && c!='}') return -1;
+                if (FIRE(on_val_done)) return -1;
+                state = c==',' ? ST_OBJ_KEY : json_close(ctx, c);
+            } break;
+            case ST_ARRAY_ITEM:
+            {
+                if (c==',') break;
+                state = c==']' ? json_close(ctx, c) : json_value(ctx, pos);
+            } break;
+            case ST_ITEM_DONE:
+            {
+                if (c!=',' && c!=']') return -1;
+                if (FIRE(on_item_done)) return -1;
+                state = c==',' ? ST_ARRAY_ITEM : json_close(ctx, c);
+            } break;
+            case ST_END:
+            {
+                if (c!=',') return -1;
+            } break;
+            default:
+            {
+                A(0, "internal logic error");
+            } break;
+        }
+    }
+    return (state==ST_END || state==ST_BEGIN) ? 0 : -1;
+}
+
+int hvml_json_parse_buffer_isa(HVML_ESCAPE_ISA isa, const hvml_json_parser_conf_t *conf,
+                               const char *buf, size_t len)
+{
+    json_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.conf       = conf;
+    ctx.s.buf      = buf;
+    ctx.s.len      = len;
+    ctx.s.classify = json_classifier(isa);
+    if (!ctx.s.classify) return -1;
+
+    // no more offsets than bytes
+    size_t cap = (len < JSON_BATCH ? len : JSON_BATCH) + JSON_BLOCK;
+    ctx.s.idx = (uint32_t*)malloc(cap * sizeof(*ctx.s.idx));
+    if (!ctx.s.idx) return -1;
+
+    int ret = json_parse(&ctx);
+
+    free(ctx.s.idx);
+    hvml_string_clear(&ctx.stack);
+    hvml_string_clear(&ctx.cache);
+
+    return ret;
+}
+
+int hvml_json_parse_buffer(const hvml_json_parser_conf_t *conf, const char *buf, size_t len) {
+    return hvml_json_parse_buffer_isa(HVML_ESCAPE_ISA_AUTO, conf, buf, len);
+}
@@ -17,10 +17,12 @@
 
 #include "hvml/hvml_json_parser.h"
 
+#include "hvml/hvml_escape.h"
 #include "hvml/hvml_log.h"
 #include "hvml/hvml_string.h"
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 // unicode support, specifically utf-16be
@@ -64,6 +66,7 @@ struct hvml_json_parser_s {
     hvml_json_parser_conf_t        conf;
     HVML_JSON_PARSER_STATE        *ar_states;
     size_t                         states;
+    size_t                         states_cap; // doubles, and kept across reset
     hvml_string_t                  cache;
     hvml_string_t                  curr;
 
@@ -100,16 +103,16 @@ do {
         ret = -1;                                                                             \
         break;                                                                                \
     }                                                                                         \
-    const char *s = hvml_string_str(&parser->cache);                                          \
-    long double d = 0;                                                                        \
-    ret = hvml_string_to_number(s, &d);                                                       \
+    hvml_json_number_t num;                                                                   \
+    ret = hvml_json_number_parse(parser->cache.str, parser->cache.len, &num);                 \
     if (ret) {                                                                                \
         EPARSE();                                                                             \
         ret = -1;                                                                             \
         break;                                                                                \
     }                                                                                         \
+    num.origin = hvml_string_str(&parser->cache);                                             \
     if (parser->conf.on_number) {                                                             \
-        ret = parser->conf.on_number(parser->conf.arg, s, d);                                 \
+        ret = parser->conf.on_number(parser->conf.arg, &num);                                 \
     }                                                                                         \
     hvml_string_reset(&parser->cache);                                                        \
 } while (0)
@@ -134,12 +137,17 @@ void hvml_json_parser_destroy(hvml_json_parser_t *parser) {
 }
 
 void hvml_json_parser_reset(hvml_json_parser_t *parser) {
-    hvml_string_clear(&parser->cache);
-    hvml_string_clear(&parser->curr);
+    // keep the buffers for reuse
+    hvml_string_reset(&parser->cache);
+    hvml_string_reset(&parser->curr);
     parser->states = 0;
     hvml_json_parser_push_state(parser, MKSTATE(BEGIN));
     parser->line   = 0;
     parser->col    = 0;
+    parser->shi    = 0;
+    parser->slo    = 0;
+    parser->shi_   = 0;
+    parser->cr     = 0;
 }
 
 static int hvml_json_parser_at_begin(hvml_json_parser_t *parser, const char c, const char *str_state) {
@@ -1305,64 +1313,189 @@ void hvml_json_parser_set_offset(hvml_json_parser_t *parser, size_t line, size_t
     parser->conf.offset_col  = col;
 }
 
-void hvml_json_str_printf(FILE *out, const char *s, size_t len) {
+// up to 19 significant digits are taken into mantissa, which always fits in uint64
+#define NUMBER_DIGITS        19
+// exponents beyond are out of range of double anyway
+#define NUMBER_EXP_MAX       100000
+
+// powers of 10 exactly representable by double
+static const double number_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// correctly rounded, for those out of the fast path
+static int number_strtod(const char *s, size_t len, double *d) {
+    char  buf[64];
+    char *p = len < sizeof(buf) ? buf : (char*)malloc(len + 1);
+    if (!p) return -1;
+    memcpy(p, s, len);
+    p[len] = '\0';
+
+    char *end = NULL;
+    *d = strtod(p, &end);
+    int r = (end == p + len) ? 0 : -1;
+
+    if (p != buf) free(p);
+
+    return r;
+}
+
+int hvml_json_number_parse(const char *s, size_t len, hvml_json_number_t *num) {
+    const char *p   = s;
+    const char *end = s + len;
+
+    int neg = 0;
+    if (p<end && (*p=='+' || *p=='-')) {
+        neg = (*p=='-');
+        ++p;
+    }
+
+    uint64_t mant   = 0;
+    int      digits = 0;      // in mant, leading 0's excluded
+    int64_t  exp10  = 0;      // value = mant * 10^exp10
+    int      trunc  = 0;      // non-zero digits dropped from mant
+    int      real   = 0;      // with fraction or exponent
+
+    const char *start = p;
+    for (; p<end && *p>='0' && *p<='9'; ++p) {
+        if (digits < NUMBER_DIGITS) {
+            mant = mant * 10 + (uint64_t)(*p - '0');
+            if (mant) ++digits;
+        } else {
+            if (*p != '0') trunc = 1;
+            ++exp10;
+        }
+    }
+    if (p==start) return -1;
+
+    if (p<end && *p=='.') {
+        real = 1;
+        for (++p; p<end && *p>='0' && *p<='9'; ++p) {
+            if (digits < NUMBER_DIGITS) {
+                mant = mant * 10 + (uint64_t)(*p - '0');
+                if (mant) ++digits;
+                --exp10;
+            } else if (*p != '0') {
+                trunc = 1;
+            }
+        }
+    }
+
+    if (p<end && (*p=='e' || *p=='E')) {
+        real = 1;
+        ++p;
+        int eneg = 0;
+        if (p<end && (*p=='+' || *p=='-')) {
+            eneg = (*p=='-');
+            ++p;
+        }
+        int64_t e = 0;
+        start = p;
+        for (; p<end && *p>='0' && *p<='9'; ++p) {
+            if (e < NUMBER_EXP_MAX) e = e * 10 + (*p - '0');
+        }
+        if (p==start) return -1;
+        exp10 += eneg ? -e : e;
+    }
+    if (p!=end) return -1;
+
+    num->integer = 0;
+    num->i       = 0;
+    num->d       = 0;
+    num->origin  = NULL;
+    num->len     = len;
+
+    if (!real && !trunc && exp10==0) {
+        // -0 is left to double, which keeps the sign
+        if (!neg && mant <= (uint64_t)INT64_MAX) {
+            num->integer = 1;
+            num->i       = (int64_t)mant;
+            num->d       = (double)mant;
+            return 0;
+        }
+        if (neg && mant && mant - 1 <= (uint64_t)INT64_MAX) {
+            num->integer = 1;
+            num->i       = -(int64_t)(mant - 1) - 1;
+            num->d       = (double)num->i;
+            return 0;
+        }
+    }
+
+    // exact if both mant and 10^exp10 are exactly representable
+    double d = 0;
+    if (mant == 0) {
+        d = 0;
+    } else if (!trunc && mant <= ((uint64_t)1 << 53) && exp10 >= -22 && exp10 <= 22) {
+        d = (double)mant;
+        if (exp10 < 0) d /= number_pow10[-exp10];
+        else           d *= number_pow10[exp10];
+    } else {
+        if (number_strtod(s, len, &d)) return -1;
+        num->d = d;
+        return 0;
+    }
+    num->d = neg ? -d : d;
+
+    return 0;
+}
+
+int hvml_json_str_printf(FILE *out, const char *s, size_t len) {
     hvml_stream_t *stream= hvml_stream_bind_file(out, 0);
-    if (!stream) return;
-    hvml_json_str_serialize(stream, s, len);
+    if (!stream) return -1;
+    int r = hvml_json_str_serialize(stream, s, len);
+    if (hvml_stream_flush(stream)) r = -1;
     hvml_stream_destroy(stream);
+    return r;
+}
+
+static const char* json_str_escape(const char c) {
+    switch (c) {
+        case '"':  return "\\\"";
+        case '\\': return "\\\\";
+        case '\b': return "\\b";
+        case '\t': return "\\t";
+        case '\f': return "\\f";
+        case '\r': return "\\r";
+        case '\n': return "\\n";
+        case '\0': return "\\u0000";
+        default:   return NULL;
+    }
 }
 
 int hvml_json_str_serialize(hvml_stream_t *stream, const char *s, size_t len) {
-    int r = 0;
-    r = hvml_stream_printf(stream, "\"");
-    if (r<0) return -1;
-    const char *p = s;
-    for (size_t i=0; i<len; ++i, ++p) {
-        const char c = *p;
-        switch (c) {
-            case '"': {
-                r = hvml_stream_printf(stream, "\\\"");
-            } break;
-            case '\\': {
-                r = hvml_stream_printf(stream, "\\\\");
-            } break;
-            case '\b': {
-                r = hvml_stream_printf(stream, "\\b");
-            } break;
-            case '\t': {
-                r = hvml_stream_printf(stream, "\\t");
-            } break;
-            case '\f': {
-                r = hvml_stream_printf(stream, "\\f");
-            } break;
-            case '\r': {
-                r = hvml_stream_printf(stream, "\\r");
-            } break;
-            case '\n': {
-                r = hvml_stream_printf(stream, "\\n");
-            } break;
-            case '\0': {
-                r = hvml_stream_printf(stream, "\\u0000");
-            } break;
-            default: {
-                r = hvml_stream_printf(stream, "%c", c);
-            } break;
-        }
+    if (hvml_stream_putc(stream, '"')) return -1;
+
+    // unescaped runs are located by hvml_escape_scan and copied in one go
+    const char *p   = s;
+    const char *end = s + len;
+    while (p < end) {
+        size_t n = hvml_escape_scan(HVML_ESCAPE_JSON, p, end - p);
+        if (hvml_stream_write(stream, p, n)) return -1;
+        p += n;
+        if (p == end) break;
+        const char *esc = json_str_escape(*p);
+        A(esc, "internal logic error");
+        if (hvml_stream_puts(stream, esc)) return -1;
+        ++p;
     }
-    if (r<0) return -1;
-    r = hvml_stream_printf(stream, "\"");
-    return r<0 ? -1 : 0;
+
+    return hvml_stream_putc(stream, '"') ? -1 : 0;
 }
 
 
 
 static int hvml_json_parser_push_state(hvml_json_parser_t *parser, HVML_JSON_PARSER_STATE state) {
-    HVML_JSON_PARSER_STATE *st = (HVML_JSON_PARSER_STATE*)realloc(parser->ar_states, (parser->states + 1) * sizeof(*st));
-    if (!st) return -1;
+    if (parser->states == parser->states_cap) {
+        size_t cap = parser->states_cap ? parser->states_cap * 2 : 16;
+        HVML_JSON_PARSER_STATE *st = (HVML_JSON_PARSER_STATE*)realloc(parser->ar_states, cap * sizeof(*st));
+        if (!st) return -1;
+        parser->ar_states  = st;
+        parser->states_cap = cap;
+    }
 
-    st[parser->states] = state;
-    parser->states    += 1;
-    parser->ar_states  = st;
+    parser->ar_states[parser->states] = state;
+    parser->states                   += 1;
 
     return 0;
 }
@@ -90,8 +90,10 @@ typedef struct string_s                             string_t;
 struct string_s {
     char                  *str;
     size_t                 len;
+    size_t                 cap;
 };
 static int         string_append(string_t *str, const char c);
+static int         string_append_n(string_t *str, const char *s, size_t n);
 static void        string_reset(string_t *str);
 static void        string_clear(string_t *str);
 static const char* string_get(string_t *str); // if not initialized, return null string rather than null pointer
@@ -100,18 +102,29 @@ struct hvml_parser_s {
     hvml_parser_conf_t             conf;
     HVML_PARSER_STATE             *ar_states;
     size_t                         states;
+    size_t                         states_cap;
     string_t                       cache;
     size_t                         escape;
 
     string_t                       curr;
 
-    char                         **ar_tags;
+    // where cache was copied from, if it's a verbatim copy of the buffer being parsed
+    // see hvml_parser_token_span
+    const char                    *span;
+    size_t                         span_len;
+
+    // names of open tags are kept back to back in tag_names, null-terminated
+    // and ar_tags holds where each one starts
+    size_t                        *ar_tags;
     size_t                         tags;
+    size_t                         tags_cap;
+    string_t                       tag_names;
 
     unsigned int                   declared:2; // 0:undefined;1:defining;2:defined;3:notexist
     unsigned int                   commenting:1;
     unsigned int                   rooted:1;
     unsigned int                   cr:1;       // if CR cached
+    unsigned int                   span_live:1;
 
     size_t                         line;
     size_t                         col;
@@ -125,9 +138,10 @@ static HVML_PARSER_STATE hvml_parser_pop_state(hvml_parser_t *parser);
 static HVML_PARSER_STATE hvml_parser_peek_state(hvml_parser_t *parser);
 static HVML_PARSER_STATE hvml_parser_chg_state(hvml_parser_t *parser, HVML_PARSER_STATE state);
 
-static int         hvml_parser_push_tag(hvml_parser_t *parser, const char *tag);
+static int         hvml_parser_push_tag(hvml_parser_t *parser, const char *tag, size_t len);
 static void        hvml_parser_pop_tag(hvml_parser_t *parser);
 static const char* hvml_parser_peek_tag(hvml_parser_t *parser);
+static int         hvml_parser_is_json_tag(hvml_parser_t *parser);
 
 static int on_begin(void *arg);
 static int on_open_array(void *arg);
@@ -139,7 +153,7 @@ static int on_true(void *arg);
 static int on_false(void *arg);
 static int on_null(void *arg);
 static int on_string(void *arg, const char *val, size_t len);
-static int on_number(void *arg, const char *origin, long double val);
+static int on_number(void *arg, const hvml_json_number_t *num);
 static int on_end(void *arg);
 
 hvml_parser_t* hvml_parser_create(hvml_parser_conf_t conf) {
@@ -186,9 +200,7 @@ void hvml_parser_destroy(hvml_parser_t *parser) {
 
     string_clear(&parser->cache);
     string_clear(&parser->curr);
-    for (size_t i=0; i<parser->tags; ++i) {
-        free(parser->ar_tags[i]);
-    }
+    string_clear(&parser->tag_names);
     free(parser->ar_tags);   parser->ar_tags   = NULL;
     free(parser->ar_states); parser->ar_states = NULL;
     hvml_json_parser_destroy(parser->jp); parser->jp = NULL;
@@ -197,6 +209,29 @@ void hvml_parser_destroy(hvml_parser_t *parser) {
     free(parser);
 }
 
+void hvml_parser_reset(hvml_parser_t *parser) {
+    string_reset(&parser->cache);
+    string_reset(&parser->curr);
+    string_reset(&parser->tag_names);
+    parser->escape     = 0;
+    parser->span       = NULL;
+    parser->span_len   = 0;
+    parser->span_live  = 0;
+    parser->tags       = 0;
+    parser->states     = 0;
+    hvml_parser_push_state(parser, HVML_PARSER_STATE_BEGIN);
+
+    parser->declared   = 0;
+    parser->commenting = 0;
+    parser->rooted     = 0;
+    parser->cr         = 0;
+    parser->line       = 0;
+    parser->col        = 0;
+
+    hvml_json_parser_reset(parser->jp);
+    hvml_utf8_decoder_reset(parser->decoder);
+}
+
 static int hvml_parser_at_begin(hvml_parser_t *parser, const char c, const char *str_state) {
     if (isspace(c)) return 0;
     switch (c) {
@@ -362,7 +397,7 @@ static int hvml_parser_at_stag(hvml_parser_t *parser, const char c, const char *
         if (parser->conf.on_open_tag) {
             ret = parser->conf.on_open_tag(parser->conf.arg, string_get(&parser->cache));
         }
-        hvml_parser_push_tag(parser, string_get(&parser->cache));
+        hvml_parser_push_tag(parser, string_get(&parser->cache), parser->cache.len);
         string_reset(&parser->cache);
         if (ret) return ret;
     }
@@ -659,8 +694,7 @@ static int hvml_parser_at_escape(hvml_parser_t *parser, const char c, const char
 }
 
 static int hvml_parser_at_element(hvml_parser_t *parser, const char c, const char *str_state) {
-    const char* tag = hvml_parser_peek_tag(parser);
-    const int parse_json = (strcmp(tag,"init")==0) || (strcmp(tag, "archedata")==0);
+    const int parse_json = hvml_parser_is_json_tag(parser);
     if (parse_json) {
         int ret = hvml_json_parser_parse_char(parser->jp, c);
         if (ret==0) return 0;
@@ -983,21 +1017,154 @@ int hvml_parser_parse_char(hvml_parser_t *parser, const char c) {
     return ret;
 }
 
+// bulk-scanning fast path
+// in text and attribute-value states, most bytes are just appended to cache
+// thus we scan for the next delimiter and consume the whole run at once
+// runs are taken only from utf8 already validated, non-ascii bytes included
+// anything else, eg.: CR/escape/markup, falls back to the per-char path
+#define RUN_STOP_TEXT     0x01
+#define RUN_STOP_STR      0x02
+#define RUN_STOP_STR1     0x04
+#define RUN_STOP_ALL      (RUN_STOP_TEXT | RUN_STOP_STR | RUN_STOP_STR1)
+
+static const unsigned char run_stops[0x80] = {
+    ['\n']   = RUN_STOP_ALL,
+    ['\r']   = RUN_STOP_ALL,
+    ['"']    = RUN_STOP_STR,
+    ['&']    = RUN_STOP_ALL,
+    ['\'']   = RUN_STOP_STR1,
+    ['<']    = RUN_STOP_ALL,
+};
+
+static size_t scan_run(const char *buf, size_t len, const unsigned char stops) {
+    size_t i = 0;
+    for (; i<len; ++i) {
+        const unsigned char uc = (const unsigned char)buf[i];
+        if (uc < 0x80 && (run_stops[uc] & stops)) break;
+    }
+    return i;
+}
+
+// cache keeps its span as long as runs are appended back to back
+static void span_track(hvml_parser_t *parser, const char *p, size_t n) {
+    if (parser->cache.len==0) {
+        parser->span     = p;
+        parser->span_len = n;
+        return;
+    }
+    if (parser->span && parser->span + parser->span_len == p && parser->span_len == parser->cache.len) {
+        parser->span_len += n;
+        return;
+    }
+    parser->span = NULL;
+}
+
+static int hvml_parser_parse_run(hvml_parser_t *parser, const char *buf, size_t len, size_t *consumed) {
+    *consumed = 0;
+    if (parser->cr) return 0;
+    if (!hvml_utf8_decoder_ready(parser->decoder)) return 0;
+
+    unsigned char stops = 0;
+    switch (hvml_parser_peek_state(parser)) {
+        case MKSTATE(ELEMENT):
+        {
+            if (hvml_parser_is_json_tag(parser)) return 0;
+            stops = RUN_STOP_TEXT;
+        } break;
+        case MKSTATE(STR):
+        {
+            stops = RUN_STOP_STR;
+        } break;
+        case MKSTATE(STR1):
+        {
+            stops = RUN_STOP_STR1;
+        } break;
+        default:
+        {
+            return 0;
+        } break;
+    }
+
+    size_t i = 0;
+    while (i<len) {
+        size_t n = scan_run(buf + i, len - i, stops);
+        if (n>0) {
+            span_track(parser, buf + i, n);
+            if (string_append_n(&parser->cache, buf + i, n)) return -1;
+            if (string_append_n(&parser->curr, buf + i, n)) return -1;
+            parser->col += n;
+            i           += n;
+        }
+        if (i>=len || buf[i]!='\n') break;
+        // LF is kept in text/attribute-value, the same as the per-char path
+        span_track(parser, buf + i, 1);
+        if (string_append(&parser->cache, '\n')) return -1;
+        string_reset(&parser->curr);
+        ++parser->line;
+        parser->col = 0;
+        ++i;
+    }
+
+    *consumed = i;
+    return 0;
+}
+
 int hvml_parser_parse(hvml_parser_t *parser, const char *buf, size_t len) {
-    for (size_t i=0; i<len; ++i) {
+    // spans never cross calls
+    parser->span = NULL;
+
+    size_t i = 0;
+    // finish the utf8 sequence left over by the previous call
+    while (i<len && !hvml_utf8_decoder_ready(parser->decoder)) {
+        int ret = hvml_parser_parse_char(parser, buf[i]);
+        if (ret) return ret;
+        ++i;
+    }
+
+    // validated in bulk, thus what's valid skips the decoder
+    size_t valid = len;
+    size_t off   = 0;
+    if (hvml_utf8_validate(buf + i, len - i, &off)) valid = i + off;
+
+    while (i<valid) {
+        size_t n = 0;
+        if (hvml_parser_parse_run(parser, buf + i, valid - i, &n)) return -1; // out of memory
+        i += n;
+        if (i>=valid) break;
+        // the span is valid in callbacks fired by the very next char
+        // only if no other char has gone into cache since
+        parser->span_live = parser->span &&
+                            parser->span + parser->span_len == buf + i &&
+                            parser->span_len == parser->cache.len;
+        int ret = hvml_parser_parse_char_(parser, buf[i]);
+        parser->span_live = 0;
+        if (ret) return ret;
+        ++i;
+    }
+
+    // a truncated sequence is cached by the decoder, and an ill-formed one
+    // is reported by it
+    for (; i<len; ++i) {
         int ret = hvml_parser_parse_char(parser, buf[i]);
         if (ret) return ret;
     }
     return 0;
 }
 
+int hvml_parser_token_span(hvml_parser_t *parser, const char **span, size_t *len) {
+    if (!parser->span_live) return 0;
+    *span = parser->span;
+    *len  = parser->span_len;
+    return 1;
+}
+
 int hvml_parser_parse_string(hvml_parser_t *parser, const char *str) {
     return hvml_parser_parse(parser, (const char *)str, strlen(str));
 }
 
 int hvml_parser_parse_end(hvml_parser_t *parser) {
     if (parser->tags != 0) {
-        E("open tag [%s] not closed", parser->ar_tags[parser->tags - 1]);
+        E("open tag [%s] not closed", hvml_parser_peek_tag(parser));
         return -1;
     }
     if (parser->states != 1) {
@@ -1016,15 +1183,31 @@ int hvml_parser_parse_end(hvml_parser_t *parser) {
 
 
 
-static int string_append(string_t *str, const char c) {
+static int string_grow(string_t *str, size_t len) {
     // one extra null-terminator
-    // actually, won't realloc new mem everytime
-    char *s = (char*)realloc(str->str, (str->len + 2) * sizeof(*s));
+    if (len < str->cap) return 0;
+    size_t cap = str->cap ? str->cap : 64;
+    while (cap <= len) cap *= 2;
+    char *s = (char*)realloc(str->str, cap * sizeof(*s));
     if (!s) return -1;
-    s[str->len]   = c;
-    s[str->len+1] = '\0';
     str->str      = s;
-    str->len     += 1;
+    str->cap      = cap;
+    return 0;
+}
+
+static int string_append(string_t *str, const char c) {
+    if (string_grow(str, str->len + 1)) return -1;
+    str->str[str->len]   = c;
+    str->str[str->len+1] = '\0';
+    str->len            += 1;
+    return 0;
+}
+
+static int string_append_n(string_t *str, const char *s, size_t n) {
+    if (string_grow(str, str->len + n)) return -1;
+    memcpy(str->str + str->len, s, n);
+    str->str[str->len + n] = '\0';
+    str->len              += n;
     return 0;
 }
 
@@ -1038,6 +1221,7 @@ static void string_clear(string_t *str) {
     free(str->str);
     str->str = NULL;
     str->len = 0;
+    str->cap = 0;
 }
 
 static const char* string_get(string_t *str) {
@@ -1046,12 +1230,16 @@ static const char* string_get(string_t *str) {
 }
 
 static int hvml_parser_push_state(hvml_parser_t *parser, HVML_PARSER_STATE state) {
-    HVML_PARSER_STATE *st = (HVML_PARSER_STATE*)realloc(parser->ar_states, (parser->states + 1) * sizeof(*st));
-    if (!st) return -1;
+    if (parser->states == parser->states_cap) {
+        size_t cap = parser->states_cap ? parser->states_cap * 2 : 16;
+        HVML_PARSER_STATE *st = (HVML_PARSER_STATE*)realloc(parser->ar_states, cap * sizeof(*st));
+        if (!st) return -1;
+        parser->ar_states  = st;
+        parser->states_cap = cap;
+    }
 
-    st[parser->states] = state;
-    parser->states    += 1;
-    parser->ar_states  = st;
+    parser->ar_states[parser->states] = state;
+    parser->states                   += 1;
 
     return 0;
 }
@@ -1083,18 +1271,25 @@ static HVML_PARSER_STATE hvml_parser_chg_state(hvml_parser_t *parser, HVML_PARSE
 }
 
 
-static int hvml_parser_push_tag(hvml_parser_t *parser, const char *tag) {
-    char *s   = strdup(tag);
-    if (!s)  return -1;
-    char **ar = (char**)realloc(parser->ar_tags, (parser->tags + 1) * sizeof(*ar));
-    if (!ar) {
-        free(s);
+static int hvml_parser_push_tag(hvml_parser_t *parser, const char *tag, size_t len) {
+    if (parser->tags == parser->tags_cap) {
+        size_t cap = parser->tags_cap ? parser->tags_cap * 2 : 16;
+        size_t *ar = (size_t*)realloc(parser->ar_tags, cap * sizeof(*ar));
+        if (!ar) return -1;
+        parser->ar_tags  = ar;
+        parser->tags_cap = cap;
+    }
+
+    size_t offset = parser->tag_names.len;
+    if (string_append_n(&parser->tag_names, tag, len) ||
+        string_append(&parser->tag_names, '\0'))
+    {
+        parser->tag_names.len = offset;
         return -1;
     }
 
-    ar[parser->tags] = s;
-    parser->tags    += 1;
-    parser->ar_tags  = ar;
+    parser->ar_tags[parser->tags] = offset;
+    parser->tags                 += 1;
 
     return 0;
 }
@@ -1102,17 +1297,22 @@ static int hvml_parser_push_tag(hvml_parser_t *parser, const char *tag) {
 static void hvml_parser_pop_tag(hvml_parser_t *parser) {
     A(parser->tags>0, "parser's internal ar_tags stack not initialized or underflowed");
 
-    char *tag      = parser->ar_tags[parser->tags - 1];
-    parser->tags  -= 1;
-    free(tag);
+    parser->tags                                 -= 1;
+    parser->tag_names.len                         = parser->ar_tags[parser->tags];
+    parser->tag_names.str[parser->tag_names.len]  = '\0';
 }
 
+// valid till the next push
 static const char* hvml_parser_peek_tag(hvml_parser_t *parser) {
     A(parser->tags>0, "parser's internal ar_tags stack not initialized or underflowed");
 
-    char *tag      = parser->ar_tags[parser->tags - 1];
+    return parser->tag_names.str + parser->ar_tags[parser->tags - 1];
+}
+
+static int hvml_parser_is_json_tag(hvml_parser_t *parser) {
+    const char *tag = hvml_parser_peek_tag(parser);
 
-    return tag;
+    return (strcmp(tag, "init")==0) || (strcmp(tag, "archedata")==0);
 }
 
 // json callbacks
@@ -1206,11 +1406,11 @@ static int on_string(void *arg, const char *val, size_t len) {
     return ret;
 }
 
-static int on_number(void *arg, const char *origin, long double val) {
+static int on_number(void *arg, const hvml_json_number_t *num) {
     hvml_parser_t *parser = (hvml_parser_t*)arg;
     int ret = 0;
     if (parser->conf.on_number) {
-        ret = parser->conf.on_number(parser->conf.arg, origin, val);
+        ret = parser->conf.on_number(parser->conf.arg, num);
     }
     return ret;
 }
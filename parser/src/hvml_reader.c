@@ -0,0 +1,350 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_reader.h"
+
+#include "hvml_file_map.h"
+
+#include "hvml/hvml_log.h"
+#include "hvml/hvml_parser.h"
+#include "hvml/hvml_string.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the parser is fed by chunks, and the events fired are queued
+// thus the queue is bounded by the size of a chunk
+// a token split across chunks is copied, since spans never cross calls
+#define READER_CHUNK             (16 * 1024)
+
+typedef struct reader_ev_s                 reader_ev_t;
+struct reader_ev_s {
+    HVML_READER_EVENT          type;
+    const char                *view;      // into the input, or null if copied
+    size_t                     off;       // into scratch, if copied
+    size_t                     len;
+    hvml_json_number_t         num;
+};
+
+struct hvml_reader_s {
+    hvml_parser_t             *parser;
+
+    const char                *buf;
+    size_t                     len;
+    size_t                     pos;
+    hvml_file_map_t            map;
+
+    reader_ev_t               *evs;
+    size_t                     nevs;
+    size_t                     evs_cap;
+    size_t                     head;       // the next one to deliver
+    // copies of the strings that queued events refer to
+    hvml_string_t              scratch;
+
+    // names of open tags, back to back, for HVML_READER_CLOSE_TAG
+    hvml_string_t              tag_names;
+    size_t                    *tags;
+    size_t                     ntags;
+    size_t                     tags_cap;
+    size_t                     depth;      // as of what's delivered
+
+    unsigned int               mapped:1;
+    unsigned int               ended:1;
+    unsigned int               failed:1;
+};
+
+static const char *event_names[] = {
+    "OPEN_TAG",
+    "ATTR_KEY",
+    "ATTR_VAL",
+    "CLOSE_TAG",
+    "TEXT",
+    "JSON_BEGIN",
+    "OPEN_ARRAY",
+    "CLOSE_ARRAY",
+    "OPEN_OBJ",
+    "CLOSE_OBJ",
+    "KEY",
+    "TRUE",
+    "FALSE",
+    "NULL",
+    "STRING",
+    "NUMBER",
+    "JSON_END",
+};
+
+const char* hvml_reader_event_str(HVML_READER_EVENT type) {
+    if ((size_t)type >= sizeof(event_names)/sizeof(event_names[0])) return "UNKNOWN";
+    return event_names[type];
+}
+
+static reader_ev_t* reader_queue(hvml_reader_t *reader, HVML_READER_EVENT type) {
+    if (reader->nevs == reader->evs_cap) {
+        size_t cap = reader->evs_cap ? reader->evs_cap * 2 : 64;
+        reader_ev_t *evs = (reader_ev_t*)realloc(reader->evs, cap * sizeof(*evs));
+        if (!evs) return NULL;
+        reader->evs     = evs;
+        reader->evs_cap = cap;
+    }
+    reader_ev_t *ev = reader->evs + reader->nevs;
+    memset(ev, 0, sizeof(*ev));
+    ev->type      = type;
+    reader->nevs += 1;
+    return ev;
+}
+
+static int reader_queue_str(hvml_reader_t *reader, HVML_READER_EVENT type, const char *s, size_t len) {
+    reader_ev_t *ev = reader_queue(reader, type);
+    if (!ev) return -1;
+
+    ev->off = hvml_string_len(&reader->scratch);
+    ev->len = len;
+    if (len && hvml_string_append_n(&reader->scratch, s, len)) return -1;
+    return 0;
+}
+
+// text and attr vals are borrowed from the input if they're verbatim there
+static int reader_queue_token(hvml_reader_t *reader, HVML_READER_EVENT type, const char *s) {
+    const char *span = NULL;
+    size_t      len  = 0;
+    if (hvml_parser_token_span(reader->parser, &span, &len)) {
+        reader_ev_t *ev = reader_queue(reader, type);
+        if (!ev) return -1;
+        ev->view = span;
+        ev->len  = len;
+        return 0;
+    }
+    return reader_queue_str(reader, type, s, strlen(s));
+}
+
+static int on_open_tag(void *arg, const char *tag) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    size_t len = strlen(tag);
+
+    if (reader->ntags == reader->tags_cap) {
+        size_t cap = reader->tags_cap ? reader->tags_cap * 2 : 16;
+        size_t *tags = (size_t*)realloc(reader->tags, cap * sizeof(*tags));
+        if (!tags) return -1;
+        reader->tags     = tags;
+        reader->tags_cap = cap;
+    }
+    reader->tags[reader->ntags] = hvml_string_len(&reader->tag_names);
+    if (hvml_string_append_n(&reader->tag_names, tag, len)) return -1;
+    reader->ntags += 1;
+
+    return reader_queue_str(reader, HVML_READER_OPEN_TAG, tag, len);
+}
+
+static int on_attr_key(void *arg, const char *key) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    return reader_queue_str(reader, HVML_READER_ATTR_KEY, key, strlen(key));
+}
+
+static int on_attr_val(void *arg, const char *val) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    return reader_queue_token(reader, HVML_READER_ATTR_VAL, val);
+}
+
+static int on_close_tag(void *arg) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    A(reader->ntags>0, "internal logic error");
+
+    reader->ntags -= 1;
+    size_t      off = reader->tags[reader->ntags];
+    const char *tag = hvml_string_str(&reader->tag_names) + off;
+    size_t      len = hvml_string_len(&reader->tag_names) - off;
+    int ret = reader_queue_str(reader, HVML_READER_CLOSE_TAG, tag, len);
+    reader->tag_names.len      = off;
+    reader->tag_names.str[off] = '\0';
+    return ret;
+}
+
+static int on_text(void *arg, const char *txt) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    return reader_queue_token(reader, HVML_READER_TEXT, txt);
+}
+
+static int on_begin(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_JSON_BEGIN) ? 0 : -1;
+}
+
+static int on_open_array(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_OPEN_ARRAY) ? 0 : -1;
+}
+
+static int on_close_array(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_CLOSE_ARRAY) ? 0 : -1;
+}
+
+static int on_open_obj(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_OPEN_OBJ) ? 0 : -1;
+}
+
+static int on_close_obj(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_CLOSE_OBJ) ? 0 : -1;
+}
+
+static int on_key(void *arg, const char *key, size_t len) {
+    return reader_queue_str((hvml_reader_t*)arg, HVML_READER_KEY, key, len);
+}
+
+static int on_true(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_TRUE) ? 0 : -1;
+}
+
+static int on_false(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_FALSE) ? 0 : -1;
+}
+
+static int on_null(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_NULL) ? 0 : -1;
+}
+
+static int on_string(void *arg, const char *val, size_t len) {
+    return reader_queue_str((hvml_reader_t*)arg, HVML_READER_STRING, val, len);
+}
+
+static int on_number(void *arg, const hvml_json_number_t *num) {
+    hvml_reader_t *reader = (hvml_reader_t*)arg;
+    const char    *s      = num->origin ? num->origin : "";
+    size_t         len    = num->origin ? num->len : 0;
+    if (reader_queue_str(reader, HVML_READER_NUMBER, s, len)) return -1;
+    reader->evs[reader->nevs - 1].num = *num;
+    return 0;
+}
+
+static int on_end(void *arg) {
+    return reader_queue((hvml_reader_t*)arg, HVML_READER_JSON_END) ? 0 : -1;
+}
+
+hvml_reader_t* hvml_reader_create(const char *buf, size_t len) {
+    hvml_reader_t *reader = (hvml_reader_t*)calloc(1, sizeof(*reader));
+    if (!reader) return NULL;
+
+    hvml_parser_conf_t conf = {0};
+
+    conf.on_open_tag      = on_open_tag;
+    conf.on_attr_key      = on_attr_key;
+    conf.on_attr_val      = on_attr_val;
+    conf.on_close_tag     = on_close_tag;
+    conf.on_text          = on_text;
+
+    conf.on_begin         = on_begin;
+    conf.on_open_array    = on_open_array;
+    conf.on_close_array   = on_close_array;
+    conf.on_open_obj      = on_open_obj;
+    conf.on_close_obj     = on_close_obj;
+    conf.on_key           = on_key;
+    conf.on_true          = on_true;
+    conf.on_false         = on_false;
+    conf.on_null          = on_null;
+    conf.on_string        = on_string;
+    conf.on_number        = on_number;
+    conf.on_end           = on_end;
+
+    conf.arg              = reader;
+
+    reader->parser = hvml_parser_create(conf);
+    if (!reader->parser) {
+        free(reader);
+        return NULL;
+    }
+
+    reader->buf = buf;
+    reader->len = buf ? len : 0;
+
+    return reader;
+}
+
+hvml_reader_t* hvml_reader_create_from_file(const char *path) {
+    hvml_file_map_t map;
+    if (hvml_file_map(path, &map)) return NULL;
+
+    hvml_reader_t *reader = hvml_reader_create(map.buf, map.len);
+    if (!reader) {
+        hvml_file_unmap(&map);
+        return NULL;
+    }
+    reader->map    = map;
+    reader->mapped = 1;
+
+    return reader;
+}
+
+void hvml_reader_destroy(hvml_reader_t *reader) {
+    if (!reader) return;
+
+    hvml_parser_destroy(reader->parser);
+    reader->parser = NULL;
+    free(reader->evs);
+    free(reader->tags);
+    hvml_string_clear(&reader->scratch);
+    hvml_string_clear(&reader->tag_names);
+    if (reader->mapped) hvml_file_unmap(&reader->map);
+
+    free(reader);
+}
+
+// parse the next chunk, or end the document
+static int reader_fill(hvml_reader_t *reader) {
+    // what's been delivered is no longer referred to
+    reader->head = 0;
+    reader->nevs = 0;
+    hvml_string_reset(&reader->scratch);
+
+    if (reader->pos < reader->len) {
+        size_t n = reader->len - reader->pos;
+        if (n > READER_CHUNK) n = READER_CHUNK;
+        if (hvml_parser_parse(reader->parser, reader->buf + reader->pos, n)) return -1;
+        reader->pos += n;
+        return 0;
+    }
+
+    if (hvml_parser_parse_end(reader->parser)) return -1;
+    reader->ended = 1;
+    return 0;
+}
+
+int hvml_reader_next(hvml_reader_t *reader, hvml_reader_event_t *ev) {
+    while (reader->head == reader->nevs) {
+        if (reader->failed) return -1;
+        if (reader->ended)  return 0;
+        // what's queued before the error is delivered first
+        if (reader_fill(reader)) reader->failed = 1;
+    }
+
+    const reader_ev_t *e = reader->evs + reader->head;
+    reader->head += 1;
+
+    ev->type = e->type;
+    ev->str  = e->view ? e->view : (e->len ? hvml_string_str(&reader->scratch) + e->off : "");
+    ev->len  = e->len;
+    ev->num  = e->num;
+    if (ev->type == HVML_READER_OPEN_TAG)  reader->depth += 1;
+    if (ev->type == HVML_READER_CLOSE_TAG) reader->depth -= 1;
+    if (ev->type == HVML_READER_NUMBER) {
+        ev->num.origin = ev->str;
+        ev->num.len    = ev->len;
+    }
+
+    return 1;
+}
+
+size_t hvml_reader_depth(hvml_reader_t *reader) {
+    return reader->depth;
+}
+
@@ -0,0 +1,69 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "hvml/hvml_rstr.h"
+
+#include "hvml_atomic.h"
+
+#include "hvml/hvml_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// header and bytes in one single allocation
+struct hvml_rstr_s {
+    volatile size_t     refs;
+    size_t              len;
+    char                str[1];
+};
+
+hvml_rstr_t* hvml_rstr_create(const char *buf, size_t len) {
+    hvml_rstr_t *rs = (hvml_rstr_t*)malloc(offsetof(hvml_rstr_t, str) + len + 1);
+    if (!rs) return NULL;
+
+    rs->refs = 1;
+    rs->len  = len;
+    if (len) memcpy(rs->str, buf, len);
+    rs->str[len] = '\0';
+
+    return rs;
+}
+
+hvml_rstr_t* hvml_rstr_ref(hvml_rstr_t *rs) {
+    A(rs, "internal logic error");
+    hvml_atomic_inc(&rs->refs);
+    return rs;
+}
+
+void hvml_rstr_unref(hvml_rstr_t *rs) {
+    if (!rs) return;
+    // the sole owner, nobody else could ref it meanwhile
+    if (hvml_atomic_get(&rs->refs) != 1 && hvml_atomic_dec(&rs->refs)) return;
+    free(rs);
+}
+
+const char* hvml_rstr_str(hvml_rstr_t *rs) {
+    return rs->str;
+}
+
+size_t hvml_rstr_len(hvml_rstr_t *rs) {
+    return rs->len;
+}
+
+size_t hvml_rstr_refs(hvml_rstr_t *rs) {
+    return hvml_atomic_get(&rs->refs);
+}
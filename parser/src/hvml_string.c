@@ -40,14 +40,56 @@ void hvml_string_clear(hvml_string_t *str) {
         str->str = NULL;
     }
     str->len = 0;
+    str->cap = 0;
 }
 
-int hvml_string_push(hvml_string_t *str, const char c) {
-    char *s = (char*)realloc(str->str, str->len + 2); // one extra null terminator
+static int hvml_string_realloc(hvml_string_t *str, size_t cap) {
+    char *s = (char*)realloc(str->str, cap);
     if (!s) return -1;
 
+    str->str = s;
+    str->cap = cap;
+
+    return 0;
+}
+
+// capacity doubles, thus appending N bytes one by one costs O(log N) reallocs
+static int hvml_string_grow(hvml_string_t *str, size_t len) {
+    if (!str->str) str->cap = 0;
+    if (len < str->cap) return 0;
+
+    size_t cap = str->cap ? str->cap : 16;
+    while (cap <= len) {
+        if (cap*2 < cap) return -1;
+        cap *= 2;
+    }
+
+    return hvml_string_realloc(str, cap);
+}
+
+int hvml_string_reserve(hvml_string_t *str, size_t len) {
+    if (!str->str) str->cap = 0;
+    if (len < str->cap) return 0;
+    if (len+1 < len) return -1;
+
+    return hvml_string_realloc(str, len + 1); // one extra null terminator
+}
+
+int hvml_string_shrink_to_fit(hvml_string_t *str) {
+    if (!str->str) {
+        str->cap = 0;
+        return 0;
+    }
+    if (str->cap == str->len + 1) return 0;
+
+    return hvml_string_realloc(str, str->len + 1);
+}
+
+int hvml_string_push(hvml_string_t *str, const char c) {
+    if (hvml_string_grow(str, str->len + 1)) return -1;
+
+    char *s     = str->str;
     s[str->len] = c;
-    str->str    = s;
     str->len   += 1;
     s[str->len] = '\0';
 
@@ -70,16 +112,27 @@ int hvml_string_append(hvml_string_t *str, const char *s) {
     size_t len  = str->len + slen;
     if (len<str->len) return -1;
 
-    char *ss    = (char*)realloc(str->str, len+1);
-    if (!ss) return -1;
+    if (hvml_string_grow(str, len)) return -1;
 
-    strcpy(ss+str->len, s);
-    str->str    = ss;
+    memcpy(str->str+str->len, s, slen+1);
     str->len    = len;
 
     return 0;
 }
 
+int hvml_string_append_n(hvml_string_t *str, const char *buf, size_t n) {
+    size_t len = str->len + n;
+    if (len<str->len) return -1;
+
+    if (hvml_string_grow(str, len)) return -1;
+
+    memcpy(str->str+str->len, buf, n);
+    str->str[len] = '\0';
+    str->len      = len;
+
+    return 0;
+}
+
 int hvml_string_get(hvml_string_t *str, char **buf, size_t *len) {
     if (buf) *buf = str->str;
     if (len) *len = str->len;
@@ -88,12 +141,11 @@ int hvml_string_get(hvml_string_t *str, char **buf, size_t *len) {
 }
 
 int hvml_string_set(hvml_string_t *str, const char *buf, size_t len) {
-    char *s = (char*)realloc(str->str, len + 1); // one extra null terminator
-    if (!s) return -1;
+    if (hvml_string_reserve(str, len)) return -1;
 
+    char *s = str->str;
     memcpy(s, buf, len);
     s[len] = 0;
-    str->str    = s;
     str->len    = len;
 
     return 0;
@@ -113,14 +165,12 @@ int hvml_string_printf(hvml_string_t *str, const char *fmt, ...) {
 
     if (n<0) return -1;
 
-    char *s = (char*)realloc(str->str, n+1);
-    if (!s) return -1;
+    if (hvml_string_reserve(str, n)) return -1;
 
     va_start(arg, fmt);
-    vsnprintf(s, n+1, fmt, arg);
+    vsnprintf(str->str, n+1, fmt, arg);
     va_end(arg);
 
-    str->str = s;
     str->len = n;
 
     return str->len;
@@ -139,17 +189,15 @@ int hvml_string_append_printf(hvml_string_t *str, const char *fmt, ...) {
 
     if (n<0) return -1;
 
-    char *s = (char*)realloc(str->str, str->len + n + 1);
-    if (!s) return -1;
+    if (hvml_string_grow(str, str->len + n)) return -1;
 
     va_start(arg, fmt);
-    vsnprintf(s+str->len, n+1, fmt, arg);
+    vsnprintf(str->str+str->len, n+1, fmt, arg);
     va_end(arg);
 
-    str->str  = s;
-    str->len += n + 1;
+    str->len += n;
 
-    return str->len;
+    return 0;
 }
 
 int hvml_string_to_number(const char *s, long double *v) {
@@ -290,47 +338,38 @@ int hvml_string_to_unix(hvml_string_t *str) {
 
 
 
-static int hvml_string_append_vprintf(hvml_string_t *str, size_t total, const char *fmt, va_list ap) {
-    A(str, "internal logic error");
-    A(total>0, "internal logic error");
-
-    char *s = (char*)realloc(str->str, str->len + total + 1);
-    if (!s) return -1;
-
-    int n = vsnprintf(s+str->len, total+1, fmt, ap);
-
-    A(n>=0 && (size_t)n==total, "internal logic error");
-
-    str->str  = s;
-    str->len += total + 1;
-
-    return str->len;
-}
-
-typedef int (*hvml_stream_vprintf_func)(void *target, size_t total, const char *fmt, va_list ap);
+typedef int (*hvml_stream_write_func)(void *target, const char *buf, size_t len);
 typedef int (*hvml_stream_destroy_func)(void *target);
 
+// output is gathered in buf and handed to write_func only when full,
+// flushed explicitly, or destroyed
 struct hvml_stream_s {
-    unsigned int                   sc:1;             // safe check
     void                          *arg;
-    hvml_stream_vprintf_func       vprintf_func;
+    hvml_stream_write_func         write_func;
     hvml_stream_destroy_func       destroy_func;
+    size_t                         len;              // bytes buffered
+    char                           buf[4096];
 };
 
-static int call_vfprintf(void *arg, size_t total, const char *fmt, va_list ap) {
+static int call_fwrite(void *arg, const char *buf, size_t len) {
     A(arg, "internal logic error");
-    A(total==0, "internal logic error");
     FILE *out = (FILE*)arg;
-    return vfprintf(out, fmt, ap);
+    return fwrite(buf, 1, len, out)==len ? 0 : -1;
 }
 
-static int call_hvml_string_append_vprintf(void *arg, size_t total, const char *fmt, va_list ap) {
+static int call_hvml_string_append(void *arg, const char *buf, size_t len) {
     A(arg, "internal logic error");
-    A(total>0, "internal logic error");
 
     hvml_string_t *str = (hvml_string_t*)arg;
 
-    return hvml_string_append_vprintf(str, total, fmt, ap);
+    if (str->len + len < str->len) return -1;
+    if (hvml_string_grow(str, str->len + len)) return -1;
+
+    memcpy(str->str + str->len, buf, len);
+    str->len += len;
+    str->str[str->len] = '\0';
+
+    return 0;
 }
 
 static int call_fclose(void *arg) {
@@ -342,14 +381,13 @@ static int call_fclose(void *arg) {
 hvml_stream_t* hvml_stream_bind_file(FILE *out, int take_ownership) {
     A(out, "internal logic error");
 
-    hvml_stream_t *stream = (hvml_stream_t*)calloc(1, sizeof(*stream));
+    hvml_stream_t *stream = (hvml_stream_t*)malloc(sizeof(*stream));
     if (!stream) return NULL;
 
-    stream->sc               = 0;
     stream->arg              = out;
-    stream->vprintf_func     = call_vfprintf;
-    if (!take_ownership) return stream;
-    stream->destroy_func     = call_fclose;
+    stream->write_func       = call_fwrite;
+    stream->destroy_func     = take_ownership ? call_fclose : NULL;
+    stream->len              = 0;
 
     return stream;
 }
@@ -357,12 +395,13 @@ hvml_stream_t* hvml_stream_bind_file(FILE *out, int take_ownership) {
 hvml_stream_t* hvml_stream_bind_string(hvml_string_t *str) {
     A(str, "internal logic error");
 
-    hvml_stream_t *stream = (hvml_stream_t*)calloc(1, sizeof(*stream));
+    hvml_stream_t *stream = (hvml_stream_t*)malloc(sizeof(*stream));
     if (!stream) return NULL;
 
-    stream->sc               = 1;
     stream->arg              = str;
-    stream->vprintf_func     = call_hvml_string_append_vprintf;
+    stream->write_func       = call_hvml_string_append;
+    stream->destroy_func     = NULL;
+    stream->len              = 0;
 
     return stream;
 }
@@ -371,37 +410,105 @@ void hvml_stream_destroy(hvml_stream_t *stream) {
     if (!stream) return;
     if (!stream->arg) return;
 
+    hvml_stream_flush(stream);
+
     if (stream->destroy_func) {
         stream->destroy_func(stream->arg);
     }
     stream->arg           = NULL;
-    stream->vprintf_func  = NULL;
+    stream->write_func    = NULL;
     stream->destroy_func  = NULL;
 
     free(stream);
 }
 
+int hvml_stream_flush(hvml_stream_t *stream) {
+    A(stream, "internal logic error");
+    A(stream->write_func, "internal logic error");
+
+    if (stream->len==0) return 0;
+
+    int r = stream->write_func(stream->arg, stream->buf, stream->len);
+    stream->len = 0;
+
+    return r ? -1 : 0;
+}
+
+int hvml_stream_write(hvml_stream_t *stream, const char *buf, size_t len) {
+    A(stream, "internal logic error");
+
+    if (len <= sizeof(stream->buf) - stream->len) {
+        memcpy(stream->buf + stream->len, buf, len);
+        stream->len += len;
+        return 0;
+    }
+
+    if (hvml_stream_flush(stream)) return -1;
+
+    if (len < sizeof(stream->buf)) {
+        memcpy(stream->buf, buf, len);
+        stream->len = len;
+        return 0;
+    }
+
+    // large enough to bypass the buffer
+    return stream->write_func(stream->arg, buf, len) ? -1 : 0;
+}
+
+int hvml_stream_puts(hvml_stream_t *stream, const char *s) {
+    return hvml_stream_write(stream, s, strlen(s));
+}
+
+int hvml_stream_putc(hvml_stream_t *stream, const char c) {
+    A(stream, "internal logic error");
+
+    if (stream->len == sizeof(stream->buf)) {
+        if (hvml_stream_flush(stream)) return -1;
+    }
+    stream->buf[stream->len++] = c;
+
+    return 0;
+}
+
 int hvml_stream_printf(hvml_stream_t *stream, const char *fmt, ...) {
     A(stream, "internal logic error");
     A(stream->arg, "internal logic error");
-    A(stream->vprintf_func, "internal logic error");
+    A(stream->write_func, "internal logic error");
 
-    int n = 0;
+    // format straight into the buffer, which is large enough most of the time
+    size_t room = sizeof(stream->buf) - stream->len;
+
+    va_list arg;
+    va_start(arg, fmt);
+    int n = vsnprintf(stream->buf + stream->len, room, fmt, arg);
+    va_end(arg);
+
+    if (n<0) return n;
+    if ((size_t)n < room) {
+        stream->len += n;
+        return n;
+    }
+
+    if (hvml_stream_flush(stream)) return -1;
 
-    if (stream->sc) {
-        va_list arg;
+    if ((size_t)n < sizeof(stream->buf)) {
         va_start(arg, fmt);
-        n = vsnprintf(NULL, 0, fmt, arg);
+        vsnprintf(stream->buf, sizeof(stream->buf), fmt, arg);
         va_end(arg);
-
-        if (n<=0) return n;
+        stream->len = n;
+        return n;
     }
 
-    va_list arg;
+    char *s = (char*)malloc(n + 1);
+    if (!s) return -1;
+
     va_start(arg, fmt);
-    int r = stream->vprintf_func(stream->arg, n, fmt, arg);
+    vsnprintf(s, n + 1, fmt, arg);
     va_end(arg);
 
-    return r;
+    int r = stream->write_func(stream->arg, s, n);
+    free(s);
+
+    return r ? -1 : n;
 }
 
@@ -20,20 +20,61 @@
 #include "hvml/hvml_string.h"
 
 #include <stdlib.h>
+#include <string.h>
 
+// table-driven DFA for well-formed utf8, as of RFC 3629
+// bytes are mapped into classes first, and then (state, class) to next state
+// overlongs, surrogates and code points beyond U+10FFFF are rejected
 #define MKDT(type)  DECODER##type
-#define MKDS(type) "DECODER_"#type
 
 typedef enum {
-    MKDT(D_INIT),
-    MKDT(D_22),
-    MKDT(D_32),
-    MKDT(D_33),
-    MKDT(D_42),
-    MKDT(D_43),
-    MKDT(D_44)
+    MKDT(D_INIT),     // accept
+    MKDT(D_REJECT),
+    MKDT(D_T1),       // 1 more trailing byte
+    MKDT(D_T2),       // 2 more
+    MKDT(D_T3),       // 3 more
+    MKDT(D_E0),       // E0:    A0..BF, then T1
+    MKDT(D_ED),       // ED:    80..9F, then T1, no surrogates
+    MKDT(D_F0),       // F0:    90..BF, then T2
+    MKDT(D_F4),       // F4:    80..8F, then T2
+    MKDT(D_COUNT)
 } DECODER_STATE;
 
+// 0: 00..7F   1: 80..8F   2: 90..9F   3: A0..BF
+// 4: C2..DF   5: E0       6: E1..EC/EE..EF   7: ED
+// 8: F0       9: F1..F3   10: F4     11: C0/C1/F5..FF
+#define UTF8_CLASSES 12
+
+static const unsigned char utf8_class[256] = {
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+    3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, 3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+   11,11,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    5,6,6,6,6,6,6,6,6,6,6,6,6,7,6,6, 8,9,9,9,10,11,11,11,11,11,11,11,11,11,11,11,
+};
+
+#define R MKDT(D_REJECT)
+static const unsigned char utf8_next[MKDT(D_COUNT)][UTF8_CLASSES] = {
+    [MKDT(D_INIT)]   = { MKDT(D_INIT), R, R, R, MKDT(D_T1), MKDT(D_E0), MKDT(D_T2), MKDT(D_ED), MKDT(D_F0), MKDT(D_T3), MKDT(D_F4), R },
+    [MKDT(D_REJECT)] = { R, R,            R,            R,            R, R, R, R, R, R, R, R },
+    [MKDT(D_T1)]     = { R, MKDT(D_INIT), MKDT(D_INIT), MKDT(D_INIT), R, R, R, R, R, R, R, R },
+    [MKDT(D_T2)]     = { R, MKDT(D_T1),   MKDT(D_T1),   MKDT(D_T1),   R, R, R, R, R, R, R, R },
+    [MKDT(D_T3)]     = { R, MKDT(D_T2),   MKDT(D_T2),   MKDT(D_T2),   R, R, R, R, R, R, R, R },
+    [MKDT(D_E0)]     = { R, R,            R,            MKDT(D_T1),   R, R, R, R, R, R, R, R },
+    [MKDT(D_ED)]     = { R, MKDT(D_T1),   MKDT(D_T1),   R,            R, R, R, R, R, R, R, R },
+    [MKDT(D_F0)]     = { R, R,            MKDT(D_T2),   MKDT(D_T2),   R, R, R, R, R, R, R, R },
+    [MKDT(D_F4)]     = { R, MKDT(D_T2),   R,            R,            R, R, R, R, R, R, R, R },
+};
+#undef R
+
+// payload bits of a leading byte, by class
+static const unsigned char utf8_lead_mask[UTF8_CLASSES] = {
+    0x7f, 0, 0, 0, 0x1f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07, 0,
+};
+
 struct hvml_utf8_decoder_s {
     DECODER_STATE             state;
     uint64_t                  cp;
@@ -56,136 +97,37 @@ void hvml_utf8_decoder_destroy(hvml_utf8_decoder_t *decoder) {
     free(decoder);
 }
 
-#define do_output()                                    \
-do {                                                   \
-    if (cp) {                                          \
-        *cp = decoder->cp;                             \
-    }                                                  \
-    decoder->state = MKDT(D_INIT);                     \
-    decoder->cp = 0;                                   \
-} while (0)
+void hvml_utf8_decoder_reset(hvml_utf8_decoder_t *decoder) {
+    decoder->state = MKDT(D_INIT);
+    decoder->cp    = 0;
+    hvml_string_reset(&decoder->cache);
+}
 
 int hvml_utf8_decoder_push(hvml_utf8_decoder_t *decoder, const char c, uint64_t *cp)
 {
     if (!decoder) return -1;
-    const unsigned char uc = (const unsigned char)c;
-    switch (decoder->state) {
-        case MKDT(D_INIT):
-        {
-            hvml_string_reset(&decoder->cache);
-            if ((uc&0x80)==0) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                   return -1;
-                }
-                decoder->cp = uc;
-                do_output();
-                return 1;
-            }
-            if ((uc&0xe0)==0xc0) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                   return -1;
-                }
-                decoder->cp = (uc & ~0xe0) << 6;
-                decoder->state = MKDT(D_22);
-                break;
-            }
-            if ((uc&0xf0)==0xe0) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                   return -1;
-                }
-                decoder->cp = (uc & ~0xf0) << 12;
-                decoder->state = MKDT(D_32);
-                break;
-            }
-            if ((uc&0xf4)==0xf0) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                   return -1;
-                }
-                decoder->cp = (uc & ~0xf4) << 18;
-                decoder->state = MKDT(D_42);
-                break;
-            }
-            return -1;
-        } break;
-        case MKDT(D_22):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0);
-                do_output();
-                return 1;
-            }
-            return -1;
-        } break;
-        case MKDT(D_32):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0) << 6;
-                decoder->state = MKDT(D_33);
-                break;
-            }
-            return -1;
-        } break;
-        case MKDT(D_33):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0);
-                do_output();
-                return 1;
-            }
-            return -1;
-        } break;
-        case MKDT(D_42):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0) << 12;
-                decoder->state = MKDT(D_43);
-                break;
-            }
-            return -1;
-        } break;
-        case MKDT(D_43):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0) << 6;
-                decoder->state = MKDT(D_44);
-                break;
-            }
-            return -1;
-        } break;
-        case MKDT(D_44):
-        {
-            if ((uc&0xc0)==0x80) {
-                if (hvml_string_push(&decoder->cache, c)) {
-                    return -1;
-                }
-                decoder->cp |= (uc & ~0xc0);
-                do_output();
-                return 1;
-            }
-            return -1;
-        } break;
-        default:
-        {
-            return -1;
-        } break;
+    const unsigned char uc  = (const unsigned char)c;
+    const unsigned char cls = utf8_class[uc];
+
+    if (decoder->state == MKDT(D_INIT)) {
+        hvml_string_reset(&decoder->cache);
+        decoder->cp = uc & utf8_lead_mask[cls];
+    } else {
+        decoder->cp = (decoder->cp << 6) | (uc & 0x3f);
     }
 
-    return 0;
+    DECODER_STATE next = (DECODER_STATE)utf8_next[decoder->state][cls];
+    if (next == MKDT(D_REJECT)) return -1;
+
+    if (hvml_string_push(&decoder->cache, c)) {
+        return -1;
+    }
+    decoder->state = next;
+    if (next != MKDT(D_INIT)) return 0;
+
+    if (cp) *cp = decoder->cp;
+    decoder->cp = 0;
+    return 1;
 }
 
 int hvml_utf8_decoder_ready(hvml_utf8_decoder_t *decoder) {
@@ -203,6 +145,71 @@ const char* hvml_utf8_decoder_cache(hvml_utf8_decoder_t *decoder, size_t *len) {
     return decoder->cache.str;
 }
 
+// # of leading ascii bytes, 16 at a time
+static size_t utf8_ascii_run(const unsigned char *p, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint64_t a, b;
+        memcpy(&a, p + i,     8);
+        memcpy(&b, p + i + 8, 8);
+        if ((a | b) & 0x8080808080808080ULL) break;
+    }
+    while (i<len && p[i]<0x80) ++i;
+    return i;
+}
+
+int hvml_utf8_validate(const char *buf, size_t len, size_t *err_off) {
+    const unsigned char *p = (const unsigned char*)buf;
+    size_t i = 0;
+    while (i<len) {
+        i += utf8_ascii_run(p + i, len - i);
+        if (i>=len) break;
+
+        size_t        start = i;
+        unsigned char state = utf8_next[MKDT(D_INIT)][utf8_class[p[i++]]];
+        while (state != MKDT(D_INIT) && state != MKDT(D_REJECT) && i<len) {
+            state = utf8_next[state][utf8_class[p[i++]]];
+        }
+        if (state == MKDT(D_INIT)) continue;
+
+        if (err_off) *err_off = start;
+        return state == MKDT(D_REJECT) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+size_t hvml_utf8_decode(const char *buf, size_t len, uint32_t *cps, size_t cap, size_t *consumed) {
+    const unsigned char *p = (const unsigned char*)buf;
+    size_t i = 0;
+    size_t n = 0;
+    while (i<len && n<cap) {
+        size_t run = utf8_ascii_run(p + i, len - i);
+        if (run > cap - n) run = cap - n;
+        for (size_t k=0; k<run; ++k) cps[n++] = p[i + k];
+        i += run;
+        if (i>=len || n>=cap) break;
+
+        size_t        j     = i;
+        unsigned char cls   = utf8_class[p[j]];
+        uint32_t      cp    = p[j] & utf8_lead_mask[cls];
+        unsigned char state = utf8_next[MKDT(D_INIT)][cls];
+        ++j;
+        while (state != MKDT(D_INIT) && state != MKDT(D_REJECT) && j<len) {
+            cp    = (cp << 6) | (p[j] & 0x3f);
+            state = utf8_next[state][utf8_class[p[j]]];
+            ++j;
+        }
+        if (state != MKDT(D_INIT)) break;
+
+        cps[n++] = cp;
+        i        = j;
+    }
+
+    if (consumed) *consumed = i;
+    return n;
+}
+
 int hvml_utf8_encode(const uint64_t cp, char *output, size_t *output_len)
 {
     if (output && !output_len) return -1;
@@ -258,7 +265,7 @@ int hvml_utf8_encode(const uint64_t cp, char *output, size_t *output_len)
             *output_len = 4;
         }
         if (output) {
-            output[0] = 0xf0 | ((cp>>18) & ~0xf4);
+            output[0] = 0xf0 | ((cp>>18) & 0x07);
             output[1] = 0x80 | ((cp>>12) & ~0xc0);
             output[2] = 0x80 | ((cp>>6) & ~0xc0);
             output[3] = 0x80 | (cp & ~0xc0);
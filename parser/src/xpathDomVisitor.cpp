@@ -73,10 +73,160 @@ do {
 } while(0)
 
 
+struct xpathNodesetEntry {
+    hvml_doms_t                  doms;
+    size_t                       refc;
+    xpathNodesetEntry           *next;
+};
+
+namespace {
+
+// released entries, per thread
+struct xpathNodesetPool {
+    xpathNodesetEntry           *head  = nullptr;
+    size_t                       count = 0;
+
+    ~xpathNodesetPool() {
+        while (head) {
+            xpathNodesetEntry *entry = head;
+            head = entry->next;
+            hvml_doms_cleanup(&entry->doms);
+            free(entry);
+        }
+    }
+};
+
+// bounds what the pool keeps
+const size_t POOL_MAX_ENTRIES   = 64;
+const size_t POOL_MAX_CAP       = 4096;
+
+xpathNodesetPool& nodeset_pool() {
+    static thread_local xpathNodesetPool pool;
+    return pool;
+}
+
+} // namespace
+
+xpathNodeset::xpathNodeset(const xpathNodeset &other)
+:entry_(other.entry_)
+{
+    if (entry_) ++entry_->refc;
+}
+
+xpathNodeset::xpathNodeset(xpathNodeset &&other) noexcept
+:entry_(other.entry_)
+{
+    other.entry_ = nullptr;
+}
+
+xpathNodeset::~xpathNodeset() {
+    release();
+}
+
+xpathNodeset& xpathNodeset::operator=(const xpathNodeset &other) {
+    if (other.entry_) ++other.entry_->refc;
+    release();
+    entry_ = other.entry_;
+    return *this;
+}
+
+xpathNodeset& xpathNodeset::operator=(xpathNodeset &&other) noexcept {
+    if (this != &other) {
+        release();
+        entry_ = other.entry_;
+        other.entry_ = nullptr;
+    }
+    return *this;
+}
+
+xpathNodeset xpathNodeset::make() {
+    xpathNodesetPool &pool = nodeset_pool();
+    xpathNodesetEntry *entry = pool.head;
+    if (entry) {
+        pool.head = entry->next;
+        pool.count -= 1;
+    } else {
+        entry = (xpathNodesetEntry*)calloc(1, sizeof(*entry));
+        if (!entry) T("out of memory");
+    }
+    entry->refc = 1;
+    entry->next = nullptr;
+
+    xpathNodeset ns;
+    ns.entry_ = entry;
+    return ns;
+}
+
+hvml_doms_t* xpathNodeset::get() const {
+    A(entry_, "internal logic error");
+    return &entry_->doms;
+}
+
+void xpathNodeset::release() {
+    xpathNodesetEntry *entry = entry_;
+    entry_ = nullptr;
+    if (!entry) return;
+    if (--entry->refc) return;
+
+    xpathNodesetPool &pool = nodeset_pool();
+    if (pool.count >= POOL_MAX_ENTRIES || entry->doms.cap > POOL_MAX_CAP) {
+        hvml_doms_cleanup(&entry->doms);
+        free(entry);
+        return;
+    }
+    hvml_doms_reset(&entry->doms);
+    entry->next = pool.head;
+    pool.head   = entry;
+    pool.count += 1;
+}
+
 static xpathNodeset make_nodeset() {
-    hvml_doms_t *doms = (hvml_doms_t*)calloc(1, sizeof(*doms));
-    if (!doms) T("out of memory");
-    return std::shared_ptr<hvml_doms_t>{doms, hvml_doms_destroy};
+    return xpathNodeset::make();
+}
+
+xpathTokens::entry& xpathTokens::lookup(antlr4::tree::ParseTree *node) {
+    for (size_t i=0; i<entries_.size(); ++i) {
+        if (entries_[i]->node == node) return *entries_[i];
+    }
+    std::unique_ptr<entry> e(new entry);
+    e->node     = node;
+    e->text     = node->getText();
+    e->number   = NAN;
+    e->parsed   = false;
+    e->atom     = HVML_ATOM_NONE;
+    e->atomized = false;
+    entries_.push_back(std::move(e));
+    return *entries_.back();
+}
+
+const std::string& xpathTokens::text(antlr4::tree::ParseTree *node) {
+    return lookup(node).text;
+}
+
+hvml_atom_t xpathTokens::atom(antlr4::tree::ParseTree *node) {
+    entry &e = lookup(node);
+    if (!e.atomized) {
+        // the document is already there, names not interned match nothing
+        e.atom     = hvml_atom_lookup(e.text.c_str(), e.text.size());
+        e.atomized = true;
+    }
+    return e.atom;
+}
+
+long double xpathTokens::number(antlr4::tree::TerminalNode *node) {
+    entry &e = lookup(node);
+    if (!e.parsed) {
+        hvml_string_to_number(e.text.c_str(), &e.number);
+        e.parsed = true;
+    }
+    return e.number;
+}
+
+// token type of a terminal child, 0 for rule contexts
+static size_t token_type(antlr4::tree::ParseTree *node) {
+    antlr4::tree::TerminalNode *terminal = dynamic_cast<antlr4::tree::TerminalNode*>(node);
+    if (!terminal) return 0;
+    return terminal->getSymbol()->getType();
 }
 
 typedef struct doms_collect_relative_s          doms_collect_relative_t;
@@ -188,11 +338,17 @@ static int do_doms_append_relative(hvml_doms_t *out, int forward, int self, int
 }
 
 xpathDomVisitor::xpathDomVisitor(hvml_dom_t *dom, size_t idx, size_t size)
+:xpathDomVisitor(dom, idx, size, nullptr)
+{
+}
+
+xpathDomVisitor::xpathDomVisitor(hvml_dom_t *dom, size_t idx, size_t size, xpathDomVisitor *parent)
 :dom_(dom)
 ,idx_(idx)
 ,size_(size)
 ,axis_(HVML_DOM_XPATH_AXIS_UNSPECIFIED)
 ,principal_(HVML_DOM_XPATH_PRINCIPAL_UNSPECIFIED)
+,tokens_(parent ? parent->tokens_ : &own_tokens_)
 {
     A(dom_,       "internal logic error");
     A(idx_<size_, "internal logic error");
@@ -201,27 +357,171 @@ xpathDomVisitor::xpathDomVisitor(hvml_dom_t *dom, size_t idx, size_t size)
 xpathDomVisitor::~xpathDomVisitor() {
 }
 
+void xpathDomVisitor::rebind(hvml_dom_t *dom, size_t idx, size_t size) {
+    dom_       = dom;
+    idx_       = idx;
+    size_      = size;
+    axis_      = HVML_DOM_XPATH_AXIS_UNSPECIFIED;
+    principal_ = HVML_DOM_XPATH_PRINCIPAL_UNSPECIFIED;
+    A(dom_,       "internal logic error");
+    A(idx_<size_, "internal logic error");
+}
+
 antlrcpp::Any xpathDomVisitor::visitMain(xpathParser::MainContext *ctx) {
+    return eval_main(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitLocationPath(xpathParser::LocationPathContext *ctx) {
+    return eval_location_path(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitAbsoluteLocationPathNoroot(xpathParser::AbsoluteLocationPathNorootContext *ctx) {
+    return eval_absolute_location_path(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitRelativeLocationPath(xpathParser::RelativeLocationPathContext *ctx) {
+    return eval_relative_location_path(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitStep(xpathParser::StepContext *ctx) {
+    return eval_step(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitAxisSpecifier(xpathParser::AxisSpecifierContext *ctx) {
+    return eval_axis_specifier(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitNodeTest(xpathParser::NodeTestContext *ctx) {
+    return eval_node_test(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitPredicate(xpathParser::PredicateContext *ctx) {
+    return eval_predicate(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitAbbreviatedStep(xpathParser::AbbreviatedStepContext *ctx) {
+    return eval_abbreviated_step(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitExpr(xpathParser::ExprContext *ctx) {
+    return to_any(eval_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitPrimaryExpr(xpathParser::PrimaryExprContext *ctx) {
+    return to_any(eval_primary_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitFunctionCall(xpathParser::FunctionCallContext *ctx) {
+    return to_any(eval_function_call(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitUnionExprNoRoot(xpathParser::UnionExprNoRootContext *ctx) {
+    return to_any(eval_union_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitPathExprNoRoot(xpathParser::PathExprNoRootContext *ctx) {
+    return to_any(eval_path_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitFilterExpr(xpathParser::FilterExprContext *ctx) {
+    return to_any(eval_filter_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitOrExpr(xpathParser::OrExprContext *ctx) {
+    return to_any(eval_or_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitAndExpr(xpathParser::AndExprContext *ctx) {
+    return to_any(eval_and_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitEqualityExpr(xpathParser::EqualityExprContext *ctx) {
+    return to_any(eval_equality_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitRelationalExpr(xpathParser::RelationalExprContext *ctx) {
+    return to_any(eval_relational_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitAdditiveExpr(xpathParser::AdditiveExprContext *ctx) {
+    return to_any(eval_additive_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitMultiplicativeExpr(xpathParser::MultiplicativeExprContext *ctx) {
+    return to_any(eval_multiplicative_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitUnaryExprNoRoot(xpathParser::UnaryExprNoRootContext *ctx) {
+    return to_any(eval_unary_expr(ctx));
+}
+
+antlrcpp::Any xpathDomVisitor::visitQName(xpathParser::QNameContext *ctx) {
+    return eval_qname(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitFunctionName(xpathParser::FunctionNameContext *ctx) {
+    // std::vector<NCNameContext *> nCName();
+    // NCNameContext* nCName(size_t i);
+    // antlr4::tree::TerminalNode *COLON();
+    // antlr4::tree::TerminalNode *NCName();
+    // antlr4::tree::TerminalNode *AxisName();
+    if (ctx->COLON()) {
+        const std::string &prefix = eval_ncname(ctx->nCName(0));
+        const std::string &local_part = eval_ncname(ctx->nCName(1));
+        return std::tuple<std::string, std::string>{prefix, local_part};
+    }
+    if (ctx->NCName()) {
+        const std::string &local_part = tokens_->text(ctx->NCName());
+        return std::tuple<std::string, std::string>{"", local_part};
+    }
+    if (ctx->AxisName()) {
+        const std::string &local_part = tokens_->text(ctx->AxisName());
+        return std::tuple<std::string, std::string>{"", local_part};
+    }
+    A(0, "internal logic error");
+    // never reached here
+    return false;
+}
+
+antlrcpp::Any xpathDomVisitor::visitVariableReference(xpathParser::VariableReferenceContext *ctx) {
+    (void)ctx;
+    T("internal logic error");
+}
+
+antlrcpp::Any xpathDomVisitor::visitNameTest(xpathParser::NameTestContext *ctx) {
+    return eval_name_test(ctx);
+}
+
+antlrcpp::Any xpathDomVisitor::visitNCName(xpathParser::NCNameContext *ctx) {
+    return eval_ncname(ctx);
+}
+
+xpathNodeset xpathDomVisitor::eval_main(xpathParser::MainContext *ctx) {
     // LocationPathContext *locationPath();
-    antlrcpp::Any any = visitChildren(ctx);
-    if (!any.is<xpathNodeset>()) return any;
-    xpathNodeset doms = any;
+    if (!ctx->locationPath()) T("expecting node set but failed");
+    xpathNodeset doms = eval_location_path(ctx->locationPath());
     xpathNodeset output = make_nodeset();
     if (hvml_doms_sort(output.get(), doms.get())) T("out of memory");
     return output;
 }
 
-antlrcpp::Any xpathDomVisitor::visitLocationPath(xpathParser::LocationPathContext *ctx) {
+xpathNodeset xpathDomVisitor::eval_location_path(xpathParser::LocationPathContext *ctx) {
     // RelativeLocationPathContext *relativeLocationPath();
     // AbsoluteLocationPathNorootContext *absoluteLocationPathNoroot();
-    return visitChildren(ctx);
+    if (ctx->relativeLocationPath()) {
+        return eval_relative_location_path(ctx->relativeLocationPath());
+    }
+    if (ctx->absoluteLocationPathNoroot()) {
+        return eval_absolute_location_path(ctx->absoluteLocationPathNoroot());
+    }
+    T("expecting node set but failed");
 }
 
-antlrcpp::Any xpathDomVisitor::visitAbsoluteLocationPathNoroot(xpathParser::AbsoluteLocationPathNorootContext *ctx) {
+xpathNodeset xpathDomVisitor::eval_absolute_location_path(xpathParser::AbsoluteLocationPathNorootContext *ctx) {
     // antlr4::tree::TerminalNode *PATHSEP();
     // RelativeLocationPathContext *relativeLocationPath();
     // antlr4::tree::TerminalNode *ABRPATH();
-    xpathNodeset doms = make_nodeset();
+    xpathNodeset doms;
     if (ctx->PATHSEP()) {
         doms = stepToRoot();
     } else if (ctx->ABRPATH()) {
@@ -229,6 +529,7 @@ antlrcpp::Any xpathDomVisitor::visitAbsoluteLocationPathNoroot(xpathParser::Abso
         hvml_dom_t *root = hvml_dom_root(dom_);
         A(root, "internal logic error");
         A(hvml_dom_type(root)==MKDOT(D_ROOT), "internal logic error");
+        doms = make_nodeset();
         if (hvml_doms_append_dom(doms.get(), root)) T("out of memory");
         A(doms->ndoms==1, "internal logic error");
         doms = do_collect_descendant_or_self(doms);
@@ -237,7 +538,7 @@ antlrcpp::Any xpathDomVisitor::visitAbsoluteLocationPathNoroot(xpathParser::Abso
     } else {
         A(0, "internal logic error");
         // never reached here
-        return xpathError();
+        T("internal logic error");
     }
 
     if (doms->ndoms==0) return doms;
@@ -247,70 +548,46 @@ antlrcpp::Any xpathDomVisitor::visitAbsoluteLocationPathNoroot(xpathParser::Abso
     return do_relative(doms, ctx->relativeLocationPath());
 }
 
-antlrcpp::Any xpathDomVisitor::visitRelativeLocationPath(xpathParser::RelativeLocationPathContext *ctx) {
-    // std::vector<StepContext *> step();
-    // StepContext* step(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> PATHSEP();
-    // antlr4::tree::TerminalNode* PATHSEP(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> ABRPATH();
-    // antlr4::tree::TerminalNode* ABRPATH(size_t i);
+xpathNodeset xpathDomVisitor::eval_relative_location_path(xpathParser::RelativeLocationPathContext *ctx) {
+    // step (('/'|'//') step)*
     xpathNodeset doms = make_nodeset();
     int r = hvml_doms_append_dom(doms.get(), dom_);
     if (r) T("out of memory");
 
-    for (size_t i=0; i<ctx->children.size(); ++i) {
-        int visited = 0;
-        auto node = ctx->children[i];
-        for (size_t j=0; j<ctx->step().size(); ++j) {
-            auto step = ctx->step(j);
-            if (node != step) continue;
+    for (auto node: ctx->children) {
+        xpathParser::StepContext *step = dynamic_cast<xpathParser::StepContext*>(node);
+        if (step) {
             doms = do_step(doms, step);
             if (doms->ndoms==0) return doms;
-            visited = 1;
-            break;
-        }
-        if (visited) continue;
-        for (size_t j=0; j<ctx->PATHSEP().size(); ++j) {
-            auto pathsep = ctx->PATHSEP(j);
-            if (node != pathsep) continue;
-            visited = 1;
-            break;
+            continue;
         }
-        if (visited) continue;
-        for (size_t j=0; j<ctx->ABRPATH().size(); ++j) {
-            auto abrpath = ctx->ABRPATH(j);
-            if (node != abrpath) continue;
-            antlrcpp::Any any = do_collect_descendant_or_self(doms);
-            if (!any.is<xpathNodeset>()) T("expecting node set but failed");
-            doms = any;
+        if (token_type(node) == xpathParser::ABRPATH) {
+            doms = do_collect_descendant_or_self(doms);
             if (doms->ndoms==0) return doms;
-            visited = 1;
-            break;
         }
     }
 
     return doms;
 }
 
-antlrcpp::Any xpathDomVisitor::visitStep(xpathParser::StepContext *ctx) {
+xpathNodeset xpathDomVisitor::eval_step(xpathParser::StepContext *ctx) {
     // AxisSpecifierContext *axisSpecifier();
     // NodeTestContext *nodeTest();
     // std::vector<PredicateContext *> predicate();
     // PredicateContext* predicate(size_t i);
     // AbbreviatedStepContext *abbreviatedStep();
     if (ctx->abbreviatedStep()) {
-        return visitAbbreviatedStep(ctx->abbreviatedStep());
+        return eval_abbreviated_step(ctx->abbreviatedStep());
     }
 
     A(ctx->axisSpecifier(), "internal logic error");
-    antlrcpp::Any any = visitAxisSpecifier(ctx->axisSpecifier());
-    if (!any.is<xpathNodeset>()) T("expecting node set but failed");
-    xpathNodeset doms = any;
+    xpathNodeset doms = eval_axis_specifier(ctx->axisSpecifier());
     if (doms->ndoms==0) return doms;
 
     doms = do_nodetest(doms, principal_, ctx->nodeTest());
-    for (size_t i=0; i<ctx->predicate().size(); ++i) {
-        auto predicate = ctx->predicate(i);
+    for (auto node: ctx->children) {
+        xpathParser::PredicateContext *predicate = dynamic_cast<xpathParser::PredicateContext*>(node);
+        if (!predicate) continue;
         doms = do_predicate(doms, predicate);
         if (doms->ndoms==0) break;
     }
@@ -318,12 +595,12 @@ antlrcpp::Any xpathDomVisitor::visitStep(xpathParser::StepContext *ctx) {
     return doms;
 }
 
-antlrcpp::Any xpathDomVisitor::visitAxisSpecifier(xpathParser::AxisSpecifierContext *ctx) {
+xpathNodeset xpathDomVisitor::eval_axis_specifier(xpathParser::AxisSpecifierContext *ctx) {
     // antlr4::tree::TerminalNode *AxisName();
     // antlr4::tree::TerminalNode *CC();
     // antlr4::tree::TerminalNode *AT();
     if (ctx->AxisName()) {
-        return do_axis(ctx->AxisName()->getText());
+        return do_axis(tokens_->text(ctx->AxisName()));
     }
     if (ctx->AT()) {
         return do_axis_attribute();
@@ -331,7 +608,7 @@ antlrcpp::Any xpathDomVisitor::visitAxisSpecifier(xpathParser::AxisSpecifierCont
     return do_axis_child();
 }
 
-antlrcpp::Any xpathDomVisitor::visitNodeTest(xpathParser::NodeTestContext *ctx) {
+bool xpathDomVisitor::eval_node_test(xpathParser::NodeTestContext *ctx) {
     // NameTestContext *nameTest();
     // antlr4::tree::TerminalNode *NodeType();
     // antlr4::tree::TerminalNode *LPAR();
@@ -340,62 +617,53 @@ antlrcpp::Any xpathDomVisitor::visitNodeTest(xpathParser::NodeTestContext *ctx)
     // antlr4::tree::TerminalNode *DIV();
     // antlr4::tree::TerminalNode *MOD();
     if (ctx->nameTest()) {
-        return visitNameTest(ctx->nameTest());
+        return eval_name_test(ctx->nameTest());
     }
     if (ctx->NodeType()) {
-        const std::string &nt = ctx->NodeType()->getText();
-        return do_node_type(dom_, nt);
+        return do_node_type(dom_, tokens_->text(ctx->NodeType()));
     }
     if (ctx->Literal()) {
         W("processing-instruction: not supported yet");
         return false;
     }
     if (ctx->DIV()) {
-        return do_name_test(dom_, NULL, "div");
+        return do_name_test(dom_, NULL, "div", tokens_->atom(ctx->DIV()));
     }
     if (ctx->MOD()) {
-        return do_name_test(dom_, NULL, "mod");
+        return do_name_test(dom_, NULL, "mod", tokens_->atom(ctx->MOD()));
     }
     A(0, "internal logic error");
     // never reached here
     return false;
 }
 
-bool xpathDomVisitor::do_predicate(const antlrcpp::Any &any) {
-    bool ok = false;
-    if (any.is<bool>()) {
-        ok = any;
-    } else if (any.is<long double>()) {
-        long double number = any;
-        if (fabsl(number - (idx_+1))<=DBL_EPSILON) ok = true;
-    } else if (any.is<std::string>()) {
-        const std::string &literal = any;
-        if (!literal.empty()) ok = true;
-    } else if (any.is<xpathNodeset>()) {
-        xpathNodeset doms = any;
-        if (doms->ndoms>0) ok = true;
-    } else {
-        T("internal logic error");
+bool xpathDomVisitor::do_predicate(const xpathValue &v) {
+    switch (v.type) {
+        case xpathValue::BOOLEAN: return v.boolean;
+        case xpathValue::NUMBER:  return fabsl(v.number - (idx_+1))<=DBL_EPSILON;
+        case xpathValue::STRING:  return !v.string.empty();
+        case xpathValue::NODESET: return v.nodeset->ndoms>0;
+        default: {
+            T("internal logic error");
+        } break;
     }
-    return ok;
 }
 
-antlrcpp::Any xpathDomVisitor::visitPredicate(xpathParser::PredicateContext *ctx) {
+bool xpathDomVisitor::eval_predicate(xpathParser::PredicateContext *ctx) {
     // antlr4::tree::TerminalNode *LBRAC();
     // ExprContext *expr();
     // antlr4::tree::TerminalNode *RBRAC();
-    antlrcpp::Any any = visitExpr(ctx->expr());
-    return do_predicate(any);
+    return do_predicate(eval_expr(ctx->expr()));
 }
 
-antlrcpp::Any xpathDomVisitor::visitAbbreviatedStep(xpathParser::AbbreviatedStepContext *ctx) {
+xpathNodeset xpathDomVisitor::eval_abbreviated_step(xpathParser::AbbreviatedStepContext *ctx) {
     // antlr4::tree::TerminalNode *DOT();
     // antlr4::tree::TerminalNode *DOTDOT();
-    xpathNodeset doms = make_nodeset();
+    xpathNodeset doms;
     if (ctx->DOT()) {
-        doms = do_axis("self");
+        doms = do_axis_self();
     } else if (ctx->DOTDOT()) {
-        doms = do_axis("parent");
+        doms = do_axis_parent();
     } else {
         T("internal logic error");
     }
@@ -406,12 +674,12 @@ antlrcpp::Any xpathDomVisitor::visitAbbreviatedStep(xpathParser::AbbreviatedStep
     return doms;
 }
 
-antlrcpp::Any xpathDomVisitor::visitExpr(xpathParser::ExprContext *ctx) {
+xpathValue xpathDomVisitor::eval_expr(xpathParser::ExprContext *ctx) {
     // OrExprContext *orExpr();
-    return visitOrExpr(ctx->orExpr());
+    return eval_or_expr(ctx->orExpr());
 }
 
-antlrcpp::Any xpathDomVisitor::visitPrimaryExpr(xpathParser::PrimaryExprContext *ctx) {
+xpathValue xpathDomVisitor::eval_primary_expr(xpathParser::PrimaryExprContext *ctx) {
     // VariableReferenceContext *variableReference();
     // antlr4::tree::TerminalNode *LPAR();
     // ExprContext *expr();
@@ -423,27 +691,23 @@ antlrcpp::Any xpathDomVisitor::visitPrimaryExpr(xpathParser::PrimaryExprContext
         T("not implemented yet");
     }
     if (ctx->expr()) {
-        return visitExpr(ctx->expr());
+        return eval_expr(ctx->expr());
     }
     if (ctx->Literal()) {
-        const std::string &s = ctx->Literal()->getText();
+        const std::string &s = tokens_->text(ctx->Literal());
         A(s.size()>=2, "internal logic error");
-        std::string literal(s.c_str()+1, s.size()-2);
-        return literal;
+        return std::string(s.c_str()+1, s.size()-2);
     }
     if (ctx->Number()) {
-        const std::string &number = ctx->Number()->getText();
-        long double ldbl = NAN;
-        hvml_string_to_number(number.c_str(), &ldbl);
-        return ldbl;
+        return tokens_->number(ctx->Number());
     }
     if (ctx->functionCall()) {
-        return visitFunctionCall(ctx->functionCall());
+        return eval_function_call(ctx->functionCall());
     }
     T("internal logic error");
 }
 
-antlrcpp::Any xpathDomVisitor::visitFunctionCall(xpathParser::FunctionCallContext *ctx) {
+xpathValue xpathDomVisitor::eval_function_call(xpathParser::FunctionCallContext *ctx) {
     // FunctionNameContext *functionName();
     // antlr4::tree::TerminalNode *LPAR();
     // antlr4::tree::TerminalNode *RPAR();
@@ -451,27 +715,30 @@ antlrcpp::Any xpathDomVisitor::visitFunctionCall(xpathParser::FunctionCallContex
     // ExprContext* expr(size_t i);
     // std::vector<antlr4::tree::TerminalNode *> COMMA();
     // antlr4::tree::TerminalNode* COMMA(size_t i);
-    std::tuple<std::string, std::string> funcName = visitFunctionName(ctx->functionName());
-    if (!std::get<0>(funcName).empty()) {
+    xpathParser::FunctionNameContext *name = ctx->functionName();
+    if (name->COLON()) {
         T("not implemented yet");
     }
-    if (std::get<1>(funcName) == "position") {
-        A(ctx->expr().size()==0, "internal logic error");
+    antlr4::tree::TerminalNode *local = name->NCName() ? name->NCName() : name->AxisName();
+    A(local, "internal logic error");
+    const std::string &local_part = tokens_->text(local);
+    if (local_part == "position") {
+        A(ctx->expr(0)==NULL, "internal logic error");
         return (long double)(idx_ + 1);
     }
-    if (std::get<1>(funcName) == "last") {
-        A(ctx->expr().size()==0, "internal logic error");
+    if (local_part == "last") {
+        A(ctx->expr(0)==NULL, "internal logic error");
         return (long double)size_;
     }
     T("not implemented yet");
 }
 
-antlrcpp::Any xpathDomVisitor::visitUnionExprNoRoot(xpathParser::UnionExprNoRootContext *ctx) {
+xpathValue xpathDomVisitor::eval_union_expr(xpathParser::UnionExprNoRootContext *ctx) {
     // PathExprNoRootContext *pathExprNoRoot();
     // antlr4::tree::TerminalNode *PIPE();
     // UnionExprNoRootContext *unionExprNoRoot();
     // antlr4::tree::TerminalNode *PATHSEP();
-    antlrcpp::Any head;
+    xpathValue head;
 
     if (ctx->PATHSEP()) {
         hvml_dom_t *root = hvml_dom_root(dom_);
@@ -480,407 +747,308 @@ antlrcpp::Any xpathDomVisitor::visitUnionExprNoRoot(xpathParser::UnionExprNoRoot
         if (hvml_doms_append_dom(nodes.get(), root)) T("out of memory");
         head = nodes;
     } else if (ctx->pathExprNoRoot()) {
-        head = visitPathExprNoRoot(ctx->pathExprNoRoot());
+        head = eval_path_expr(ctx->pathExprNoRoot());
     } else {
         A(0, "internal logic error");
         // never reached here
-        return xpathError();
+        T("internal logic error");
     }
 
     if (!ctx->unionExprNoRoot()) return head;
 
-    antlrcpp::Any tail = visitUnionExprNoRoot(ctx->unionExprNoRoot());
-    if (!head.is<xpathNodeset>()) T("expecting node set but failed");
-    if (!tail.is<xpathNodeset>()) T("expecting node set but failed");
+    xpathValue tail = eval_union_expr(ctx->unionExprNoRoot());
+    if (!head.is_nodeset()) T("expecting node set but failed");
+    if (!tail.is_nodeset()) T("expecting node set but failed");
 
-    xpathNodeset hdoms = head;
-    xpathNodeset tdoms = tail;
-    if (hvml_doms_append_doms(hdoms.get(), tdoms.get())) T("out of memory");
-    return hdoms;
+    if (hvml_doms_append_doms(head.nodeset.get(), tail.nodeset.get())) T("out of memory");
+    return head;
 }
 
-antlrcpp::Any xpathDomVisitor::visitPathExprNoRoot(xpathParser::PathExprNoRootContext *ctx) {
+xpathValue xpathDomVisitor::eval_path_expr(xpathParser::PathExprNoRootContext *ctx) {
     // LocationPathContext *locationPath();
     // FilterExprContext *filterExpr();
     // RelativeLocationPathContext *relativeLocationPath();
     // antlr4::tree::TerminalNode *PATHSEP();
     // antlr4::tree::TerminalNode *ABRPATH();
     if (ctx->locationPath()) {
-        xpathDomVisitor visitor(dom_, 0, 1);
-        return visitor.visitLocationPath(ctx->locationPath());
+        xpathDomVisitor visitor(dom_, 0, 1, this);
+        return visitor.eval_location_path(ctx->locationPath());
     } else if (ctx->filterExpr()) {
-        antlrcpp::Any any = visitFilterExpr(ctx->filterExpr());
+        xpathValue v = eval_filter_expr(ctx->filterExpr());
         if (ctx->relativeLocationPath()) {
-            xpathNodeset head = any;
-            return do_relative(head, ctx->relativeLocationPath());
+            if (!v.is_nodeset()) T("expecting node set but failed");
+            return do_relative(v.nodeset, ctx->relativeLocationPath());
         } else {
             A(ctx->PATHSEP()==NULL, "internal logic error");
             A(ctx->ABRPATH()==NULL, "internal logic error");
-            return any;
+            return v;
         }
     } else {
         A(0, "internal logic error");
         // never reached here
-        return xpathError();
+        T("internal logic error");
     }
 }
 
-antlrcpp::Any xpathDomVisitor::visitFilterExpr(xpathParser::FilterExprContext *ctx) {
+xpathValue xpathDomVisitor::eval_filter_expr(xpathParser::FilterExprContext *ctx) {
     // PrimaryExprContext *primaryExpr();
     // std::vector<PredicateContext *> predicate();
     // PredicateContext* predicate(size_t i);
     A(ctx->primaryExpr(), "internal logic error");
-    antlrcpp::Any any = visitPrimaryExpr(ctx->primaryExpr());
-    if (ctx->predicate().size()==0) return any;
+    xpathValue v = eval_primary_expr(ctx->primaryExpr());
+    if (ctx->predicate(0)==NULL) return v;
 
     xpathNodeset doms = make_nodeset();
-    do {
-        if (any.is<bool>()) {
-            bool ok = any;
-            if (!ok) return false;
+    switch (v.type) {
+        case xpathValue::BOOLEAN: {
+            if (!v.boolean) return false;
             if (hvml_doms_append_dom(doms.get(), dom_)) T("out of memory");
-            break;
-        }
-        if (any.is<std::string>()) {
-            const std::string &literal = any;
-            if (literal.empty()) return false;
+        } break;
+        case xpathValue::STRING: {
+            if (v.string.empty()) return false;
             if (hvml_doms_append_dom(doms.get(), dom_)) T("out of memory");
-            break;
-        }
-        if (any.is<long double>()) {
-            long double ldbl = any;
-            if (!(fabsl(ldbl - (idx_ + 1)) <= DBL_EPSILON)) return false;
+        } break;
+        case xpathValue::NUMBER: {
+            if (!(fabsl(v.number - (idx_ + 1)) <= DBL_EPSILON)) return false;
             if (hvml_doms_append_dom(doms.get(), dom_)) T("out of memory");
-            break;
-        }
-        if (any.is<xpathNodeset>()) {
-            xpathNodeset r = any;
-            if (r->ndoms == 0) return false;
-            if (hvml_doms_append_doms(doms.get(), r.get())) T("out of memory");
-            break;
-        }
-        A(0, "internal logic error");
-    } while (0);
+        } break;
+        case xpathValue::NODESET: {
+            if (v.nodeset->ndoms == 0) return false;
+            if (hvml_doms_append_doms(doms.get(), v.nodeset.get())) T("out of memory");
+        } break;
+        default: {
+            A(0, "internal logic error");
+        } break;
+    }
 
     A(doms->ndoms, "internal logic error");
 
-    for (size_t i=0; i<ctx->predicate().size(); ++i) {
-        auto predicate = ctx->predicate(i);
-        antlrcpp::Any any = do_predicate(doms, predicate);
-        if (!any.is<xpathNodeset>()) T("expecting node set but failed");
-        xpathNodeset r = any;
-        if (r->ndoms==0) return false;
-        doms = r;
+    for (auto node: ctx->children) {
+        xpathParser::PredicateContext *predicate = dynamic_cast<xpathParser::PredicateContext*>(node);
+        if (!predicate) continue;
+        doms = do_predicate(doms, predicate);
+        if (doms->ndoms==0) return false;
     }
 
     return doms->ndoms>0 ? true : false;
 }
 
-antlrcpp::Any xpathDomVisitor::visitOrExpr(xpathParser::OrExprContext *ctx) {
-    // std::vector<AndExprContext *> andExpr();
-    // AndExprContext* andExpr(size_t i);
-    for (size_t i=0; i<ctx->andExpr().size(); ++i) {
-        antlrcpp::Any any = visitAndExpr(ctx->andExpr(i));
-        if (ctx->andExpr().size()==1) return any;
-        if (any.is<bool>()) {
-            bool ok = any;
-            if (ok) return true;
-            continue;
-        }
-        if (any.is<std::string>()) {
-            const std::string &literal = any;
-            if (!literal.empty()) return true;
-            continue;
-        }
-        if (any.is<long double>()) {
-            long double ldbl = any;
-            if (fabsl(ldbl - (idx_ + 1)) <= DBL_EPSILON) return true;
-            continue;
-        }
-        if (any.is<xpathNodeset>()) {
-            xpathNodeset doms = any;
-            bool ok = doms->ndoms > 0;
-            if (ok) return true;
-            continue;
+xpathValue xpathDomVisitor::eval_or_expr(xpathParser::OrExprContext *ctx) {
+    // andExpr ('or' andExpr)*
+    if (ctx->andExpr(1)==NULL) return eval_and_expr(ctx->andExpr(0));
+
+    for (auto node: ctx->children) {
+        xpathParser::AndExprContext *expr = dynamic_cast<xpathParser::AndExprContext*>(node);
+        if (!expr) continue;
+        xpathValue v = eval_and_expr(expr);
+        switch (v.type) {
+            case xpathValue::BOOLEAN: {
+                if (v.boolean) return true;
+            } break;
+            case xpathValue::STRING: {
+                if (!v.string.empty()) return true;
+            } break;
+            case xpathValue::NUMBER: {
+                if (fabsl(v.number - (idx_ + 1)) <= DBL_EPSILON) return true;
+            } break;
+            case xpathValue::NODESET: {
+                if (v.nodeset->ndoms > 0) return true;
+            } break;
+            default: {
+                A(0, "internal logic error");
+            } break;
         }
-        A(0, "internal logic error");
     }
 
     return false;
 }
 
-antlrcpp::Any xpathDomVisitor::visitAndExpr(xpathParser::AndExprContext *ctx) {
-    // std::vector<EqualityExprContext *> equalityExpr();
-    // EqualityExprContext* equalityExpr(size_t i);
-    for (size_t i=0; i<ctx->equalityExpr().size(); ++i) {
-        antlrcpp::Any any = visitEqualityExpr(ctx->equalityExpr(i));
-        if (ctx->equalityExpr().size()==1) return any;
-        if (any.is<bool>()) {
-            bool ok = any;
-            if (!ok) return false;
-            continue;
-        }
-        if (any.is<std::string>()) {
-            const std::string &literal = any;
-            if (literal.empty()) return false;
-            continue;
-        }
-        if (any.is<long double>()) {
-            long double ldbl = any;
-            if (fabsl(ldbl - (idx_ + 1)) > DBL_EPSILON) return false;
-            continue;
-        }
-        if (any.is<xpathNodeset>()) {
-            xpathNodeset doms = any;
-            bool ok = doms->ndoms > 0;
-            if (!ok) return false;
-            continue;
+xpathValue xpathDomVisitor::eval_and_expr(xpathParser::AndExprContext *ctx) {
+    // equalityExpr ('and' equalityExpr)*
+    if (ctx->equalityExpr(1)==NULL) return eval_equality_expr(ctx->equalityExpr(0));
+
+    for (auto node: ctx->children) {
+        xpathParser::EqualityExprContext *expr = dynamic_cast<xpathParser::EqualityExprContext*>(node);
+        if (!expr) continue;
+        xpathValue v = eval_equality_expr(expr);
+        switch (v.type) {
+            case xpathValue::BOOLEAN: {
+                if (!v.boolean) return false;
+            } break;
+            case xpathValue::STRING: {
+                if (v.string.empty()) return false;
+            } break;
+            case xpathValue::NUMBER: {
+                if (fabsl(v.number - (idx_ + 1)) > DBL_EPSILON) return false;
+            } break;
+            case xpathValue::NODESET: {
+                if (v.nodeset->ndoms == 0) return false;
+            } break;
+            default: {
+                A(0, "internal logic error");
+            } break;
         }
-        A(0, "internal logic error");
     }
+
     return true;
 }
 
-antlrcpp::Any xpathDomVisitor::visitEqualityExpr(xpathParser::EqualityExprContext *ctx) {
+static bool do_compare(HVML_DOM_XPATH_OP_TYPE op, const xpathValue &left, const xpathValue &right);
+
+xpathValue xpathDomVisitor::eval_equality_expr(xpathParser::EqualityExprContext *ctx) {
     // std::vector<RelationalExprContext *> relationalExpr();
     // RelationalExprContext* relationalExpr(size_t i);
     // antlr4::tree::TerminalNode *EQ();
     // antlr4::tree::TerminalNode *NEQ();
-    A(ctx->relationalExpr().size()>=1, "internal logic error");
+    A(ctx->relationalExpr(0), "internal logic error");
 
-    antlrcpp::Any l = visitRelationalExpr(ctx->relationalExpr(0));
+    xpathValue l = eval_relational_expr(ctx->relationalExpr(0));
     if (ctx->relationalExpr(1) == NULL) return l;
-    antlrcpp::Any r = visitRelationalExpr(ctx->relationalExpr(1));
+    xpathValue r = eval_relational_expr(ctx->relationalExpr(1));
     if (ctx->EQ()) {
-        return do_eq(l, r);
+        return do_compare(HVML_DOM_XPATH_OP_EQ, l, r);
     } else if (ctx->NEQ()) {
-        return !do_eq(l, r);
+        return !do_compare(HVML_DOM_XPATH_OP_EQ, l, r);
     } else {
         T("internal logic error");
     }
 }
 
-antlrcpp::Any xpathDomVisitor::visitRelationalExpr(xpathParser::RelationalExprContext *ctx) {
+xpathValue xpathDomVisitor::eval_relational_expr(xpathParser::RelationalExprContext *ctx) {
     // std::vector<AdditiveExprContext *> additiveExpr();
     // AdditiveExprContext* additiveExpr(size_t i);
     // antlr4::tree::TerminalNode *LESS();
     // antlr4::tree::TerminalNode *MORE_();
     // antlr4::tree::TerminalNode *LE();
     // antlr4::tree::TerminalNode *GE();
-    A(ctx->additiveExpr().size()>=1, "internal logic error");
+    A(ctx->additiveExpr(0), "internal logic error");
 
-    antlrcpp::Any l = visitAdditiveExpr(ctx->additiveExpr(0));
+    xpathValue l = eval_additive_expr(ctx->additiveExpr(0));
     if (ctx->additiveExpr(1) == NULL) return l;
-    antlrcpp::Any r = visitAdditiveExpr(ctx->additiveExpr(1));
+    xpathValue r = eval_additive_expr(ctx->additiveExpr(1));
     if (ctx->LESS()) {
-        return do_less(l, r);
+        return do_compare(HVML_DOM_XPATH_OP_LT, l, r);
     } else if (ctx->MORE_()) {
-        return do_less(r, l);
+        return do_compare(HVML_DOM_XPATH_OP_LT, r, l);
     } else if (ctx->LE()) {
-        return do_lte(l, r);
+        return do_compare(HVML_DOM_XPATH_OP_LTE, l, r);
     } else if (ctx->GE()) {
-        return do_lte(r, l);
+        return do_compare(HVML_DOM_XPATH_OP_LTE, r, l);
     } else {
         T("internal logic error");
     }
 }
 
-antlrcpp::Any xpathDomVisitor::visitAdditiveExpr(xpathParser::AdditiveExprContext *ctx) {
-    // std::vector<MultiplicativeExprContext *> multiplicativeExpr();
-    // MultiplicativeExprContext* multiplicativeExpr(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> PLUS();
-    // antlr4::tree::TerminalNode* PLUS(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> MINUS();
-    // antlr4::tree::TerminalNode* MINUS(size_t i);
+xpathValue xpathDomVisitor::eval_additive_expr(xpathParser::AdditiveExprContext *ctx) {
+    // multiplicativeExpr (('+'|'-') multiplicativeExpr)*
     A(ctx->children.size()>=1, "internal logic error");
     A(ctx->children[0] == ctx->multiplicativeExpr(0), "internal logic error");
-    antlrcpp::Any l = visitMultiplicativeExpr(ctx->multiplicativeExpr(0));
-    if (ctx->children.size()==1) return l;
+    xpathValue l = eval_multiplicative_expr(ctx->multiplicativeExpr(0));
     for (size_t i=1; i<ctx->children.size(); ++i) {
-        std::string op;
-        do {
-            int found = 0;
-            for (size_t j=0; j<ctx->PLUS().size(); ++j) {
-                if (ctx->children[i] != ctx->PLUS(j)) continue;
-                op = "+";
-                found = 1;
-                break;
-            }
-            if (found) break;
-            for (size_t j=0; j<ctx->MINUS().size(); ++j) {
-                if (ctx->children[i] != ctx->MINUS(j)) continue;
-                op = "-";
-                found = 1;
-                break;
-            }
-            A(found, "internal logic error");
-        } while (0);
+        char op = 0;
+        switch (token_type(ctx->children[i])) {
+            case xpathParser::PLUS:  op = '+'; break;
+            case xpathParser::MINUS: op = '-'; break;
+            default: {
+                A(0, "internal logic error");
+            } break;
+        }
 
         ++i;
         A(i<ctx->children.size(), "internal logic error");
 
-        antlrcpp::Any r;
-        int found = 0;
-        for (size_t j=0; j<ctx->multiplicativeExpr().size(); ++j) {
-            if (ctx->children[i] != ctx->multiplicativeExpr(j)) continue;
-            r = visitMultiplicativeExpr(ctx->multiplicativeExpr(j));
-            found = 1;
-            break;
-        }
-        A(found, "internal logic error");
+        xpathParser::MultiplicativeExprContext *expr = dynamic_cast<xpathParser::MultiplicativeExprContext*>(ctx->children[i]);
+        A(expr, "internal logic error");
+        xpathValue r = eval_multiplicative_expr(expr);
 
         l = do_op(op, l, r);
     }
     return l;
 }
 
-antlrcpp::Any xpathDomVisitor::visitMultiplicativeExpr(xpathParser::MultiplicativeExprContext *ctx) {
-    // std::vector<UnaryExprNoRootContext *> unaryExprNoRoot();
-    // UnaryExprNoRootContext* unaryExprNoRoot(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> MUL();
-    // antlr4::tree::TerminalNode* MUL(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> DIV();
-    // antlr4::tree::TerminalNode* DIV(size_t i);
-    // std::vector<antlr4::tree::TerminalNode *> MOD();
-    // antlr4::tree::TerminalNode* MOD(size_t i);
+xpathValue xpathDomVisitor::eval_multiplicative_expr(xpathParser::MultiplicativeExprContext *ctx) {
+    // unaryExprNoRoot (('*'|'div'|'mod') unaryExprNoRoot)*
     A(ctx->children.size()>=1, "internal logic error");
     A(ctx->children[0] == ctx->unaryExprNoRoot(0), "internal logic error");
-    antlrcpp::Any l = visitUnaryExprNoRoot(ctx->unaryExprNoRoot(0));
-    if (ctx->children.size()==1) return l;
+    xpathValue l = eval_unary_expr(ctx->unaryExprNoRoot(0));
     for (size_t i=1; i<ctx->children.size(); ++i) {
-        std::string op;
-        do {
-            int found = 0;
-            for (size_t j=0; j<ctx->MUL().size(); ++j) {
-                if (ctx->children[i] != ctx->MUL(j)) continue;
-                op = "*";
-                found = 1;
-                break;
-            }
-            if (found) break;
-            for (size_t j=0; j<ctx->DIV().size(); ++j) {
-                if (ctx->children[i] != ctx->DIV(j)) continue;
-                op = "/";
-                found = 1;
-                break;
-            }
-            if (found) break;
-            for (size_t j=0; j<ctx->MOD().size(); ++j) {
-                if (ctx->children[i] != ctx->MOD(j)) continue;
-                op = "%";
-                found = 1;
-                break;
-            }
-            if (found) break;
-            A(found, "internal logic error");
-        } while (0);
+        char op = 0;
+        switch (token_type(ctx->children[i])) {
+            case xpathParser::MUL: op = '*'; break;
+            case xpathParser::DIV: op = '/'; break;
+            case xpathParser::MOD: op = '%'; break;
+            default: {
+                A(0, "internal logic error");
+            } break;
+        }
 
         ++i;
         A(i<ctx->children.size(), "internal logic error");
 
-        antlrcpp::Any r;
-        int found = 0;
-        for (size_t j=0; j<ctx->unaryExprNoRoot().size(); ++j) {
-            if (ctx->children[i] != ctx->unaryExprNoRoot(j)) continue;
-            r = visitUnaryExprNoRoot(ctx->unaryExprNoRoot(j));
-            found = 1;
-            break;
-        }
-        A(found, "internal logic error");
+        xpathParser::UnaryExprNoRootContext *expr = dynamic_cast<xpathParser::UnaryExprNoRootContext*>(ctx->children[i]);
+        A(expr, "internal logic error");
+        xpathValue r = eval_unary_expr(expr);
 
         l = do_op(op, l, r);
     }
     return l;
 }
 
-antlrcpp::Any xpathDomVisitor::visitUnaryExprNoRoot(xpathParser::UnaryExprNoRootContext *ctx) {
-    // UnionExprNoRootContext *unionExprNoRoot();
-    // std::vector<antlr4::tree::TerminalNode *> MINUS();
-    // antlr4::tree::TerminalNode* MINUS(size_t i);
+xpathValue xpathDomVisitor::eval_unary_expr(xpathParser::UnaryExprNoRootContext *ctx) {
+    // '-'* unionExprNoRoot
     A(ctx->children.size()>=1, "internal logic error");
     A(ctx->children[0] == ctx->unionExprNoRoot(), "internal logic error");
-    antlrcpp::Any l = visitUnionExprNoRoot(ctx->unionExprNoRoot());
+    xpathValue l = eval_union_expr(ctx->unionExprNoRoot());
     if (ctx->children.size()==1) return l;
-    if (!l.is<long double>()) T("expecting number but failed");
-    if (ctx->MINUS().size() % 2 == 0) return l;
-    long double ldbl = l;
-    l = -ldbl;
-    return l;
-}
-
-antlrcpp::Any xpathDomVisitor::visitQName(xpathParser::QNameContext *ctx) {
-    // std::vector<NCNameContext *> nCName();
-    // NCNameContext* nCName(size_t i);
-    // antlr4::tree::TerminalNode *COLON();
-    std::string sprefix, slocal_part;
-    if (ctx->COLON()) {
-        antlrcpp::Any any = visitNCName(ctx->nCName(0));
-        sprefix = any.as<std::string>();
-        any = visitNCName(ctx->nCName(1));
-        slocal_part = any.as<std::string>();
-    } else {
-        antlrcpp::Any any = visitNCName(ctx->nCName(0));
-        slocal_part = any.as<std::string>();
+    if (!l.is_number()) T("expecting number but failed");
+    size_t minus = 0;
+    for (auto node: ctx->children) {
+        if (token_type(node) == xpathParser::MINUS) ++minus;
     }
-
-    return do_name_test(dom_, sprefix.empty() ? NULL : sprefix.c_str(), slocal_part.c_str());
+    if (minus % 2 == 0) return l;
+    return -l.number;
 }
 
-antlrcpp::Any xpathDomVisitor::visitFunctionName(xpathParser::FunctionNameContext *ctx) {
+bool xpathDomVisitor::eval_qname(xpathParser::QNameContext *ctx) {
     // std::vector<NCNameContext *> nCName();
     // NCNameContext* nCName(size_t i);
     // antlr4::tree::TerminalNode *COLON();
-    // antlr4::tree::TerminalNode *NCName();
-    // antlr4::tree::TerminalNode *AxisName();
     if (ctx->COLON()) {
-        const std::string &prefix = visitNCName(ctx->nCName(0));
-        const std::string &local_part = visitNCName(ctx->nCName(1));
-        return std::tuple<std::string, std::string>{prefix, local_part};
-    }
-    if (ctx->NCName()) {
-        const std::string &local_part = ctx->NCName()->getText();
-        return std::tuple<std::string, std::string>{"", local_part};
-    }
-    if (ctx->AxisName()) {
-        const std::string &local_part = ctx->AxisName()->getText();
-        return std::tuple<std::string, std::string>{"", local_part};
+        const std::string &prefix     = eval_ncname(ctx->nCName(0));
+        const std::string &local_part = eval_ncname(ctx->nCName(1));
+        return do_name_test(dom_, prefix.empty() ? NULL : prefix.c_str(), local_part.c_str(), tokens_->atom(ctx));
     }
-    A(0, "internal logic error");
-    // never reached here
-    return false;
-}
 
-antlrcpp::Any xpathDomVisitor::visitVariableReference(xpathParser::VariableReferenceContext *ctx) {
-    (void)ctx;
-    T("internal logic error");
+    const std::string &local_part = eval_ncname(ctx->nCName(0));
+    return do_name_test(dom_, NULL, local_part.c_str(), tokens_->atom(ctx));
 }
 
-antlrcpp::Any xpathDomVisitor::visitNameTest(xpathParser::NameTestContext *ctx) {
+bool xpathDomVisitor::eval_name_test(xpathParser::NameTestContext *ctx) {
     // antlr4::tree::TerminalNode *MUL();
     // NCNameContext *nCName();
     // antlr4::tree::TerminalNode *COLON();
     // QNameContext *qName();
     if (ctx->MUL()) {
-        return do_name_test(dom_, NULL, "*");
+        return do_name_test(dom_, NULL, "*", HVML_ATOM_NONE);
     }
     if (ctx->nCName()) {
         T("internal logic error");
     }
     if (ctx->qName()) {
-        return visitQName(ctx->qName());
+        return eval_qname(ctx->qName());
     }
     A(0, "internal logic error");
     // never reached here
     return false;
 }
 
-antlrcpp::Any xpathDomVisitor::visitNCName(xpathParser::NCNameContext *ctx) {
+const std::string& xpathDomVisitor::eval_ncname(xpathParser::NCNameContext *ctx) {
     // antlr4::tree::TerminalNode *NCName();
     // antlr4::tree::TerminalNode *AxisName();
     // antlr4::tree::TerminalNode *NodeType();
-    if (ctx->NCName()) return ctx->NCName()->getText();
-    if (ctx->AxisName()) return ctx->AxisName()->getText();
-    if (ctx->NodeType()) return ctx->NodeType()->getText();
+    if (ctx->NCName()) return tokens_->text(ctx->NCName());
+    if (ctx->AxisName()) return tokens_->text(ctx->AxisName());
+    if (ctx->NodeType()) return tokens_->text(ctx->NodeType());
     T("internal logic error");
 }
 
@@ -899,18 +1067,14 @@ xpathNodeset xpathDomVisitor::stepToRoot(void) {
 }
 
 xpathNodeset xpathDomVisitor::do_step(xpathNodeset &doms, xpathParser::StepContext *ctx) {
-    // AxisSpecifierContext *axisSpecifier();
-    // NodeTestContext *nodeTest();
-    // std::vector<PredicateContext *> predicate();
-    // PredicateContext* predicate(size_t i);
-    // AbbreviatedStepContext *abbreviatedStep();
     xpathNodeset output = make_nodeset();
+    if (doms->ndoms==0) return output;
+
+    // one context for the whole step, rebound to each node
+    xpathDomVisitor visitor(doms->doms[0], 0, 1, this);
     for (size_t i=0; i<doms->ndoms; ++i) {
-        hvml_dom_t *dom = doms->doms[i];
-        xpathDomVisitor visitor(dom, 0, 1);
-        antlrcpp::Any any = visitor.visitStep(ctx);
-        if (!any.is<xpathNodeset>()) T("expecting node set but failed");
-        xpathNodeset tail = any;
+        visitor.rebind(doms->doms[i], 0, 1);
+        xpathNodeset tail = visitor.eval_step(ctx);
         if (hvml_doms_append_doms(output.get(), tail.get())) T("out of memory");
     }
     return output;
@@ -918,9 +1082,11 @@ xpathNodeset xpathDomVisitor::do_step(xpathNodeset &doms, xpathParser::StepConte
 
 xpathNodeset xpathDomVisitor::do_collect_descendant_or_self(xpathNodeset &doms) {
     xpathNodeset output = make_nodeset();
+    if (doms->ndoms==0) return output;
+
+    xpathDomVisitor visitor(doms->doms[0], 0, 1, this);
     for (size_t i=0; i<doms->ndoms; ++i) {
-        hvml_dom_t *dom = doms->doms[i];
-        xpathDomVisitor visitor(dom, 0, 1);
+        visitor.rebind(doms->doms[i], 0, 1);
         xpathNodeset tail = visitor.do_axis_descendant_or_self();
         if (hvml_doms_append_doms(output.get(), tail.get())) T("out of memory");
     }
@@ -929,11 +1095,12 @@ xpathNodeset xpathDomVisitor::do_collect_descendant_or_self(xpathNodeset &doms)
 
 xpathNodeset xpathDomVisitor::do_relative(xpathNodeset &doms, xpathParser::RelativeLocationPathContext *ctx) {
     xpathNodeset output = make_nodeset();
+    if (doms->ndoms==0) return output;
+
+    xpathDomVisitor visitor(doms->doms[0], 0, 1, this);
     for (size_t i=0; i<doms->ndoms; ++i) {
-        xpathDomVisitor visitor(doms->doms[i], 0, 1);
-        antlrcpp::Any any = visitor.visitRelativeLocationPath(ctx);
-        if (!any.is<xpathNodeset>()) T("expecting node set but failed");
-        xpathNodeset tail = any;
+        visitor.rebind(doms->doms[i], 0, 1);
+        xpathNodeset tail = visitor.eval_relative_location_path(ctx);
         if (hvml_doms_append_doms(output.get(), tail.get())) T("out of memory");
     }
     return output;
@@ -1132,13 +1299,14 @@ xpathNodeset xpathDomVisitor::do_axis_self(void) {
 
 xpathNodeset xpathDomVisitor::do_nodetest(xpathNodeset &doms, HVML_DOM_XPATH_PRINCIPAL_TYPE principal, xpathParser::NodeTestContext *ctx) {
     xpathNodeset output = make_nodeset();
+    if (doms->ndoms==0) return output;
+
+    xpathDomVisitor visitor(doms->doms[0], 0, 1, this);
     for (size_t i=0; i<doms->ndoms; ++i) {
         hvml_dom_t *dom = doms->doms[i];
-        xpathDomVisitor visitor(dom, 0, 1);
+        visitor.rebind(dom, 0, 1);
         visitor.principal_ = principal;
-        antlrcpp::Any any = visitor.visitNodeTest(ctx);
-        if (!any.is<bool>()) T("expecting boolean but failed");
-        if (!any) continue;
+        if (!visitor.eval_node_test(ctx)) continue;
         if (hvml_doms_append_dom(output.get(), dom)) T("out of memory");
     }
     return output;
@@ -1146,56 +1314,40 @@ xpathNodeset xpathDomVisitor::do_nodetest(xpathNodeset &doms, HVML_DOM_XPATH_PRI
 
 xpathNodeset xpathDomVisitor::do_predicate(xpathNodeset &doms, xpathParser::PredicateContext *ctx) {
     xpathNodeset output = make_nodeset();
+    if (doms->ndoms==0) return output;
 
+    xpathDomVisitor visitor(doms->doms[0], 0, doms->ndoms, this);
     for (size_t i=0; i<doms->ndoms; ++i) {
         hvml_dom_t *dom = doms->doms[i];
-        xpathDomVisitor visitor(dom, i, doms->ndoms);
-        antlrcpp::Any any = visitor.visitPredicate(ctx);
-        if (!any.is<bool>()) T("expecting boolean but failed");
-        bool ok = any;
-        if (!ok) continue;
+        visitor.rebind(dom, i, doms->ndoms);
+        if (!visitor.eval_predicate(ctx)) continue;
         if (hvml_doms_append_dom(output.get(), dom)) T("out of memory");
     }
 
     return output;
 }
 
-static antlrcpp::Any do_compare(HVML_DOM_XPATH_OP_TYPE op, const antlrcpp::Any &left, const antlrcpp::Any &right);
-
-antlrcpp::Any xpathDomVisitor::do_eq(const antlrcpp::Any &left, const antlrcpp::Any &right) {
-    return do_compare(HVML_DOM_XPATH_OP_EQ, left, right);
-}
-
-antlrcpp::Any xpathDomVisitor::do_less(const antlrcpp::Any &left, const antlrcpp::Any &right) {
-    return do_compare(HVML_DOM_XPATH_OP_LT, left, right);
-}
-
-antlrcpp::Any xpathDomVisitor::do_lte(const antlrcpp::Any &left, const antlrcpp::Any &right) {
-    return do_compare(HVML_DOM_XPATH_OP_LTE, left, right);
-}
-
-antlrcpp::Any xpathDomVisitor::do_op(const std::string &op, const antlrcpp::Any &left, const antlrcpp::Any &right) {
+xpathValue xpathDomVisitor::do_op(char op, const xpathValue &left, const xpathValue &right) {
     long double l = to_number(left);
     long double r = to_number(right);
-    if (op == "+") {
-        return l + r;
-    } else if (op == "-") {
-        return l - r;
-    } else if (op == "*") {
-        return l * r;
-    } else if (op == "/") {
-        return l / r;
-    } else if (op == "%") {
-        int s = signbit(l);
-        l = fabsl(l);
-        r = fabsl(r);
-        long double v = l / r;
-        A(v<=INT64_MAX, "overflow, not supported");
-        int64_t t = (int64_t)v;
-        l -= r * t;
-        return s ? -l : l;
-    } else {
-        A(0, "internal logic error");
+    switch (op) {
+        case '+': return l + r;
+        case '-': return l - r;
+        case '*': return l * r;
+        case '/': return l / r;
+        case '%': {
+            int s = signbit(l);
+            l = fabsl(l);
+            r = fabsl(r);
+            long double v = l / r;
+            A(v<=INT64_MAX, "overflow, not supported");
+            int64_t t = (int64_t)v;
+            l -= r * t;
+            return s ? -l : l;
+        } break;
+        default: {
+            A(0, "internal logic error");
+        } break;
     }
     A(0, "internal logic error");
     return false;
@@ -1220,14 +1372,16 @@ bool xpathDomVisitor::do_node_type(hvml_dom_t *dom, const std::string &nt) {
     T("internal logic error");
 }
 
-bool xpathDomVisitor::do_name_test(hvml_dom_t *dom, const char *prefix, const char *local_part) {
+// atom: of "xxx" or "xxx:yyy" as a whole, not used for wildcards
+bool xpathDomVisitor::do_name_test(hvml_dom_t *dom, const char *prefix, const char *local_part, hvml_atom_t atom) {
     A(principal_!=HVML_DOM_XPATH_PRINCIPAL_UNSPECIFIED, "internal logic error");
-    const char *tok = NULL;
+    hvml_atom_t name = HVML_ATOM_NONE;
     if (hvml_dom_type(dom) == MKDOT(D_TAG)) {
-        tok = hvml_dom_tag_name(dom);
+        name = hvml_dom_tag_atom(dom);
     } else if (hvml_dom_type(dom) == MKDOT(D_ATTR)) {
-        tok = hvml_dom_attr_key(dom);
+        name = hvml_dom_attr_atom(dom);
     }
+    const char *tok   = name ? hvml_atom_str(name) : NULL;
     const char *colon = tok ? strchr(tok, ':') : NULL;
 
     if (strcmp(local_part, "*")==0) {
@@ -1265,161 +1419,171 @@ bool xpathDomVisitor::do_name_test(hvml_dom_t *dom, const char *prefix, const ch
         if (strcmp(colon+1, local_part)) return false;
         return true;
     }
-    if (!prefix) {
-        // "xxx"
-        if (!tok) return false;
-        if (strcmp(tok, local_part)) return false;
-        return true;
-    }
-    // "xxx:yyy"
-    if (!tok) return false;
-    if (!colon) return false;
-    if (strstr(tok, prefix)!=tok) return false;
-    if (strcmp(colon+1, local_part)) return false;
-    return true;
+    // "xxx" or "xxx:yyy"
+    if (!name) return false;
+    return name == atom;
 }
 
-bool xpathDomVisitor::to_bool(const antlrcpp::Any &any) {
-    bool v = false;
-    if (any.is<bool>()) {
-        v = any;
-    } else if (any.is<long double>()) {
-        long double number = any;
-        int fc = fpclassify(number);
-        switch (fc) {
-            case FP_INFINITE:
-            case FP_SUBNORMAL:
-            case FP_NORMAL: {
-                v = true;
-            } break;
-            case FP_NAN:
-            case FP_ZERO: {
-                v = false;
-            } break;
-            default: {
-                T("internal logic error");
-            } break;
-        }
-    } else if (any.is<std::string>()) {
-        const std::string &literal = any;
-        if (!literal.empty()) v = true;
-    } else if (any.is<xpathNodeset>()) {
-        xpathNodeset doms = any;
-        if (doms->ndoms>0) v = true;
-    } else {
-        T("internal logic error");
-    }
-    return v;
-}
-
-long double xpathDomVisitor::to_number(const antlrcpp::Any &any) {
-    long double v = NAN;
-    if (any.is<bool>()) {
-        bool t = any;
-        v = t ? 1 : 0;
-    } else if (any.is<long double>()) {
-        v = any;
-    } else if (any.is<std::string>()) {
-        const std::string &literal = any;
-        hvml_string_to_number(literal.c_str(), &v);
-    } else if (any.is<xpathNodeset>()) {
-        std::string s = to_string(any);
-        hvml_string_to_number(s.c_str(), &v);
-    } else {
-        T("internal logic error");
+bool xpathDomVisitor::to_bool(const xpathValue &v) {
+    switch (v.type) {
+        case xpathValue::BOOLEAN: {
+            return v.boolean;
+        } break;
+        case xpathValue::NUMBER: {
+            int fc = fpclassify(v.number);
+            switch (fc) {
+                case FP_INFINITE:
+                case FP_SUBNORMAL:
+                case FP_NORMAL: {
+                    return true;
+                } break;
+                case FP_NAN:
+                case FP_ZERO: {
+                    return false;
+                } break;
+                default: {
+                    T("internal logic error");
+                } break;
+            }
+        } break;
+        case xpathValue::STRING: {
+            return !v.string.empty();
+        } break;
+        case xpathValue::NODESET: {
+            return v.nodeset->ndoms>0;
+        } break;
+        default: {
+            T("internal logic error");
+        } break;
     }
-    return v;
+    return false;
 }
 
-std::string xpathDomVisitor::to_string(const antlrcpp::Any &any) {
-    std::string v;
-    if (any.is<bool>()) {
-        bool t = any;
-        v = t ? "true" : "false";
-    } else if (any.is<long double>()) {
-        long double ldbl = any;
-        int fc = fpclassify(ldbl);
-        switch (fc) {
-            case FP_NAN: {
-                v = "NaN";
-            } break;
-            case FP_INFINITE: {
-                int sb = signbit(ldbl);
-                v = sb ? "-Infinity" : "Infinity";
-            } break;
-            case FP_ZERO: {
-                v = "0";
-            } break;
-            case FP_SUBNORMAL: {
-                char buf[128];
-                snprintf(buf, sizeof(buf), "%.*Lf", int(sizeof(buf)/2), ldbl);
-                v = buf;
-            } break;
-            case FP_NORMAL: {
-                char buf[128];
-                snprintf(buf, sizeof(buf), "%.*Lf", int(sizeof(buf)/2), ldbl);
-                v = buf;
-            } break;
-            default: {
-                T("internal logic error");
-            } break;
-        }
-    } else if (any.is<std::string>()) {
-        v = any.as<std::string>();
-    } else if (any.is<xpathNodeset>()) {
-        xpathNodeset doms = any;
-        if (doms->ndoms==0) return "";
-        hvml_dom_t *dom = doms->doms[0];
-        const char *s = NULL;
-        int allocated = 0;
-        if (hvml_dom_string_for_xpath(dom, &s, &allocated)) T("out of memory");
-        A(s, "internal logic error");
-        std::string str = s;
-        if (allocated) free((void*)s);
-        return str;
-    } else {
-        T("internal logic error");
+long double xpathDomVisitor::to_number(const xpathValue &v) {
+    long double n = NAN;
+    switch (v.type) {
+        case xpathValue::BOOLEAN: {
+            n = v.boolean ? 1 : 0;
+        } break;
+        case xpathValue::NUMBER: {
+            n = v.number;
+        } break;
+        case xpathValue::STRING: {
+            hvml_string_to_number(v.string.c_str(), &n);
+        } break;
+        case xpathValue::NODESET: {
+            std::string s = to_string(v);
+            hvml_string_to_number(s.c_str(), &n);
+        } break;
+        default: {
+            T("internal logic error");
+        } break;
     }
-    return v;
+    return n;
 }
 
-static antlrcpp::Any do_compare(HVML_DOM_XPATH_OP_TYPE op, const antlrcpp::Any &left, const antlrcpp::Any &right) {
-    if (left.is<xpathNodeset>() && right.is<xpathNodeset>()) {
-        D("not implemented yet");
-        return false;
-    }
-    if (left.is<xpathNodeset>() || right.is<xpathNodeset>()) {
-        if (right.is<xpathNodeset>()) {
-            switch (op) {
-                case HVML_DOM_XPATH_OP_EQ: {
-                    return do_compare(op, right, left);
+std::string xpathDomVisitor::to_string(const xpathValue &v) {
+    switch (v.type) {
+        case xpathValue::BOOLEAN: {
+            return v.boolean ? "true" : "false";
+        } break;
+        case xpathValue::NUMBER: {
+            long double ldbl = v.number;
+            int fc = fpclassify(ldbl);
+            switch (fc) {
+                case FP_NAN: {
+                    return "NaN";
+                } break;
+                case FP_INFINITE: {
+                    int sb = signbit(ldbl);
+                    return sb ? "-Infinity" : "Infinity";
                 } break;
-                case HVML_DOM_XPATH_OP_LT: {
-                    return do_compare(HVML_DOM_XPATH_OP_GT, right, left);
+                case FP_ZERO: {
+                    return "0";
                 } break;
-                case HVML_DOM_XPATH_OP_LTE: {
-                    return do_compare(HVML_DOM_XPATH_OP_GTE, right, left);
+                case FP_SUBNORMAL:
+                case FP_NORMAL: {
+                    char buf[128];
+                    snprintf(buf, sizeof(buf), "%.*Lf", int(sizeof(buf)/2), ldbl);
+                    return buf;
                 } break;
                 default: {
-                    A(0, "internal logic error");
-                    // never reached here
-                    return false;
+                    T("internal logic error");
                 } break;
             }
+        } break;
+        case xpathValue::STRING: {
+            return v.string;
+        } break;
+        case xpathValue::NODESET: {
+            hvml_doms_t *doms = v.nodeset.get();
+            if (doms->ndoms==0) return "";
+            hvml_dom_t *dom = doms->doms[0];
+            const char *s = NULL;
+            int allocated = 0;
+            if (hvml_dom_string_for_xpath(dom, &s, &allocated)) T("out of memory");
+            A(s, "internal logic error");
+            std::string str = s;
+            if (allocated) free((void*)s);
+            return str;
+        } break;
+        default: {
+            T("internal logic error");
+        } break;
+    }
+    return "";
+}
+
+antlrcpp::Any xpathDomVisitor::to_any(const xpathValue &v) {
+    switch (v.type) {
+        case xpathValue::BOOLEAN: return v.boolean;
+        case xpathValue::NUMBER:  return v.number;
+        case xpathValue::STRING:  return v.string;
+        case xpathValue::NODESET: return v.nodeset;
+        default: {
+            T("internal logic error");
+        } break;
+    }
+    return false;
+}
+
+static bool do_compare(HVML_DOM_XPATH_OP_TYPE op, const xpathValue &left, const xpathValue &right) {
+    if (left.is_nodeset() && right.is_nodeset()) {
+        D("not implemented yet");
+        return false;
+    }
+    if (right.is_nodeset()) {
+        switch (op) {
+            case HVML_DOM_XPATH_OP_EQ: {
+                return do_compare(op, right, left);
+            } break;
+            case HVML_DOM_XPATH_OP_LT: {
+                return do_compare(HVML_DOM_XPATH_OP_GT, right, left);
+            } break;
+            case HVML_DOM_XPATH_OP_LTE: {
+                return do_compare(HVML_DOM_XPATH_OP_GTE, right, left);
+            } break;
+            default: {
+                A(0, "internal logic error");
+                // never reached here
+                return false;
+            } break;
         }
     }
     if (op == HVML_DOM_XPATH_OP_EQ) {
-        if (left.is<bool>() || right.is<bool>()) {
+        if (left.is_boolean() || right.is_boolean()) {
             bool l = xpathDomVisitor::to_bool(left);
             bool r = xpathDomVisitor::to_bool(right);
             return l == r;
         }
-        if (left.is<long double>() || right.is<long double>()) {
+        if (left.is_number() || right.is_number()) {
             long double l = xpathDomVisitor::to_number(left);
             long double r = xpathDomVisitor::to_number(right);
             return fabsl(l-r) <= DBL_EPSILON;
         }
-        if (left.is<std::string>() || right.is<std::string>()) {
+        if (left.is_string() || right.is_string()) {
+            // no copy needed when both are strings already
+            if (left.is_string() && right.is_string()) return left.string == right.string;
             std::string l = xpathDomVisitor::to_string(left);
             std::string r = xpathDomVisitor::to_string(right);
             return l == r;
@@ -1441,4 +1605,3 @@ static antlrcpp::Any do_compare(HVML_DOM_XPATH_OP_TYPE op, const antlrcpp::Any &
         }
     }
 }
-
@@ -26,12 +26,90 @@
 
 #include "hvml_dom_xpath_parser.h"
 
-struct xpathError {};
-typedef std::shared_ptr<hvml_doms_t> xpathNodeset;
+#include <memory>
+#include <string>
+#include <vector>
+
+struct xpathNodesetEntry;
+
+// refcounted node set
+// the hvml_doms_t behind comes from a per-thread pool, and keeps its buffers
+// when released, thus steps and predicates allocate nothing in steady state
+// not to be shared among threads
+class xpathNodeset {
+public:
+    xpathNodeset(): entry_(nullptr) {}
+    xpathNodeset(const xpathNodeset &other);
+    xpathNodeset(xpathNodeset &&other) noexcept;
+    ~xpathNodeset();
+    xpathNodeset& operator=(const xpathNodeset &other);
+    xpathNodeset& operator=(xpathNodeset &&other) noexcept;
+
+    static xpathNodeset make();
+
+    hvml_doms_t* get() const;
+    hvml_doms_t* operator->() const { return get(); }
+
+private:
+    void release();
+
+private:
+    xpathNodesetEntry              *entry_;
+};
+
+// value of an expression, tagged instead of boxed into antlrcpp::Any
+struct xpathValue {
+    enum Type { NODESET, BOOLEAN, NUMBER, STRING };
+
+    xpathValue(): type(BOOLEAN), boolean(false), number(0) {}
+    xpathValue(bool v): type(BOOLEAN), boolean(v), number(0) {}
+    xpathValue(long double v): type(NUMBER), boolean(false), number(v) {}
+    xpathValue(const char *v): type(STRING), boolean(false), number(0), string(v) {}
+    xpathValue(const std::string &v): type(STRING), boolean(false), number(0), string(v) {}
+    xpathValue(std::string &&v): type(STRING), boolean(false), number(0), string(std::move(v)) {}
+    xpathValue(const xpathNodeset &v): type(NODESET), boolean(false), number(0), nodeset(v) {}
+
+    bool is_nodeset() const { return type==NODESET; }
+    bool is_boolean() const { return type==BOOLEAN; }
+    bool is_number() const  { return type==NUMBER;  }
+    bool is_string() const  { return type==STRING;  }
+
+    Type                            type;
+    bool                            boolean;
+    long double                     number;
+    std::string                     string;
+    xpathNodeset                    nodeset;
+};
+
+// texts, numbers and atoms of tokens, extracted once per evaluation
+// antlr4 rebuilds token text from the input stream on every getText()
+class xpathTokens {
+public:
+    const std::string& text(antlr4::tree::ParseTree *node);
+    long double number(antlr4::tree::TerminalNode *node);
+    // HVML_ATOM_NONE if no tag or attr is ever named so
+    hvml_atom_t atom(antlr4::tree::ParseTree *node);
+
+private:
+    struct entry {
+        antlr4::tree::ParseTree    *node;
+        std::string                 text;
+        long double                 number;
+        bool                        parsed;
+        hvml_atom_t                 atom;
+        bool                        atomized;
+    };
+    entry& lookup(antlr4::tree::ParseTree *node);
+
+private:
+    std::vector<std::unique_ptr<entry>>     entries_;
+};
 
 /**
- * This class provides an empty implementation of xpathVisitor, which can be
- * extended to create a visitor which only needs to handle a subset of the available methods.
+ * Evaluates the parse tree against a context node.
+ * Internally, values travel as xpathValue, and visit* overrides only wrap
+ * them into antlrcpp::Any.
+ * Per-node visitors are created once per step and rebound to each node.
  */
 class  xpathDomVisitor : public xpathVisitor {
 public:
@@ -67,7 +145,34 @@ public:
     virtual antlrcpp::Any visitNCName(xpathParser::NCNameContext *ctx) override;
 
 private:
-    bool empty() const;
+    xpathDomVisitor(hvml_dom_t *dom, size_t idx, size_t size, xpathDomVisitor *parent);
+    void rebind(hvml_dom_t *dom, size_t idx, size_t size);
+
+    xpathNodeset eval_main(xpathParser::MainContext *ctx);
+    xpathNodeset eval_location_path(xpathParser::LocationPathContext *ctx);
+    xpathNodeset eval_absolute_location_path(xpathParser::AbsoluteLocationPathNorootContext *ctx);
+    xpathNodeset eval_relative_location_path(xpathParser::RelativeLocationPathContext *ctx);
+    xpathNodeset eval_step(xpathParser::StepContext *ctx);
+    xpathNodeset eval_axis_specifier(xpathParser::AxisSpecifierContext *ctx);
+    bool         eval_node_test(xpathParser::NodeTestContext *ctx);
+    bool         eval_predicate(xpathParser::PredicateContext *ctx);
+    xpathNodeset eval_abbreviated_step(xpathParser::AbbreviatedStepContext *ctx);
+    xpathValue   eval_expr(xpathParser::ExprContext *ctx);
+    xpathValue   eval_primary_expr(xpathParser::PrimaryExprContext *ctx);
+    xpathValue   eval_function_call(xpathParser::FunctionCallContext *ctx);
+    xpathValue   eval_union_expr(xpathParser::UnionExprNoRootContext *ctx);
+    xpathValue   eval_path_expr(xpathParser::PathExprNoRootContext *ctx);
+    xpathValue   eval_filter_expr(xpathParser::FilterExprContext *ctx);
+    xpathValue   eval_or_expr(xpathParser::OrExprContext *ctx);
+    xpathValue   eval_and_expr(xpathParser::AndExprContext *ctx);
+    xpathValue   eval_equality_expr(xpathParser::EqualityExprContext *ctx);
+    xpathValue   eval_relational_expr(xpathParser::RelationalExprContext *ctx);
+    xpathValue   eval_additive_expr(xpathParser::AdditiveExprContext *ctx);
+    xpathValue   eval_multiplicative_expr(xpathParser::MultiplicativeExprContext *ctx);
+    xpathValue   eval_unary_expr(xpathParser::UnaryExprNoRootContext *ctx);
+    bool         eval_qname(xpathParser::QNameContext *ctx);
+    bool         eval_name_test(xpathParser::NameTestContext *ctx);
+    const std::string& eval_ncname(xpathParser::NCNameContext *ctx);
 
     xpathNodeset stepToRoot(void);
     xpathNodeset do_step(xpathNodeset &doms, xpathParser::StepContext *ctx);
@@ -88,25 +193,26 @@ private:
     xpathNodeset do_axis_self(void);
     xpathNodeset do_nodetest(xpathNodeset &doms, HVML_DOM_XPATH_PRINCIPAL_TYPE principal, xpathParser::NodeTestContext *ctx);
     xpathNodeset do_predicate(xpathNodeset &doms, xpathParser::PredicateContext *ctx);
-    bool         do_predicate(const antlrcpp::Any &any);
-    antlrcpp::Any do_eq(const antlrcpp::Any &left, const antlrcpp::Any &right);
-    antlrcpp::Any do_less(const antlrcpp::Any &left, const antlrcpp::Any &right);
-    antlrcpp::Any do_lte(const antlrcpp::Any &left, const antlrcpp::Any &right);
-    antlrcpp::Any do_op(const std::string &op, const antlrcpp::Any &left, const antlrcpp::Any &right);
+    bool         do_predicate(const xpathValue &v);
+    xpathValue   do_op(char op, const xpathValue &left, const xpathValue &right);
 
-    bool do_name_test(hvml_dom_t *dom, const char *prefix, const char *local_part);
+    bool do_name_test(hvml_dom_t *dom, const char *prefix, const char *local_part, hvml_atom_t atom);
     bool do_node_type(hvml_dom_t *dom, const std::string &nt);
 
 public:
-    static bool to_bool(const antlrcpp::Any &any);
-    static long double to_number(const antlrcpp::Any &any);
-    static std::string to_string(const antlrcpp::Any &any);
+    static bool to_bool(const xpathValue &v);
+    static long double to_number(const xpathValue &v);
+    static std::string to_string(const xpathValue &v);
+    static antlrcpp::Any to_any(const xpathValue &v);
 
 private:
     hvml_dom_t                     *dom_;
-    const size_t                    idx_;
-    const size_t                    size_;
+    size_t                          idx_;
+    size_t                          size_;
     HVML_DOM_XPATH_AXIS_TYPE        axis_;
     HVML_DOM_XPATH_PRINCIPAL_TYPE   principal_;
+
+    xpathTokens                     own_tokens_;
+    xpathTokens                    *tokens_;       // shared with the visitors created thru this
 };
 
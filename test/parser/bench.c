@@ -0,0 +1,2007 @@
+// This file is a part of Purring Cat, a reference implementation of HVML.
+//
+// Copyright (C) 2020, <freemine@yeah.net>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// micro benchmarks
+// usage: hb <bench> [args...]
+
+#include "hvml/hvml_atom.h"
+#include "hvml/hvml_dom.h"
+#include "hvml/hvml_dom_pack.h"
+#include "hvml/hvml_escape.h"
+#include "hvml/hvml_log.h"
+#include "hvml/hvml_parser.h"
+#include "hvml/hvml_printf.h"
+#include "hvml/hvml_reader.h"
+#include "hvml/hvml_string.h"
+#include "hvml/hvml_utf8.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+
+#ifdef HB_WRAP_ALLOC
+#include <malloc.h>
+
+// linked with --wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+// thus every allocation made by hvml_parser_static and by this file is counted
+// and so are the bytes still in use
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void *ptr, size_t size);
+void  __real_free(void *ptr);
+
+static size_t allocs = 0;
+static size_t live   = 0;
+
+void* __wrap_malloc(size_t size) {
+    ++allocs;
+    void *p = __real_malloc(size);
+    if (p) live += malloc_usable_size(p);
+    return p;
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+    ++allocs;
+    void *p = __real_calloc(nmemb, size);
+    if (p) live += malloc_usable_size(p);
+    return p;
+}
+
+void* __wrap_realloc(void *ptr, size_t size) {
+    ++allocs;
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void  *p   = __real_realloc(ptr, size);
+    if (p)         live += malloc_usable_size(p) - old;
+    else if (!size) live -= old;
+    return p;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr) live -= malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+#else
+static size_t allocs = 0;   // not counted in this build
+static size_t live   = 0;
+#endif
+
+typedef struct bench_s            bench_t;
+typedef int (*bench_func)(int argc, char *argv[]);
+
+struct bench_s {
+    const char         *name;
+    const char         *args;
+    bench_func          func;
+};
+
+static int bench_string(int argc, char *argv[]);
+static int bench_parse(int argc, char *argv[]);
+static int bench_xpath(int argc, char *argv[]);
+static int bench_qry(int argc, char *argv[]);
+static int bench_predicate(int argc, char *argv[]);
+static int bench_serialize(int argc, char *argv[]);
+static int bench_escape(int argc, char *argv[]);
+static int bench_load(int argc, char *argv[]);
+static int bench_snapshot(int argc, char *argv[]);
+static int bench_footprint(int argc, char *argv[]);
+static int bench_destroy(int argc, char *argv[]);
+static int bench_clone(int argc, char *argv[]);
+static int bench_jo_clone(int argc, char *argv[]);
+static int bench_numbers(int argc, char *argv[]);
+static int bench_json(int argc, char *argv[]);
+static int bench_small(int argc, char *argv[]);
+static int bench_utf8(int argc, char *argv[]);
+static int bench_events(int argc, char *argv[]);
+static int bench_atoms(int argc, char *argv[]);
+
+static const bench_t benches[] = {
+    { "string",   "[bytes]",               bench_string  },
+    { "parse",    "<file> [rounds]",       bench_parse   },
+    { "xpath",    "<hvml> <xpaths> [rounds]", bench_xpath  },
+    { "qry",      "<hvml> <xpaths> [rounds]", bench_qry    },
+    { "predicate", "[rows] [rounds]",      bench_predicate },
+    { "serialize", "[kbytes] [rounds]",    bench_serialize },
+    { "escape",   "[kbytes] [rounds]",     bench_escape  },
+    { "load",     "<file> [rounds]",       bench_load    },
+    { "snapshot", "<file> <snap> [rounds]", bench_snapshot },
+    { "footprint", "[elements]",           bench_footprint },
+    { "destroy",  "[depth] [rounds]",      bench_destroy },
+    { "clone",    "<hvml> [scale] [rounds]", bench_clone  },
+    { "jo_clone", "<json> [scale] [rounds]", bench_jo_clone },
+    { "numbers",  "[count] [rounds]",      bench_numbers },
+    { "json",     "<json> [scale] [rounds]", bench_json   },
+    { "small",    "[rounds]",              bench_small   },
+    { "utf8",     "[kbytes] [rounds]",     bench_utf8    },
+    { "events",   "<hvml> [rounds]",       bench_events  },
+    { "atoms",    "[count] [rounds]",      bench_atoms   },
+};
+
+typedef struct measure_s          measure_t;
+struct measure_s {
+    clock_t          start;
+    size_t           allocs;
+};
+
+static void measure_start(measure_t *m) {
+    m->allocs = allocs;
+    m->start  = clock();
+}
+
+static void measure_report(measure_t *m, const char *title, size_t bytes) {
+    clock_t end    = clock();
+    double  ms     = (double)(end - m->start) * 1000. / CLOCKS_PER_SEC;
+    size_t  n      = allocs - m->allocs;
+#ifdef HB_WRAP_ALLOC
+    fprintf(stdout, "%-32s %10zu bytes %10zu allocs %10.3f ms", title, bytes, n, ms);
+#else
+    (void)n;
+    fprintf(stdout, "%-32s %10zu bytes %10s allocs %10.3f ms", title, bytes, "n/a", ms);
+#endif
+    if (ms > 0 && bytes > 0) {
+        fprintf(stdout, " %10.2f MB/s", (double)bytes / (1024. * 1024.) / (ms / 1000.));
+    }
+    fprintf(stdout, "\n");
+}
+
+static char* load_file(const char *file, size_t *len) {
+    FILE *in = fopen(file, "rb");
+    if (!in) {
+        E("failed to open file: %s", file);
+        return NULL;
+    }
+
+    hvml_string_t str = {0};
+    char          buf[4096];
+    size_t        n   = 0;
+    int           r   = 0;
+    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
+        if (hvml_string_reserve(&str, str.len + n)) {
+            r = -1;
+            break;
+        }
+        memcpy(str.str + str.len, buf, n);
+        str.len += n;
+        str.str[str.len] = '\0';
+    }
+    fclose(in);
+
+    if (r || !str.str) {
+        E("failed to load file: %s", file);
+        hvml_string_clear(&str);
+        return NULL;
+    }
+
+    *len = str.len;
+    return str.str;
+}
+
+// building a token byte by byte, as the parsers do
+static int bench_string(int argc, char *argv[]) {
+    size_t bytes = 1024 * 1024;
+    if (argc > 0) bytes = (size_t)strtoull(argv[0], NULL, 0);
+
+    measure_t m;
+
+    // previous policy: realloc to len+2 for every byte
+    measure_start(&m);
+    char *s = NULL;
+    for (size_t i=0; i<bytes; ++i) {
+        char *p = (char*)realloc(s, i + 2);
+        if (!p) {
+            free(s);
+            return -1;
+        }
+        s        = p;
+        s[i]     = 'x';
+        s[i + 1] = '\0';
+    }
+    free(s);
+    measure_report(&m, "realloc(len+2) per byte", bytes);
+
+    hvml_string_t str = {0};
+
+    measure_start(&m);
+    for (size_t i=0; i<bytes; ++i) {
+        if (hvml_string_push(&str, 'x')) return -1;
+    }
+    measure_report(&m, "hvml_string_push", bytes);
+    hvml_string_clear(&str);
+
+    measure_start(&m);
+    if (hvml_string_reserve(&str, bytes)) return -1;
+    for (size_t i=0; i<bytes; ++i) {
+        if (hvml_string_push(&str, 'x')) return -1;
+    }
+    measure_report(&m, "hvml_string_reserve+push", bytes);
+    hvml_string_clear(&str);
+
+    measure_start(&m);
+    for (size_t i=0; i<bytes; ++i) {
+        if (hvml_string_push(&str, 'x')) return -1;
+        if ((i % 64) != 63) continue;
+        // token done, buffer reused for the next one
+        hvml_string_reset(&str);
+    }
+    measure_report(&m, "hvml_string_push+reset/64", bytes);
+    hvml_string_clear(&str);
+
+    return 0;
+}
+
+static int bench_parse(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <file>, but got nothing");
+        return -1;
+    }
+    int rounds = 10;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+
+    int r = 0;
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds; ++i) {
+        hvml_dom_gen_t *gen = hvml_dom_gen_create();
+        if (!gen) {
+            r = -1;
+            break;
+        }
+        r = hvml_dom_gen_parse(gen, buf, len);
+        hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
+        hvml_dom_gen_destroy(gen);
+        if (!dom) r = -1;
+        if (r) break;
+        hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_gen_parse", len * rounds);
+
+    free(buf);
+
+    return r ? -1 : 0;
+}
+
+static hvml_dom_t* load_dom(const char *file) {
+    size_t  len = 0;
+    char   *buf = load_file(file, &len);
+    if (!buf) return NULL;
+
+    hvml_dom_t *dom = NULL;
+    hvml_dom_gen_t *gen = hvml_dom_gen_create();
+    if (gen) {
+        if (hvml_dom_gen_parse(gen, buf, len)==0) {
+            dom = hvml_dom_gen_parse_end(gen);
+        }
+        hvml_dom_gen_destroy(gen);
+    }
+    free(buf);
+    if (!dom) {
+        E("failed to parse: %s", file);
+    }
+    return dom;
+}
+
+// one xpath per line, in the same format as test/*.xpath
+// returns the buffer that paths point into
+static char* load_paths(const char *file, const char **paths, size_t *npaths, size_t max) {
+    size_t  len = 0;
+    char   *buf = load_file(file, &len);
+    if (!buf) return NULL;
+
+    *npaths = 0;
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        while (*line==' ' || *line=='\t') ++line;
+        if (*line=='\0' || *line=='#') continue;
+        if (*npaths == max) break;
+        paths[(*npaths)++] = line;
+    }
+    return buf;
+}
+
+#ifndef _MSC_VER
+typedef struct xpath_reader_s            xpath_reader_t;
+struct xpath_reader_s {
+    pthread_t             thread;
+    hvml_dom_t           *dom;
+    hvml_dom_xpath_t    **xpaths;
+    size_t                nxpaths;
+    hvml_doms_t          *results;
+    int                   r;
+};
+
+static void* xpath_reader_routine(void *arg) {
+    xpath_reader_t *reader = (xpath_reader_t*)arg;
+    for (size_t j=0; j<reader->nxpaths && reader->r==0; ++j) {
+        reader->r = hvml_dom_xpath_exec(reader->xpaths[j], reader->dom, reader->results + j);
+    }
+    return NULL;
+}
+
+// a few readers query a freshly loaded dom at once, racing to number it in
+// document order, and each of them shall end up with the sequential results
+static int xpath_concurrent_check(const char *file, hvml_dom_xpath_t **xpaths, size_t nxpaths, int rounds) {
+    xpath_reader_t  readers[4];
+    const size_t    nreaders = sizeof(readers)/sizeof(readers[0]);
+    size_t          bad = 0;
+    int             r = 0;
+
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_dom_t *dom = load_dom(file);
+        if (!dom) return -1;
+
+        size_t n = 0;
+        for (; n<nreaders; ++n) {
+            xpath_reader_t *reader = readers + n;
+            reader->dom     = dom;
+            reader->xpaths  = xpaths;
+            reader->nxpaths = nxpaths;
+            reader->results = (hvml_doms_t*)calloc(nxpaths ? nxpaths : 1, sizeof(*reader->results));
+            reader->r       = 0;
+            if (!reader->results) break;
+            if (pthread_create(&reader->thread, NULL, xpath_reader_routine, reader)) {
+                free(reader->results);
+                break;
+            }
+        }
+        for (size_t k=0; k<n; ++k) {
+            pthread_join(readers[k].thread, NULL);
+            if (readers[k].r) r = -1;
+        }
+        if (n < nreaders) r = -1;
+
+        for (size_t j=0; j<nxpaths && r==0; ++j) {
+            hvml_doms_t doms = {0};
+            r = hvml_dom_xpath_exec(xpaths[j], dom, &doms);
+            for (size_t k=0; k<n && r==0; ++k) {
+                hvml_doms_t *res = readers[k].results + j;
+                if (res->ndoms != doms.ndoms ||
+                    (doms.ndoms && memcmp(res->doms, doms.doms, doms.ndoms * sizeof(*doms.doms))))
+                {
+                    bad += 1;
+                }
+            }
+            hvml_doms_cleanup(&doms);
+        }
+
+        for (size_t k=0; k<n; ++k) {
+            for (size_t j=0; j<nxpaths; ++j) {
+                hvml_doms_cleanup(readers[k].results + j);
+            }
+            free(readers[k].results);
+        }
+        hvml_dom_destroy(dom);
+    }
+
+    if (bad) {
+        E("%zd results of concurrent queries differ from sequential ones", bad);
+        r = -1;
+    }
+    return r;
+}
+#endif
+
+// the same few selectors evaluated again and again, as the runtime does
+static int bench_xpath(int argc, char *argv[]) {
+    if (argc < 2) {
+        E("expecting <hvml> <xpaths>, but got nothing");
+        return -1;
+    }
+    int rounds = 100;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    hvml_dom_t *dom = load_dom(argv[0]);
+    if (!dom) return -1;
+
+    const char *paths[256];
+    size_t      npaths = 0;
+    char *buf = load_paths(argv[1], paths, &npaths, sizeof(paths)/sizeof(paths[0]));
+    if (!buf) {
+        hvml_dom_destroy(dom);
+        return -1;
+    }
+    // skip those not supported by hvml_dom_query
+    size_t n = 0;
+    for (size_t j=0; j<npaths; ++j) {
+        hvml_dom_xpath_t *xpath = hvml_dom_xpath_compile(paths[j]);
+        if (!xpath) continue;
+        hvml_dom_xpath_destroy(xpath);
+        paths[n++] = paths[j];
+    }
+    npaths = n;
+
+    int r = 0;
+    char title[64];
+    size_t queries = npaths * (size_t)rounds;
+    measure_t m;
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        for (size_t j=0; j<npaths && r==0; ++j) {
+            hvml_doms_t doms = {0};
+            r = hvml_dom_query(dom, paths[j], &doms);
+            hvml_doms_cleanup(&doms);
+        }
+    }
+    snprintf(title, sizeof(title), "hvml_dom_query x%zu", queries);
+    measure_report(&m, title, 0);
+
+    if (r==0 && hvml_dom_xpath_cache_set_capacity(64)==0) {
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            for (size_t j=0; j<npaths && r==0; ++j) {
+                hvml_doms_t doms = {0};
+                r = hvml_dom_query(dom, paths[j], &doms);
+                hvml_doms_cleanup(&doms);
+            }
+        }
+        snprintf(title, sizeof(title), "hvml_dom_query+cache x%zu", queries);
+        measure_report(&m, title, 0);
+        hvml_dom_xpath_cache_set_capacity(0);
+    }
+
+    if (r==0) {
+        hvml_dom_xpath_t *xpaths[sizeof(paths)/sizeof(paths[0])];
+        for (size_t j=0; j<npaths; ++j) {
+            xpaths[j] = hvml_dom_xpath_compile(paths[j]);
+            if (!xpaths[j]) r = -1;
+        }
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            for (size_t j=0; j<npaths && r==0; ++j) {
+                hvml_doms_t doms = {0};
+                r = hvml_dom_xpath_exec(xpaths[j], dom, &doms);
+                hvml_doms_cleanup(&doms);
+            }
+        }
+        snprintf(title, sizeof(title), "hvml_dom_xpath_exec x%zu", queries);
+        measure_report(&m, title, 0);
+#ifndef _MSC_VER
+        if (r==0) {
+            measure_start(&m);
+            r = xpath_concurrent_check(argv[0], xpaths, npaths, rounds);
+            snprintf(title, sizeof(title), "hvml_dom_xpath_exec mt x%zu", queries * 4);
+            measure_report(&m, title, 0);
+        }
+#endif
+        for (size_t j=0; j<npaths; ++j) {
+            hvml_dom_xpath_destroy(xpaths[j]);
+        }
+    }
+
+    free(buf);
+    hvml_dom_destroy(dom);
+
+    return r ? -1 : 0;
+}
+
+// antlr4 counterpart of bench_xpath
+static int bench_qry(int argc, char *argv[]) {
+    if (argc < 2) {
+        E("expecting <hvml> <xpaths>, but got nothing");
+        return -1;
+    }
+    int rounds = 100;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    hvml_dom_t *dom = load_dom(argv[0]);
+    if (!dom) return -1;
+
+    const char *paths[256];
+    size_t      npaths = 0;
+    char *buf = load_paths(argv[1], paths, &npaths, sizeof(paths)/sizeof(paths[0]));
+    if (!buf) {
+        hvml_dom_destroy(dom);
+        return -1;
+    }
+
+    int r = 0;
+    char title[64];
+    size_t queries = npaths * (size_t)rounds;
+    measure_t m;
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        for (size_t j=0; j<npaths && r==0; ++j) {
+            hvml_doms_t doms = {0};
+            r = hvml_dom_qry(dom, paths[j], &doms);
+            hvml_doms_cleanup(&doms);
+        }
+    }
+    snprintf(title, sizeof(title), "hvml_dom_qry x%zu", queries);
+    measure_report(&m, title, 0);
+
+    if (r==0 && hvml_dom_qry_cache_set_capacity(64)==0) {
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            for (size_t j=0; j<npaths && r==0; ++j) {
+                hvml_doms_t doms = {0};
+                r = hvml_dom_qry(dom, paths[j], &doms);
+                hvml_doms_cleanup(&doms);
+            }
+        }
+        snprintf(title, sizeof(title), "hvml_dom_qry+cache x%zu", queries);
+        measure_report(&m, title, 0);
+        hvml_dom_qry_cache_set_capacity(0);
+    }
+
+    if (r==0) {
+        hvml_dom_qry_t *qrys[sizeof(paths)/sizeof(paths[0])];
+        for (size_t j=0; j<npaths; ++j) {
+            qrys[j] = hvml_dom_qry_compile(paths[j]);
+            if (!qrys[j]) r = -1;
+        }
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            for (size_t j=0; j<npaths && r==0; ++j) {
+                hvml_doms_t doms = {0};
+                r = hvml_dom_qry_exec(qrys[j], dom, &doms);
+                hvml_doms_cleanup(&doms);
+            }
+        }
+        snprintf(title, sizeof(title), "hvml_dom_qry_exec x%zu", queries);
+        measure_report(&m, title, 0);
+        for (size_t j=0; j<npaths; ++j) {
+            hvml_dom_qry_destroy(qrys[j]);
+        }
+    }
+
+    free(buf);
+    hvml_dom_destroy(dom);
+
+    return r ? -1 : 0;
+}
+
+// positional predicate over a large table, thru antlr4
+static int bench_predicate(int argc, char *argv[]) {
+    size_t rows   = 10000;
+    int    rounds = 10;
+    if (argc > 0) rows   = (size_t)strtoull(argv[0], NULL, 0);
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    hvml_string_t str = {0};
+    int r = hvml_string_append(&str, "<hvml><body><table>");
+    for (size_t i=0; i<rows && r==0; ++i) {
+        r = hvml_string_append_printf(&str, "<tr><td>%zu</td></tr>", i);
+    }
+    if (r==0) r = hvml_string_append(&str, "</table></body></hvml>");
+    if (r) {
+        hvml_string_clear(&str);
+        return -1;
+    }
+
+    hvml_dom_t *dom = NULL;
+    hvml_dom_gen_t *gen = hvml_dom_gen_create();
+    if (gen) {
+        if (hvml_dom_gen_parse(gen, str.str, str.len)==0) {
+            dom = hvml_dom_gen_parse_end(gen);
+        }
+        hvml_dom_gen_destroy(gen);
+    }
+    hvml_string_clear(&str);
+    if (!dom) return -1;
+
+    const char *path = "//tr[position() mod 2 = 0]";
+    hvml_dom_qry_t *qry = hvml_dom_qry_compile(path);
+    if (!qry) {
+        hvml_dom_destroy(dom);
+        return -1;
+    }
+
+    char title[64];
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_doms_t doms = {0};
+        r = hvml_dom_qry_exec(qry, dom, &doms);
+        if (r==0 && doms.ndoms != rows / 2) {
+            E("expecting %zu nodes, but got %zu", rows / 2, doms.ndoms);
+            r = -1;
+        }
+        hvml_doms_cleanup(&doms);
+    }
+    snprintf(title, sizeof(title), "%s x%d", path, rounds);
+    measure_report(&m, title, 0);
+
+    hvml_dom_qry_destroy(qry);
+    hvml_dom_destroy(dom);
+
+    return r ? -1 : 0;
+}
+
+// output small enough to be written by the final flush only shall still
+// report a failed write
+static int serialize_failure_check(void) {
+#ifndef _MSC_VER
+    FILE *full = fopen("/dev/full", "wb");
+    if (!full) return 0;
+    setvbuf(full, NULL, _IONBF, 0);
+
+    static const char small[] = "<hvml><body><p id=\"a\">hello</p></body></hvml>";
+    hvml_dom_t      *dom = NULL;
+    hvml_dom_gen_t  *gen = hvml_dom_gen_create();
+    if (gen) {
+        if (hvml_dom_gen_parse(gen, small, sizeof(small) - 1)==0) {
+            dom = hvml_dom_gen_parse_end(gen);
+        }
+        hvml_dom_gen_destroy(gen);
+    }
+    hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer("[1,2,3]", 7);
+
+    int r = 0;
+    if (!dom || !jo) {
+        r = -1;
+    } else if (hvml_dom_printf(dom, full)==0 ||
+               hvml_jo_value_printf(jo, full)==0 ||
+               hvml_json_str_printf(full, "hello", 5)==0 ||
+               hvml_dom_str_serialize_file("hello", 5, full)==0)
+    {
+        E("writing to /dev/full succeeded");
+        r = -1;
+    }
+    if (dom) hvml_dom_destroy(dom);
+    if (jo)  hvml_jo_value_free(jo);
+    fclose(full);
+
+    return r;
+#else
+    return 0;
+#endif
+}
+
+// serializing a page full of text that needs escaping now and then
+static int bench_serialize(int argc, char *argv[]) {
+    size_t kbytes = 1024;
+    int    rounds = 10;
+    if (argc > 0) kbytes = (size_t)strtoull(argv[0], NULL, 0);
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    hvml_string_t str = {0};
+    int r = hvml_string_append(&str, "<hvml><body>");
+    for (size_t i=0; str.len < kbytes * 1024 && r==0; ++i) {
+        r = hvml_string_append_printf(&str,
+                "<p class=\"c%zu\" title=\"a &quot;b&quot; &amp; c\">"
+                "paragraph %zu: lorem ipsum dolor sit amet, a &lt; b &amp;&amp; b &gt; c, "
+                "consectetur adipiscing elit</p>", i % 16, i);
+    }
+    if (r==0) r = hvml_string_append(&str, "</body></hvml>");
+    if (r) {
+        hvml_string_clear(&str);
+        return -1;
+    }
+
+    hvml_dom_t *dom = NULL;
+    hvml_dom_gen_t *gen = hvml_dom_gen_create();
+    if (gen) {
+        if (hvml_dom_gen_parse(gen, str.str, str.len)==0) {
+            dom = hvml_dom_gen_parse_end(gen);
+        }
+        hvml_dom_gen_destroy(gen);
+    }
+    hvml_string_clear(&str);
+    if (!dom) return -1;
+
+    size_t bytes = 0;
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_string_t out = {0};
+        r = hvml_dom_serialize_string(dom, &out);
+        bytes += out.len;
+        hvml_string_clear(&out);
+    }
+    measure_report(&m, "hvml_dom_serialize_string", bytes);
+
+    hvml_dom_destroy(dom);
+
+    if (r==0) r = serialize_failure_check();
+
+    return r ? -1 : 0;
+}
+
+// walks thru buf as the serializers do, returns the number of escapes found
+static size_t escape_walk(HVML_ESCAPE_ISA isa, HVML_ESCAPE_SET set, const char *buf, size_t len) {
+    size_t hits = 0;
+    size_t i    = 0;
+    while (i < len) {
+        i += hvml_escape_scan_isa(isa, set, buf + i, len - i);
+        if (i == len) break;
+        ++hits;
+        ++i;
+    }
+    return hits;
+}
+
+// every kernel shall agree with the scalar one, at any offset and length
+static int escape_check(HVML_ESCAPE_ISA isa, HVML_ESCAPE_SET set, const char *buf, size_t len) {
+    for (size_t off=0; off<64 && off<len; ++off) {
+        for (size_t n=0; n<=160 && off+n<=len; ++n) {
+            size_t a = hvml_escape_scan_isa(HVML_ESCAPE_ISA_SCALAR, set, buf + off, n);
+            size_t b = hvml_escape_scan_isa(isa, set, buf + off, n);
+            if (a != b) {
+                E("%s: set %d, offset %zu, len %zu: expecting %zu, but got %zu",
+                  hvml_escape_isa_name(isa), set, off, n, a, b);
+                return -1;
+            }
+        }
+    }
+    size_t a = escape_walk(HVML_ESCAPE_ISA_SCALAR, set, buf, len);
+    size_t b = escape_walk(isa, set, buf, len);
+    if (a != b) {
+        E("%s: set %d: expecting %zu escapes, but got %zu", hvml_escape_isa_name(isa), set, a, b);
+        return -1;
+    }
+    return 0;
+}
+
+// scanning text for bytes to escape, one kernel after another
+static int bench_escape(int argc, char *argv[]) {
+    size_t kbytes = 1024;
+    int    rounds = 10;
+    if (argc > 0) kbytes = (size_t)strtoull(argv[0], NULL, 0);
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    // mostly plain text, with something special every 128 bytes or so
+    // \x01 and \v are not escaped, but fall into the same range as \b..\r
+    static const char specials[] = { '&', '<', '"', '\\', '\b', '\t', '\f', '\r', '\n', '\0', '\x01', '\v' };
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 .,;:!?'()";
+    size_t len = kbytes * 1024;
+    char  *buf = (char*)malloc(len + 1);
+    if (!buf) return -1;
+    unsigned int seed = 20201;
+    for (size_t i=0; i<len; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int v = (seed >> 16) & 0x7fff;
+        if (v % 128 == 0) buf[i] = specials[(v >> 7) % sizeof(specials)];
+        else              buf[i] = plain[v % (sizeof(plain) - 1)];
+    }
+    buf[len] = '\0';
+
+    static const HVML_ESCAPE_SET sets[] = { HVML_ESCAPE_DOM_TEXT, HVML_ESCAPE_DOM_ATTR, HVML_ESCAPE_JSON };
+    static const HVML_ESCAPE_ISA isas[] = { HVML_ESCAPE_ISA_SCALAR, HVML_ESCAPE_ISA_SSE2, HVML_ESCAPE_ISA_AVX2 };
+    static const char *set_names[] = { "text", "attr", "json" };
+
+    int r = 0;
+    for (size_t k=0; k<sizeof(isas)/sizeof(isas[0]) && r==0; ++k) {
+        HVML_ESCAPE_ISA isa = isas[k];
+        if (!hvml_escape_isa_supported(isa)) {
+            fprintf(stdout, "%-32s not supported\n", hvml_escape_isa_name(isa));
+            continue;
+        }
+        for (size_t j=0; j<sizeof(sets)/sizeof(sets[0]) && r==0; ++j) {
+            r = escape_check(isa, sets[j], buf, len);
+            if (r) break;
+
+            char title[64];
+            size_t hits = 0;
+            measure_t m;
+            measure_start(&m);
+            for (int i=0; i<rounds; ++i) {
+                hits += escape_walk(isa, sets[j], buf, len);
+            }
+            snprintf(title, sizeof(title), "%s/%s, %zu hits", hvml_escape_isa_name(isa), set_names[j], hits);
+            measure_report(&m, title, len * rounds);
+        }
+    }
+
+    free(buf);
+
+    return r ? -1 : 0;
+}
+
+// loading a document from disk, thru stdio vs. thru a mapping
+static int bench_load(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <file>, but got nothing");
+        return -1;
+    }
+    int rounds = 10;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+    free(buf);
+
+    int r = 0;
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        FILE *in = fopen(argv[0], "rb");
+        if (!in) {
+            r = -1;
+            break;
+        }
+        hvml_dom_t *dom = hvml_dom_load_from_stream(in);
+        fclose(in);
+        if (!dom) r = -1;
+        else      hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_load_from_stream", len * rounds);
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_dom_t *dom = hvml_dom_load_from_file(argv[0]);
+        if (!dom) r = -1;
+        else      hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_load_from_file", len * rounds);
+
+    return r ? -1 : 0;
+}
+
+// json nested depth levels deep shall survive a round trip through a snapshot
+static int snapshot_deep_check(const char *snap, size_t depth) {
+    hvml_string_t str = {0};
+    int r = hvml_string_append(&str, "<hvml><init>");
+    for (size_t i=0; i<depth && r==0; ++i) r = hvml_string_push(&str, '[');
+    for (size_t i=0; i<depth && r==0; ++i) r = hvml_string_push(&str, ']');
+    if (r==0) r = hvml_string_append(&str, "</init></hvml>");
+
+    hvml_dom_t *dom = NULL;
+    hvml_dom_gen_t *gen = r ? NULL : hvml_dom_gen_create();
+    if (gen) {
+        if (hvml_dom_gen_parse(gen, str.str, str.len)==0) {
+            dom = hvml_dom_gen_parse_end(gen);
+        }
+        hvml_dom_gen_destroy(gen);
+    }
+    hvml_string_clear(&str);
+    if (!dom) return -1;
+
+    r = hvml_dom_save_snapshot(dom, snap);
+    hvml_dom_destroy(dom);
+    if (r) return -1;
+
+    dom = hvml_dom_load_snapshot(snap);
+    if (!dom) return -1;
+
+    hvml_dom_t *d = hvml_dom_child(dom);
+    if (d) d = hvml_dom_child(d);
+    if (d) d = hvml_dom_child(d);
+    size_t levels = 0;
+    if (d && hvml_dom_type(d)==MKDOT(D_JSON)) {
+        for (hvml_jo_value_t *v = hvml_dom_jo(d); v; v = hvml_jo_value_child(v)) levels += 1;
+    }
+    hvml_dom_destroy(dom);
+    if (levels != depth) {
+        E("%zu levels of json out of %zu", levels, depth);
+        return -1;
+    }
+    return 0;
+}
+
+// parsing a document vs. loading its binary snapshot
+static int bench_snapshot(int argc, char *argv[]) {
+    if (argc < 2) {
+        E("expecting <file> <snap>, but got %d", argc);
+        return -1;
+    }
+    int rounds = 10;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+    free(buf);
+
+    hvml_dom_t *dom = hvml_dom_load_from_file(argv[0]);
+    if (!dom) return -1;
+    int r = hvml_dom_save_snapshot(dom, argv[1]);
+    hvml_dom_destroy(dom);
+    if (r) return -1;
+
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        dom = hvml_dom_load_from_file(argv[0]);
+        if (!dom) r = -1;
+        else      hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_load_from_file", len * rounds);
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        dom = hvml_dom_load_snapshot(argv[1]);
+        if (!dom) r = -1;
+        else      hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_load_snapshot", len * rounds);
+
+    if (r==0) r = snapshot_deep_check(argv[1], 200000);
+
+    return r ? -1 : 0;
+}
+
+static void footprint_report(const char *title, size_t nodes, size_t bytes) {
+#ifdef HB_WRAP_ALLOC
+    fprintf(stdout, "%-32s %10zu nodes %12zu bytes %10.1f bytes/node\n",
+            title, nodes, bytes, nodes ? (double)bytes / nodes : 0.);
+#else
+    (void)bytes;
+    fprintf(stdout, "%-32s %10zu nodes %12s bytes\n", title, nodes, "n/a");
+#endif
+}
+
+// memory held by a document of hvml_dom_t's, vs. by its packed counterpart
+static int bench_footprint(int argc, char *argv[]) {
+    size_t elements = 100000;
+    if (argc > 0) elements = (size_t)strtoull(argv[0], NULL, 0);
+
+    // <div>'s of 9 <li>'s each, under <hvml>
+    hvml_string_t str = {0};
+    int r = hvml_string_append(&str, "<hvml>");
+    for (size_t i=1; i<elements && r==0; ++i) {
+        if ((i % 10) == 1) {
+            if (i > 1) r = hvml_string_append(&str, "</div>");
+            if (r==0)  r = hvml_string_append_printf(&str, "<div id=\"d%zu\">", i / 10);
+            continue;
+        }
+        r = hvml_string_append_printf(&str, "<li class=\"item\" n=\"%zu\">item %zu</li>", i, i);
+    }
+    if (r==0 && elements > 1) r = hvml_string_append(&str, "</div>");
+    if (r==0) r = hvml_string_append(&str, "</hvml>");
+    if (r) {
+        hvml_string_clear(&str);
+        return -1;
+    }
+
+    for (int with_arena=0; with_arena<2 && r==0; ++with_arena) {
+        size_t          base = live;
+        hvml_dom_gen_t *gen  = with_arena ? hvml_dom_gen_create_with_arena() : hvml_dom_gen_create();
+        if (!gen) {
+            r = -1;
+            break;
+        }
+        r = hvml_dom_gen_parse(gen, str.str, str.len);
+        hvml_dom_t *dom = r ? NULL : hvml_dom_gen_parse_end(gen);
+        hvml_dom_gen_destroy(gen);
+        if (!dom) {
+            r = -1;
+            break;
+        }
+        size_t bytes = live - base;
+
+        base = live;
+        hvml_dom_pack_t *pack = hvml_dom_pack(dom);
+        if (!pack) {
+            hvml_dom_destroy(dom);
+            r = -1;
+            break;
+        }
+        size_t packed = live - base;
+        size_t nodes  = hvml_dom_pack_nodes(pack);
+
+        footprint_report(with_arena ? "hvml_dom_t, arena" : "hvml_dom_t", nodes, bytes);
+        if (!with_arena) {
+            footprint_report("hvml_dom_pack_t", nodes, packed);
+            fprintf(stdout, "%-32s %10zu nodes %12zu bytes %10.1f bytes/node\n", "hvml_dom_pack_footprint",
+                    nodes, hvml_dom_pack_footprint(pack), (double)hvml_dom_pack_footprint(pack) / nodes);
+        }
+
+        hvml_dom_pack_destroy(pack);
+        hvml_dom_destroy(dom);
+    }
+
+    hvml_string_clear(&str);
+
+    return r ? -1 : 0;
+}
+
+// <div>'s nested depth levels deep, each with an attr and a text
+// and json arrays nested depth levels deep at the bottom
+static hvml_dom_t* destroy_deep_dom(size_t depth) {
+    hvml_dom_t *top = hvml_dom_add_tag(NULL, "div", 3);
+    hvml_dom_t *d   = top;
+    for (size_t i=0; i<depth && d; ++i) {
+        if (!hvml_dom_append_attr(d, "id", 2, "x", 1)) d = NULL;
+        else if (!hvml_dom_append_content(d, "text", 4)) d = NULL;
+        else d = hvml_dom_add_tag(d, "div", 3);
+    }
+    hvml_jo_value_t *jo = d ? hvml_jo_array() : NULL;
+    hvml_jo_value_t *v  = jo;
+    for (size_t i=0; i<depth && v; ++i) {
+        hvml_jo_value_t *a = hvml_jo_array();
+        if (a && hvml_jo_value_push(v, a)) {
+            hvml_jo_value_free(a);
+            a = NULL;
+        }
+        v = a;
+    }
+    if (!v || !hvml_dom_append_json(d, jo)) {
+        if (jo) hvml_jo_value_free(jo);
+        if (top) hvml_dom_destroy(top);
+        return NULL;
+    }
+    return top;
+}
+
+// tearing down deeply nested documents, which shall not depend on stack depth
+static int bench_destroy(int argc, char *argv[]) {
+    size_t depth = 1000000;
+    if (argc > 0) depth = (size_t)strtoull(argv[0], NULL, 0);
+    int rounds = 1;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    int r = 0;
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_dom_t *dom = destroy_deep_dom(depth);
+        if (!dom) {
+            r = -1;
+            break;
+        }
+        measure_t m;
+        measure_start(&m);
+        hvml_dom_destroy(dom);
+        measure_report(&m, "hvml_dom_destroy, deep", 0);
+    }
+
+    return r ? -1 : 0;
+}
+
+// per-request cost of generating a document from a template
+// the content of the top-most tag of <hvml> is repeated `scale` times
+static int bench_clone(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <hvml>, but got nothing");
+        return -1;
+    }
+    size_t scale = 1000;
+    if (argc > 1) scale = (size_t)strtoull(argv[1], NULL, 0);
+    int rounds = 10;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+
+    const char *open  = strstr(buf, "<hvml");
+    const char *inner = open ? strchr(open, '>') : NULL;
+    const char *close = inner ? strstr(inner, "</hvml>") : NULL;
+    if (!close) {
+        E("no <hvml>...</hvml> in [%s]", argv[0]);
+        free(buf);
+        return -1;
+    }
+    inner += 1;
+
+    hvml_string_t str = {0};
+    int r = hvml_string_append_n(&str, open, (size_t)(inner - open));
+    for (size_t i=0; i<scale && r==0; ++i) {
+        r = hvml_string_append_n(&str, inner, (size_t)(close - inner));
+    }
+    if (r==0) r = hvml_string_append(&str, "</hvml>");
+    free(buf);
+
+    hvml_dom_gen_t *gen = r ? NULL : hvml_dom_gen_create();
+    if (gen) {
+        r = hvml_dom_gen_parse(gen, str.str, str.len);
+    }
+    hvml_dom_t *tmpl = (gen && r==0) ? hvml_dom_gen_parse_end(gen) : NULL;
+    if (gen) hvml_dom_gen_destroy(gen);
+    size_t text = str.len;
+    hvml_string_clear(&str);
+    if (!tmpl) return -1;
+
+    for (int shared=0; shared<2 && r==0; ++shared) {
+        size_t    bytes = 0;   // in use right after cloning
+        measure_t m;
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            size_t      base = live;
+            hvml_dom_t *dom  = shared ? hvml_dom_clone_shared(tmpl) : hvml_dom_clone(tmpl);
+            if (!dom) {
+                r = -1;
+                break;
+            }
+            bytes += live - base;
+            hvml_dom_destroy(dom);
+        }
+        measure_report(&m, shared ? "hvml_dom_clone_shared" : "hvml_dom_clone", text * rounds);
+#ifdef HB_WRAP_ALLOC
+        if (rounds > 0) fprintf(stdout, "%-32s %10zu bytes per clone\n", "", bytes / rounds);
+#else
+        (void)bytes;
+#endif
+    }
+
+    hvml_dom_destroy(tmpl);
+
+    return r ? -1 : 0;
+}
+
+// checks lookups into jo against walking thru its children
+// mismatches are counted into arg
+static int jo_lookup_check(hvml_jo_value_t *jo, int lvl, int action, void *arg) {
+    (void)lvl;
+    size_t *bad = (size_t*)arg;
+    if (action!=1) return 0;
+
+    switch (hvml_jo_value_type(jo)) {
+        case MKJOT(J_OBJECT): {
+            for (hvml_jo_value_t *kv = hvml_jo_value_child(jo); kv; kv = hvml_jo_value_sibling_next(kv)) {
+                const char *key = NULL;
+                size_t      len = 0;
+                hvml_jo_kv_get_key(kv, &key, &len);
+                hvml_jo_value_t *v = hvml_jo_object_get_kv_by_key(jo, key, len);
+                const char *k = NULL;
+                size_t      n = 0;
+                if (v) hvml_jo_kv_get_key(v, &k, &n);
+                if (!v || n!=len || memcmp(k, key, len)) *bad += 1;
+            }
+        } break;
+        case MKJOT(J_ARRAY): {
+            size_t i = 0;
+            for (hvml_jo_value_t *v = hvml_jo_value_child(jo); v; v = hvml_jo_value_sibling_next(v)) {
+                if (hvml_jo_array_get(jo, i++) != v) *bad += 1;
+            }
+        } break;
+        default: break;
+    }
+
+    return 0;
+}
+
+#ifndef _MSC_VER
+typedef struct jo_reader_s            jo_reader_t;
+struct jo_reader_s {
+    pthread_t             thread;
+    hvml_jo_value_t      *jo;
+    size_t                bad;
+};
+
+static void* jo_reader_routine(void *arg) {
+    jo_reader_t *reader = (jo_reader_t*)arg;
+    hvml_jo_value_traverse(reader->jo, &reader->bad, jo_lookup_check);
+    return NULL;
+}
+#endif
+
+// cloning json values, whose strings are shared rather than copied
+// the template is an object of `scale` kv's, each holding a clone of <json>
+// the first clone is then looked up by a few readers at once, indices of which
+// are built lazily by whoever comes first
+static int bench_jo_clone(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <json>, but got nothing");
+        return -1;
+    }
+    size_t scale = 1000;
+    if (argc > 1) scale = (size_t)strtoull(argv[1], NULL, 0);
+    int rounds = 10;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    hvml_jo_value_t *jo = hvml_jo_value_load_from_file(argv[0]);
+    if (!jo) return -1;
+
+    int r = 0;
+    hvml_jo_value_t *tmpl = hvml_jo_object();
+    if (!tmpl) r = -1;
+    for (size_t i=0; i<scale && r==0; ++i) {
+        char key[32];
+        snprintf(key, sizeof(key), "%zu", i);
+        hvml_jo_value_t *kv = hvml_jo_object_kv(key, strlen(key));
+        hvml_jo_value_t *v  = hvml_jo_clone(jo);
+        if (!kv || !v || hvml_jo_value_push(kv, v)) {
+            if (v)  hvml_jo_value_free(v);
+            if (kv) hvml_jo_value_free(kv);
+            r = -1;
+            break;
+        }
+        if (!hvml_jo_object_append_kv(tmpl, kv)) {
+            hvml_jo_value_free(kv);
+            r = -1;
+        }
+    }
+    hvml_jo_value_free(jo);
+
+    hvml_jo_value_t *first = NULL;
+    size_t    bytes = 0;   // in use right after cloning
+    measure_t m;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        size_t           base = live;
+        hvml_jo_value_t *v    = hvml_jo_clone(tmpl);
+        if (!v) {
+            r = -1;
+            break;
+        }
+        bytes += live - base;
+        if (first) hvml_jo_value_free(v);
+        else       first = v;
+    }
+    measure_report(&m, "hvml_jo_clone", 0);
+#ifdef HB_WRAP_ALLOC
+    if (rounds > 0) fprintf(stdout, "%-32s %10zu bytes per clone\n", "", bytes / rounds);
+#else
+    (void)bytes;
+#endif
+
+    if (first) {
+        size_t bad = 0;
+#ifndef _MSC_VER
+        jo_reader_t readers[4];
+        size_t      n = 0;
+        for (; n<sizeof(readers)/sizeof(readers[0]); ++n) {
+            readers[n].jo  = first;
+            readers[n].bad = 0;
+            if (pthread_create(&readers[n].thread, NULL, jo_reader_routine, readers + n)) break;
+        }
+        for (size_t i=0; i<n; ++i) {
+            pthread_join(readers[i].thread, NULL);
+            bad += readers[i].bad;
+        }
+#endif
+        // and once more, after indices have been built
+        hvml_jo_value_traverse(first, &bad, jo_lookup_check);
+        if (bad) {
+            E("%zu lookups mismatched", bad);
+            r = -1;
+        }
+        hvml_jo_value_free(first);
+    }
+
+    if (tmpl) hvml_jo_value_free(tmpl);
+
+    return r ? -1 : 0;
+}
+
+// numbers printed back, without and with the origin text kept
+// kept origins are printed as is
+// as items of arrays, a bare number is not terminated till the end
+typedef struct number_fixture_s          number_fixture_t;
+struct number_fixture_s {
+    const char          *text;
+    const char          *printed;
+    const char          *printed_with_origin;
+};
+
+static const number_fixture_t number_fixtures[] = {
+    { "[0]",                      "[0]",                       "[0]"                      },
+    { "[-0]",                     "[-0]",                      "[-0]"                     },
+    { "[-0.0]",                   "[-0]",                      "[-0.0]"                   },
+    { "[1e309]",                  "[null]",                    "[1e309]"                  },
+    { "[-1e309]",                 "[null]",                    "[-1e309]"                 },
+    { "[1.7976931348623157e308]", "[1.7976931348623157e+308]", "[1.7976931348623157e308]" },
+    { "[0.30000000000000004]",    "[0.30000000000000004]",     "[0.30000000000000004]"    },
+    { "[0.10000000000000001]",    "[0.1]",                     "[0.10000000000000001]"    },
+    { "[12345678901234567]",      "[12345678901234567]",       "[12345678901234567]"      },
+    { "[9223372036854775807]",    "[9223372036854775807]",     "[9223372036854775807]"    },
+    { "[-9223372036854775808]",   "[-9223372036854775808]",    "[-9223372036854775808]"   },
+    { "[9223372036854775808]",    "[9.223372036854776e+18]",   "[9223372036854775808]"    },
+    { "[-9223372036854775809]",   "[-9.223372036854776e+18]",  "[-9223372036854775809]"   },
+    { "[18446744073709551615]",   "[1.8446744073709552e+19]",  "[18446744073709551615]"   },
+};
+
+static int numbers_round_trip(void) {
+    size_t bad = 0;
+    for (size_t i=0; i<sizeof(number_fixtures)/sizeof(number_fixtures[0]); ++i) {
+        const number_fixture_t *fx = number_fixtures + i;
+        for (int keep=0; keep<2; ++keep) {
+            const char    *expected = keep ? fx->printed_with_origin : fx->printed;
+            hvml_string_t  str      = {0};
+            hvml_jo_gen_t *gen      = hvml_jo_gen_create();
+            if (!gen) return -1;
+            hvml_jo_gen_set_keep_origin(gen, keep);
+            hvml_jo_value_t *jo = hvml_jo_gen_parse_buffer(gen, fx->text, strlen(fx->text));
+            hvml_jo_gen_destroy(gen);
+            if (!jo || hvml_jo_value_serialize_string(jo, &str) || !str.str || strcmp(str.str, expected)) {
+                E("%s%s: expecting %s, but got %s", fx->text, keep ? ", origin kept" : "",
+                  expected, str.str ? str.str : "nothing");
+                bad += 1;
+            }
+            hvml_string_clear(&str);
+            if (jo) hvml_jo_value_free(jo);
+        }
+    }
+    return bad ? -1 : 0;
+}
+
+// a json array of `count` numbers, 9 out of 10 are integers
+static int numbers_json(hvml_string_t *str, size_t count) {
+    uint64_t seed = 88172645463325252ULL;
+    int r = hvml_string_push(str, '[');
+    for (size_t i=0; i<count && r==0; ++i) {
+        // xorshift64
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        if (i) r = hvml_string_push(str, ',');
+        if (r) break;
+        switch (seed % 10) {
+            case 0:  r = hvml_string_append_printf(str, "%d.%02d", (int)((seed >> 40) % 100000), (int)((seed >> 20) % 100)); break;
+            case 1:  r = hvml_string_append_printf(str, "-%" PRIu64, (seed >> 24));                                      break;
+            default: r = hvml_string_append_printf(str, "%" PRIu64, (seed >> (seed % 48)));                             break;
+        }
+    }
+    if (r==0) r = hvml_string_push(str, ']');
+    return r;
+}
+
+// parsing json numbers: scanning, and then building jo values
+// with or without keeping the origin text
+static int bench_numbers(int argc, char *argv[]) {
+    size_t count = 100000;
+    if (argc > 0) count = (size_t)strtoull(argv[0], NULL, 0);
+    int rounds = 10;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    if (numbers_round_trip()) return -1;
+
+    hvml_string_t str = {0};
+    if (numbers_json(&str, count)) {
+        hvml_string_clear(&str);
+        return -1;
+    }
+
+    int r = 0;
+    measure_t m;
+
+    // scanning only, token by token
+    for (int fast=0; fast<2 && r==0; ++fast) {
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            const char *p = str.str + 1;     // past '['
+            while (r==0) {
+                const char *e = p;
+                while (*e!=',' && *e!=']') ++e;
+                if (e==p) break;
+                if (fast) {
+                    hvml_json_number_t num;
+                    r = hvml_json_number_parse(p, (size_t)(e - p), &num);
+                } else {
+                    char        buf[64];
+                    long double d = 0;
+                    size_t      n = (size_t)(e - p) < sizeof(buf) ? (size_t)(e - p) : sizeof(buf) - 1;
+                    memcpy(buf, p, n);
+                    buf[n] = '\0';
+                    r = hvml_string_to_number(buf, &d);
+                }
+                if (*e==']') break;
+                p = e + 1;
+            }
+        }
+        measure_report(&m, fast ? "hvml_json_number_parse" : "hvml_string_to_number", str.len * rounds);
+    }
+
+    for (int keep=0; keep<2 && r==0; ++keep) {
+        size_t bytes = 0;   // in use right after parsing
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            size_t         base = live;
+            hvml_jo_gen_t *gen  = hvml_jo_gen_create();
+            if (!gen) {
+                r = -1;
+                break;
+            }
+            hvml_jo_gen_set_keep_origin(gen, keep);
+            r = hvml_jo_gen_parse(gen, str.str, str.len);
+            hvml_jo_value_t *jo = hvml_jo_gen_parse_end(gen);
+            hvml_jo_gen_destroy(gen);
+            if (!jo) r = -1;
+            if (r) break;
+            bytes += live - base;
+            hvml_jo_value_free(jo);
+        }
+        measure_report(&m, keep ? "hvml_jo_gen_parse, origin kept" : "hvml_jo_gen_parse", str.len * rounds);
+#ifdef HB_WRAP_ALLOC
+        if (rounds > 0) fprintf(stdout, "%-32s %10zu bytes per parse\n", "", bytes / rounds);
+#else
+        (void)bytes;
+#endif
+    }
+
+    hvml_string_clear(&str);
+
+    return r ? -1 : 0;
+}
+
+static hvml_jo_value_t* json_parse_with(int isa, const char *buf, size_t len) {
+    hvml_jo_gen_t *gen = hvml_jo_gen_create();
+    if (!gen) return NULL;
+
+    hvml_jo_value_t *jo = NULL;
+    if (isa < 0) {
+        int r = hvml_jo_gen_parse(gen, buf, len);
+        jo = hvml_jo_gen_parse_end(gen);
+        if (r && jo) {
+            hvml_jo_value_free(jo);
+            jo = NULL;
+        }
+    } else {
+        hvml_escape_set_isa((HVML_ESCAPE_ISA)isa);
+        jo = hvml_jo_gen_parse_buffer(gen, buf, len);
+    }
+    hvml_jo_gen_destroy(gen);
+
+    return jo;
+}
+
+// parsing json into jo values, incrementally vs. in one go
+// <json> is repeated `scale` times as items of an array
+// the results shall be the same whichever kernel indexes the structurals
+static int bench_json(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <json>, but got nothing");
+        return -1;
+    }
+    size_t scale = 1000;
+    if (argc > 1) scale = (size_t)strtoull(argv[1], NULL, 0);
+    int rounds = 10;
+    if (argc > 2) rounds = atoi(argv[2]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+
+    hvml_string_t str = {0};
+    int r = hvml_string_push(&str, '[');
+    for (size_t i=0; i<scale && r==0; ++i) {
+        if (i) r = hvml_string_append(&str, ",\n");
+        if (r==0) r = hvml_string_append_n(&str, buf, len);
+    }
+    if (r==0) r = hvml_string_append(&str, "]\n");
+    free(buf);
+
+    static const HVML_ESCAPE_ISA isas[] = { HVML_ESCAPE_ISA_SCALAR, HVML_ESCAPE_ISA_SSE2, HVML_ESCAPE_ISA_AVX2 };
+    HVML_ESCAPE_ISA saved = hvml_escape_get_isa();
+
+    hvml_string_t expected = {0};
+    hvml_string_t got      = {0};
+    measure_t m;
+
+    for (int k=-1; k<(int)(sizeof(isas)/sizeof(isas[0])) && r==0; ++k) {
+        int  isa = k < 0 ? -1 : (int)isas[k];
+        char title[64];
+        if (isa < 0) {
+            snprintf(title, sizeof(title), "hvml_jo_gen_parse");
+        } else {
+            snprintf(title, sizeof(title), "hvml_jo_gen_parse_buffer/%s", hvml_escape_isa_name((HVML_ESCAPE_ISA)isa));
+            if (!hvml_escape_isa_supported((HVML_ESCAPE_ISA)isa)) {
+                fprintf(stdout, "%-32s not supported\n", title);
+                continue;
+            }
+        }
+
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            hvml_jo_value_t *jo = json_parse_with(isa, str.str, str.len);
+            if (!jo) {
+                r = -1;
+                break;
+            }
+            hvml_jo_value_free(jo);
+        }
+        measure_report(&m, title, str.len * rounds);
+
+        hvml_jo_value_t *jo = r ? NULL : json_parse_with(isa, str.str, str.len);
+        if (!jo) {
+            r = -1;
+            break;
+        }
+        hvml_string_t *out = isa < 0 ? &expected : &got;
+        hvml_string_reset(out);
+        r = hvml_jo_value_serialize_string(jo, out);
+        hvml_jo_value_free(jo);
+        if (r==0 && isa >= 0 && (expected.len != got.len || memcmp(expected.str, got.str, got.len))) {
+            E("%s: differs from hvml_jo_gen_parse", title);
+            r = -1;
+        }
+    }
+    hvml_escape_set_isa(saved);
+
+    hvml_string_clear(&expected);
+    hvml_string_clear(&got);
+    hvml_string_clear(&str);
+
+    return r ? -1 : 0;
+}
+
+// a typical body of an http request
+static const char small_json[] =
+    "{\"id\":1024,\"method\":\"update\",\"params\":{\"device\":\"sensor-07\","
+    "\"values\":[21.5,22.25,-3,0.125],\"unit\":\"celsius\",\"ok\":true,"
+    "\"tags\":[\"room\",\"north\"],\"note\":null},\"ts\":\"2020-10-16T08:00:00Z\"}";
+
+static const char small_hvml[] =
+    "<hvml><body><init as=\"users\">[{\"id\":1,\"name\":\"foo\"},{\"id\":2}]</init>"
+    "<p id=\"greeting\">hello</p></body></hvml>";
+
+static void* small_routine(void *arg) {
+    int *r = (int*)arg;
+    for (int i=0; i<100 && *r==0; ++i) {
+        hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer(small_json, sizeof(small_json) - 1);
+        if (!jo) *r = -1;
+        else     hvml_jo_value_free(jo);
+    }
+    return NULL;
+}
+
+static int small_dom(hvml_dom_gen_t *gen, hvml_string_t *out) {
+    int r = hvml_dom_gen_parse(gen, small_hvml, sizeof(small_hvml) - 1);
+    hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
+    if (!dom) return -1;
+    if (r==0 && out) {
+        hvml_string_reset(out);
+        r = hvml_dom_serialize_string(dom, out);
+    }
+    hvml_dom_destroy(dom);
+    return r ? -1 : 0;
+}
+
+// many small documents: fresh generators vs. reset/pooled ones
+// the latter shall allocate only for the values they produce
+static int bench_small(int argc, char *argv[]) {
+    int rounds = 100000;
+    if (argc > 0) rounds = atoi(argv[0]);
+
+    const size_t len = sizeof(small_json) - 1;
+    int r = 0;
+    measure_t m;
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_jo_gen_t *gen = hvml_jo_gen_create();
+        hvml_jo_value_t *jo = gen ? hvml_jo_gen_parse_buffer(gen, small_json, len) : NULL;
+        if (gen) hvml_jo_gen_destroy(gen);
+        if (!jo) r = -1;
+        else     hvml_jo_value_free(jo);
+    }
+    measure_report(&m, "hvml_jo_gen_create", len * rounds);
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer(small_json, len);
+        if (!jo) r = -1;
+        else     hvml_jo_value_free(jo);
+    }
+    measure_report(&m, "hvml_jo_value_load_from_buffer", len * rounds);
+
+    // pooled ones are reset and thus reusable after failures
+    for (int i=0; i<2 && r==0; ++i) {
+        hvml_jo_gen_t *gen = hvml_jo_gen_acquire();
+        if (!gen) {
+            r = -1;
+            break;
+        }
+        hvml_jo_gen_set_keep_origin(gen, 1);
+        if (hvml_jo_gen_parse(gen, small_json, len / 2)) r = -1;
+        hvml_jo_gen_release(gen);
+        hvml_jo_value_t *jo = hvml_jo_value_load_from_buffer("[1,", 3);
+        if (jo) {
+            hvml_jo_value_free(jo);
+            r = -1;
+        }
+    }
+
+    // and destroyed when the thread exits
+#ifndef _MSC_VER
+    if (r==0) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, small_routine, &r)) r = -1;
+        else pthread_join(t, NULL);
+    }
+#endif
+
+    hvml_string_t expected = {0};
+    hvml_string_t got      = {0};
+    hvml_dom_gen_t *gen    = r ? NULL : hvml_dom_gen_create();
+    if (!gen) r = -1;
+    if (r==0) r = small_dom(gen, &expected);
+    if (r==0) {
+        // left half way, and then reset
+        hvml_dom_gen_reset(gen);
+        hvml_dom_gen_parse(gen, small_hvml, sizeof(small_hvml) / 2);
+        hvml_dom_gen_reset(gen);
+        r = small_dom(gen, &got);
+        if (r==0 && (expected.len != got.len || memcmp(expected.str, got.str, got.len))) {
+            E("hvml_dom_gen_reset: differs from a fresh generator");
+            r = -1;
+        }
+    }
+    if (gen) hvml_dom_gen_destroy(gen);
+    hvml_string_clear(&expected);
+    hvml_string_clear(&got);
+
+    if (r==0) {
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            hvml_dom_gen_t *gen = hvml_dom_gen_create();
+            if (!gen) r = -1;
+            else {
+                r = small_dom(gen, NULL);
+                hvml_dom_gen_destroy(gen);
+            }
+        }
+        measure_report(&m, "hvml_dom_gen_create", (sizeof(small_hvml) - 1) * rounds);
+    }
+
+    if (r==0) {
+        gen = hvml_dom_gen_create();
+        if (!gen) r = -1;
+        measure_start(&m);
+        for (int i=0; i<rounds && r==0; ++i) {
+            r = small_dom(gen, NULL);
+            hvml_dom_gen_reset(gen);
+        }
+        measure_report(&m, "hvml_dom_gen_reset", (sizeof(small_hvml) - 1) * rounds);
+        if (gen) hvml_dom_gen_destroy(gen);
+    }
+
+    return r ? -1 : 0;
+}
+
+// decoding utf8 byte by byte vs. in bulk
+// mostly ascii, with 2/3/4-byte sequences now and then
+static int bench_utf8(int argc, char *argv[]) {
+    size_t kbytes = 1024;
+    int    rounds = 10;
+    if (argc > 0) kbytes = (size_t)strtoull(argv[0], NULL, 0);
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    static const char *multi[] = { "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf" };
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 .,;:!?'()";
+    size_t    len = kbytes * 1024;
+    char     *buf = (char*)malloc(len + 4);
+    uint32_t *cps = (uint32_t*)malloc(len * sizeof(*cps));
+    if (!buf || !cps) {
+        free(buf);
+        free(cps);
+        return -1;
+    }
+    unsigned int seed = 20201;
+    size_t n = 0;
+    while (n<len) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int v = (seed >> 16) & 0x7fff;
+        if (v % 64 == 0) {
+            const char *p = multi[(v >> 6) % 4];
+            size_t      k = strlen(p);
+            if (n + k > len) break;
+            memcpy(buf + n, p, k);
+            n += k;
+        } else {
+            buf[n++] = plain[v % (sizeof(plain) - 1)];
+        }
+    }
+    len = n;
+
+    int r = 0;
+    measure_t m;
+
+    size_t   ncps = 0;
+    uint64_t sum0 = 0;
+    hvml_utf8_decoder_t *decoder = hvml_utf8_decoder();
+    if (!decoder) r = -1;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        for (size_t j=0; j<len; ++j) {
+            uint64_t cp = 0;
+            int ret = hvml_utf8_decoder_push(decoder, buf[j], &cp);
+            if (ret==-1) {
+                r = -1;
+                break;
+            }
+            if (ret==1) sum0 += cp;
+        }
+    }
+    measure_report(&m, "hvml_utf8_decoder_push", len * rounds);
+    hvml_utf8_decoder_destroy(decoder);
+
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        size_t off = 0;
+        if (hvml_utf8_validate(buf, len, &off)) r = -1;
+    }
+    measure_report(&m, "hvml_utf8_validate", len * rounds);
+
+    uint64_t sum1 = 0;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        size_t used = 0;
+        ncps = hvml_utf8_decode(buf, len, cps, len, &used);
+        if (used != len) r = -1;
+        for (size_t j=0; j<ncps; ++j) sum1 += cps[j];
+    }
+    measure_report(&m, "hvml_utf8_decode", len * rounds);
+
+    if (r==0 && sum0 != sum1) {
+        E("hvml_utf8_decode: differs from hvml_utf8_decoder_push");
+        r = -1;
+    }
+
+    free(buf);
+    free(cps);
+
+    return r ? -1 : 0;
+}
+
+// what the reader shall yield, tallied by parser callbacks
+typedef struct events_tally_s           events_tally_t;
+struct events_tally_s {
+    size_t                events;
+    size_t                bytes;      // of payloads, close tags excluded
+};
+
+static int tally(void *arg) {
+    ((events_tally_t*)arg)->events += 1;
+    return 0;
+}
+
+static int tally_str(void *arg, const char *str) {
+    tally(arg);
+    ((events_tally_t*)arg)->bytes += strlen(str);
+    return 0;
+}
+
+static int tally_strn(void *arg, const char *str, size_t len) {
+    (void)str;
+    tally(arg);
+    ((events_tally_t*)arg)->bytes += len;
+    return 0;
+}
+
+static int tally_number(void *arg, const hvml_json_number_t *num) {
+    tally(arg);
+    ((events_tally_t*)arg)->bytes += num->len;
+    return 0;
+}
+
+static int events_tally(const char *buf, size_t len, events_tally_t *t) {
+    hvml_parser_conf_t conf = {0};
+    conf.on_open_tag    = tally_str;
+    conf.on_attr_key    = tally_str;
+    conf.on_attr_val    = tally_str;
+    conf.on_close_tag   = tally;
+    conf.on_text        = tally_str;
+    conf.on_begin       = tally;
+    conf.on_open_array  = tally;
+    conf.on_close_array = tally;
+    conf.on_open_obj    = tally;
+    conf.on_close_obj   = tally;
+    conf.on_key         = tally_strn;
+    conf.on_true        = tally;
+    conf.on_false       = tally;
+    conf.on_null        = tally;
+    conf.on_string      = tally_strn;
+    conf.on_number      = tally_number;
+    conf.on_end         = tally;
+    conf.arg            = t;
+
+    hvml_parser_t *parser = hvml_parser_create(conf);
+    if (!parser) return -1;
+    int r = hvml_parser_parse(parser, buf, len);
+    if (r==0) r = hvml_parser_parse_end(parser);
+    hvml_parser_destroy(parser);
+    return r;
+}
+
+// pulling events vs. building the dom, and the peak of bytes in use
+static int bench_events(int argc, char *argv[]) {
+    if (argc < 1) {
+        E("expecting <hvml>, but got nothing");
+        return -1;
+    }
+    int rounds = 10;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    size_t  len = 0;
+    char   *buf = load_file(argv[0], &len);
+    if (!buf) return -1;
+
+    int r = 0;
+    measure_t m;
+
+    size_t base = live;
+    size_t peak = 0;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_dom_gen_t *gen = hvml_dom_gen_create();
+        if (!gen) {
+            r = -1;
+            break;
+        }
+        r = hvml_dom_gen_parse(gen, buf, len);
+        hvml_dom_t *dom = hvml_dom_gen_parse_end(gen);
+        hvml_dom_gen_destroy(gen);
+        if (!dom) r = -1;
+        if (live - base > peak) peak = live - base;
+        if (dom) hvml_dom_destroy(dom);
+    }
+    measure_report(&m, "hvml_dom_gen_parse", len * rounds);
+#ifdef HB_WRAP_ALLOC
+    fprintf(stdout, "%-32s %10zu bytes at peak\n", "", peak);
+#endif
+
+    events_tally_t expected = {0};
+    if (r==0) r = events_tally(buf, len, &expected);
+
+    size_t events = 0;
+    peak = 0;
+    measure_start(&m);
+    for (int i=0; i<rounds && r==0; ++i) {
+        hvml_reader_t *reader = hvml_reader_create(buf, len);
+        if (!reader) {
+            r = -1;
+            break;
+        }
+        events_tally_t      got = {0};
+        hvml_reader_event_t ev;
+        int ret = 0;
+        while ( (ret=hvml_reader_next(reader, &ev))==1) {
+            ++events;
+            got.events += 1;
+            if (ev.type!=HVML_READER_CLOSE_TAG) got.bytes += ev.len;
+            if (live - base > peak) peak = live - base;
+        }
+        hvml_reader_destroy(reader);
+        if (ret) r = -1;
+        if (r==0 && (got.events!=expected.events || got.bytes!=expected.bytes)) {
+            E("reader got %zu events of %zu bytes, but %zu events of %zu bytes expected",
+              got.events, got.bytes, expected.events, expected.bytes);
+            r = -1;
+        }
+    }
+    char title[64];
+    snprintf(title, sizeof(title), "hvml_reader_next, %zu events", rounds > 0 ? events / rounds : 0);
+    measure_report(&m, title, len * rounds);
+#ifdef HB_WRAP_ALLOC
+    fprintf(stdout, "%-32s %10zu bytes at peak\n", "", peak);
+#else
+    (void)peak;
+#endif
+
+    free(buf);
+
+    return r ? -1 : 0;
+}
+
+// names of the form <prefix>-<i>, interned or looked up
+// mismatches of names are counted into bad
+static void atoms_of(const char *prefix, size_t count, int intern, hvml_atom_t *out, size_t *bad) {
+    char name[64];
+    for (size_t i=0; i<count; ++i) {
+        int         n    = snprintf(name, sizeof(name), "%s-%zu", prefix, i);
+        hvml_atom_t atom = intern ? hvml_atom_intern(name, (size_t)n) : hvml_atom_lookup(name, (size_t)n);
+        if (!atom || hvml_atom_len(atom)!=(size_t)n || memcmp(hvml_atom_str(atom), name, (size_t)n)) {
+            *bad += 1;
+        }
+        if (out) out[i] = atom;
+    }
+}
+
+#ifndef _MSC_VER
+typedef struct atoms_worker_s            atoms_worker_t;
+struct atoms_worker_s {
+    pthread_t             thread;
+    const char           *prefix;
+    size_t                count;
+    hvml_atom_t          *atoms;
+    size_t                bad;
+};
+
+static void* atoms_routine(void *arg) {
+    atoms_worker_t *worker = (atoms_worker_t*)arg;
+    atoms_of(worker->prefix, worker->count, 1, worker->atoms, &worker->bad);
+    atoms_of(worker->prefix, worker->count, 0, NULL, &worker->bad);
+    return NULL;
+}
+#endif
+
+// interning new names, which grows the table, and looking them up again
+// then a few threads intern the same new names at once, and shall agree
+static int bench_atoms(int argc, char *argv[]) {
+    size_t count = 100000;
+    if (argc > 0) count = (size_t)strtoull(argv[0], NULL, 0);
+    int rounds = 10;
+    if (argc > 1) rounds = atoi(argv[1]);
+
+    const char *prefix = "atom";
+    size_t      bad    = 0;
+    measure_t m;
+    measure_start(&m);
+    atoms_of(prefix, count, 1, NULL, &bad);
+    measure_report(&m, "hvml_atom_intern, new", 0);
+
+    measure_start(&m);
+    for (int i=0; i<rounds; ++i) {
+        atoms_of(prefix, count, 1, NULL, &bad);
+    }
+    measure_report(&m, "hvml_atom_intern, existing", 0);
+
+    measure_start(&m);
+    for (int i=0; i<rounds; ++i) {
+        atoms_of(prefix, count, 0, NULL, &bad);
+    }
+    measure_report(&m, "hvml_atom_lookup", 0);
+
+#ifndef _MSC_VER
+    atoms_worker_t workers[4];
+    const size_t   nworkers = sizeof(workers)/sizeof(workers[0]);
+    int            r        = 0;
+    prefix = "shared";
+
+    measure_start(&m);
+    size_t n = 0;
+    for (; n<nworkers; ++n) {
+        atoms_worker_t *worker = workers + n;
+        worker->prefix = prefix;
+        worker->count  = count;
+        worker->atoms  = (hvml_atom_t*)calloc(count ? count : 1, sizeof(hvml_atom_t));
+        worker->bad    = 0;
+        if (!worker->atoms) break;
+        if (pthread_create(&worker->thread, NULL, atoms_routine, worker)) {
+            free(worker->atoms);
+            break;
+        }
+    }
+    for (size_t i=0; i<n; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        bad += workers[i].bad;
+    }
+    measure_report(&m, "hvml_atom_intern, 4 threads", 0);
+    if (n < nworkers) r = -1;
+
+    for (size_t i=1; i<n; ++i) {
+        if (memcmp(workers[i].atoms, workers[0].atoms, count * sizeof(hvml_atom_t))) bad += 1;
+    }
+    for (size_t i=0; i<n; ++i) {
+        free(workers[i].atoms);
+    }
+    if (r) return -1;
+#endif
+
+    if (bad) {
+        E("%zd atoms mismatched", bad);
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *arg0) {
+    fprintf(stderr, "usage: %s <bench> [args...]\n", arg0);
+    for (size_t i=0; i<sizeof(benches)/sizeof(benches[0]); ++i) {
+        fprintf(stderr, "    %-10s %s\n", benches[i].name, benches[i].args);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    hvml_log_set_thread_type("main");
+
+    for (size_t i=0; i<sizeof(benches)/sizeof(benches[0]); ++i) {
+        if (strcmp(argv[1], benches[i].name)) continue;
+        int r = benches[i].func(argc - 2, argv + 2);
+        return r ? 1 : 0;
+    }
+
+    E("unknown bench: [%s]", argv[1]);
+    usage(argv[0]);
+    return 1;
+}
+
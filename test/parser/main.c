@@ -18,10 +18,14 @@
 #include "hvml/hvml_parser.h"
 
 #include "hvml/hvml_dom.h"
+#include "hvml/hvml_dom_pack.h"
+#include "hvml/hvml_escape.h"
 #include "hvml/hvml_jo.h"
 #include "hvml/hvml_json_parser.h"
 #include "hvml/hvml_log.h"
 #include "hvml/hvml_printf.h"
+#include "hvml/hvml_reader.h"
+#include "hvml/hvml_string.h"
 #include "hvml/hvml_utf8.h"
 
 #include <ctype.h>
@@ -37,13 +41,20 @@
 #endif
 #endif
 
-static int with_clone = 0;
+static int with_clone = 0;        // 1: hvml_dom_clone, 2: hvml_dom_clone_shared
 static int with_antlr4 = 0;
+static int with_arena = 0;
+static int with_mmap = 0;
+static const char *with_snapshot = NULL;
+static int with_pack = 0;
+static int with_events = 0;
 
 static const char* file_ext(const char *file);
-static int process(FILE *in, const char *ext, hvml_dom_t *hvml);
-static int process_hvml(FILE *in);
-static int process_json(FILE *in);
+static int process(FILE *in, const char *file, const char *ext, hvml_dom_t *hvml);
+static hvml_dom_t* load_hvml(FILE *in, const char *file);
+static int process_hvml(FILE *in, const char *file);
+static int process_events(const char *file);
+static int process_json(FILE *in, const char *file);
 static int process_utf8(FILE *in);
 static int process_xpath(FILE *in, hvml_dom_t *hvml);
 
@@ -127,6 +138,10 @@ int main(int argc, char *argv[]) {
             with_clone = 1;
             continue;
         }
+        if (strcmp(arg, "-s")==0) {
+            with_clone = 2;
+            continue;
+        }
         if (strcmp(arg, "--hvml")==0) {
             ++i;
             if (i>=argc) {
@@ -140,6 +155,56 @@ int main(int argc, char *argv[]) {
             with_antlr4 = 1;
             continue;
         }
+        if (strcmp(arg, "--arena")==0) {
+            with_arena = 1;
+            continue;
+        }
+        if (strcmp(arg, "--snapshot")==0) {
+            ++i;
+            if (i>=argc) {
+                E("expecting <snapshot>, but got nothing");
+                ok = 0;
+                break;
+            }
+            with_snapshot = argv[i];
+            continue;
+        }
+        if (strcmp(arg, "--mmap")==0) {
+            with_mmap = 1;
+            continue;
+        }
+        if (strcmp(arg, "--pack")==0) {
+            with_pack = 1;
+            continue;
+        }
+        if (strcmp(arg, "--events")==0) {
+            with_events = 1;
+            continue;
+        }
+        if (strcmp(arg, "--escape")==0) {
+            ++i;
+            if (i>=argc) {
+                E("expecting <scalar/sse2/avx2>, but got nothing");
+                ok = 0;
+                break;
+            }
+            HVML_ESCAPE_ISA isa = HVML_ESCAPE_ISA_AUTO;
+            if (strcmp(argv[i], "scalar")==0) {
+                isa = HVML_ESCAPE_ISA_SCALAR;
+            } else if (strcmp(argv[i], "sse2")==0) {
+                isa = HVML_ESCAPE_ISA_SSE2;
+            } else if (strcmp(argv[i], "avx2")==0) {
+                isa = HVML_ESCAPE_ISA_AVX2;
+            } else {
+                E("expecting <scalar/sse2/avx2>, but got [%s]", argv[i]);
+                ok = 0;
+                break;
+            }
+            // output shall be the same whichever kernel is used
+            // thus falls back to the default one silently
+            hvml_escape_set_isa(isa);
+            continue;
+        }
         const char *file = argv[i];
         const char *ext  = file_ext(file);
 
@@ -164,7 +229,7 @@ int main(int argc, char *argv[]) {
                     hvml_dom_destroy(hvml);
                     hvml = NULL;
                 }
-                hvml = hvml_dom_load_from_stream(in);
+                hvml = load_hvml(in, buf);
                 fclose(in); in = NULL;
                 if (!hvml) {
                     E("failed to load hvml from file: %s", buf);
@@ -176,7 +241,7 @@ int main(int argc, char *argv[]) {
 
         if (ok) {
             I("processing file: %s", file);
-            int ret = process(in, ext, hvml);
+            int ret = process(in, file, ext, hvml);
             ok = ret ? 0 : 1;
         }
 
@@ -195,27 +260,97 @@ static const char* file_ext(const char *file) {
     return p ? p : "";
 }
 
-static int process(FILE *in, const char *ext, hvml_dom_t *hvml) {
+static int process(FILE *in, const char *file, const char *ext, hvml_dom_t *hvml) {
     if (strcmp(ext, ".utf8")==0) {
         return process_utf8(in);
     } else if (strcmp(ext, ".json")==0) {
-        return process_json(in);
+        return process_json(in, file);
     }else if (strcmp(ext, ".xpath")==0) {
         return process_xpath(in, hvml);
+    } else if (with_events) {
+        return process_events(file);
     } else {
-        return process_hvml(in);
+        return process_hvml(in, file);
+    }
+}
+
+static hvml_dom_t* load_hvml_(FILE *in, const char *file);
+
+// saves what is loaded as a snapshot, and loads it back in place
+// both shall print the same
+static hvml_dom_t* thru_snapshot(hvml_dom_t *dom, const char *file) {
+    hvml_dom_t    *snap = NULL;
+    hvml_string_t  s1   = {0};
+    hvml_string_t  s2   = {0};
+    do {
+        if (hvml_dom_serialize_string(dom, &s1)) break;
+        if (hvml_dom_save_snapshot(dom, with_snapshot)) break;
+        snap = hvml_dom_load_snapshot(with_snapshot);
+        if (!snap) break;
+        if (hvml_dom_serialize_string(snap, &s2)) break;
+        if (s1.len!=s2.len || memcmp(s1.str, s2.str, s1.len)) {
+            E("snapshot of [%s] does not print the same", file);
+            hvml_dom_destroy(snap);
+            snap = NULL;
+        }
+    } while (0);
+    hvml_string_clear(&s1);
+    hvml_string_clear(&s2);
+    hvml_dom_destroy(dom);
+
+    return snap;
+}
+
+// packs what is loaded, and unpacks it in place
+static hvml_dom_t* thru_pack(hvml_dom_t *dom) {
+    hvml_dom_pack_t *pack = hvml_dom_pack(dom);
+    hvml_dom_destroy(dom);
+    if (!pack) return NULL;
+
+    dom = hvml_dom_unpack(pack);
+    hvml_dom_pack_destroy(pack);
+
+    return dom;
+}
+
+static hvml_dom_t* load_hvml(FILE *in, const char *file) {
+    hvml_dom_t *dom = load_hvml_(in, file);
+    if (dom && with_snapshot) dom = thru_snapshot(dom, file);
+    if (dom && with_pack)     dom = thru_pack(dom);
+    return dom;
+}
+
+static hvml_dom_t* load_hvml_(FILE *in, const char *file) {
+    if (with_mmap)   return hvml_dom_load_from_file(file);
+    if (!with_arena) return hvml_dom_load_from_stream(in);
+
+    hvml_dom_gen_t *gen = hvml_dom_gen_create_with_arena();
+    if (!gen) return NULL;
+
+    char buf[4096] = {0};
+    int  n         = 0;
+    int  ret       = 0;
+
+    while ( (n=fread(buf, 1, sizeof(buf), in))>0) {
+        ret = hvml_dom_gen_parse(gen, buf, n);
+        if (ret) break;
     }
+    hvml_dom_t *dom = ret ? NULL : hvml_dom_gen_parse_end(gen);
+    hvml_dom_gen_destroy(gen);
+
+    return dom;
 }
 
-static int process_hvml(FILE *in) {
+static int process_hvml(FILE *in, const char *file) {
     int r = 1;
-    hvml_dom_t *dom = hvml_dom_load_from_stream(in);
+    hvml_dom_t *dom = load_hvml(in, file);
     do {
         if (!dom) break;
 
         A(hvml_dom_type(dom)==MKDOT(D_ROOT), "internal logic error");
         if (with_clone) {
-            hvml_dom_t *v = hvml_dom_clone(dom);
+            // the source goes first, what's shared shall outlive it
+            hvml_dom_t *v = with_clone==2 ? hvml_dom_clone_shared(dom) : hvml_dom_clone(dom);
             if (!v) break;
             A(hvml_dom_type(v)==hvml_dom_type(dom), "internal logic error");
             hvml_dom_destroy(dom);
@@ -230,9 +365,50 @@ static int process_hvml(FILE *in) {
     return r ? 1 : 0;
 }
 
-static int process_json(FILE *in) {
+// one event per line, with its string if any
+static int process_events(const char *file) {
+    hvml_reader_t *reader = hvml_reader_create_from_file(file);
+    if (!reader) {
+        E("failed to read file: %s", file);
+        return 1;
+    }
+
+    hvml_reader_event_t ev;
+    int r = 0;
+    while ( (r=hvml_reader_next(reader, &ev))==1) {
+        // tags at the level of their parents, attrs and children one level in
+        size_t lvl = hvml_reader_depth(reader);
+        if (ev.type==HVML_READER_OPEN_TAG) --lvl;
+        fprintf(stdout, "%*s%s", (int)lvl * 2, "", hvml_reader_event_str(ev.type));
+        switch (ev.type) {
+            case HVML_READER_OPEN_TAG:
+            case HVML_READER_ATTR_KEY:
+            case HVML_READER_ATTR_VAL:
+            case HVML_READER_CLOSE_TAG:
+            case HVML_READER_TEXT:
+            case HVML_READER_KEY:
+            case HVML_READER_STRING:
+            {
+                fprintf(stdout, " ");
+                hvml_json_str_printf(stdout, ev.str, ev.len);
+            } break;
+            case HVML_READER_NUMBER:
+            {
+                fprintf(stdout, " %.*s", (int)ev.len, ev.str);
+            } break;
+            default: break;
+        }
+        fprintf(stdout, "\n");
+    }
+    hvml_reader_destroy(reader);
+
+    return r ? 1 : 0;
+}
+
+static int process_json(FILE *in, const char *file) {
     int r = 1;
-    hvml_jo_value_t *jo = hvml_jo_value_load_from_stream(in);
+    hvml_jo_value_t *jo = with_mmap ? hvml_jo_value_load_from_file(file)
+                                    : hvml_jo_value_load_from_stream(in);
     do {
         if (!jo) break;
 